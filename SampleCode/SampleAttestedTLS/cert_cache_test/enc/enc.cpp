@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+/* Enclave side of the certificate cache test. It creates certificates
+ * with tee_get_certificate_with_evidence() and hands their SHA-256 to the
+ * host, which compares them and counts the quotes it was asked for.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "sgx_tcrypto.h"
+#include "../../common/utility.h"
+#include "cert_cache_test_t.h"
+
+#define TEST_KEYS 2
+
+static uint8_t *g_public_key[TEST_KEYS];
+static size_t g_public_key_size[TEST_KEYS];
+static uint8_t *g_private_key[TEST_KEYS];
+static size_t g_private_key_size[TEST_KEYS];
+
+void t_print(const char *fmt, ...)
+{
+    char buf[BUFSIZ] = {'\0'};
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(buf, BUFSIZ, fmt, ap);
+    va_end(ap);
+    ocall_print_string(buf);
+}
+
+void t_time(time_t *current_t)
+{
+    ocall_get_current_time((uint64_t*)current_t);
+}
+
+int ecall_init_keys(void)
+{
+    for (int i = 0; i < TEST_KEYS; i++) {
+        if (g_public_key[i] != NULL)
+            continue;
+        if (generate_key_pair(EC_TYPE, &g_public_key[i], &g_public_key_size[i],
+                &g_private_key[i], &g_private_key_size[i]) != SGX_SUCCESS) {
+            t_print("failed to generate key pair %d\n", i);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int ecall_set_certificate_cache(uint32_t ttl_seconds, uint32_t max_entries)
+{
+    quote3_error_t ret = tee_set_certificate_cache(ttl_seconds, max_entries);
+    if (ret != SGX_QL_SUCCESS) {
+        t_print("tee_set_certificate_cache failed with 0x%x\n", ret);
+        return -1;
+    }
+    return 0;
+}
+
+int ecall_get_certificate(int key_index, uint8_t digest[32])
+{
+    if (key_index < 0 || key_index >= TEST_KEYS || g_public_key[key_index] == NULL)
+        return -1;
+
+    uint8_t *cert = NULL;
+    size_t cert_size = 0;
+    quote3_error_t ret = tee_get_certificate_with_evidence(certificate_subject_name,
+        g_private_key[key_index], g_private_key_size[key_index],
+        g_public_key[key_index], g_public_key_size[key_index],
+        &cert, &cert_size);
+    if (ret != SGX_QL_SUCCESS) {
+        t_print("tee_get_certificate_with_evidence failed with 0x%x\n", ret);
+        return -1;
+    }
+
+    sgx_status_t status = sgx_sha256_msg(cert, (uint32_t)cert_size, (sgx_sha256_hash_t *)digest);
+    tee_free_certificate(cert);
+    return status == SGX_SUCCESS ? 0 : -1;
+}
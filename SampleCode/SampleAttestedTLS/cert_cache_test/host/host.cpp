@@ -0,0 +1,332 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+/* Host side of the certificate cache test.
+ *
+ * The host answers the sgx_ttls.edl OCALLs with a stand-in quoting
+ * provider: every quote carries a new serial number, so every certificate
+ * generated from a fresh quote has a different digest, and the host clock
+ * is a counter the test moves by hand. No PCE/QE or PCCS is needed.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "sgx_urts.h"
+#include "cert_cache_test_u.h"
+
+#define FAKE_QUOTE_SIZE 1024
+#define DIGEST_SIZE 32
+
+static sgx_enclave_id_t g_eid = 0;
+static uint32_t g_quotes = 0;         /* quotes handed to the enclave */
+static time_t g_fake_time = 1000000;  /* clock returned by sgx_tls_get_time_ocall */
+
+quote3_error_t sgx_tls_get_qe_target_info_ocall(sgx_target_info_t *p_target_info,
+    size_t target_info_size)
+{
+    if (p_target_info == NULL || target_info_size != sizeof(sgx_target_info_t))
+        return SGX_QL_ERROR_INVALID_PARAMETER;
+    memset(p_target_info, 0, target_info_size);
+    return SGX_QL_SUCCESS;
+}
+
+quote3_error_t sgx_tls_get_quote_size_ocall(uint32_t *p_quote_size)
+{
+    if (p_quote_size == NULL)
+        return SGX_QL_ERROR_INVALID_PARAMETER;
+    *p_quote_size = FAKE_QUOTE_SIZE;
+    return SGX_QL_SUCCESS;
+}
+
+quote3_error_t sgx_tls_get_quote_ocall(sgx_report_t *p_report, size_t report_size,
+    uint8_t *p_quote, uint32_t quote_size)
+{
+    if (p_report == NULL || report_size != sizeof(sgx_report_t)
+            || p_quote == NULL || quote_size != FAKE_QUOTE_SIZE)
+        return SGX_QL_ERROR_INVALID_PARAMETER;
+
+    g_quotes++;
+    memset(p_quote, 0, quote_size);
+    memcpy(p_quote, &g_quotes, sizeof(g_quotes));
+    memcpy(p_quote + sizeof(g_quotes), &p_report->body, sizeof(p_report->body));
+    return SGX_QL_SUCCESS;
+}
+
+quote3_error_t sgx_tls_get_supplemental_data_size_ocall(uint32_t *p_supplemental_data_size)
+{
+    if (p_supplemental_data_size == NULL)
+        return SGX_QL_ERROR_INVALID_PARAMETER;
+    *p_supplemental_data_size = 0;
+    return SGX_QL_SUCCESS;
+}
+
+quote3_error_t sgx_tls_get_time_ocall(time_t *p_time)
+{
+    if (p_time == NULL)
+        return SGX_QL_ERROR_INVALID_PARAMETER;
+    *p_time = g_fake_time;
+    return SGX_QL_SUCCESS;
+}
+
+/* The test never verifies certificates. */
+quote3_error_t sgx_tls_verify_quote_ocall(const uint8_t *p_quote, uint32_t quote_size,
+    time_t expiration_check_date, sgx_ql_qv_result_t *p_quote_verification_result,
+    sgx_ql_qe_report_info_t *p_qve_report_info, size_t qve_report_info_size,
+    uint8_t *p_supplemental_data, uint32_t supplemental_data_size)
+{
+    (void)p_quote;
+    (void)quote_size;
+    (void)expiration_check_date;
+    (void)p_quote_verification_result;
+    (void)p_qve_report_info;
+    (void)qve_report_info_size;
+    (void)p_supplemental_data;
+    (void)supplemental_data_size;
+    return SGX_QL_ERROR_UNEXPECTED;
+}
+
+void ocall_print_string(const char *str)
+{
+    printf("%s", str);
+}
+
+int ocall_close(int fd)
+{
+    (void)fd;
+    return -1;
+}
+
+void ocall_get_current_time(uint64_t *p_current_time)
+{
+    if (p_current_time != NULL)
+        *p_current_time = (uint64_t)g_fake_time;
+}
+
+#define CHECK(cond)                                                       \
+    do {                                                                  \
+        if (!(cond)) {                                                    \
+            printf("    check failed at line %d: %s\n", __LINE__, #cond); \
+            return 1;                                                     \
+        }                                                                 \
+    } while (0)
+
+static int set_cache(uint32_t ttl_seconds, uint32_t max_entries)
+{
+    int ret = -1;
+    if (ecall_set_certificate_cache(g_eid, &ret, ttl_seconds, max_entries) != SGX_SUCCESS)
+        return -1;
+    return ret;
+}
+
+static int get_cert(int key_index, uint8_t digest[DIGEST_SIZE])
+{
+    int ret = -1;
+    if (ecall_get_certificate(g_eid, &ret, key_index, digest) != SGX_SUCCESS)
+        return -1;
+    return ret;
+}
+
+/* The cache never lets its clock go backwards, so every test starts
+ * later than anything an earlier test has shown it.
+ */
+static void advance_clock()
+{
+    g_fake_time += 1000;
+}
+
+static int test_cache_disabled()
+{
+    uint8_t a[DIGEST_SIZE], b[DIGEST_SIZE];
+
+    CHECK(set_cache(0, 0) == 0);
+    uint32_t quotes = g_quotes;
+    CHECK(get_cert(0, a) == 0);
+    CHECK(get_cert(0, b) == 0);
+    CHECK(g_quotes == quotes + 2);
+    CHECK(memcmp(a, b, DIGEST_SIZE) != 0);
+    return 0;
+}
+
+static int test_cache_hit()
+{
+    uint8_t a[DIGEST_SIZE], b[DIGEST_SIZE];
+
+    CHECK(set_cache(100, 0) == 0);
+    uint32_t quotes = g_quotes;
+    CHECK(get_cert(0, a) == 0);
+    CHECK(g_quotes == quotes + 1);
+    g_fake_time += 10;
+    CHECK(get_cert(0, b) == 0);
+    CHECK(g_quotes == quotes + 1);
+    CHECK(memcmp(a, b, DIGEST_SIZE) == 0);
+    return 0;
+}
+
+static int test_cache_per_key()
+{
+    uint8_t a[DIGEST_SIZE], b[DIGEST_SIZE], c[DIGEST_SIZE];
+
+    CHECK(set_cache(100, 0) == 0);
+    uint32_t quotes = g_quotes;
+    CHECK(get_cert(0, a) == 0);
+    CHECK(get_cert(1, b) == 0);
+    CHECK(g_quotes == quotes + 2);
+    CHECK(memcmp(a, b, DIGEST_SIZE) != 0);
+    CHECK(get_cert(0, c) == 0);
+    CHECK(g_quotes == quotes + 2);
+    CHECK(memcmp(a, c, DIGEST_SIZE) == 0);
+    return 0;
+}
+
+/* In the last fifth of the TTL the first caller regenerates and the
+ * callers after it get the new certificate.
+ */
+static int test_cache_refresh()
+{
+    uint8_t a[DIGEST_SIZE], b[DIGEST_SIZE], c[DIGEST_SIZE];
+
+    CHECK(set_cache(100, 0) == 0);
+    uint32_t quotes = g_quotes;
+    CHECK(get_cert(0, a) == 0);
+    g_fake_time += 80;
+    CHECK(get_cert(0, b) == 0);
+    CHECK(g_quotes == quotes + 2);
+    CHECK(memcmp(a, b, DIGEST_SIZE) != 0);
+    CHECK(get_cert(0, c) == 0);
+    CHECK(g_quotes == quotes + 2);
+    CHECK(memcmp(b, c, DIGEST_SIZE) == 0);
+    return 0;
+}
+
+static int test_cache_expiry()
+{
+    uint8_t a[DIGEST_SIZE], b[DIGEST_SIZE];
+
+    CHECK(set_cache(100, 0) == 0);
+    uint32_t quotes = g_quotes;
+    CHECK(get_cert(0, a) == 0);
+    g_fake_time += 100;
+    CHECK(get_cert(0, b) == 0);
+    CHECK(g_quotes == quotes + 2);
+    CHECK(memcmp(a, b, DIGEST_SIZE) != 0);
+    return 0;
+}
+
+/* A host that stops its clock still gets a new quote after 1024 uses. */
+static int test_cache_use_limit()
+{
+    uint8_t a[DIGEST_SIZE], b[DIGEST_SIZE];
+
+    CHECK(set_cache(100, 0) == 0);
+    uint32_t quotes = g_quotes;
+    CHECK(get_cert(0, a) == 0);
+    for (int i = 0; i < 1024; i++) {
+        CHECK(get_cert(0, b) == 0);
+        CHECK(memcmp(a, b, DIGEST_SIZE) == 0);
+    }
+    CHECK(g_quotes == quotes + 1);
+    CHECK(get_cert(0, b) == 0);
+    CHECK(g_quotes == quotes + 2);
+    CHECK(memcmp(a, b, DIGEST_SIZE) != 0);
+    return 0;
+}
+
+/* Rewinding the host clock doesn't bring an expired certificate back. */
+static int test_cache_clock_rewind()
+{
+    uint8_t a[DIGEST_SIZE], b[DIGEST_SIZE], c[DIGEST_SIZE];
+
+    CHECK(set_cache(100, 0) == 0);
+    uint32_t quotes = g_quotes;
+    time_t start = g_fake_time;
+    CHECK(get_cert(0, a) == 0);
+    g_fake_time = start + 200;
+    CHECK(get_cert(1, b) == 0);
+    g_fake_time = start;
+    CHECK(get_cert(0, c) == 0);
+    CHECK(g_quotes == quotes + 3);
+    CHECK(memcmp(a, c, DIGEST_SIZE) != 0);
+    return 0;
+}
+
+typedef struct _test_case_t {
+    const char *name;
+    int (*run)();
+} test_case_t;
+
+static test_case_t g_tests[] = {
+    {"cache disabled", test_cache_disabled},
+    {"cache hit", test_cache_hit},
+    {"cache per key", test_cache_per_key},
+    {"cache refresh", test_cache_refresh},
+    {"cache expiry", test_cache_expiry},
+    {"cache use limit", test_cache_use_limit},
+    {"cache clock rewind", test_cache_clock_rewind},
+};
+
+int main(int argc, const char* argv[])
+{
+    if (argc != 2) {
+        printf("Usage: %s CERT_CACHE_TEST_ENCLAVE_PATH\n", argv[0]);
+        return 1;
+    }
+
+    sgx_status_t status = sgx_create_enclave(argv[1], SGX_DEBUG_FLAG, NULL, NULL, &g_eid, NULL);
+    if (status != SGX_SUCCESS) {
+        printf("Host: sgx_create_enclave failed with 0x%x\n", status);
+        return 1;
+    }
+
+    int ret = -1;
+    if (ecall_init_keys(g_eid, &ret) != SGX_SUCCESS || ret != 0) {
+        printf("Host: failed to generate the test keys\n");
+        sgx_destroy_enclave(g_eid);
+        return 1;
+    }
+
+    int failed = 0;
+    size_t count = sizeof(g_tests) / sizeof(g_tests[0]);
+    for (size_t i = 0; i < count; i++) {
+        advance_clock();
+        if (g_tests[i].run() != 0) {
+            printf("[FAIL] %s\n", g_tests[i].name);
+            failed++;
+        } else {
+            printf("[PASS] %s\n", g_tests[i].name);
+        }
+    }
+
+    set_cache(0, 0);
+    sgx_destroy_enclave(g_eid);
+    printf("Host: %s\n", failed == 0 ? "all certificate cache tests passed" : "certificate cache tests failed");
+    return failed == 0 ? 0 : 1;
+}
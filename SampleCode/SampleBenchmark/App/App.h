@@ -29,71 +29,33 @@
  *
  */
 
-#pragma once
 
-#ifndef _LRU_CACHE_H_
-#define _LRU_CACHE_H_
+#ifndef _APP_H_
+#define _APP_H_
 
 #include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
 
-#include <list>
+#include "sgx_error.h"       /* sgx_status_t */
+#include "sgx_eid.h"     /* sgx_enclave_id_t */
 
-/* STL map is implemented as a tree, hence all operations are O(logN)
-   STL unordered_map is implemented as hash, hence all operations are O(1)
-   http://stackoverflow.com/questions/2196995/is-there-any-advantage-of-using-map-over-unordered-map-in-case-of-trivial-keys
-   http://stackoverflow.com/questions/3902644/choosing-between-stdmap-and-stdunordered-map
-   */
+# define ENCLAVE_FILENAME "enclave.signed.so"
 
-#include <unordered_map>
+extern sgx_enclave_id_t global_eid;    /* global enclave id */
 
-/* this hasher code was needed since strict ansi don't allow 'long long' type
- * adding -U__STRICT_ANSI__ to the compilation flags solved the issue
- * leaving this code here for future reference
-namespace stlpmtx_std
-{
-template<> struct hash<uint64_t> {
-  size_t operator()(uint64_t x) const { return (size_t)x; }
-  };
-}
-*/
+/* Monotonic time in nanoseconds */
+uint64_t now_ns(void);
 
-typedef struct _list_node
-{
-	uint64_t key;
-} list_node_t;
+/* Print the error of a failed SGX call and exit */
+void check_status(sgx_status_t ret, const char *what);
 
-typedef struct _map_node
-{
-	void* data;
-	std::list<list_node_t*>::iterator list_it;
-} map_node_t;
+/* Benchmarks, one per App/<name>.cpp */
+void benchmark_ecall(void);
+void benchmark_aes_gcm(void);
+void benchmark_startup(void);
+void benchmark_memcpy_verw(void);
+void benchmark_mutex(void);
 
-typedef std::unordered_map<uint64_t, map_node_t*>::iterator map_iterator;
-typedef std::list<list_node_t*>::iterator list_iterator;
-
-class lru_cache
-{
-private:
-	std::list<list_node_t*> list;
-	std::unordered_map<uint64_t, map_node_t*> map;
-
-	list_iterator m_it; // for get_first and get_next sequence
-
-public:	
-	lru_cache();
-	~lru_cache();
-
-	void rehash(uint32_t size_);
-
-	bool add(uint64_t key, void* p);
-	void* get(uint64_t key);
-	void* find(uint64_t key); // only returns the object, do not bump it to the head
-	uint32_t size();
-
-	void* get_first();
-	void* get_next();
-	void* get_last();
-	void remove_last();
-};
-
-#endif // _LRU_CACHE_H_
+#endif /* !_APP_H_ */
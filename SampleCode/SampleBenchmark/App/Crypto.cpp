@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include <stdio.h>
+
+#include "App.h"
+#include "Enclave_u.h"
+
+#define AES_GCM_BYTES   (256U << 20)    /* bytes encrypted per record size */
+
+/* AES-GCM-128 throughput against the record size, with the key expanded
+ * for every record (one-shot API) or once (sgx_aes_gcm_key_init()).
+ */
+void benchmark_aes_gcm(void)
+{
+    static const uint32_t sizes[] = { 64, 256, 1024, 4096, 16384 };
+
+    printf("Measuring AES-GCM-128 encryption throughput inside the enclave...\n");
+    printf("%8s %16s %16s\n", "record", "one-shot GB/s", "key state GB/s");
+    for (size_t s = 0; s < sizeof sizes / sizeof sizes[0]; s++) {
+        uint32_t records = AES_GCM_BYTES / sizes[s];
+        double rate[2];
+        for (int reuse_key = 0; reuse_key < 2; reuse_key++) {
+            int retval = -1;
+            uint64_t start = now_ns();
+            check_status(ecall_aes_gcm(global_eid, &retval, sizes[s], records, reuse_key), "ecall_aes_gcm");
+            uint64_t elapsed = now_ns() - start;
+            if (retval != 0) {
+                printf("ERROR: AES-GCM encryption failed\n");
+                exit(-1);
+            }
+            rate[reuse_key] = (double)records * sizes[s] / (double)elapsed;
+        }
+        printf("%8u %16.2f %16.2f\n", sizes[s], rate[0], rate[1]);
+    }
+    printf("Done.\n");
+}
@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include <stdio.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "App.h"
+#include "Enclave_u.h"
+
+#define ECALL_RUN_NS        1000000000ULL   /* time each thread count runs */
+#define ECALL_CHECK_EVERY   1024            /* ECalls between clock reads */
+
+static std::atomic<bool> ecall_go(false);
+static std::atomic<bool> ecall_stop(false);
+
+/* Issue empty ECalls until told to stop. The first ECall binds a TCS to the
+ * thread before the timed part starts, so later ECalls take the bound TCS
+ * path of the uRTS.
+ */
+static void ecall_worker(uint64_t *calls)
+{
+    check_status(ecall_empty(global_eid), "ecall_empty");
+    while (!ecall_go.load())
+        std::this_thread::yield();
+
+    uint64_t n = 0;
+    while (!ecall_stop.load()) {
+        for (int i = 0; i < ECALL_CHECK_EVERY; i++)
+            ecall_empty(global_eid);
+        n += ECALL_CHECK_EVERY;
+    }
+    *calls = n;
+}
+
+/* ECall throughput against the number of calling threads. Every thread
+ * keeps its own TCS, so without contention in the uRTS the total rate
+ * grows with the thread count up to the number of cores.
+ */
+void benchmark_ecall(void)
+{
+    static const unsigned thread_counts[] = { 1, 2, 4, 8, 16 };
+    unsigned cores = std::thread::hardware_concurrency();
+
+    printf("Measuring empty ECall throughput against the number of threads (%u cores)...\n", cores);
+    printf("%8s %16s %16s\n", "threads", "ECalls/s", "ECalls/s/thread");
+    for (size_t t = 0; t < sizeof thread_counts / sizeof thread_counts[0]; t++) {
+        unsigned nthreads = thread_counts[t];
+        std::vector<uint64_t> calls(nthreads, 0);
+        std::vector<std::thread> threads;
+
+        ecall_go = false;
+        ecall_stop = false;
+        for (unsigned i = 0; i < nthreads; i++)
+            threads.push_back(std::thread(ecall_worker, &calls[i]));
+
+        uint64_t start = now_ns();
+        ecall_go = true;
+        while (now_ns() - start < ECALL_RUN_NS)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        ecall_stop = true;
+        for (unsigned i = 0; i < nthreads; i++)
+            threads[i].join();
+        uint64_t elapsed = now_ns() - start;
+
+        uint64_t total = 0;
+        for (unsigned i = 0; i < nthreads; i++)
+            total += calls[i];
+        double rate = (double)total * 1e9 / (double)elapsed;
+        printf("%8u %16.0f %16.0f\n", nthreads, rate, rate / nthreads);
+    }
+    printf("Done.\n");
+}
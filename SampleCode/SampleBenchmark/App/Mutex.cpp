@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include <stdio.h>
+#include <sys/resource.h>
+#include <thread>
+#include <vector>
+
+#include "App.h"
+#include "Enclave_u.h"
+
+#define MUTEX_ITERATIONS    200000U     /* locks per thread */
+#define MUTEX_HOLD          100U        /* counter increments under the lock */
+
+static void mutex_worker(int adaptive, int *result)
+{
+    check_status(ecall_mutex_contend(global_eid, result, adaptive, MUTEX_ITERATIONS, MUTEX_HOLD),
+                 "ecall_mutex_contend");
+}
+
+/* Voluntary context switches of the process. A waiter that sleeps on the
+ * mutex leaves the enclave and blocks in the uRTS, so this counts the
+ * sleep transitions.
+ */
+static uint64_t context_switches(void)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (uint64_t)usage.ru_nvcsw;
+}
+
+/* Lock throughput of a plain and an adaptive sgx_thread_mutex against the
+ * number of contending threads, and the rate at which waiters go to sleep
+ * outside the enclave.
+ */
+void benchmark_mutex(void)
+{
+    static const unsigned thread_counts[] = { 1, 2, 4, 8 };
+    int retval = -1;
+
+    check_status(ecall_mutex_setup(global_eid, &retval), "ecall_mutex_setup");
+    if (retval != 0) {
+        printf("ERROR: mutex setup failed\n");
+        exit(-1);
+    }
+
+    printf("Measuring sgx_thread_mutex contention (%u cores)...\n", std::thread::hardware_concurrency());
+    printf("%8s %10s %14s %14s\n", "threads", "mutex", "locks/s", "sleeps/s");
+    for (size_t t = 0; t < sizeof thread_counts / sizeof thread_counts[0]; t++) {
+        unsigned nthreads = thread_counts[t];
+        for (int adaptive = 0; adaptive < 2; adaptive++) {
+            std::vector<int> results(nthreads, -1);
+            std::vector<std::thread> threads;
+
+            uint64_t switches = context_switches();
+            uint64_t start = now_ns();
+            for (unsigned i = 0; i < nthreads; i++)
+                threads.push_back(std::thread(mutex_worker, adaptive, &results[i]));
+            for (unsigned i = 0; i < nthreads; i++)
+                threads[i].join();
+            uint64_t elapsed = now_ns() - start;
+            switches = context_switches() - switches;
+
+            for (unsigned i = 0; i < nthreads; i++) {
+                if (results[i] != 0) {
+                    printf("ERROR: mutex benchmark failed\n");
+                    exit(-1);
+                }
+            }
+            printf("%8u %10s %14.0f %14.0f\n", nthreads, adaptive ? "adaptive" : "plain",
+                   (double)nthreads * MUTEX_ITERATIONS * 1e9 / (double)elapsed,
+                   (double)switches * 1e9 / (double)elapsed);
+        }
+    }
+    printf("Done.\n");
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include <stdio.h>
+#include <algorithm>
+
+#include <sgx_urts.h>
+#include "App.h"
+
+/* Pages the loader adds for Enclave/Enclave.config.xml: the 64 MB heap and
+ * 20 stacks of 256 KB. Code, data, TCS and SSA pages are left out, they are
+ * a small fraction of the total.
+ */
+#define STARTUP_PAGES   ((0x4000000ULL + 20 * 0x40000ULL) / 4096)
+#define STARTUP_RUNS    10
+
+/* Enclave load throughput: creates and destroys a second instance of the
+ * benchmark enclave, and reports the time sgx_create_enclave() takes. Run it
+ * against two builds of the uRTS (LD_LIBRARY_PATH) to compare them.
+ */
+void benchmark_startup(void)
+{
+    uint64_t create_ns[STARTUP_RUNS];
+
+    printf("Measuring enclave creation time (%llu heap and stack pages)...\n", STARTUP_PAGES);
+    for (int run = 0; run < STARTUP_RUNS; run++) {
+        sgx_enclave_id_t eid = 0;
+        uint64_t start = now_ns();
+        check_status(sgx_create_enclave(ENCLAVE_FILENAME, SGX_DEBUG_FLAG, NULL, NULL, &eid, NULL), "sgx_create_enclave");
+        create_ns[run] = now_ns() - start;
+        sgx_destroy_enclave(eid);
+    }
+
+    std::sort(create_ns, create_ns + STARTUP_RUNS);
+    uint64_t median = create_ns[STARTUP_RUNS / 2];
+    printf("%12s %12s %14s\n", "min ms", "median ms", "pages/s");
+    printf("%12.2f %12.2f %14.0f\n", (double)create_ns[0] / 1e6, (double)median / 1e6,
+            (double)STARTUP_PAGES * 1e9 / (double)median);
+    printf("Done.\n");
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "sgx_tcrypto.h"
+#include "Enclave.h"
+#include "Enclave_t.h"
+
+/*
+ * ecall_aes_gcm:
+ *   Encrypts records of record_size bytes, each with its own IV. With
+ *   reuse_key, the key is expanded once with sgx_aes_gcm_key_init();
+ *   otherwise every record goes through sgx_rijndael128GCM_encrypt(),
+ *   which expands the key again. Returns 0 on success.
+ */
+int ecall_aes_gcm(uint32_t record_size, uint32_t records, int reuse_key)
+{
+    sgx_aes_gcm_128bit_key_t key = { 0 };
+    sgx_aes_gcm_128bit_tag_t mac;
+    uint8_t iv[SGX_AESGCM_IV_SIZE] = { 0 };
+    sgx_aes_state_handle_t state = NULL;
+    int ret = -1;
+
+    uint8_t *src = (uint8_t *)calloc(1, record_size);
+    uint8_t *dst = (uint8_t *)malloc(record_size);
+    if (src == NULL || dst == NULL)
+        goto out;
+    if (reuse_key && sgx_aes_gcm_key_init(key, sizeof(key), &state) != SGX_SUCCESS)
+        goto out;
+
+    for (uint32_t i = 0; i < records; i++) {
+        memcpy(iv, &i, sizeof(i));
+        sgx_status_t status = reuse_key
+            ? sgx_aes_gcm_key_encrypt(state, src, record_size, dst, iv, sizeof(iv), NULL, 0, &mac)
+            : sgx_rijndael128GCM_encrypt(&key, src, record_size, dst, iv, sizeof(iv), NULL, 0, &mac);
+        if (status != SGX_SUCCESS)
+            goto out;
+    }
+    ret = 0;
+
+out:
+    if (state != NULL)
+        sgx_aes_gcm_close(state);
+    free(dst);
+    free(src);
+    return ret;
+}
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "sgx_thread.h"
+#include "Enclave.h"
+#include "Enclave_t.h"
+
+#define MUTEX_GAP   64      /* pause iterations between two locks */
+
+/* [0] is a plain mutex, [1] an adaptive one */
+static sgx_thread_mutex_t mutexes[2];
+static volatile uint64_t shared_counter;
+
+/*
+ * ecall_mutex_setup:
+ *   Initializes both mutexes, the adaptive one through its attributes.
+ *   Returns 0 on success.
+ */
+int ecall_mutex_setup(void)
+{
+    sgx_thread_mutexattr_t attr;
+    attr.m_type = SGX_THREAD_MUTEX_NONRECURSIVE | SGX_THREAD_MUTEX_ADAPTIVE;
+
+    if (sgx_thread_mutex_init(&mutexes[0], NULL) != 0)
+        return -1;
+    if (sgx_thread_mutex_init(&mutexes[1], &attr) != 0)
+        return -1;
+    return 0;
+}
+
+/*
+ * ecall_mutex_contend:
+ *   Takes the plain or the adaptive mutex iterations times, holding it for
+ *   hold increments of a shared counter. Returns 0 on success.
+ */
+int ecall_mutex_contend(int adaptive, uint32_t iterations, uint32_t hold)
+{
+    sgx_thread_mutex_t *mutex = &mutexes[adaptive ? 1 : 0];
+
+    for (uint32_t i = 0; i < iterations; i++) {
+        if (sgx_thread_mutex_lock(mutex) != 0)
+            return -1;
+        for (uint32_t j = 0; j < hold; j++)
+            shared_counter = shared_counter + 1;
+        if (sgx_thread_mutex_unlock(mutex) != 0)
+            return -1;
+        for (uint32_t j = 0; j < MUTEX_GAP; j++)
+            __asm__ __volatile__("pause" : : : "memory");
+    }
+    return 0;
+}
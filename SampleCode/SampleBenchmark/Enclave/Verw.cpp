@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <string.h>
+
+#include "sgx_trts.h"
+#include "Enclave.h"
+#include "Enclave_t.h"
+
+#define VERW_MAX_SIZE   16384
+#define VERW_MAX_OFFSET 8
+
+static uint8_t verw_src[VERW_MAX_SIZE + VERW_MAX_OFFSET];
+
+/*
+ * ecall_memcpy_verw:
+ *   Copies size bytes from the enclave, starting src_offset bytes into an
+ *   aligned buffer, to the untrusted buffer dst with memcpy_verw(), copies
+ *   times. Returns 0 on success.
+ */
+int ecall_memcpy_verw(void *dst, uint32_t size, uint32_t src_offset, uint32_t copies)
+{
+    if (size > VERW_MAX_SIZE || src_offset >= VERW_MAX_OFFSET ||
+        !sgx_is_outside_enclave(dst, size))
+        return -1;
+
+    for (uint32_t i = 0; i < copies; i++)
+        memcpy_verw(dst, verw_src + src_offset, size);
+    return 0;
+}
@@ -31,6 +31,8 @@
 
 
 #include <thread>
+#include <atomic>
+#include <vector>
 #include <stdio.h>
 using namespace std;
 
@@ -65,6 +67,30 @@ void data_consumer(void)
         abort();
 }
 
+#define TCS_STRESS_THREADS  32
+#define TCS_STRESS_ROUNDS   8
+#define TCS_STRESS_LOOPS    2000
+
+static atomic<int> tcs_stress_errors(0);
+
+/* More threads than TCSs run short ECALLs, so the TCSs bound to live
+ * threads keep being reclaimed and handed to other threads while their
+ * previous owners take the lock free path again.
+ */
+void tcs_stress(void)
+{
+    for (int i = 0; i < TCS_STRESS_LOOPS; i++) {
+        int busy = 0;
+        sgx_status_t ret = ecall_tcs_enter(global_eid, &busy);
+        if (ret == SGX_ERROR_OUT_OF_TCS) {
+            this_thread::yield();
+            continue;
+        }
+        if (ret != SGX_SUCCESS || busy != 0)
+            tcs_stress_errors++;
+    }
+}
+
 /* ecall_thread_functions:
  *   Invokes thread functions including mutex, condition variable, etc.
  */
@@ -95,4 +121,17 @@ void ecall_thread_functions(void)
     consumer3.join();
     consumer4.join();
     producer0.join();
+
+    printf("Info: executing TCS binding stress, please wait...  \n");
+    for (int round = 0; round < TCS_STRESS_ROUNDS; round++) {
+        vector<thread> stressers;
+        for (int i = 0; i < TCS_STRESS_THREADS; i++)
+            stressers.push_back(thread(tcs_stress));
+        for (size_t i = 0; i < stressers.size(); i++)
+            stressers[i].join();
+    }
+    if (tcs_stress_errors != 0) {
+        printf("Error: %d ECALLs shared a TCS with another thread.\n", tcs_stress_errors.load());
+        abort();
+    }
 }
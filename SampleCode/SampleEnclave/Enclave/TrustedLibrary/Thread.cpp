@@ -88,6 +88,23 @@ void ecall_producer(void)
     }
 }
 
+/* Set while an ECALL runs on this TCS. */
+static __thread int tcs_in_use = 0;
+
+/*
+ * ecall_tcs_enter:
+ *   Returns -1 if another thread is running on the same TCS.
+ */
+int ecall_tcs_enter(void)
+{
+    if (__atomic_exchange_n(&tcs_in_use, 1, __ATOMIC_ACQUIRE) != 0)
+        return -1;
+    for (volatile int i = 0; i < 100; i++)
+        ;
+    __atomic_store_n(&tcs_in_use, 0, __ATOMIC_RELEASE);
+    return 0;
+}
+
 void ecall_consumer(void)
 {
     for (int i = 0; i < LOOPS_PER_THREAD; i++) {
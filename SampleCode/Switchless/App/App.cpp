@@ -34,6 +34,12 @@
 #include <string.h>
 #include <assert.h>
 #include <sys/time.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <x86intrin.h>
 
 # include <unistd.h>
 # include <pwd.h>
@@ -55,6 +61,12 @@ typedef struct _sgx_errlist_t {
 
 #define REPEATS 500000
 
+/* Latency benchmark: number of OCalls timed with spinning and with sleeping
+ * workers, and the idle time that puts the workers to sleep */
+#define LATENCY_CALLS   10000
+#define SLEEPING_CALLS  1000
+#define IDLE_GAP_US     10000
+
 /* Error code returned by sgx_create_enclave */
 static sgx_errlist_t sgx_errlist[] = {
     {
@@ -193,6 +205,83 @@ void ocall_print_string(const char *str)
 void ocall_empty(void) {}
 void ocall_empty_switchless(void) {}
 
+unsigned long ocall_square(unsigned long x) { return x * x; }
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t cpu_time_us(void)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (uint64_t)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000ULL
+        + (uint64_t)(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec);
+}
+
+/* TSC ticks per ns, to convert the cycles measured by the enclave */
+static double tsc_per_ns(void)
+{
+    uint64_t ns = now_ns();
+    uint64_t tsc = __rdtsc();
+    usleep(50000);
+    return (double)(__rdtsc() - tsc) / (double)(now_ns() - ns);
+}
+
+/* Have the enclave time ncalls back to back OCalls, one rdtsc pair around
+ * each, and store the cycles in latencies.
+ */
+static void time_ocalls(unsigned long ncalls, int is_switchless, uint64_t *latencies)
+{
+    sgx_status_t status = ecall_time_ocalls(global_eid, ncalls, is_switchless, latencies);
+    if (status != SGX_SUCCESS) {
+        printf("ERROR: ECall failed\n");
+        print_error_message(status);
+        exit(-1);
+    }
+}
+
+/* Spinning: the OCalls are back to back, so the untrusted workers are busy
+ * polling when each one arrives.
+ * Sleeping: every OCall comes after IDLE_GAP_US without calls, long after
+ * the workers ran out of spin budget and went to sleep.
+ * CPU cost is the process CPU time, which includes the spinning workers.
+ */
+void benchmark_ocall_latency(int is_switchless, int is_sleeping)
+{
+    static uint64_t latencies[LATENCY_CALLS];
+    size_t ncalls = is_sleeping ? SLEEPING_CALLS : LATENCY_CALLS;
+
+    printf("Measuring the latency of **%s** OCalls with %s workers...\n",
+            is_switchless ? "switchless" : "ordinary", is_sleeping ? "sleeping" : "spinning");
+
+    uint64_t cpu_before = cpu_time_us();
+    uint64_t wall_before = now_ns();
+
+    if (is_sleeping) {
+        for (size_t i = 0; i < ncalls; i++) {
+            usleep(IDLE_GAP_US);
+            time_ocalls(1, is_switchless, latencies + i);
+        }
+    } else {
+        time_ocalls(ncalls, is_switchless, latencies);
+    }
+
+    uint64_t wall_us = (now_ns() - wall_before) / 1000;
+    uint64_t cpu_us = cpu_time_us() - cpu_before;
+    double ticks = tsc_per_ns();
+
+    std::sort(latencies, latencies + ncalls);
+    printf("OCalls: %lu, p50: %.0f ns, p90: %.0f ns, p99: %.0f ns, max: %.0f ns\n", (unsigned long)ncalls,
+            (double)latencies[ncalls / 2] / ticks, (double)latencies[ncalls * 90 / 100] / ticks,
+            (double)latencies[ncalls * 99 / 100] / ticks, (double)latencies[ncalls - 1] / ticks);
+    printf("CPU time: %lu us (%.2f CPUs busy)\n", (unsigned long)cpu_us,
+            wall_us ? (double)cpu_us / wall_us : 0.0);
+}
+
 void benchmark_empty_ocall(int is_switchless) 
 {
     unsigned long nrepeats = REPEATS;
@@ -233,6 +322,31 @@ void benchmark_empty_ecall(int is_switchless)
     printf("Time elapsed: %ld.%06ld seconds\n", (long int)tval_result.tv_sec, (long int)tval_result.tv_usec);
 }
 
+void benchmark_batch_ocall(void)
+{
+    unsigned long nrepeats = REPEATS;
+    printf("Repeating a **batched switchless** OCall for %lu times...\n", nrepeats);
+
+    struct timeval tval_before, tval_after, tval_result;
+    gettimeofday(&tval_before, NULL);
+
+    int retval = -1;
+    sgx_status_t status = ecall_batch_ocalls(global_eid, &retval, nrepeats);
+    if (status != SGX_SUCCESS) {
+        printf("ERROR: ECall failed\n");
+        print_error_message(status);
+        exit(-1);
+    }
+    if (retval != 0) {
+        printf("ERROR: batched OCalls failed\n");
+        exit(-1);
+    }
+
+    gettimeofday(&tval_after, NULL);
+    timersub(&tval_after, &tval_before, &tval_result);
+    printf("Time elapsed: %ld.%06ld seconds\n", (long int)tval_result.tv_sec, (long int)tval_result.tv_usec);
+}
+
 /* Application entry */
 int SGX_CDECL main(int argc, char *argv[])
 {
@@ -255,6 +369,7 @@ int SGX_CDECL main(int argc, char *argv[])
     printf("Running a benchmark that compares **ordinary** and **switchless** OCalls...\n");
     benchmark_empty_ocall(1);
     benchmark_empty_ocall(0);
+    benchmark_batch_ocall();
     printf("Done.\n");
     
 
@@ -263,6 +378,13 @@ int SGX_CDECL main(int argc, char *argv[])
     benchmark_empty_ecall(0);
     printf("Done.\n");
 
+    printf("Running a benchmark that compares the latency and CPU cost of **ordinary** and **switchless** OCalls...\n");
+    benchmark_ocall_latency(1, 0);
+    benchmark_ocall_latency(0, 0);
+    benchmark_ocall_latency(1, 1);
+    benchmark_ocall_latency(0, 1);
+    printf("Done.\n");
+
     sgx_destroy_enclave(global_eid);
     return 0;
 }
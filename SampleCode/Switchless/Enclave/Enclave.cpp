@@ -38,5 +38,62 @@ void ecall_repeat_ocalls(unsigned long nrepeats, int use_switchless) {
     }
 }
 
+static inline uint64_t read_tsc(void)
+{
+    uint32_t lo, hi;
+    __asm__ volatile("lfence; rdtsc" : "=a"(lo), "=d"(hi) :: "memory");
+    return ((uint64_t)hi << 32) | lo;
+}
+
+/* Time each of ncalls empty OCalls in TSC cycles. RDTSC is only allowed
+ * inside an enclave on SGX2 CPUs, or in simulation mode.
+ */
+void ecall_time_ocalls(unsigned long ncalls, int use_switchless, uint64_t* cycles) {
+    sgx_status_t(*ocall_fn)(void) = use_switchless ? ocall_empty_switchless : ocall_empty;
+    for (unsigned long i = 0; i < ncalls; i++) {
+        uint64_t start = read_tsc();
+        ocall_fn();
+        cycles[i] = read_tsc() - start;
+    }
+}
+
+#define BATCH_SIZE 16
+
+/* Issue nrepeats switchless OCalls in batches of BATCH_SIZE. The entries of
+ * a batch are filled in by the edger8r-generated ocall_square_batch_prepare()
+ * and submitted together; once they have all completed, the results are read
+ * back with ocall_square_batch_result() and the marshalling structures are
+ * released with sgx_ocfree().
+ * Returns 0 if every OCall returned the expected result, -1 otherwise.
+ */
+int ecall_batch_ocalls(unsigned long nrepeats) {
+    sgx_switchless_ocall_t calls[BATCH_SIZE];
+    while (nrepeats > 0) {
+        size_t count = nrepeats < BATCH_SIZE ? nrepeats : BATCH_SIZE;
+        for (size_t i = 0; i < count; i++) {
+            if (ocall_square_batch_prepare(&calls[i], i) != SGX_SUCCESS) {
+                sgx_ocfree();
+                return -1;
+            }
+        }
+
+        if (sgx_ocall_switchless_submit(calls, count) != SGX_SUCCESS ||
+            sgx_ocall_switchless_wait(calls, count) != SGX_SUCCESS) {
+            return -1;
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            unsigned long square = 0;
+            if (ocall_square_batch_result(&calls[i], &square) != SGX_SUCCESS || square != i * i) {
+                sgx_ocfree();
+                return -1;
+            }
+        }
+        sgx_ocfree();
+        nrepeats -= count;
+    }
+    return 0;
+}
+
 void ecall_empty(void) {}
 void ecall_empty_switchless(void) {}
@@ -68,6 +68,20 @@ public:
     *@attr can be REMOVABLE
     */
     virtual int add_enclave_page(sgx_enclave_id_t enclave_id, void *source, uint64_t offset, const sec_info_t &sinfo, uint32_t attr) = 0;
+    /*
+    *add @size bytes of consecutive pages with the same @sinfo and @attr;
+    *@source holds @size bytes of page data, or is NULL for zero-filled pages
+    */
+    virtual int add_enclave_pages(sgx_enclave_id_t enclave_id, void *source, uint64_t offset, uint64_t size, const sec_info_t &sinfo, uint32_t attr)
+    {
+        for(uint64_t added = 0; added < size; added += SE_PAGE_SIZE)
+        {
+            int ret = add_enclave_page(enclave_id, source ? GET_PTR(void, source, added) : NULL, offset + added, sinfo, attr);
+            if(ret != SGX_SUCCESS)
+                return ret;
+        }
+        return SGX_SUCCESS;
+    }
     virtual int init_enclave(sgx_enclave_id_t enclave_id, enclave_css_t *enclave_css, SGXLaunchToken *lc, le_prd_css_file_t *prd_css_file = NULL) = 0;
     virtual int destroy_enclave(sgx_enclave_id_t enclave_id, uint64_t enclave_size = 0) = 0;
     virtual int initialize(sgx_enclave_id_t enclave_id) = 0;
@@ -68,6 +68,8 @@ typedef struct _global_data_t
     sys_word_t     edmm_bk_overhead;        /* memory overhead used by edmm bookkeeping */
     uint32_t       fips_on;
     uint32_t       reserved2;
+    sys_word_t     heap_commit_ahead;       /* minimum EDMM heap growth step, also kept committed after a trim */
+    sys_word_t     heap_trim_threshold;     /* committed-but-unused heap above which sbrk gives pages back */
 } global_data_t;
 
 #define ENCLAVE_INIT_NOT_STARTED  0
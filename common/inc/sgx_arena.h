@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#pragma once
+
+#ifndef _SGX_ARENA_H_
+#define _SGX_ARENA_H_
+
+#include "stddef.h"
+#include "sgx_defs.h"
+
+/* Size of the per-TCS arena, taken from the reserved memory area on first use */
+#define SGX_ARENA_SIZE      0x10000
+#define SGX_ARENA_ALIGN     16
+
+typedef size_t sgx_arena_mark_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    /* Return the current top of the calling thread's arena.
+     *
+     * Everything allocated with sgx_arena_alloc() after this call is released
+     * at once by passing the returned mark to sgx_arena_reset(). Marks nest, so
+     * an ecall made from inside an ocall does not disturb the outer ecall.
+     * Return: the current arena mark
+     */
+    sgx_arena_mark_t SGXAPI sgx_arena_begin(void);
+
+    /* Allocate scratch memory from the calling thread's arena
+     *
+     * Parameters:
+     *      size[in] - Size of the allocation in bytes
+     * Return: SGX_ARENA_ALIGN aligned memory on success; NULL when the arena is
+     *      exhausted or the enclave has no reserved memory. The memory must not
+     *      be passed to free().
+     */
+    void * SGXAPI sgx_arena_alloc(size_t size);
+
+    /* Release every arena allocation made after 'mark' was taken
+     *
+     * Parameters:
+     *      mark[in] - A mark returned by sgx_arena_begin() on the same thread
+     */
+    void SGXAPI sgx_arena_reset(sgx_arena_mark_t mark);
+
+    /* Return non-zero if 'ptr' lies in the calling thread's arena */
+    int SGXAPI sgx_arena_contains(const void *ptr);
+
+    /* Allocation helpers used by bridges generated with `edger8r --use-arena'.
+     * sgx_arena_edge_malloc() falls back to malloc() when the arena is full and
+     * sgx_arena_edge_free() only calls free() on such fallback allocations.
+     */
+    void * SGXAPI sgx_arena_edge_malloc(size_t size);
+    void SGXAPI sgx_arena_edge_free(void *ptr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
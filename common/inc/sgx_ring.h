@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef _SGX_RING_H_
+#define _SGX_RING_H_
+
+/*
+ * Shared buffer rings
+ *
+ * A ring lives in untrusted memory and carries variable-sized records
+ * between the application and the enclave without going through edger8r
+ * marshalling. The application allocates and initializes the ring, passes
+ * it once to the enclave as a [user_check] pointer, and the enclave attaches
+ * to it with sgx_tring_attach() (see sgx_tring.h), which validates its
+ * bounds a single time. From then on both sides only exchange offsets; the
+ * enclave copies a record in once when it reads it and copies it out once
+ * when it writes it.
+ *
+ * Each ring has one producer and one consumer. head and tail count the
+ * bytes consumed and produced since the ring was initialized, and each is
+ * written only by its owner. A record is a 64-bit length followed by the
+ * payload, padded to SGX_RING_RECORD_ALIGN bytes.
+ *
+ * The sgx_uring_* functions below are for the untrusted side.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define SGX_RING_HDR_SIZE       192
+#define SGX_RING_ALIGN          64      /* alignment of the ring in memory */
+#define SGX_RING_RECORD_ALIGN   8
+#define SGX_RING_RECORD_SIZE(len) \
+    (((uint64_t)(len) + sizeof(uint64_t) + SGX_RING_RECORD_ALIGN - 1) & ~(uint64_t)(SGX_RING_RECORD_ALIGN - 1))
+
+typedef struct _sgx_ring_t
+{
+    volatile uint64_t   head;           /* bytes consumed, written by the consumer */
+    uint8_t             reserved0[56];
+    volatile uint64_t   tail;           /* bytes produced, written by the producer */
+    uint8_t             reserved1[56];
+    uint64_t            size;           /* size of the data area, a power of two */
+    uint8_t             reserved2[56];
+    /* the data area follows at SGX_RING_HDR_SIZE */
+} sgx_ring_t;
+
+#define SGX_RING_DATA(ring)     ((uint8_t *)(ring) + SGX_RING_HDR_SIZE)
+
+/* sgx_uring_init()
+ * Parameters:
+ *     mem       - untrusted memory to hold the ring, 64-byte aligned
+ *     mem_size  - size of mem; the data area is the largest power of two that fits
+ * Return Value:
+ *     the ring on success, NULL if mem is too small
+ */
+static inline sgx_ring_t *sgx_uring_init(void *mem, size_t mem_size)
+{
+    sgx_ring_t *ring = (sgx_ring_t *)mem;
+    uint64_t size = SGX_RING_RECORD_ALIGN;
+
+    if (mem == NULL || ((uintptr_t)mem & (SGX_RING_ALIGN - 1)) || mem_size < SGX_RING_HDR_SIZE + 2 * SGX_RING_RECORD_ALIGN)
+        return NULL;
+    while (size * 2 <= mem_size - SGX_RING_HDR_SIZE)
+        size *= 2;
+
+    memset(ring, 0, SGX_RING_HDR_SIZE);
+    ring->size = size;
+    return ring;
+}
+
+static inline void sgx_uring_copy_in(sgx_ring_t *ring, uint64_t pos, const void *src, uint64_t len)
+{
+    uint64_t off = pos & (ring->size - 1);
+    uint64_t first = (len < ring->size - off) ? len : ring->size - off;
+
+    memcpy(SGX_RING_DATA(ring) + off, src, first);
+    memcpy(SGX_RING_DATA(ring), (const uint8_t *)src + first, len - first);
+}
+
+static inline void sgx_uring_copy_out(const sgx_ring_t *ring, uint64_t pos, void *dst, uint64_t len)
+{
+    uint64_t off = pos & (ring->size - 1);
+    uint64_t first = (len < ring->size - off) ? len : ring->size - off;
+
+    memcpy(dst, SGX_RING_DATA(ring) + off, first);
+    memcpy((uint8_t *)dst + first, SGX_RING_DATA(ring), len - first);
+}
+
+/* sgx_uring_write()
+ * Return Value:
+ *     0 on success, -1 if the ring has no room for the record
+ */
+static inline int sgx_uring_write(sgx_ring_t *ring, const void *buf, size_t len)
+{
+    uint64_t tail = ring->tail;
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    uint64_t rec = SGX_RING_RECORD_SIZE(len);
+    uint64_t hdr = len;
+
+    if (len == 0 || rec > ring->size - (tail - head))
+        return -1;
+    sgx_uring_copy_in(ring, tail, &hdr, sizeof(hdr));
+    sgx_uring_copy_in(ring, tail + sizeof(hdr), buf, len);
+    __atomic_store_n(&ring->tail, tail + rec, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/* sgx_uring_read()
+ * Parameters:
+ *     len       - [out] the record length, also set when buf is too small
+ * Return Value:
+ *     0 on success, -1 if the ring is empty, -2 if buf_size is too small
+ */
+static inline int sgx_uring_read(sgx_ring_t *ring, void *buf, size_t buf_size, size_t *len)
+{
+    uint64_t head = ring->head;
+    uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    uint64_t hdr = 0;
+
+    if (head == tail)
+        return -1;
+    sgx_uring_copy_out(ring, head, &hdr, sizeof(hdr));
+    *len = (size_t)hdr;
+    if (hdr > buf_size)
+        return -2;
+    sgx_uring_copy_out(ring, head + sizeof(hdr), buf, hdr);
+    __atomic_store_n(&ring->head, head + SGX_RING_RECORD_SIZE(hdr), __ATOMIC_RELEASE);
+    return 0;
+}
+
+#endif
@@ -1126,6 +1126,77 @@ extern "C" {
         uint8_t *p_dst,
         sgx_aes_state_handle_t aes_gcm_state);
 
+    /** Allocate an AES-GCM state keyed with p_key, to be used for many messages.
+    *   Key expansion and GHASH setup are done once here instead of on every message.
+    *   The state must not be used by several threads at the same time.
+    *   Release the state with sgx_aes_gcm_close.
+    *
+    * Parameters:
+    *   Return: sgx_status_t - SGX_SUCCESS or failure as defined in sgx_error.h
+    *   Inputs: p_key - Pointer to the key.
+    *           key_len - Key length, SGX_AESGCM_KEY_SIZE or SGX_AESGCM_KEY256_SIZE.
+    *   Output: p_key_state - AES-GCM state pointer.
+    *
+    */
+    sgx_status_t sgx_aes_gcm_key_init(
+        const uint8_t *p_key,
+        uint32_t key_len,
+        sgx_aes_state_handle_t *p_key_state);
+
+    /** Encrypt one message with a state from sgx_aes_gcm_key_init.
+    *   Same as sgx_rijndael128GCM_encrypt, except that the key comes from key_state.
+    *
+    * Parameters:
+    *   Return: sgx_status_t - SGX_SUCCESS or failure as defined in sgx_error.h
+    *   Inputs: key_state - AES-GCM state returned by sgx_aes_gcm_key_init.
+    *           p_src - Pointer to the plaintext.
+    *           src_len - Plaintext length.
+    *           p_iv - Pointer to the IV. Every message must use a different IV.
+    *           iv_len - Length of the IV, must be SGX_AESGCM_IV_SIZE.
+    *           p_aad - Pointer to the additional authentication data, it could be NULL.
+    *           aad_len - Length of the additional authentication data.
+    *   Output: p_dst - Pointer to the ciphertext. Size of buffer should be >= src_len.
+    *           p_out_mac - Pointer to the MAC generated.
+    *
+    */
+    sgx_status_t sgx_aes_gcm_key_encrypt(
+        sgx_aes_state_handle_t key_state,
+        const uint8_t *p_src,
+        uint32_t src_len,
+        uint8_t *p_dst,
+        const uint8_t *p_iv,
+        uint32_t iv_len,
+        const uint8_t *p_aad,
+        uint32_t aad_len,
+        sgx_aes_gcm_128bit_tag_t *p_out_mac);
+
+    /** Decrypt one message with a state from sgx_aes_gcm_key_init.
+    *   Same as sgx_rijndael128GCM_decrypt, except that the key comes from key_state.
+    *
+    * Parameters:
+    *   Return: sgx_status_t - SGX_SUCCESS or failure as defined in sgx_error.h
+    *   Inputs: key_state - AES-GCM state returned by sgx_aes_gcm_key_init.
+    *           p_src - Pointer to the ciphertext.
+    *           src_len - Ciphertext length.
+    *           p_iv - Pointer to the IV.
+    *           iv_len - Length of the IV, must be SGX_AESGCM_IV_SIZE.
+    *           p_aad - Pointer to the additional authentication data, it could be NULL.
+    *           aad_len - Length of the additional authentication data.
+    *           p_in_mac - Pointer to the expected MAC.
+    *   Output: p_dst - Pointer to the plaintext. Size of buffer should be >= src_len.
+    *
+    */
+    sgx_status_t sgx_aes_gcm_key_decrypt(
+        sgx_aes_state_handle_t key_state,
+        const uint8_t *p_src,
+        uint32_t src_len,
+        uint8_t *p_dst,
+        const uint8_t *p_iv,
+        uint32_t iv_len,
+        const uint8_t *p_aad,
+        uint32_t aad_len,
+        const sgx_aes_gcm_128bit_tag_t *p_in_mac);
+
     /** Check if a function is FIPS-approved or not
     *
     * Paramters:
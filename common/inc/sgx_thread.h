@@ -76,6 +76,18 @@ typedef struct _sgx_thread_rwlock_t
 #define SGX_THREAD_MUTEX_INITIALIZER \
             SGX_THREAD_NONRECURSIVE_MUTEX_INITIALIZER
 
+/* Adaptive mutexes spin for a while before sleeping outside the enclave.
+ * The flag may be combined with either mutex type, in a static initializer
+ * or in the m_type of the attributes passed to sgx_thread_mutex_init().
+ * The spin budget is tuned at run time and kept in the upper bits of
+ * m_control.
+ */
+#define SGX_THREAD_MUTEX_ADAPTIVE       0x04
+#define SGX_THREAD_ADAPTIVE_MUTEX_INITIALIZER \
+            {0, SGX_THREAD_MUTEX_NONRECURSIVE | SGX_THREAD_MUTEX_ADAPTIVE, 0, SGX_THREAD_T_NULL, {SGX_THREAD_T_NULL, SGX_THREAD_T_NULL}}
+#define SGX_THREAD_ADAPTIVE_RECURSIVE_MUTEX_INITIALIZER \
+            {0, SGX_THREAD_MUTEX_RECURSIVE | SGX_THREAD_MUTEX_ADAPTIVE, 0, SGX_THREAD_T_NULL, {SGX_THREAD_T_NULL, SGX_THREAD_T_NULL}}
+
 #define SGX_THREAD_LOCK_INITIALIZER \
             {0, 0, 0, SGX_THREAD_T_NULL, {SGX_THREAD_T_NULL, SGX_THREAD_T_NULL}, {SGX_THREAD_T_NULL, SGX_THREAD_T_NULL}}
 
@@ -83,7 +95,7 @@ typedef struct _sgx_thread_rwlock_t
 
 typedef struct _sgx_thread_mutex_attr_t
 {
-    unsigned char       m_dummy;  /* for C syntax check */
+    unsigned char       m_type;   /* SGX_THREAD_MUTEX_* flags, 0 for a plain non-recursive mutex */
 } sgx_thread_mutexattr_t;
 
 typedef struct _sgx_thread_rwlock_attr_t
@@ -110,7 +122,7 @@ extern "C" {
 #endif
 
 /* Mutex */
-int SGXAPI sgx_thread_mutex_init(sgx_thread_mutex_t *mutex, const sgx_thread_mutexattr_t *unused);
+int SGXAPI sgx_thread_mutex_init(sgx_thread_mutex_t *mutex, const sgx_thread_mutexattr_t *attr);
 int SGXAPI sgx_thread_mutex_destroy(sgx_thread_mutex_t *mutex);
 
 int SGXAPI sgx_thread_mutex_lock(sgx_thread_mutex_t *mutex);
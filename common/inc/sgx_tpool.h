@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef _SGX_TPOOL_H_
+#define _SGX_TPOOL_H_
+
+#include <stddef.h>
+#include "sgx_defs.h"
+
+/* Tasks each worker can queue before new ones go to the shared queue */
+#define SGX_TPOOL_DEQUE_SIZE    256
+/* Tasks submitted from outside the pool that can wait in the shared queue */
+#define SGX_TPOOL_QUEUE_SIZE    256
+#define SGX_TPOOL_MAX_WORKERS   64
+
+typedef void (*sgx_tpool_fn_t)(void *arg);
+typedef void (*sgx_tpool_range_fn_t)(size_t begin, size_t end, void *arg);
+
+/* A set of tasks waited for together by sgx_tpool_wait() */
+typedef struct _sgx_tpool_group_t
+{
+    volatile size_t     m_pending;  /* tasks submitted but not finished */
+} sgx_tpool_group_t;
+
+#define SGX_TPOOL_GROUP_INITIALIZER {0}
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    /* Start the trusted worker pool
+     *
+     * Creates 'workers' enclave threads with pthread_create(). Each of them
+     * keeps its TCS and waits inside the enclave for tasks, so submitting
+     * a task does not create a thread. Needs libsgx_pthread and one TCS per
+     * worker.
+     * Parameters:
+     *      workers[in] - Number of worker threads, 1 to SGX_TPOOL_MAX_WORKERS
+     * Return: 0 on success; EINVAL for a bad worker count; EBUSY if the pool
+     *      is already running; ENOMEM or EAGAIN if no worker could be created.
+     *      The pool runs with fewer workers if only some could be created.
+     */
+    int SGXAPI sgx_tpool_init(unsigned int workers);
+
+    /* Queue 'fn(arg)' to run on the pool
+     *
+     * A task submitted by a worker goes to that worker's deque, where idle
+     * workers can steal it. When the queues are full or the pool is not
+     * running, the task runs on the calling thread before returning.
+     * Parameters:
+     *      group[in] - Group to count the task in, can be NULL
+     *      fn[in] - Task function
+     *      arg[in] - Argument passed to 'fn'
+     * Return: 0 on success; EINVAL if 'fn' is not inside the enclave.
+     */
+    int SGXAPI sgx_tpool_submit(sgx_tpool_group_t *group, sgx_tpool_fn_t fn, void *arg);
+
+    /* Wait until every task submitted to 'group' has finished
+     *
+     * The calling thread runs queued tasks while it waits, so tasks may
+     * submit and wait for nested groups. A thread that is not a worker
+     * only runs tasks from the shared queue. When there is nothing to run
+     * for a while, the thread sleeps until a task is queued or the group
+     * finishes.
+     * Return: 0 on success; EINVAL if 'group' is not inside the enclave.
+     */
+    int SGXAPI sgx_tpool_wait(sgx_tpool_group_t *group);
+
+    /* Run 'fn' over [begin, end) in chunks of at most 'grain' indexes
+     * spread over the pool, and wait for all of them.
+     *
+     * The range is split in halves recursively, each half being a task
+     * that idle workers can steal, so no task list is allocated.
+     * Return: 0 on success; EINVAL for bad parameters.
+     */
+    int SGXAPI sgx_tpool_parallel_for(size_t begin, size_t end, size_t grain,
+                                      sgx_tpool_range_fn_t fn, void *arg);
+
+    /* Run the queued tasks, stop the workers and release their TCSs
+     * Return: 0 on success; EINVAL if the pool is not running or the caller
+     *      is one of its workers.
+     */
+    int SGXAPI sgx_tpool_destroy(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
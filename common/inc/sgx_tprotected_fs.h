@@ -57,6 +57,23 @@
 #define FILENAME_MAX  260
 #define FOPEN_MAX     20
 
+#define SGX_FADV_NORMAL      0 /* detect sequential reads and read ahead when they are found */
+#define SGX_FADV_RANDOM      1 /* no read ahead */
+#define SGX_FADV_SEQUENTIAL  2 /* always read ahead */
+
+typedef struct _sgx_fstats_t
+{
+    uint64_t cache_hits;             /* node lookups of this file that were served from the cache */
+    uint64_t cache_misses;           /* node lookups of this file that had to read and decrypt the node */
+    uint64_t cache_evictions;        /* nodes of this file that were dropped from the cache */
+    uint64_t cached_pages;           /* nodes of this file currently in the cache */
+    uint64_t shared_cache_hits;      /* same as above, for all the files */
+    uint64_t shared_cache_misses;
+    uint64_t shared_cache_evictions;
+    uint64_t shared_cached_pages;
+    uint64_t shared_cache_pages;     /* size of the shared cache in pages, sum of the cache sizes of all the open files */
+} sgx_fstats_t;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -107,6 +124,7 @@ SGX_FILE* SGXAPI sgx_fopen_auto_key(const char* filename, const char* mode);
  *      NOTE - the key is actually used as a KDK (key derivation key) and only for the meta-data node, and not used directly for the encryption of any part of the file
  *             this is important in order to prevent hitting the key wear-out problem, and some other issues with GCM encryptions using the same key
  *      cache_size - [IN] Internal cache size in byte, which used to cache R/W data in enclave before flush to actual file
+ *                   The size is added to the cache shared by all the open files, and removed from it when the file is closed
  *                   It must larger than default cache size (192KB), and must be page (4KB by default) aligned
  *                   a) Please make sure enclave heap is enough for the `cache`, e.g. Configure enough heap in enclave config file
  *                   b) All the data in cache may lost after exeception, please try to call `sgx_fflush` explicitly to avoid data loss
@@ -174,7 +192,7 @@ int32_t SGXAPI sgx_fseek(SGX_FILE* stream, int64_t offset, int origin);
 
 
 /* sgx_fset_parallel_level
- *  Purpose: set number of threads can be used in file flush
+ *  Purpose: set number of threads can be used in file flush, and to decrypt the nodes read ahead (see sgx_fadvise)
  *           To achieve the best performance, please only use when write large files (>10M),
  *           and with a customized cache size (i.e. use sgx_fopen_ex to open file)
  *           For the reference, test result on ICX server
@@ -311,6 +329,36 @@ int32_t SGXAPI sgx_fimport_auto_key(const char* filename, const sgx_key_128bit_t
 int32_t SGXAPI sgx_fclear_cache(SGX_FILE* stream);
 
 
+/* sgx_fadvise
+*  Purpose: tell how the file is going to be read.
+*           when reads are sequential, a read that misses the cache reads and decrypts the next data nodes in one batch,
+*           using up to the number of threads set with sgx_fset_parallel_level
+*
+*  Parameters:
+*      stream - [IN] the file handle (opened with sgx_fopen or sgx_fopen_auto_key
+*      advice - [IN] SGX_FADV_NORMAL (default), SGX_FADV_RANDOM or SGX_FADV_SEQUENTIAL
+*
+*  Return value:
+*     int32_t  - result, 0 - success, 1 - there was an error, check errno for the error code
+*/
+int32_t SGXAPI sgx_fadvise(SGX_FILE* stream, int32_t advice);
+
+
+/* sgx_fget_stats
+*  Purpose: get the statistics of the node cache.
+*           the cache is shared by all the open files, its size is the sum of the cache sizes they were opened with
+*           (see sgx_fopen_ex), and a file may use more than its own share when the other files do not need it
+*
+*  Parameters:
+*      stream - [IN] the file handle (opened with sgx_fopen or sgx_fopen_auto_key
+*      stats - [OUT] the statistics of this file and of the shared cache
+*
+*  Return value:
+*     int32_t  - result, 0 - success, 1 - there was an error, check errno for the error code
+*/
+int32_t SGXAPI sgx_fget_stats(SGX_FILE* stream, sgx_fstats_t* stats);
+
+
 #ifdef __cplusplus
 }
 #endif
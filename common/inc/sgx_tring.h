@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef _SGX_TRING_H_
+#define _SGX_TRING_H_
+
+/*
+ * Trusted side of the shared buffer rings described in sgx_ring.h.
+ *
+ * sgx_tring_attach() checks once that the whole ring lies outside the
+ * enclave and takes a private copy of its size and of the offset the
+ * enclave owns. Offsets written by the untrusted side are re-validated
+ * against that private state on every access, so a corrupted ring results
+ * in SGX_ERROR_UNEXPECTED rather than an out-of-bounds access.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sgx_error.h"
+#include "sgx_defs.h"
+#include "sgx_ring.h"
+
+typedef struct _sgx_tring_t
+{
+    sgx_ring_t *ring;       /* private */
+    uint8_t    *data;       /* private */
+    uint64_t    size;       /* private */
+    uint64_t    head;       /* private */
+    uint64_t    tail;       /* private */
+} sgx_tring_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* sgx_tring_attach()
+ * Parameters:
+ *     tring     - [out] trusted handle of the ring
+ *     ring      - the ring, initialized by the untrusted side, SGX_RING_ALIGN-byte aligned
+ *     mem_size  - size of the untrusted memory holding the ring
+ * Return Value:
+ *     SGX_SUCCESS on success
+ *     SGX_ERROR_INVALID_PARAMETER if the ring is not aligned or not entirely
+ *     outside the enclave, or its size is not a power of two that fits in mem_size
+ */
+sgx_status_t SGXAPI sgx_tring_attach(sgx_tring_t *tring, void *ring, size_t mem_size);
+
+/* sgx_tring_read()
+ * Copy the next record into enclave memory.
+ * Parameters:
+ *     buf       - enclave buffer receiving the payload
+ *     len       - [out] the record length, 0 if the ring is empty
+ * Return Value:
+ *     SGX_SUCCESS on success, or if the ring is empty
+ *     SGX_ERROR_INVALID_PARAMETER if buf_size is smaller than *len; the
+ *     record stays in the ring
+ *     SGX_ERROR_UNEXPECTED if the untrusted side corrupted the ring
+ */
+sgx_status_t SGXAPI sgx_tring_read(sgx_tring_t *tring, void *buf, size_t buf_size, size_t *len);
+
+/* sgx_tring_write()
+ * Copy a record out of the enclave.
+ * Return Value:
+ *     SGX_SUCCESS on success
+ *     SGX_ERROR_INVALID_PARAMETER if len is zero
+ *     SGX_ERROR_OUT_OF_MEMORY if the ring has no room for the record
+ *     SGX_ERROR_UNEXPECTED if the untrusted side corrupted the ring
+ */
+sgx_status_t SGXAPI sgx_tring_write(sgx_tring_t *tring, const void *buf, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -61,6 +61,8 @@ typedef struct _sealed_data_t
     sgx_aes_gcm_data_t aes_data;          /* 80: Data structure holding the AES/GCM related data */
 } sgx_sealed_data_t;
 
+typedef struct _sgx_seal_session_t sgx_seal_session_t;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -252,6 +254,86 @@ extern "C" {
         uint8_t *p_additional_MACtext,
         uint32_t *p_additional_MACtext_length);
 
+    /* sgx_seal_session_open
+     * Purpose: Open a sealing session. The session derives the seal key once and keeps the
+     *          expanded key in enclave memory, so that sealing and unsealing many records does
+     *          not run EGETKEY for every record. Blobs sealed by the session carry a random IV
+     *          and are flagged as such in their key request. sgx_unseal_data can unseal them,
+     *          older SDK versions reject them. Blobs from sgx_seal_data and sgx_seal_data_ex
+     *          can be unsealed by the session.
+     *          A session can be used by several threads of the same enclave. They only
+     *          serialize on the key cache lookup, encryption and decryption run in parallel.
+     *
+     * Parameters:
+     *      key_policy - [IN] Specifies the measurement to use in key derivation
+     *      attribute_mask - [IN] Identifies which platform/enclave attributes to use in key derivation
+     *      misc_mask - [IN] The mask for MISC_SELECT
+     *      pp_session - [OUT] pointer to the session handle
+     *
+     * Return Value:
+     *      sgx_status_t - SGX Error code
+    */
+    sgx_status_t SGXAPI sgx_seal_session_open(const uint16_t key_policy,
+        const sgx_attributes_t attribute_mask,
+        const sgx_misc_select_t misc_mask,
+        sgx_seal_session_t **pp_session);
+
+    /* sgx_seal_session_seal
+     * Purpose: Same as sgx_seal_data_ex, except that the seal key and key policy come from the session.
+     *
+     * Parameters:
+     *      p_session - [IN] session handle returned by sgx_seal_session_open
+     *      additional_MACtext_length - [IN] length of the plaintext data stream in bytes
+     *      p_additional_MACtext - [IN] pointer to the plaintext data stream to be GCM protected
+     *      text2encrypt_length - [IN] length of the data stream to encrypt in bytes
+     *      p_text2encrypt - [IN] pointer to data stream to encrypt
+     *      sealed_data_size - [IN] Size of the sealed data buffer passed in
+     *      p_sealed_data - [OUT] pointer to the sealed data structure containing protected data
+     *
+     * Return Value:
+     *      sgx_status_t - SGX Error code
+    */
+    sgx_status_t SGXAPI sgx_seal_session_seal(sgx_seal_session_t *p_session,
+        const uint32_t additional_MACtext_length,
+        const uint8_t *p_additional_MACtext,
+        const uint32_t text2encrypt_length,
+        const uint8_t *p_text2encrypt,
+        const uint32_t sealed_data_size,
+        sgx_sealed_data_t *p_sealed_data);
+
+    /* sgx_seal_session_unseal
+     * Purpose: Same as sgx_unseal_data, except that the seal key is looked up by the key request
+     *          of the sealed data in the session key cache, and is only derived on a miss.
+     *
+     * Parameters:
+     *      p_session - [IN] session handle returned by sgx_seal_session_open
+     *      p_sealed_data - [IN] pointer to the sealed data structure containing protected data
+     *      p_additional_MACtext - [OUT] pointer to the plaintext data stream which was GCM protected
+     *      p_additional_MACtext_length - [IN/OUT] pointer to length of the plaintext data stream in bytes
+     *      p_decrypted_text - [OUT] pointer to decrypted data stream
+     *      p_decrypted_text_length - [IN/OUT] pointer to length of the decrypted data stream in bytes
+     *
+     * Return Value:
+     *      sgx_status_t - SGX Error code
+    */
+    sgx_status_t SGXAPI sgx_seal_session_unseal(sgx_seal_session_t *p_session,
+        const sgx_sealed_data_t *p_sealed_data,
+        uint8_t *p_additional_MACtext,
+        uint32_t *p_additional_MACtext_length,
+        uint8_t *p_decrypted_text,
+        uint32_t *p_decrypted_text_length);
+
+    /* sgx_seal_session_close
+     * Purpose: Close a sealing session and clear all the keys it holds.
+     *
+     * Parameters:
+     *      p_session - [IN] session handle returned by sgx_seal_session_open
+     *
+     * Return Value:
+     *      sgx_status_t - SGX Error code
+    */
+    sgx_status_t SGXAPI sgx_seal_session_close(sgx_seal_session_t *p_session);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef _SGX_TSWITCHLESS_H_
+#define _SGX_TSWITCHLESS_H_
+
+/*
+ * Batched switchless OCalls
+ *
+ * sgx_ocall_switchless() submits one request and busy waits for its
+ * completion. Enclave code that issues many small, independent OCalls can
+ * instead submit a vector of them at once and then either poll for or wait
+ * on their completions. All requests of a batch are published with a
+ * single memory barrier and a single wake-up of the untrusted workers,
+ * which then drain them in one pass over the pending signal lines.
+ *
+ * Each entry takes the same OCall index and marshalling structure that the
+ * edger8r-generated code passes to sgx_ocall_switchless(); the marshalling
+ * structures must stay valid until the entry completes. Requests that
+ * cannot be submitted, or that are not picked up by a worker in time, fall
+ * back to the traditional OCall, exactly like sgx_ocall_switchless().
+ *
+ * Entries are not built by hand. For every switchless OCall whose
+ * parameters are all passed by value, sgx_edger8r generates in the
+ * trusted header:
+ *
+ *     sgx_status_t foo_batch_prepare(sgx_switchless_ocall_t* call, <parameters>);
+ *     sgx_status_t foo_batch_result(const sgx_switchless_ocall_t* call, <type>* retval);
+ *
+ * foo_batch_prepare() allocates the marshalling structure on the OCall
+ * stack with sgx_ocalloc() and fills in the entry. foo_batch_result(),
+ * generated only for OCalls that return a value, copies the return value
+ * out once the entry has completed, or returns the status of the failed
+ * OCall. The marshalling structures are released by sgx_ocfree(), or when
+ * the ECall returns, so release them only after all entries completed:
+ *
+ *     sgx_switchless_ocall_t calls[N];
+ *     for (i = 0; i < N; i++)
+ *         foo_batch_prepare(&calls[i], args[i]);
+ *     sgx_ocall_switchless_submit(calls, N);
+ *     sgx_ocall_switchless_wait(calls, N);
+ *     for (i = 0; i < N; i++)
+ *         foo_batch_result(&calls[i], &results[i]);
+ *     sgx_ocfree();
+ *
+ * See SampleCode/Switchless for a complete example.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sgx_error.h"
+#include "sgx_defs.h"
+
+typedef struct _sgx_switchless_ocall_t
+{
+    unsigned int    index;      /* index of the untrusted function */
+    void*           ms;         /* pointer to the marshalling structure */
+    sgx_status_t    status;     /* result of the OCall, once completed */
+    uint32_t        state;      /* private */
+    uint64_t        line;       /* private */
+} sgx_switchless_ocall_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* sgx_ocall_switchless_submit()
+ * Parameters:
+ *     calls       - the OCalls to submit, with index and ms filled in
+ *     count       - the number of entries in calls
+ * Return Value:
+ *     SGX_SUCCESS on success, the OCalls are then either completed or pending
+ *     SGX_ERROR_INVALID_PARAMETER if calls is NULL while count is not zero
+ *     SGX_ERROR_ENCLAVE_CRASHED if the enclave has crashed
+*/
+sgx_status_t SGXAPI sgx_ocall_switchless_submit(sgx_switchless_ocall_t* calls,
+                              size_t count);
+
+/* sgx_ocall_switchless_poll()
+ * Parameters:
+ *     calls       - OCalls previously submitted with sgx_ocall_switchless_submit()
+ *     count       - the number of entries in calls
+ *     completed   - [out] the number of completed entries, may be NULL
+ * Return Value:
+ *     SGX_SUCCESS if all entries have completed
+ *     SGX_ERROR_BUSY if some entries are still pending
+ *     SGX_ERROR_INVALID_PARAMETER if calls is NULL while count is not zero, or
+ *                                 an entry was not returned by sgx_ocall_switchless_submit()
+*/
+sgx_status_t SGXAPI sgx_ocall_switchless_poll(sgx_switchless_ocall_t* calls,
+                              size_t count,
+                              size_t* completed);
+
+/* sgx_ocall_switchless_wait()
+ * Parameters:
+ *     calls       - OCalls previously submitted with sgx_ocall_switchless_submit()
+ *     count       - the number of entries in calls
+ * Return Value:
+ *     SGX_SUCCESS once all entries have completed
+ *     SGX_ERROR_INVALID_PARAMETER if calls is NULL while count is not zero, or
+ *                                 an entry was not returned by sgx_ocall_switchless_submit()
+ *     SGX_ERROR_ENCLAVE_CRASHED if the enclave has crashed
+*/
+sgx_status_t SGXAPI sgx_ocall_switchless_wait(sgx_switchless_ocall_t* calls,
+                              size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !_SGX_TSWITCHLESS_H_ */
@@ -94,6 +94,27 @@ quote3_error_t SGXAPI tee_get_certificate_with_evidence(
  */
 quote3_error_t SGXAPI tee_free_certificate(uint8_t* p_certificate);
 
+/**
+ * tee_set_certificate_cache
+ *
+ * Enables reuse of certificates generated by `tee_get_certificate_with_evidence`.
+ * Certificates are cached by subject name and key pair and returned for `ttl_seconds`
+ * without generating a new quote; a new certificate is generated in the last fifth of
+ * that time. The cache is disabled by default. Calling this function again drops all
+ * cached certificates.
+ * In SGX enclaves the time is read from the host with `sgx_tls_get_time_ocall`, which
+ * the host controls. The cache ignores the host clock going backwards and drops a
+ * certificate after it has been returned 1024 times, so a host that stops its clock
+ * can't keep a quote in use indefinitely.
+ * This function is only available in the enclave.
+ *
+ * @param[in] ttl_seconds Lifetime of a cached certificate in seconds. 0 disables the cache.
+ * @param[in] max_entries Maximum number of cached certificates, at most 64. 0 selects the default of 8.
+ * @retval SGX_QL_SUCCESS The function succeeded.
+ * @retval other appropriate error code.
+ */
+quote3_error_t SGXAPI tee_set_certificate_cache(uint32_t ttl_seconds, uint32_t max_entries);
+
 
 /**
  * tee_verify_certificate_with_evidence
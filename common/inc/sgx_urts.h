@@ -132,6 +132,49 @@ sgx_status_t SGXAPI sgx_get_target_info(
 	const sgx_enclave_id_t enclave_id,
 	sgx_target_info_t* target_info);
 
+/* Enclaves created from a file keep the parsed, relocated and patched image
+ * as a template, so creating the same file again skips straight to adding
+ * pages. Templates are bounded by the total size of their files; a size of 0
+ * drops every template and disables the cache. */
+sgx_status_t SGXAPI sgx_set_enclave_template_cache_size(size_t max_size);
+
+/* Drop the templates of an enclave file, or all templates if file_name is NULL. */
+sgx_status_t SGXAPI sgx_invalidate_enclave_template(const char *file_name);
+
+/* Hand out free TCSs most recently freed first (default). */
+#define SGX_TCS_AFFINITY_NONE   0
+/* Prefer the free TCS last used on the calling CPU, then on its NUMA node,
+ * so the SSA, stack and TLS pages of the TCS stay local to the caller. */
+#define SGX_TCS_AFFINITY_LOCAL  1
+
+sgx_status_t SGXAPI sgx_set_tcs_affinity_policy(const sgx_enclave_id_t enclave_id, uint32_t policy);
+
+typedef struct _sgx_tcs_stats_t
+{
+    uint64_t tcs_address;       /* address of the TCS page */
+    uint64_t ecall_count;       /* ecalls entered on the TCS */
+    uint64_t cpu_migrations;    /* ecalls that ran on a different CPU than the previous one */
+    uint64_t node_migrations;   /* ecalls that ran on a different NUMA node than the previous one */
+    uint32_t last_cpu;          /* 0xFFFFFFFF if unknown */
+    uint32_t last_node;         /* 0xFFFFFFFF if unknown */
+} sgx_tcs_stats_t;
+
+/* Return the statistics of the TCSs of an enclave. CPU and NUMA node
+ * migrations are only tracked while an affinity policy is set. On input
+ * *count is the capacity of stats; on output it is the number of TCSs.
+ * SGX_ERROR_INVALID_PARAMETER is returned if stats is too small. */
+sgx_status_t SGXAPI sgx_get_tcs_stats(const sgx_enclave_id_t enclave_id, sgx_tcs_stats_t *stats, size_t *count);
+
+/* Provision EDMM dynamic TCSs ahead of demand. The uRTS tracks the high
+ * watermark of concurrent ecalls and, while it was reached within the last
+ * cooldown_ms milliseconds, keeps enough free TCSs ready to absorb it again
+ * plus headroom more, so callers do not wait for a TCS to be added. After
+ * the cooldown only the TCSMinPool setting is kept, and no more TCSs are
+ * added; the ones already added stay for the life of the enclave. A
+ * headroom of 0 turns the prediction off; a cooldown of 0 selects the
+ * default of 1 second. */
+sgx_status_t SGXAPI sgx_set_tcs_provisioning(const sgx_enclave_id_t enclave_id, uint32_t headroom, uint32_t cooldown_ms);
+
 #ifdef __cplusplus
 }
 #endif
@@ -117,7 +117,7 @@ typedef void (*sgx_uswitchless_worker_callback_t)(
 #define SL_DEFAULT_FALLBACK_RETRIES  20000
 #define SL_DEFAULT_SLEEP_RETRIES     20000
 #define SL_DEFUALT_MAX_TASKS_QWORDS  1   //64
-#define SL_MAX_TASKS_MAX_QWORDS      8   //512
+#define SL_MAX_TASKS_MAX_QWORDS      64  //4096
 
 typedef struct 
 {
@@ -976,10 +976,13 @@ extern "C" size_t COMM_API enclave_load_data(
             elrange_start_address = reinterpret_cast<uint64_t>(enclave_base_addr);
         }
 
+        // Zero-filled ranges may cover a large part of the enclave. Read-only
+        // anonymous pages are all backed by the zero page, so the source of
+        // such a range costs neither memory nor a memset.
         uint8_t* source = (uint8_t*)source_buffer;
         if (source == NULL) {
-            source = (uint8_t*)aligned_alloc(SE_PAGE_SIZE, target_size);
-            if(source == NULL)
+            source = (uint8_t*)mmap(NULL, target_size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if(source == MAP_FAILED)
             {
                 if (enclave_error != NULL)
                 {
@@ -987,7 +990,6 @@ extern "C" size_t COMM_API enclave_load_data(
                 }
                 return 0;
             }
-            memset(source, 0 , target_size);
         } 
  
         struct sgx_enclave_add_pages_in_kernel addp;
@@ -1016,18 +1018,19 @@ extern "C" size_t COMM_API enclave_load_data(
                     *enclave_error = error_driver2api(ret, errno);
                 if(source_buffer == NULL)
                 {
-                    free(source);
+                    munmap(source, target_size);
                     source = NULL;
                 }
                 return 0;
             }
             addp.length -= addp.count;
             addp.offset += addp.count;
+            addp.src += addp.count;
             addp.count = 0;
         } while (addp.length != 0);
         if(source_buffer == NULL)
         {
-            free(source);
+            munmap(source, target_size);
             source = NULL;
         }
          
@@ -62,6 +62,8 @@ typedef struct _create_param_t
     uint32_t          tcs_policy;
     uint32_t          xsave_size;
     uint32_t          fips_on;
+    uint64_t          heap_commit_ahead;
+    uint64_t          heap_trim_threshold;
 } create_param_t;
 
 #endif
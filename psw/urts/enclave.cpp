@@ -41,6 +41,8 @@
 #include "urts_emm.h"
 #include "rts_cmd.h"
 #include <assert.h>
+#include <sched.h>
+#include <algorithm>
 #include "rts.h"
 #include "get_thread_id.h"
 #include "sgx_switchless_itf.h"
@@ -55,7 +57,6 @@ CEnclave::CEnclave()
     , m_size(0)
     , m_power_event_flag(0)
     , m_ref(0)
-    , m_zombie(false)
     , m_thread_pool(NULL)
     , m_dbg_flag(false)
     , m_destroyed(false)
@@ -69,6 +70,8 @@ CEnclave::CEnclave()
     , m_first_ecall(true)
     , m_aex_notify(false)
     , m_dynamic_tcs_list_size(0)
+    , m_event_words(NULL)
+    , m_event_word_count(0)
 {
     memset(&m_enclave_info, 0, sizeof(debug_enclave_info_t));
     memset(&m_target_info, 0, sizeof(sgx_target_info_t));
@@ -162,14 +165,20 @@ sgx_status_t CEnclave::initialize(const se_file_t& file,  CLoader &ldr, const ui
         return SGX_ERROR_OUT_OF_MEMORY;
     }
 
+    //Reserve a futex word for every enclave page, so the event of a tcs is found from its address alone.
+    //The pages are only backed once a word is touched. Without them the per-thread events are used.
+    m_event_words = (int *)se_virtual_alloc(NULL, (size_t)(m_size >> SE_PAGE_SHIFT) * sizeof(int), MEM_COMMIT);
+    if(m_event_words != NULL)
+        m_event_word_count = (size_t)(m_size >> SE_PAGE_SHIFT);
+
     if(TCS_POLICY_BIND == tcs_policy)
     {
-        m_thread_pool = new CThreadPoolBindMode(tcs_min_pool);
+        m_thread_pool = new CThreadPoolBindMode(m_enclave_id, tcs_min_pool);
     }
     else if(TCS_POLICY_UNBIND == tcs_policy)
     {
         //we also set it as bind mode.
-        m_thread_pool = new CThreadPoolUnBindMode(tcs_min_pool);
+        m_thread_pool = new CThreadPoolUnBindMode(m_enclave_id, tcs_min_pool);
     }
     else
     {
@@ -221,6 +230,13 @@ CEnclave::~CEnclave()
         
     se_event_destroy(m_new_thread_event);
     m_new_thread_event = NULL;
+
+    if (m_event_words)
+    {
+        se_virtual_free(m_event_words, m_event_word_count * sizeof(int), MEM_RELEASE);
+        m_event_words = NULL;
+        m_event_word_count = 0;
+    }
 }
 
 sgx_enclave_id_t CEnclave::get_enclave_id()
@@ -398,6 +414,8 @@ sgx_status_t CEnclave::ecall(const int proc, const void *ocall_table, void *ms,
             }
 
             ret = do_ecall(proc, m_ocall_table, ms, trust_thread);
+            //Before the reference is dropped, while no other thread can take the tcs.
+            m_thread_pool->release_thread(trust_thread);
             if(SGX_PTHREAD_EXIT == ret)
                 //If the ECALL exists by pthread_exit(), then reset the tcs's reference to "0" directly.
                 trust_thread->reset_ref();
@@ -577,6 +595,14 @@ void CEnclave::add_thread(CTrustThread * const trust_thread)
     insert_debug_tcs_info_head(&m_enclave_info, trust_thread->get_debug_info());
 }
 
+se_handle_t CEnclave::get_event(const void * const tcs)
+{
+    size_t index = ((size_t)tcs - (size_t)m_start_addr) >> SE_PAGE_SHIFT;
+    if(m_event_words == NULL || tcs < m_start_addr || index >= m_event_word_count)
+        return NULL;
+    return &m_event_words[index];
+}
+
 
 int CEnclave::set_extra_debug_info(secs_t& secs, CLoader &ldr)
 {
@@ -639,11 +665,121 @@ sgx_target_info_t CEnclave::get_target_info()
     return m_target_info;
 }
 
+//Immutable snapshot of the enclaves in the pool. Lookups by enclave id go through an
+//open addressing hash table, lookups by address through an interval index sorted by
+//start address. A new table is built and published on every add/remove enclave.
+class CEnclaveTable: private Uncopyable
+{
+public:
+    CEnclaveTable(const CEnclaveTable *base, CEnclave *added, const sgx_enclave_id_t removed);
+    CEnclave *find(const sgx_enclave_id_t enclave_id) const;
+    CEnclave *find_with_address(const void * const addr) const;
+    const std::vector<CEnclave *> &get_enclaves() const { return m_enclaves; }
+private:
+    size_t hash(const sgx_enclave_id_t enclave_id) const
+    {
+        return (size_t)((enclave_id * 0x9E3779B97F4A7C15ULL) >> 32) & (m_buckets.size() - 1);
+    }
+
+    std::vector<CEnclave *> m_enclaves;
+    std::vector<CEnclave *> m_buckets;     //size is power of 2 and at least twice the enclave count.
+    std::vector<CEnclave *> m_ranges;      //sorted by start address, enclave ranges don't overlap.
+};
+
+static bool enclave_start_less(CEnclave *a, CEnclave *b)
+{
+    return a->get_start_address() < b->get_start_address();
+}
+
+CEnclaveTable::CEnclaveTable(const CEnclaveTable *base, CEnclave *added, const sgx_enclave_id_t removed)
+{
+    if(base != NULL)
+    {
+        for(std::vector<CEnclave *>::const_iterator it = base->m_enclaves.begin(); it != base->m_enclaves.end(); it++)
+        {
+            if((*it)->get_enclave_id() != removed)
+                m_enclaves.push_back(*it);
+        }
+    }
+    if(added != NULL)
+        m_enclaves.push_back(added);
+
+    size_t nr_buckets = 8;
+    while(nr_buckets < m_enclaves.size() * 2)
+        nr_buckets <<= 1;
+    m_buckets.assign(nr_buckets, NULL);
+    for(std::vector<CEnclave *>::iterator it = m_enclaves.begin(); it != m_enclaves.end(); it++)
+    {
+        size_t idx = hash((*it)->get_enclave_id());
+        while(m_buckets[idx] != NULL)
+            idx = (idx + 1) & (nr_buckets - 1);
+        m_buckets[idx] = *it;
+    }
+
+    m_ranges = m_enclaves;
+    std::sort(m_ranges.begin(), m_ranges.end(), enclave_start_less);
+}
+
+CEnclave *CEnclaveTable::find(const sgx_enclave_id_t enclave_id) const
+{
+    size_t idx = hash(enclave_id);
+    while(m_buckets[idx] != NULL)
+    {
+        if(m_buckets[idx]->get_enclave_id() == enclave_id)
+            return m_buckets[idx];
+        idx = (idx + 1) & (m_buckets.size() - 1);
+    }
+    return NULL;
+}
+
+CEnclave *CEnclaveTable::find_with_address(const void * const addr) const
+{
+    //find the last enclave whose start address is not above addr
+    size_t lo = 0, hi = m_ranges.size();
+    while(lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if(m_ranges[mid]->get_start_address() <= addr)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if(lo == 0)
+        return NULL;
+
+    CEnclave *enclave = m_ranges[lo - 1];
+    void *end = GET_PTR(void, enclave->get_start_address(), enclave->get_size());
+    /* check start & end */
+    if(addr < end)
+        return enclave;
+    return NULL;
+}
+
 CEnclavePool CEnclavePool::m_instance;
+//Called by remove_enclave. Return false if the enclave isn't referenced any more, then
+//the caller deletes it; otherwise the last unref_enclave will.
+bool CEnclave::try_mark_zombie()
+{
+    uint32_t ref = m_ref.load();
+    do
+    {
+        if(ref == 0)
+            return false;
+    } while(!m_ref.compare_exchange_weak(ref, ref | ENCLAVE_REF_ZOMBIE));
+    return true;
+}
+
 CEnclavePool::CEnclavePool()
 {
-    m_enclave_list = NULL;
+    m_enclave_table = new CEnclaveTable(NULL, NULL, 0);
+    m_epoch = 0;
+    for(unsigned idx = 0; idx < ENCLAVE_POOL_READER_SLOTS; idx++)
+    {
+        m_readers[idx].count[0] = 0;
+        m_readers[idx].count[1] = 0;
+    }
     se_mutex_init(&m_enclave_mutex);
+    se_mutex_init(&m_sync_mutex);
     SE_TRACE(SE_TRACE_NOTICE, "enter CEnclavePool constructor\n");
 }
 
@@ -652,128 +788,134 @@ CEnclavePool *CEnclavePool::instance()
     return &m_instance;
 }
 
-int CEnclavePool::add_enclave(CEnclave *enclave)
+//Enter a read side critical section. The table (and the enclaves in it) seen inside
+//the section is not freed until the section is left, see synchronize_readers().
+uint32_t CEnclavePool::read_lock()
 {
-    int result = TRUE;
+    uint32_t slot = (uint32_t)(get_thread_id() % ENCLAVE_POOL_READER_SLOTS);
+    for(;;)
+    {
+        uint32_t epoch = m_epoch.load();
+        m_readers[slot].count[epoch & 1]++;
+        //if the epoch has moved on, the writer may have missed our count, retry in the new epoch.
+        if(m_epoch.load() == epoch)
+            return (slot << 1) | (epoch & 1);
+        m_readers[slot].count[epoch & 1]--;
+    }
+}
 
-    se_mutex_lock(&m_enclave_mutex);
+void CEnclavePool::read_unlock(const uint32_t token)
+{
+    m_readers[token >> 1].count[token & 1]--;
+}
 
-    if (m_enclave_list == NULL) {
-        m_enclave_list = new Node<sgx_enclave_id_t, CEnclave*>(enclave->get_enclave_id(), enclave);
-    } else {
-        Node<sgx_enclave_id_t, CEnclave*>* node = new Node<sgx_enclave_id_t, CEnclave*>(enclave->get_enclave_id(), enclave);
-        if (m_enclave_list->InsertNext(node) == false) {
-            delete node;
-            SE_TRACE(SE_TRACE_WARNING, "the encalve %llx has already been added\n", enclave->get_enclave_id());
-            result = FALSE;
-        }
+//Called with m_sync_mutex held. Wait until every reader that may still see a table
+//replaced before this call has left its read side critical section.
+void CEnclavePool::synchronize_readers()
+{
+    uint32_t epoch = m_epoch.load();
+    m_epoch.store(epoch + 1);
+    for(unsigned idx = 0; idx < ENCLAVE_POOL_READER_SLOTS; idx++)
+    {
+        while(m_readers[idx].count[epoch & 1].load() != 0)
+            sched_yield();
     }
-    se_mutex_unlock(&m_enclave_mutex);
-    return result;
 }
 
-CEnclave * CEnclavePool::get_enclave(const sgx_enclave_id_t enclave_id)
+//Called with m_enclave_mutex held. Return the replaced table, which the caller
+//passes to retire_table() after releasing m_enclave_mutex.
+CEnclaveTable *CEnclavePool::publish_table(CEnclaveTable *table)
 {
+    return m_enclave_table.exchange(table);
+}
+
+//Free a replaced table once no reader can see it. The wait doesn't hold
+//m_enclave_mutex, so it doesn't block other adds and removes.
+void CEnclavePool::retire_table(CEnclaveTable *table)
+{
+    se_mutex_lock(&m_sync_mutex);
+    synchronize_readers();
+    se_mutex_unlock(&m_sync_mutex);
+    delete table;
+}
+
+int CEnclavePool::add_enclave(CEnclave *enclave)
+{
+    int result = TRUE;
+    CEnclaveTable *old_table = NULL;
+
     se_mutex_lock(&m_enclave_mutex);
-    if(m_enclave_list == NULL)
-    {
-        se_mutex_unlock(&m_enclave_mutex);
-        return NULL;
-    }
-    Node<sgx_enclave_id_t, CEnclave*>* it = m_enclave_list->Find(enclave_id);
-    if(it != NULL)
+
+    CEnclaveTable *table = m_enclave_table.load();
+    if(table->find(enclave->get_enclave_id()) != NULL)
     {
-        se_mutex_unlock(&m_enclave_mutex);
-        return it->value;
+        SE_TRACE(SE_TRACE_WARNING, "the encalve %llx has already been added\n", enclave->get_enclave_id());
+        result = FALSE;
     }
     else
     {
-        se_mutex_unlock(&m_enclave_mutex);
-        return NULL;
+        old_table = publish_table(new CEnclaveTable(table, enclave, 0));
     }
+    se_mutex_unlock(&m_enclave_mutex);
+
+    if(old_table != NULL)
+        retire_table(old_table);
+    return result;
+}
+
+CEnclave * CEnclavePool::get_enclave(const sgx_enclave_id_t enclave_id)
+{
+    uint32_t token = read_lock();
+    CEnclave *enclave = m_enclave_table.load()->find(enclave_id);
+    read_unlock(token);
+    return enclave;
 }
 
 CEnclave * CEnclavePool::get_enclave_with_tcs(const void * const tcs)
 {
     assert(tcs != NULL);
-    se_mutex_lock(&m_enclave_mutex);
-
-    Node<sgx_enclave_id_t, CEnclave*>* it = m_enclave_list;
-    for(; it != NULL; it = it->next)
-    {
-        void *start = it->value->get_start_address();
-        void *end = GET_PTR(void, start, it->value->get_size());
-
-        /* check start & end */
-        if (tcs >= start && tcs < end) {
-            se_mutex_unlock(&m_enclave_mutex);
-            return it->value;
-        }
-    }
-    se_mutex_unlock(&m_enclave_mutex);
-    return NULL;
+    uint32_t token = read_lock();
+    CEnclave *enclave = m_enclave_table.load()->find_with_address(tcs);
+    read_unlock(token);
+    return enclave;
 }
 
 CEnclave * CEnclavePool::ref_enclave(const sgx_enclave_id_t enclave_id)
 {
-    se_mutex_lock(&m_enclave_mutex);
-    if(m_enclave_list == NULL)
-    {
-        se_mutex_unlock(&m_enclave_mutex);
-        return NULL;
-    }
-    Node<sgx_enclave_id_t, CEnclave*>* it = m_enclave_list->Find(enclave_id);
-    if(it != NULL)
-    {
-        it->value->atomic_inc_ref();
-        se_mutex_unlock(&m_enclave_mutex);
-        return it->value;
-    }
-    else
-    {
-        se_mutex_unlock(&m_enclave_mutex);
-        return NULL;
-    }
+    uint32_t token = read_lock();
+    CEnclave *enclave = m_enclave_table.load()->find(enclave_id);
+    //remove_enclave waits for this read section before checking the reference count.
+    if(enclave != NULL)
+        enclave->atomic_inc_ref();
+    read_unlock(token);
+    return enclave;
 }
 
 void CEnclavePool::unref_enclave(CEnclave *enclave)
 {
-    //We use enclave pool lock to protect data, the lock is big, but is more secure.
-    se_mutex_lock(&m_enclave_mutex);
     //The ref is increased in ref_enclave;
-    uint32_t ref = enclave->atomic_dec_ref();
-
     //If the enclave is in zombie state, the HW enclave must have been destroyed.
     //And if the enclave is not referenced, the enclave instance will not be referenced any more,
-    //so we delete the instance.
+    //so we delete the instance. The zombie flag and the count are one word, so the enclave
+    //is not touched after the decrement unless this thread owns the deletion.
     //Another code path that delete enclave instance is in function "CEnclavePool::remove_enclave"
-    if(enclave->is_zombie() && !ref)
+    if(enclave->release_ref())
         delete enclave;
-
-    se_mutex_unlock(&m_enclave_mutex);
 }
 
 se_handle_t CEnclavePool::get_event(const void * const tcs)
 {
     se_handle_t hevent = NULL;
-    CEnclave *enclave = NULL;
 
     assert(tcs != NULL);
-    se_mutex_lock(&m_enclave_mutex);
+    uint32_t token = read_lock();
 
-    Node<sgx_enclave_id_t, CEnclave*>* it = m_enclave_list;
-    for(; it != NULL; it = it->next)
+    CEnclave *enclave = m_enclave_table.load()->find_with_address(tcs);
+    if (NULL != enclave && NULL != (hevent = enclave->get_event(tcs)))
     {
-        void *start = it->value->get_start_address();
-        void *end = GET_PTR(void, start, it->value->get_size());
-
-        /* check start & end */
-        if (tcs >= start && tcs < end) {
-            enclave = it->value;
-            break;
-        }
+        read_unlock(token);
+        return hevent;
     }
-
     if (NULL != enclave)
     {
         CTrustThreadPool *pool = enclave->get_thread_pool();
@@ -785,7 +927,7 @@ se_handle_t CEnclavePool::get_event(const void * const tcs)
         }
     }
 
-    se_mutex_unlock(&m_enclave_mutex);
+    read_unlock(token);
     return hevent;
 }
 
@@ -794,7 +936,8 @@ CEnclave* CEnclavePool::remove_enclave(const sgx_enclave_id_t enclave_id, sgx_st
     status = SGX_SUCCESS;
     se_mutex_lock(&m_enclave_mutex);
 
-    CEnclave *enclave = get_enclave(enclave_id);
+    CEnclaveTable *table = m_enclave_table.load();
+    CEnclave *enclave = table->find(enclave_id);
     if(NULL == enclave)
     {
         status = SGX_ERROR_INVALID_ENCLAVE_ID;
@@ -804,11 +947,14 @@ CEnclave* CEnclavePool::remove_enclave(const sgx_enclave_id_t enclave_id, sgx_st
     }
 
     enclave->destroy();
+    //After the old table is retired, no reader can find or reference the enclave any more.
+    CEnclaveTable *old_table = publish_table(new CEnclaveTable(table, NULL, enclave_id));
+    se_mutex_unlock(&m_enclave_mutex);
+    retire_table(old_table);
+
     //the ref is not 0, maybe some thread is in sgx_ocall, so we can NOT delete enclave instance.
     if(enclave->get_ref())
     {
-        enclave->mark_zombie();
-
         /* When destroy the enclave, all threads that are waiting/about to wait
          * on untrusted event need to be waked. Otherwise, they will be always
          * pending on the untrusted events, and app need to manually kill the threads.
@@ -816,32 +962,26 @@ CEnclave* CEnclavePool::remove_enclave(const sgx_enclave_id_t enclave_id, sgx_st
         CTrustThreadPool *pool = enclave->get_thread_pool();
         pool->wake_threads();
 
-        enclave = NULL;
+        //From now on the last unref_enclave deletes the enclave instance, unless the last
+        //reference has already gone, then we delete it.
+        if(enclave->try_mark_zombie())
+            enclave = NULL;
     }
-    Node<sgx_enclave_id_t, CEnclave*>* it = m_enclave_list->Remove(enclave_id);
-    if (it == m_enclave_list)
-        m_enclave_list = it->next;
-    delete it;
-    se_mutex_unlock(&m_enclave_mutex);
 
     return enclave;
 }
 
 void CEnclavePool::notify_debugger()
 {
-    se_mutex_lock(&m_enclave_mutex);
-    if(m_enclave_list!= NULL)
+    uint32_t token = read_lock();
+    const std::vector<CEnclave *> &enclaves = m_enclave_table.load()->get_enclaves();
+    for(std::vector<CEnclave *>::const_iterator it = enclaves.begin(); it != enclaves.end(); it++)
     {
-        Node<sgx_enclave_id_t, CEnclave*>* it = m_enclave_list;
-        for(; it != NULL; it = it->next)
-        {
-            //send debug event to debugger when enclave is debug mode or release mode
-            debug_enclave_info_t * debug_info = const_cast<debug_enclave_info_t*>((it->value)->get_debug_info());
-            generate_enclave_debug_event(URTS_EXCEPTION_PREREMOVEENCLAVE, debug_info);
-        }
+        //send debug event to debugger when enclave is debug mode or release mode
+        debug_enclave_info_t * debug_info = const_cast<debug_enclave_info_t*>((*it)->get_debug_info());
+        generate_enclave_debug_event(URTS_EXCEPTION_PREREMOVEENCLAVE, debug_info);
     }
-    se_mutex_unlock(&m_enclave_mutex);
-
+    read_unlock(token);
 }
 
 bool CEnclave::update_trust_thread_debug_flag(void* tcs_address, uint8_t debug_flag)
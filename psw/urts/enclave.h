@@ -42,9 +42,13 @@
 #include "file.h"
 #include "uncopyable.h"
 #include "node.h"
+#include <atomic>
 
 class CLoader;
 
+//Set in CEnclave::m_ref when the enclave is removed while it is still referenced.
+#define ENCLAVE_REF_ZOMBIE  0x80000000U
+
 class CEnclave: private Uncopyable
 {
 public:
@@ -59,11 +63,11 @@ public:
     sgx_status_t ecall(const int proc, const void *ocall_table, void *ms, const bool is_fast = false);
     int ocall(const unsigned int proc, const sgx_ocall_table_t *ocall_table, void *ms);
     void destroy();
-    uint32_t atomic_inc_ref() { return se_atomic_inc(&m_ref); }
-    uint32_t atomic_dec_ref() { return se_atomic_dec(&m_ref); }
-    uint32_t get_ref() { return m_ref; }
-    void mark_zombie()  { m_zombie = true; }
-    bool is_zombie() { return m_zombie; }
+    uint32_t atomic_inc_ref() { return (m_ref.fetch_add(1) + 1) & ~ENCLAVE_REF_ZOMBIE; }
+    //return true if the last reference of a zombie enclave is released, the caller deletes the enclave then.
+    bool release_ref() { return m_ref.fetch_sub(1) - 1 == ENCLAVE_REF_ZOMBIE; }
+    uint32_t get_ref() { return m_ref.load() & ~ENCLAVE_REF_ZOMBIE; }
+    bool try_mark_zombie();
     sgx_status_t initialize(const se_file_t& file, CLoader &ldr, const uint64_t enclave_size, const uint32_t tcs_policy, const uint32_t enclave_version, const uint32_t tcs_min_pool);
     void add_thread(tcs_t * const tcs, bool is_unallocated);
     void add_thread(CTrustThread * const trust_thread);
@@ -90,6 +94,8 @@ public:
     CTrustThread * get_free_tcs();
     bool set_aex_notify(bool flag);
     bool get_aex_notify();
+    se_handle_t get_event(const void * const tcs);
+    int *get_event_words(size_t *count) { *count = m_event_word_count; return m_event_words; }
 
 
 private:
@@ -106,8 +112,7 @@ private:
     uint64_t                m_size;
     se_rwlock_t             m_rwlock;
     uint32_t                m_power_event_flag;
-    uint32_t                m_ref;
-    bool                    m_zombie;
+    std::atomic<uint32_t>   m_ref;          //reference count, ENCLAVE_REF_ZOMBIE is set once the enclave is removed.
     CTrustThreadPool        *m_thread_pool;
     debug_enclave_info_t    m_enclave_info;
     bool                    m_dbg_flag;
@@ -123,11 +128,17 @@ private:
     bool                    m_aex_notify;
     sgx_target_info_t       m_target_info;
     size_t                  m_dynamic_tcs_list_size;
+    int                     *m_event_words;        //futex word of each tcs, indexed by its page in the enclave.
+    size_t                  m_event_word_count;
 #ifdef SE_SIM    
     void                    *m_global_data_sim_ptr;
 #endif
 };
 
+#define ENCLAVE_POOL_READER_SLOTS   16
+
+class CEnclaveTable;
+
 class CEnclavePool: private Uncopyable
 {
 public:
@@ -142,9 +153,23 @@ public:
     void notify_debugger();
 private:
     CEnclavePool();
+    uint32_t read_lock();
+    void read_unlock(const uint32_t token);
+    void synchronize_readers();
+    CEnclaveTable *publish_table(CEnclaveTable *table);
+    void retire_table(CEnclaveTable *table);
+
+    //Readers are counted per epoch, spread over cache line sized slots by thread id.
+    struct reader_slot_t
+    {
+        alignas(64) std::atomic<uint32_t> count[2];
+    };
 
-    Node<sgx_enclave_id_t, CEnclave*>   *m_enclave_list;
-    se_mutex_t                          m_enclave_mutex;       //sync for add/get/remove enclave.
+    std::atomic<CEnclaveTable *>        m_enclave_table;       //immutable, replaced on add/remove enclave.
+    std::atomic<uint32_t>               m_epoch;
+    reader_slot_t                       m_readers[ENCLAVE_POOL_READER_SLOTS];
+    se_mutex_t                          m_enclave_mutex;       //sync for add/remove enclave.
+    se_mutex_t                          m_sync_mutex;          //serializes the waits for readers.
     static CEnclavePool                 m_instance;
 };
 
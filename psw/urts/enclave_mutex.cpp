@@ -93,3 +93,25 @@ extern "C" int sgx_thread_setwait_untrusted_events_ocall(const void *waiter, con
 
     return sgx_thread_wait_untrusted_event_ocall(self);
 }
+
+/* get the futex words of the untrusted events, so the enclave can post and
+ * consume wakeups itself while no thread is sleeping */
+extern "C" int sgx_thread_get_event_words_ocall(const void *self, uint64_t *words, uint64_t *count, uint64_t *origin)
+{
+    if (self == NULL || words == NULL || count == NULL || origin == NULL)
+        return SGX_ERROR_INVALID_PARAMETER;
+
+    CEnclave *enclave = CEnclavePool::instance()->get_enclave_with_tcs(self);
+    if (enclave == NULL)
+        return SE_ERROR_MUTEX_GET_EVENT;
+
+    size_t word_count = 0;
+    int *event_words = enclave->get_event_words(&word_count);
+    if (event_words == NULL)
+        return SE_ERROR_MUTEX_GET_EVENT;
+
+    *words = (uint64_t)(size_t)event_words;
+    *count = (uint64_t)word_count;
+    *origin = (uint64_t)(size_t)enclave->get_start_address();
+    return SGX_SUCCESS;
+}
@@ -0,0 +1,255 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "enclave_template.h"
+#include "binparser.h"
+#include "se_trace.h"
+#include <string.h>
+
+CEnclaveTemplate::CEnclaveTemplate(uint8_t *base_addr, uint64_t file_size, map_handle_t *mh)
+    : m_base_addr(base_addr)
+    , m_file_size(file_size)
+    , m_mh(mh)
+    , m_parser(NULL)
+    , m_metadata(NULL)
+    , m_ref(0)
+    , m_cached(false)
+{
+    memset(&m_id, 0, sizeof(m_id));
+}
+
+CEnclaveTemplate::~CEnclaveTemplate()
+{
+    delete m_parser;
+    if(m_mh != NULL)
+        unmap_file(m_mh);
+}
+
+uint8_t *CEnclaveTemplate::get_base_addr() const
+{
+    return m_base_addr;
+}
+
+uint64_t CEnclaveTemplate::get_file_size() const
+{
+    return m_file_size;
+}
+
+BinParser *CEnclaveTemplate::get_parser() const
+{
+    return m_parser;
+}
+
+void CEnclaveTemplate::set_parser(BinParser *parser)
+{
+    delete m_parser;
+    m_parser = parser;
+}
+
+bool CEnclaveTemplate::is_prepared() const
+{
+    return m_metadata != NULL;
+}
+
+const metadata_t *CEnclaveTemplate::get_metadata() const
+{
+    return m_metadata;
+}
+
+const std::vector<uint8_t>& CEnclaveTemplate::get_reloc_bitmap() const
+{
+    return m_reloc_bitmap;
+}
+
+void CEnclaveTemplate::set_prepared(const metadata_t *metadata, const std::vector<uint8_t> &reloc_bitmap)
+{
+    m_reloc_bitmap = reloc_bitmap;
+    m_metadata = metadata;
+}
+
+static bool same_file(const enclave_file_id_t &a, const enclave_file_id_t &b)
+{
+    return a.dev == b.dev && a.ino == b.ino;
+}
+
+static bool same_content(const enclave_file_id_t &a, const enclave_file_id_t &b)
+{
+    return same_file(a, b) && a.size == b.size &&
+           a.mtime.tv_sec == b.mtime.tv_sec && a.mtime.tv_nsec == b.mtime.tv_nsec &&
+           a.ctime.tv_sec == b.ctime.tv_sec && a.ctime.tv_nsec == b.ctime.tv_nsec;
+}
+
+static bool changed_before(const enclave_file_id_t &a, const enclave_file_id_t &b)
+{
+    return a.ctime.tv_sec < b.ctime.tv_sec ||
+           (a.ctime.tv_sec == b.ctime.tv_sec && a.ctime.tv_nsec < b.ctime.tv_nsec);
+}
+
+CEnclaveTemplateCache CEnclaveTemplateCache::m_instance;
+
+CEnclaveTemplateCache::CEnclaveTemplateCache()
+    : m_size(0)
+    , m_max_size(ENCLAVE_TEMPLATE_CACHE_DEFAULT_SIZE)
+{
+    se_mutex_init(&m_mutex);
+}
+
+CEnclaveTemplateCache *CEnclaveTemplateCache::instance()
+{
+    return &m_instance;
+}
+
+//Called with m_mutex held.
+CEnclaveTemplate *CEnclaveTemplateCache::find(const enclave_file_id_t &id)
+{
+    for(std::list<CEnclaveTemplate *>::iterator it = m_templates.begin(); it != m_templates.end(); it++)
+    {
+        if(same_content((*it)->m_id, id))
+            return *it;
+    }
+    return NULL;
+}
+
+//Called with m_mutex held. A template still used by a load is freed on its release.
+void CEnclaveTemplateCache::remove(CEnclaveTemplate *image)
+{
+    m_templates.remove(image);
+    m_size -= image->m_file_size;
+    image->m_cached = false;
+    if(image->m_ref == 0)
+        delete image;
+}
+
+//Called with m_mutex held. Drops the templates of older versions of the file of id, which
+//was rebuilt since they were cached. Returns false if a newer version is cached instead.
+bool CEnclaveTemplateCache::remove_stale(const enclave_file_id_t &id)
+{
+    std::list<CEnclaveTemplate *>::iterator it = m_templates.begin();
+    while(it != m_templates.end())
+    {
+        CEnclaveTemplate *image = *it++;
+        if(!same_file(image->m_id, id))
+            continue;
+        if(changed_before(id, image->m_id))
+            return false;
+        remove(image);
+    }
+    return true;
+}
+
+//Called with m_mutex held.
+void CEnclaveTemplateCache::shrink(uint64_t max_size)
+{
+    while(m_size > max_size && !m_templates.empty())
+        remove(m_templates.back());
+}
+
+CEnclaveTemplate *CEnclaveTemplateCache::acquire(se_file_handle_t fd)
+{
+    struct stat st;
+    enclave_file_id_t id;
+    CEnclaveTemplate *image = NULL;
+
+    memset(&id, 0, sizeof(id));
+    if(fstat(fd, &st) == 0)
+    {
+        id.dev = st.st_dev;
+        id.ino = st.st_ino;
+        id.size = st.st_size;
+        id.mtime = st.st_mtim;
+        id.ctime = st.st_ctim;
+
+        se_mutex_lock(&m_mutex);
+        image = find(id);
+        if(image != NULL)
+        {
+            image->m_ref++;
+            m_templates.remove(image);
+            m_templates.push_front(image);
+        }
+        se_mutex_unlock(&m_mutex);
+        if(image != NULL)
+            return image;
+    }
+
+    off_t file_size = 0;
+    map_handle_t *mh = map_file(fd, &file_size);
+    if(mh == NULL)
+        return NULL;
+
+    image = new CEnclaveTemplate(mh->base_addr, (uint64_t)file_size, mh);
+    image->m_id = id;
+    image->m_ref = 1;
+    return image;
+}
+
+void CEnclaveTemplateCache::release(CEnclaveTemplate *image, bool success)
+{
+    if(image == NULL)
+        return;
+
+    se_mutex_lock(&m_mutex);
+    image->m_ref--;
+    //Only a template whose identity is known, and which loaded successfully, is worth keeping.
+    if(!image->m_cached && success && image->is_prepared() && image->m_id.ino != 0 &&
+       image->m_file_size <= m_max_size && find(image->m_id) == NULL && remove_stale(image->m_id))
+    {
+        m_templates.push_front(image);
+        m_size += image->m_file_size;
+        image->m_cached = true;
+        shrink(m_max_size);
+    }
+    if(!image->m_cached && image->m_ref == 0)
+        delete image;
+    se_mutex_unlock(&m_mutex);
+}
+
+void CEnclaveTemplateCache::invalidate(const enclave_file_id_t *id)
+{
+    se_mutex_lock(&m_mutex);
+    std::list<CEnclaveTemplate *>::iterator it = m_templates.begin();
+    while(it != m_templates.end())
+    {
+        CEnclaveTemplate *image = *it++;
+        if(id == NULL || same_file(image->m_id, *id))
+            remove(image);
+    }
+    se_mutex_unlock(&m_mutex);
+}
+
+void CEnclaveTemplateCache::set_max_size(uint64_t max_size)
+{
+    se_mutex_lock(&m_mutex);
+    m_max_size = max_size;
+    shrink(m_max_size);
+    se_mutex_unlock(&m_mutex);
+}
@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef _ENCLAVE_TEMPLATE_H_
+#define _ENCLAVE_TEMPLATE_H_
+
+#include "se_wrapper.h"
+#include "se_map.h"
+#include "metadata.h"
+#include "uncopyable.h"
+#include <sys/stat.h>
+#include <stdint.h>
+#include <vector>
+#include <list>
+
+class BinParser;
+
+//Default bound on the total size of the enclave files kept mapped by the template cache.
+#define ENCLAVE_TEMPLATE_CACHE_DEFAULT_SIZE   (256ULL * 1024 * 1024)
+
+//Identity of an enclave file. A rewritten file gets a new size or timestamps,
+//so it never matches a template built from its previous content.
+typedef struct _enclave_file_id_t
+{
+    dev_t           dev;
+    ino_t           ino;
+    off_t           size;
+    struct timespec mtime;
+    struct timespec ctime;
+} enclave_file_id_t;
+
+//A parsed and relocated enclave image. After the first load it is also validated
+//and patched against its metadata (prepared), so later loads of the same image only
+//add the pages and initialize the enclave. A template published in the cache is
+//never written again.
+class CEnclaveTemplate: private Uncopyable
+{
+public:
+    CEnclaveTemplate(uint8_t *base_addr, uint64_t file_size, map_handle_t *mh = NULL);
+    ~CEnclaveTemplate();
+    uint8_t *get_base_addr() const;
+    uint64_t get_file_size() const;
+    BinParser *get_parser() const;
+    void set_parser(BinParser *parser);
+    bool is_prepared() const;
+    const metadata_t *get_metadata() const;
+    const std::vector<uint8_t>& get_reloc_bitmap() const;
+    void set_prepared(const metadata_t *metadata, const std::vector<uint8_t> &reloc_bitmap);
+
+private:
+    friend class CEnclaveTemplateCache;
+
+    uint8_t                 *m_base_addr;
+    uint64_t                m_file_size;
+    map_handle_t            *m_mh;          //owned mapping, NULL for a caller's buffer
+    BinParser               *m_parser;      //owned
+    const metadata_t        *m_metadata;    //non-NULL once prepared
+    std::vector<uint8_t>    m_reloc_bitmap;
+    enclave_file_id_t       m_id;
+    uint32_t                m_ref;
+    bool                    m_cached;
+};
+
+//Process wide cache of enclave templates, least recently used first out.
+class CEnclaveTemplateCache: private Uncopyable
+{
+public:
+    static CEnclaveTemplateCache *instance();
+    //Return a referenced template of the file, mapping the file on a miss.
+    CEnclaveTemplate *acquire(se_file_handle_t fd);
+    //Drop the reference. A template prepared by a successful load is published.
+    void release(CEnclaveTemplate *image, bool success);
+    //Drop the templates of the file, all templates if id is NULL.
+    void invalidate(const enclave_file_id_t *id);
+    void set_max_size(uint64_t max_size);
+
+private:
+    CEnclaveTemplateCache();
+    CEnclaveTemplate *find(const enclave_file_id_t &id);
+    void remove(CEnclaveTemplate *image);
+    bool remove_stale(const enclave_file_id_t &id);
+    void shrink(uint64_t max_size);
+
+    std::list<CEnclaveTemplate *>   m_templates;    //most recently used first
+    uint64_t                        m_size;
+    uint64_t                        m_max_size;
+    se_mutex_t                      m_mutex;
+    static CEnclaveTemplateCache    m_instance;
+};
+
+#endif
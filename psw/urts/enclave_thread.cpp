@@ -98,7 +98,7 @@ extern "C" sgx_status_t pthread_create_ocall(unsigned long long self)
     if(ret != 0)
     {
         //Add back the tcs to free queue directly, because the tcs hasn't been binded with the new thread yet.
-        enclave->get_thread_pool()->add_to_free_thread_vector(trust_thread);
+        enclave->get_thread_pool()->add_to_free_threads(trust_thread);
         return SGX_ERROR_UNEXPECTED;
     }
 
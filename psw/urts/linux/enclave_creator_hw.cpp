@@ -216,9 +216,14 @@ int EnclaveCreatorHW::create_enclave(secs_t *secs, sgx_enclave_id_t *enclave_id,
 }
 
 int EnclaveCreatorHW::add_enclave_page(sgx_enclave_id_t enclave_id, void *src, uint64_t rva, const sec_info_t &sinfo, uint32_t attr)
+{
+    return add_enclave_pages(enclave_id, src, rva, SE_PAGE_SIZE, sinfo, attr);
+}
+
+int EnclaveCreatorHW::add_enclave_pages(sgx_enclave_id_t enclave_id, void *src, uint64_t rva, uint64_t size, const sec_info_t &sinfo, uint32_t attr)
 {
     assert((rva & ((1<<SE_PAGE_SHIFT)-1)) == 0);
-    UNUSED(attr);
+    assert((size & ((1<<SE_PAGE_SHIFT)-1)) == 0);
 
     uint32_t enclave_error = ENCLAVE_ERROR_SUCCESS;
     uint32_t data_properties = (uint32_t)(sinfo.flags);
@@ -226,7 +231,7 @@ int EnclaveCreatorHW::add_enclave_page(sgx_enclave_id_t enclave_id, void *src, u
     {
         data_properties |= ENCLAVE_PAGE_UNVALIDATED;
     }
-    enclave_load_data((void*)(enclave_id + rva), SE_PAGE_SIZE, src, data_properties, &enclave_error);
+    enclave_load_data((void*)(enclave_id + rva), (size_t)size, src, data_properties, &enclave_error);
 
     return error_api2urts(enclave_error);
 }
@@ -31,6 +31,9 @@
 
 #include "get_thread_id.h"
 #include <stdlib.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/syscall.h>
 
 static pthread_key_t g_tid_key;
 static pthread_once_t g_key_once = PTHREAD_ONCE_INIT;
@@ -62,3 +65,19 @@ se_thread_id_t get_thread_id()
     }
     return tid;
 }
+
+bool get_current_cpu(uint32_t *cpu, uint32_t *node)
+{
+    unsigned int c = 0, n = 0;
+
+    //glibc 2.29 and later go through the vDSO, which avoids a real syscall.
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 29)
+    if(getcpu(&c, &n) != 0)
+#else
+    if(syscall(SYS_getcpu, &c, &n, NULL) != 0)
+#endif
+        return false;
+    *cpu = c;
+    *node = n;
+    return true;
+}
@@ -33,6 +33,7 @@
 #define _GET_THREAD_ID_H_
 
 #include "se_thread.h"
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -40,6 +41,10 @@ extern "C" {
 
 se_thread_id_t get_thread_id();
 
+/* Get the cpu and NUMA node the calling thread runs on. Returns false,
+ * leaving cpu and node untouched, when they can't be read. */
+bool get_current_cpu(uint32_t *cpu, uint32_t *node);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -149,6 +149,76 @@ extern "C" sgx_status_t sgx_get_target_info(
     return SGX_SUCCESS;
 }
 
+extern "C" sgx_status_t sgx_set_enclave_template_cache_size(size_t max_size)
+{
+    CEnclaveTemplateCache::instance()->set_max_size((uint64_t)max_size);
+    return SGX_SUCCESS;
+}
+
+extern "C" sgx_status_t sgx_invalidate_enclave_template(const char *file_name)
+{
+    if (file_name == NULL)
+    {
+        CEnclaveTemplateCache::instance()->invalidate(NULL);
+        return SGX_SUCCESS;
+    }
+
+    struct stat st;
+    if (stat(file_name, &st) != 0)
+    {
+        SE_TRACE(SE_TRACE_ERROR, "Couldn't stat the enclave file, error = %d\n", errno);
+        return SGX_ERROR_ENCLAVE_FILE_ACCESS;
+    }
+    enclave_file_id_t id;
+    memset(&id, 0, sizeof(id));
+    id.dev = st.st_dev;
+    id.ino = st.st_ino;
+    CEnclaveTemplateCache::instance()->invalidate(&id);
+    return SGX_SUCCESS;
+}
+
+extern "C" sgx_status_t sgx_set_tcs_affinity_policy(const sgx_enclave_id_t enclave_id, uint32_t policy)
+{
+    if (policy != SGX_TCS_AFFINITY_NONE && policy != SGX_TCS_AFFINITY_LOCAL)
+        return SGX_ERROR_INVALID_PARAMETER;
+
+    CEnclave* enclave = CEnclavePool::instance()->ref_enclave(enclave_id);
+    if (!enclave) {
+        return SGX_ERROR_INVALID_ENCLAVE_ID;
+    }
+    enclave->get_thread_pool()->set_affinity_policy(policy);
+    CEnclavePool::instance()->unref_enclave(enclave);
+    return SGX_SUCCESS;
+}
+
+extern "C" sgx_status_t sgx_set_tcs_provisioning(const sgx_enclave_id_t enclave_id, uint32_t headroom, uint32_t cooldown_ms)
+{
+    CEnclave* enclave = CEnclavePool::instance()->ref_enclave(enclave_id);
+    if (!enclave) {
+        return SGX_ERROR_INVALID_ENCLAVE_ID;
+    }
+    enclave->get_thread_pool()->set_provisioning(headroom, cooldown_ms);
+    CEnclavePool::instance()->unref_enclave(enclave);
+    return SGX_SUCCESS;
+}
+
+extern "C" sgx_status_t sgx_get_tcs_stats(const sgx_enclave_id_t enclave_id, sgx_tcs_stats_t *stats, size_t *count)
+{
+    if (!count || (!stats && *count != 0))
+        return SGX_ERROR_INVALID_PARAMETER;
+
+    CEnclave* enclave = CEnclavePool::instance()->ref_enclave(enclave_id);
+    if (!enclave) {
+        return SGX_ERROR_INVALID_ENCLAVE_ID;
+    }
+    size_t nr_tcs = enclave->get_thread_pool()->get_tcs_stats(stats, *count);
+    CEnclavePool::instance()->unref_enclave(enclave);
+
+    sgx_status_t ret = (nr_tcs > *count) ? SGX_ERROR_INVALID_PARAMETER : SGX_SUCCESS;
+    *count = nr_tcs;
+    return ret;
+}
+
 
 extern "C" sgx_status_t sgx_create_enclave_from_buffer_ex(uint8_t *buffer,
                                                           uint64_t buffer_size,
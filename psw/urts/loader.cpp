@@ -97,6 +97,7 @@ CLoader::CLoader(uint8_t *mapped_file_base, BinParser &parser)
     , m_elrange_size(0)
     , m_metadata(NULL)
     , m_parser(parser)
+    , m_prepared_metadata(NULL)
 {
     memset(&m_secs, 0, sizeof(m_secs));
 }
@@ -160,48 +161,69 @@ bool CLoader::is_relocation_page(const uint64_t rva, std::vector<uint8_t> *bitma
     return false;
 }
 
+int CLoader::get_section_page_secinfo(const section_info_t &sec_info, const uint64_t rva, sec_info_t &sinfo)
+{
+    sinfo.flags = sec_info.flag;
+
+    if(is_relocation_page(rva, sec_info.bitmap) && !(sec_info.flag & SI_FLAG_W))
+    {
+        sinfo.flags = sec_info.flag | SI_FLAG_W;
+        assert(g_enclave_creator != NULL);
+        if(g_enclave_creator->use_se_hw() == true)
+        {
+            int ret = mprotect((void*)(TRIM_TO_PAGE(rva) + (uint64_t)m_start_addr), SE_PAGE_SIZE, 
+                           (int)(sinfo.flags & SI_MASK_MEM_ATTRIBUTE));
+            if(ret != 0)
+            {
+                SE_TRACE(SE_TRACE_WARNING, "mprotect(rva=0x%llx, len=%d, flags=%d) failed\n",
+                         rva, SE_PAGE_SIZE, int(sinfo.flags & SI_MASK_MEM_ATTRIBUTE));
+                return SGX_ERROR_UNEXPECTED;
+            }
+        }
+    }
+
+    return SGX_SUCCESS;
+}
+
 int CLoader::build_mem_region(const section_info_t &sec_info)
 {
     int ret = SGX_SUCCESS;
     uint64_t offset = 0;
-    sec_info_t sinfo;
+    sec_info_t sinfo, next_sinfo;
     memset(&sinfo, 0, sizeof(sinfo));
+    memset(&next_sinfo, 0, sizeof(next_sinfo));
 
-    // Build pages of the section that are contain initialized data.  Each page
-    // needs to be added individually as the page may hold relocation data, in
-    // which case the page needs to be marked writable.
+    // Build pages of the section that are contain initialized data.  A page
+    // that holds relocation data needs to be marked writable, so the full
+    // pages are added in runs of pages that share the same page flags.
     while(offset < sec_info.raw_data_size)
     {
         uint64_t rva = sec_info.rva + offset;
         uint64_t size = MIN((SE_PAGE_SIZE - PAGE_OFFSET(rva)), (sec_info.raw_data_size - offset));
-        sinfo.flags = sec_info.flag;
+        if(SGX_SUCCESS != (ret = get_section_page_secinfo(sec_info, rva, sinfo)))
+            return ret;
 
-        if(is_relocation_page(rva, sec_info.bitmap) && !(sec_info.flag & SI_FLAG_W))
+        if (size == SE_PAGE_SIZE)
         {
-            sinfo.flags = sec_info.flag | SI_FLAG_W;
-            assert(g_enclave_creator != NULL);
-            if(g_enclave_creator->use_se_hw() == true)
+            while(offset + size + SE_PAGE_SIZE <= sec_info.raw_data_size)
             {
-                ret = mprotect((void*)(TRIM_TO_PAGE(rva) + (uint64_t)m_start_addr), SE_PAGE_SIZE, 
-                               (int)(sinfo.flags & SI_MASK_MEM_ATTRIBUTE));
-                if(ret != 0)
-                {
-                    SE_TRACE(SE_TRACE_WARNING, "mprotect(rva=0x%llx, len=%d, flags=%d) failed\n",
-                             rva, SE_PAGE_SIZE, int(sinfo.flags & SI_MASK_MEM_ATTRIBUTE));
-                    return SGX_ERROR_UNEXPECTED;
-                }
+                if(SGX_SUCCESS != (ret = get_section_page_secinfo(sec_info, rva + size, next_sinfo)))
+                    return ret;
+                if(next_sinfo.flags != sinfo.flags)
+                    break;
+                size += SE_PAGE_SIZE;
             }
+            ret = build_page_range(rva, size, sec_info.raw_data + offset, sinfo, ADD_EXTEND_PAGE);
+            offset += size;
         }
-
-        if (size == SE_PAGE_SIZE)
-            ret = build_pages(rva, size, sec_info.raw_data + offset, sinfo, ADD_EXTEND_PAGE);
         else
+        {
             ret = build_partial_page(rva, size, sec_info.raw_data + offset, sinfo, ADD_EXTEND_PAGE);
+            // only the first time that rva may be not page aligned
+            offset += SE_PAGE_SIZE - PAGE_OFFSET(rva);
+        }
         if(SGX_SUCCESS != ret)
             return ret;
-
-        // only the first time that rva may be not page aligned
-        offset += SE_PAGE_SIZE - PAGE_OFFSET(rva);
     }
     
     // Add any remaining uninitialized data.  We can call build_pages directly
@@ -295,30 +317,50 @@ int CLoader::build_partial_page(const uint64_t rva, const uint64_t size, const v
     memcpy_s(&page_data[offset], (size_t)(SE_PAGE_SIZE - offset), source, (size_t)size);
 
     // Add the page, trimming the start address to make it page aligned.
-    return build_pages(TRIM_TO_PAGE(rva), SE_PAGE_SIZE, page_data, sinfo, attr);
+    return build_page_range(TRIM_TO_PAGE(rva), SE_PAGE_SIZE, page_data, sinfo, attr);
+}
+
+int CLoader::build_page_range(const uint64_t start_rva, const uint64_t size, const void *source, const sec_info_t &sinfo, const uint32_t attr)
+{
+    assert(IS_PAGE_ALIGNED(start_rva) && IS_PAGE_ALIGNED(size));
+
+    //call driver to add the whole range at once;
+    return get_enclave_creator()->add_enclave_pages(ENCLAVE_ID_IOCTL, const_cast<void *>(source), start_rva, size, sinfo, attr);
 }
 
+// Every page of the range gets the content of the single page at source, or
+// zeros if source is NULL.
 int CLoader::build_pages(const uint64_t start_rva, const uint64_t size, const void *source, const sec_info_t &sinfo, const uint32_t attr)
 {
     int ret = SGX_SUCCESS;
     uint64_t offset = 0;
-    uint64_t rva = start_rva;
 
     assert(IS_PAGE_ALIGNED(start_rva) && IS_PAGE_ALIGNED(size));
 
+    if(source == NULL || size == SE_PAGE_SIZE)
+        return build_page_range(start_rva, size, source, sinfo, attr);
+
+    // Replicate the page into a bounded buffer and add the range chunk by chunk.
+    uint64_t chunk_size = MIN(size, (uint64_t)BUILD_PAGES_CHUNK_SIZE);
+    uint8_t *chunk = (uint8_t *)aligned_alloc(SE_PAGE_SIZE, (size_t)chunk_size);
+    if(chunk == NULL)
+        return SGX_ERROR_OUT_OF_MEMORY;
+    for(uint64_t i = 0; i < chunk_size; i += SE_PAGE_SIZE)
+        memcpy_s(chunk + i, SE_PAGE_SIZE, source, SE_PAGE_SIZE);
+
     while(offset < size)
     {
-        //call driver to add page;
-        if(SGX_SUCCESS != (ret = get_enclave_creator()->add_enclave_page(ENCLAVE_ID_IOCTL, GET_PTR(void, source, 0), rva, sinfo, attr)))
+        uint64_t len = MIN(chunk_size, size - offset);
+        if(SGX_SUCCESS != (ret = build_page_range(start_rva + offset, len, chunk, sinfo, attr)))
         {
             //if add page failed , we should remove enclave somewhere;
-            return ret;
+            break;
         }
-        offset += SE_PAGE_SIZE;
-        rva += SE_PAGE_SIZE;
+        offset += len;
     }
 
-    return SGX_SUCCESS;
+    free(chunk);
+    return ret;
 }
 
 int CLoader::build_context(const uint64_t start_rva, layout_entry_t *layout)
@@ -584,23 +626,26 @@ int CLoader::build_image(SGXLaunchToken * const lc, sgx_attributes_t * const sec
     };
 
     // read reloc bitmap before patch the enclave file
-    // If load_enclave_ex try to load the enclave for the 2nd time,
-    // the enclave image is already patched, and parser cannot read the information.
-    // For linux, there's no map conflict. We assume load_enclave_ex will not do the retry.
-    std::vector<uint8_t> bitmap;
-    if(!m_parser.get_reloc_bitmap(bitmap))
-        return SGX_ERROR_INVALID_ENCLAVE;
-
-    // patch enclave file
-    patch_entry_t *patch_start = GET_PTR(patch_entry_t, m_metadata, m_metadata->dirs[DIR_PATCH].offset);
-    patch_entry_t *patch_end = GET_PTR(patch_entry_t, m_metadata, m_metadata->dirs[DIR_PATCH].offset + m_metadata->dirs[DIR_PATCH].size);
-    for(patch_entry_t *patch = patch_start; patch < patch_end; patch++)
+    // If load_enclave_ex try to load the enclave for the 2nd time, or the image
+    // comes from the template cache, the enclave image is already patched and
+    // parser cannot read the information. Reuse the bitmap read the first time.
+    if(!is_image_prepared())
     {
-        memcpy_s(GET_PTR(void, m_parser.get_start_addr(), patch->dst), patch->size, GET_PTR(void, m_metadata, patch->src), patch->size);
+        if(!m_parser.get_reloc_bitmap(m_reloc_bitmap))
+            return SGX_ERROR_INVALID_ENCLAVE;
+
+        // patch enclave file
+        patch_entry_t *patch_start = GET_PTR(patch_entry_t, m_metadata, m_metadata->dirs[DIR_PATCH].offset);
+        patch_entry_t *patch_end = GET_PTR(patch_entry_t, m_metadata, m_metadata->dirs[DIR_PATCH].offset + m_metadata->dirs[DIR_PATCH].size);
+        for(patch_entry_t *patch = patch_start; patch < patch_end; patch++)
+        {
+            memcpy_s(GET_PTR(void, m_parser.get_start_addr(), patch->dst), patch->size, GET_PTR(void, m_metadata, patch->src), patch->size);
+        }
+        m_prepared_metadata = m_metadata;
     }
 
     //build sections, copy export function table as well;
-    if(SGX_SUCCESS != (ret = build_sections(&bitmap)))
+    if(SGX_SUCCESS != (ret = build_sections(&m_reloc_bitmap)))
     {
         SE_TRACE(SE_TRACE_WARNING, "build sections failed\n");
         goto fail;
@@ -813,6 +858,22 @@ bool CLoader::is_ae(const enclave_css_t *enclave_css)
     return false;
 }
 
+void CLoader::set_prepared_image(const metadata_t *metadata, const std::vector<uint8_t> &reloc_bitmap)
+{
+    m_prepared_metadata = metadata;
+    m_reloc_bitmap = reloc_bitmap;
+}
+
+const std::vector<uint8_t>& CLoader::get_reloc_bitmap() const
+{
+    return m_reloc_bitmap;
+}
+
+bool CLoader::is_image_prepared() const
+{
+    return m_prepared_metadata != NULL && m_prepared_metadata == m_metadata;
+}
+
 int CLoader::load_enclave(SGXLaunchToken *lc, int debug, const metadata_t *metadata, sgx_config_id_t *config_id, sgx_config_svn_t config_svn, le_prd_css_file_t *prd_css_file, sgx_misc_attribute_t *misc_attr)
 {
     int ret = SGX_SUCCESS;
@@ -820,11 +881,15 @@ int CLoader::load_enclave(SGXLaunchToken *lc, int debug, const metadata_t *metad
     memset(&sgx_misc_attr, 0, sizeof(sgx_misc_attribute_t));
 
     m_metadata = metadata;
-    ret = validate_metadata();
-    if(SGX_SUCCESS != ret)
+    // A prepared image has been validated against this metadata already.
+    if(!is_image_prepared())
     {
-        SE_TRACE(SE_TRACE_ERROR, "The metadata setting is not correct\n");
-        return ret;
+        ret = validate_metadata();
+        if(SGX_SUCCESS != ret)
+        {
+            SE_TRACE(SE_TRACE_ERROR, "The metadata setting is not correct\n");
+            return ret;
+        }
     }
 
     ret = get_enclave_creator()->get_misc_attr(&sgx_misc_attr, const_cast<metadata_t *>(m_metadata), lc, debug);
@@ -43,6 +43,9 @@
 
 #define GET_RELOC_FAILED ((uint8_t *)-1)
 
+/* upper bound of the buffer used to replicate a page over a range */
+#define BUILD_PAGES_CHUNK_SIZE (256 * SE_PAGE_SIZE)
+
 #if defined(SE_SIM)
 #define ENCLAVE_ID_IOCTL m_enclave_id
 #else
@@ -68,15 +71,22 @@ public:
     const std::vector<std::pair<tcs_t *, bool>>& get_tcs_list() const;
     void* get_symbol_address(const char* const sym);
     int set_memory_protection();
+    // Mark the mapped image as already validated and patched against `metadata' by an
+    // earlier load, so only the page adds and initialization are repeated.
+    void set_prepared_image(const metadata_t *metadata, const std::vector<uint8_t> &reloc_bitmap);
+    const std::vector<uint8_t>& get_reloc_bitmap() const;
+    bool is_image_prepared() const;
 
 private:
     int build_mem_region(const section_info_t &sec_info);
+    int get_section_page_secinfo(const section_info_t &sec_info, const uint64_t rva, sec_info_t &sinfo);
     int build_image(SGXLaunchToken * const lc, sgx_attributes_t * const secs_attr, sgx_config_id_t *config_id, sgx_config_svn_t config_svn, le_prd_css_file_t *prd_css_file, sgx_misc_attribute_t * const misc_attr);
     int build_secs(sgx_attributes_t * const secs_attr, sgx_config_id_t *config_id, sgx_config_svn_t config_svn, sgx_misc_attribute_t * const misc_attr);
     int build_context(const uint64_t start_rva, layout_entry_t *layout);
     int build_contexts(layout_t *layout_start, layout_t *layout_end, uint64_t delta);
     int build_partial_page(const uint64_t rva, const uint64_t size, const void *source, const sec_info_t &sinfo, const uint32_t attr);
     int build_pages(const uint64_t start_rva, const uint64_t size, const void *source, const sec_info_t &sinfo, const uint32_t attr);
+    int build_page_range(const uint64_t start_rva, const uint64_t size, const void *source, const sec_info_t &sinfo, const uint32_t attr);
     bool is_relocation_page(const uint64_t rva, std::vector<uint8_t> *bitmap);
 
     bool is_ae(const enclave_css_t *enclave_css);
@@ -102,6 +112,9 @@ private:
     const metadata_t    *m_metadata;
     secs_t              m_secs;
     BinParser           &m_parser;
+    // relocation bitmap read before the image was patched
+    std::vector<uint8_t> m_reloc_bitmap;
+    const metadata_t    *m_prepared_metadata;
 };
 
 #endif
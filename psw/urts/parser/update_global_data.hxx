@@ -172,6 +172,8 @@ namespace {
         }
         global_data->edmm_bk_overhead = (sys_word_t)create_param->edmm_bk_overhead;
         global_data->fips_on = create_param->fips_on;
+        global_data->heap_commit_ahead = (sys_word_t)create_param->heap_commit_ahead;
+        global_data->heap_trim_threshold = (sys_word_t)create_param->heap_trim_threshold;
         return true;
     }
 }
@@ -41,16 +41,60 @@
 #include "rts.h"
 #include "enclave.h"
 #include "get_thread_id.h"
+#include <chrono>
 
 int do_ecall(const int fn, const void *ocall_table, const void *ms, CTrustThread *trust_thread);
 
+//Per thread cache of the trust threads bound to the calling thread, indexed by enclave id.
+//Enclave id is never reused in one process, so an entry is only hit while the enclave,
+//and hence the CTrustThread it points to, is alive.
+#define TCS_CACHE_SIZE  8
+typedef struct _tcs_cache_entry_t
+{
+    sgx_enclave_id_t    enclave_id;
+    CTrustThread        *trust_thread;
+} tcs_cache_entry_t;
+
+static __thread tcs_cache_entry_t g_tcs_cache[TCS_CACHE_SIZE];
+
+//The owner and the reference count share one word, so every change of the count
+//is made against the owner it was decided for.
+#define TCS_REF_WORD(owner, ref)    (((uint64_t)(uint32_t)(owner) << 32) | (uint32_t)(ref))
+#define TCS_REF_OWNER(word)         ((se_thread_id_t)(uint32_t)((word) >> 32))
+#define TCS_REF_COUNT(word)         ((int)(uint32_t)(word))
+static_assert(sizeof(se_thread_id_t) <= sizeof(uint32_t), "thread id doesn't fit in the tcs reference word");
+
+//Number of free trust threads looked at when picking a tcs local to the caller.
+#define TCS_AFFINITY_SCAN   64
+
+#define TCS_DEFAULT_COOLDOWN_MS 1000
+
+//The concurrency high watermark and the time of its last rise share one word,
+//so the watermark is only ever decayed against the rise it was read with.
+//The time is kept modulo 2^32 ms and only compared by difference.
+#define TCS_PEAK_WORD(peak, ms)     (((uint64_t)(uint32_t)(peak) << 32) | (uint32_t)(ms))
+#define TCS_PEAK_VALUE(word)        ((uint32_t)((word) >> 32))
+#define TCS_PEAK_TIME(word)         ((uint32_t)(word))
+
+static uint64_t now_ms()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
 
 
 CTrustThread::CTrustThread(tcs_t *tcs, CEnclave* enclave)
     : m_tcs(tcs)
     , m_enclave(enclave)
-    , m_reference(0)
+    , m_ref_word(0)
+    , m_next_free(NULL)
     , m_event(NULL)
+    , m_last_cpu(TCS_CPU_UNKNOWN)
+    , m_last_node(TCS_CPU_UNKNOWN)
+    , m_ecall_count(0)
+    , m_cpu_migrations(0)
+    , m_node_migrations(0)
+    , m_demand_count(0)
 {
     memset(&m_tcs_info, 0, sizeof(debug_tcs_info_t));
     m_tcs_info.TCS_address = reinterpret_cast<void*>(tcs);
@@ -66,12 +110,80 @@ CTrustThread::~CTrustThread()
 
 se_handle_t CTrustThread::get_event()
 {
+    se_handle_t event = m_enclave->get_event(m_tcs);
+    if(event != NULL)
+        return event;
+
     if(m_event == NULL)
         m_event = se_event_init();
 
     return m_event;
 }
 
+int CTrustThread::get_reference()
+{
+    return TCS_REF_COUNT(m_ref_word.load());
+}
+
+se_thread_id_t CTrustThread::get_owner()
+{
+    return TCS_REF_OWNER(m_ref_word.load());
+}
+
+//A release without a matching reference is a bug. It is reported, and the word is left
+//alone so the count can't borrow from the owner half.
+void CTrustThread::decrease_ref()
+{
+    uint64_t word = m_ref_word.load();
+    do
+    {
+        if(TCS_REF_COUNT(word) <= 0)
+        {
+            SE_TRACE(SE_TRACE_ERROR, "unbalanced release of tcs %p\n", m_tcs);
+            assert(!"tcs reference count underflow");
+            return;
+        }
+    } while(!m_ref_word.compare_exchange_weak(word, word - 1));
+}
+
+//Take a reference on the tcs only if it is still bound to thread_id. A thread
+//with a stale cache entry therefore never touches the count of a tcs that was
+//reclaimed and handed to another thread.
+bool CTrustThread::try_acquire_ref(se_thread_id_t thread_id)
+{
+    uint64_t word = m_ref_word.load();
+    do
+    {
+        if(thread_id == 0 || TCS_REF_OWNER(word) != thread_id)
+            return false;
+    } while(!m_ref_word.compare_exchange_weak(word, word + 1));
+    return true;
+}
+
+//Called with m_thread_mutex held. The tcs is unbound only if nobody references it;
+//one CAS decides between the collector and a concurrent try_acquire_ref() of the owner.
+bool CTrustThread::try_reclaim()
+{
+    uint64_t word = m_ref_word.load();
+    if(TCS_REF_COUNT(word) != 0)
+        return false;
+    return m_ref_word.compare_exchange_strong(word, TCS_REF_WORD(0, 0));
+}
+
+void CTrustThread::set_owner(se_thread_id_t thread_id)
+{
+    uint64_t word = m_ref_word.load();
+    while(!m_ref_word.compare_exchange_weak(word, TCS_REF_WORD(thread_id, TCS_REF_COUNT(word))))
+        ;
+}
+
+void CTrustThread::reset_ref()
+{
+    uint64_t word = m_ref_word.load();
+    while(!m_ref_word.compare_exchange_weak(word, TCS_REF_WORD(TCS_REF_OWNER(word), 0)))
+        ;
+}
+
 void CTrustThread::push_ocall_frame(ocall_frame_t* frame_point)
 {
     frame_point->index = this->get_reference();
@@ -89,11 +201,97 @@ void CTrustThread::pop_ocall_frame()
     }
 }
 
+void CTrustThread::record_cpu(uint32_t cpu, uint32_t node)
+{
+    uint32_t last_cpu = m_last_cpu.exchange(cpu, std::memory_order_relaxed);
+    uint32_t last_node = m_last_node.exchange(node, std::memory_order_relaxed);
+    if(last_cpu != TCS_CPU_UNKNOWN && last_cpu != cpu)
+        m_cpu_migrations.fetch_add(1, std::memory_order_relaxed);
+    if(last_node != TCS_CPU_UNKNOWN && last_node != node)
+        m_node_migrations.fetch_add(1, std::memory_order_relaxed);
+}
+
+//Only the thread running on the tcs touches the count, so plain loads and
+//stores do, and an ecall made without provisioning costs no atomic update.
+void CTrustThread::count_demand()
+{
+    m_demand_count.store(m_demand_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+bool CTrustThread::take_demand()
+{
+    uint32_t count = m_demand_count.load(std::memory_order_relaxed);
+    if(count == 0)
+        return false;
+    m_demand_count.store(count - 1, std::memory_order_relaxed);
+    return true;
+}
+
+void CTrustThread::get_stats(sgx_tcs_stats_t *stats)
+{
+    stats->tcs_address = reinterpret_cast<uint64_t>(m_tcs);
+    stats->ecall_count = m_ecall_count.load(std::memory_order_relaxed);
+    stats->cpu_migrations = m_cpu_migrations.load(std::memory_order_relaxed);
+    stats->node_migrations = m_node_migrations.load(std::memory_order_relaxed);
+    stats->last_cpu = get_last_cpu();
+    stats->last_node = get_last_node();
+}
+
+
+void CTrustThreadStack::push(CTrustThread *trust_thread)
+{
+    CTrustThread *head = m_head.load();
+    do
+    {
+        trust_thread->set_next_free(head);
+    } while(!m_head.compare_exchange_weak(head, trust_thread));
+    m_size++;
+}
+
+CTrustThread *CTrustThreadStack::pop()
+{
+    CTrustThread *head = m_head.load();
+    while(head != NULL && !m_head.compare_exchange_weak(head, head->get_next_free()))
+        ;
+    if(head != NULL)
+    {
+        m_size--;
+        head->set_next_free(NULL);
+    }
+    return head;
+}
+
+//Unlink a trust thread that follows prev, or the head if prev is NULL.
+//Must be serialized with pop(). Concurrent pushes only ever replace the head,
+//so unlinking behind the head needs no atomic update.
+void CTrustThreadStack::remove(CTrustThread *prev, CTrustThread *trust_thread)
+{
+    if(prev == NULL)
+    {
+        CTrustThread *head = trust_thread;
+        if(!m_head.compare_exchange_strong(head, trust_thread->get_next_free()))
+        {
+            //new threads were pushed on top, so trust_thread is no longer the head
+            for(prev = head; prev->get_next_free() != trust_thread; prev = prev->get_next_free())
+                ;
+        }
+    }
+    if(prev != NULL)
+        prev->set_next_free(trust_thread->get_next_free());
+    m_size--;
+    trust_thread->set_next_free(NULL);
+}
 
-CTrustThreadPool::CTrustThreadPool(uint32_t tcs_min_pool)
+CTrustThreadPool::CTrustThreadPool(sgx_enclave_id_t enclave_id, uint32_t tcs_min_pool)
+    : m_affinity_policy(SGX_TCS_AFFINITY_NONE)
+    , m_active_ecalls(0)
+    , m_active_peak(0)
+    , m_tcs_headroom(0)
+    , m_tcs_cooldown_ms(TCS_DEFAULT_COOLDOWN_MS)
 {
     m_thread_list = NULL;
     m_utility_thread = NULL;
+    m_enclave_id = enclave_id;
     m_tcs_min_pool = tcs_min_pool;
     m_need_to_wait_for_new_thread = false;
 }
@@ -102,11 +300,11 @@ CTrustThreadPool::~CTrustThreadPool()
 {
     LockGuard lock(&m_thread_mutex);
     //destroy free tcs list
-    for(std::vector<CTrustThread *>::iterator it=m_free_thread_vector.begin(); it!=m_free_thread_vector.end(); it++)
+    CTrustThread *trust_thread = NULL;
+    while((trust_thread = m_free_threads.pop()) != NULL)
     {
-        delete *it;
+        delete trust_thread;
     }
-    m_free_thread_vector.clear();
     //destroy unallocated tcs list
     for(std::vector<CTrustThread *>::iterator it=m_unallocated_threads.begin(); it!=m_unallocated_threads.end(); it++)
     {
@@ -142,19 +340,70 @@ inline int CTrustThreadPool::find_thread(std::vector<se_thread_id_t> &thread_vec
     return FALSE;
 }
 
+//Called with m_thread_mutex held, which serializes the pops of the free stack.
 inline CTrustThread * CTrustThreadPool::get_free_thread()
 {
-    LockGuard lock(&m_free_thread_mutex);
-    if(true == m_free_thread_vector.empty())
+    if(m_affinity_policy.load() == SGX_TCS_AFFINITY_LOCAL)
+        return get_local_free_thread();
+    return m_free_threads.pop();
+}
+
+//Pick the free tcs that last ran on the calling cpu, else one that last ran on
+//its NUMA node, else the most recently freed one.
+CTrustThread * CTrustThreadPool::get_local_free_thread()
+{
+    uint32_t cpu = 0, node = 0;
+    //Without the cpu every free tcs looks equally far, and one that never
+    //ran would match the unknown cpu.
+    if(!get_current_cpu(&cpu, &node))
+        return m_free_threads.pop();
+
+    CTrustThread *node_match = NULL, *node_prev = NULL;
+    CTrustThread *prev = NULL;
+    CTrustThread *it = m_free_threads.top();
+    for(int i = 0; it != NULL && i < TCS_AFFINITY_SCAN; i++)
     {
-        return NULL;
+        if(it->get_last_cpu() == cpu)
+        {
+            m_free_threads.remove(prev, it);
+            return it;
+        }
+        if(node_match == NULL && it->get_last_node() == node)
+        {
+            node_match = it;
+            node_prev = prev;
+        }
+        prev = it;
+        it = it->get_next_free();
+    }
+    if(node_match != NULL)
+    {
+        m_free_threads.remove(node_prev, node_match);
+        return node_match;
     }
+    return m_free_threads.pop();
+}
 
-    //if there is free tcs, remove it from free list
-    CTrustThread *thread_node = m_free_thread_vector.back();
-    m_free_thread_vector.pop_back();
+//Lock free lookup of the tcs bound to the calling thread. The reference is only
+//taken while the tcs is still bound to us, so garbage_collect() either sees the
+//reference or has already unbound the tcs, in which case we fall back.
+CTrustThread * CTrustThreadPool::get_cached_thread(const se_thread_id_t thread_id)
+{
+    tcs_cache_entry_t *entry = &g_tcs_cache[m_enclave_id % TCS_CACHE_SIZE];
+    if(entry->enclave_id != m_enclave_id)
+        return NULL;
+
+    CTrustThread *trust_thread = entry->trust_thread;
+    if(!trust_thread->try_acquire_ref(thread_id))
+        return NULL;
+    return trust_thread;
+}
 
-    return thread_node;
+void CTrustThreadPool::cache_thread(CTrustThread * const trust_thread)
+{
+    tcs_cache_entry_t *entry = &g_tcs_cache[m_enclave_id % TCS_CACHE_SIZE];
+    entry->enclave_id = m_enclave_id;
+    entry->trust_thread = trust_thread;
 }
 
 //This tcs policy is bind tcs with one thread.
@@ -170,6 +419,7 @@ int CTrustThreadPool::bind_thread(const se_thread_id_t thread_id,  CTrustThread
             return FALSE;
         }
     }
+    trust_thread->set_owner(thread_id);
     return TRUE;
 }
 
@@ -189,8 +439,9 @@ void CTrustThreadPool::unbind_thread(const se_thread_id_t thread_id)
         if(it)
         {
             trust_thread = it->value;
+            trust_thread->set_owner(0);
             trust_thread->reset_ref();
-            add_to_free_thread_vector(trust_thread); 
+            add_to_free_threads(trust_thread);
             if(it == m_thread_list)
             {
                 m_thread_list = it->next;
@@ -225,7 +476,7 @@ CTrustThread * CTrustThreadPool::add_thread(tcs_t * const tcs, CEnclave * const
         if (g_enclave_creator->is_EDMM_supported(enclave->get_enclave_id()) && !m_utility_thread && (enclave->get_dynamic_tcs_list_size() != 0))
             m_utility_thread = trust_thread;
         else
-            m_free_thread_vector.push_back(trust_thread);
+            m_free_threads.push(trust_thread);
     }
     else
     {
@@ -260,9 +511,10 @@ std::vector<CTrustThread *> CTrustThreadPool::get_thread_list()
 
     std::vector<CTrustThread *> threads;
 
-    for(std::vector<CTrustThread *>::iterator it = m_free_thread_vector.begin(); it != m_free_thread_vector.end(); it++)
+    //pops are excluded by m_thread_mutex, so the free stack can be walked safely
+    for(CTrustThread *free_thread = m_free_threads.top(); free_thread != NULL; free_thread = free_thread->get_next_free())
     {
-        threads.push_back(*it);
+        threads.push_back(free_thread);
     }
 
     Node<se_thread_id_t, CTrustThread*>* it = m_thread_list;
@@ -289,8 +541,9 @@ void CTrustThreadPool::reset()
         CTrustThread *trust_thread = tmp->value;
         //remove from thread cache
         delete tmp;
+        trust_thread->set_owner(0);
         trust_thread->reset_ref();
-        add_to_free_thread_vector(trust_thread);
+        add_to_free_threads(trust_thread);
     }
     m_thread_list = NULL;
 
@@ -381,12 +634,102 @@ CTrustThread * CTrustThreadPool::_acquire_thread()
     return trust_thread;
 }
 
+void CTrustThreadPool::note_ecall(CTrustThread * const trust_thread)
+{
+    trust_thread->count_ecall();
+    if(m_affinity_policy.load(std::memory_order_relaxed) != SGX_TCS_AFFINITY_NONE)
+    {
+        uint32_t cpu = 0, node = 0;
+        if(get_current_cpu(&cpu, &node))
+            trust_thread->record_cpu(cpu, node);
+    }
+}
+
+//Count the ecall as active and raise the concurrency high watermark.
+//The watermark falls back to the current concurrency once it has not
+//been reached again for a cooldown period. Nothing is counted while
+//provisioning is off; the tcs remembers whether the ecall was counted,
+//so release_thread() stays balanced when provisioning is switched on or
+//off in between.
+void CTrustThreadPool::track_demand(CTrustThread * const trust_thread)
+{
+    if(m_tcs_headroom.load(std::memory_order_relaxed) == 0)
+        return;
+
+    trust_thread->count_demand();
+    uint32_t active = m_active_ecalls.fetch_add(1) + 1;
+    uint32_t now = (uint32_t)now_ms();
+    uint64_t word = m_active_peak.load(std::memory_order_relaxed);
+    while(active >= TCS_PEAK_VALUE(word))
+    {
+        if(m_active_peak.compare_exchange_weak(word, TCS_PEAK_WORD(active, now), std::memory_order_relaxed))
+            break;
+    }
+}
+
+void CTrustThreadPool::release_thread(CTrustThread * const trust_thread)
+{
+    if(trust_thread->take_demand())
+        m_active_ecalls.fetch_sub(1);
+}
+
+//Number of free tcs to keep ready for new callers. While a concurrency peak
+//is recent, keep enough to absorb it again plus the configured headroom;
+//after the cooldown only tcs_min_pool is kept.
+size_t CTrustThreadPool::predicted_free_threads()
+{
+    uint32_t headroom = m_tcs_headroom.load(std::memory_order_relaxed);
+    if(headroom == 0)
+        return 0;
+
+    uint32_t active = m_active_ecalls.load(std::memory_order_relaxed);
+    uint64_t word = m_active_peak.load(std::memory_order_relaxed);
+    uint32_t peak = TCS_PEAK_VALUE(word);
+    if((uint32_t)now_ms() - TCS_PEAK_TIME(word) >= m_tcs_cooldown_ms.load(std::memory_order_relaxed))
+    {
+        //A concurrent rise changes the word, and then the peak is kept.
+        m_active_peak.compare_exchange_strong(word, TCS_PEAK_WORD(active, TCS_PEAK_TIME(word)), std::memory_order_relaxed);
+        return 0;
+    }
+    return (size_t)(peak > active ? peak - active : 0) + headroom;
+}
+
+void CTrustThreadPool::set_provisioning(uint32_t headroom, uint32_t cooldown_ms)
+{
+    m_tcs_cooldown_ms.store(cooldown_ms ? cooldown_ms : TCS_DEFAULT_COOLDOWN_MS);
+    m_active_peak.store(TCS_PEAK_WORD(m_active_ecalls.load(), now_ms()));
+    m_tcs_headroom.store(headroom);
+}
+
+size_t CTrustThreadPool::get_tcs_stats(sgx_tcs_stats_t *stats, size_t count)
+{
+    std::vector<CTrustThread *> threads = get_thread_list();
+    for(size_t i = 0; i < threads.size() && i < count; i++)
+    {
+        threads[i]->get_stats(&stats[i]);
+    }
+    return threads.size();
+}
+
 CTrustThread * CTrustThreadPool::acquire_thread(int ecall_cmd)
 {
-    LockGuard lock(&m_thread_mutex);
     CTrustThread *trust_thread = NULL;
     bool is_special_ecall = (ecall_cmd == ECMD_INIT_ENCLAVE) || (ecall_cmd == ECMD_UNINIT_ENCLAVE) ;
 
+    //fast path: the calling thread already has a tcs bound, no need to take the lock.
+    if(is_special_ecall != true)
+    {
+        trust_thread = get_cached_thread(get_thread_id());
+        if(NULL != trust_thread)
+        {
+            note_ecall(trust_thread);
+            track_demand(trust_thread);
+            return trust_thread;
+        }
+    }
+
+    LockGuard lock(&m_thread_mutex);
+
     if(is_special_ecall == true)
     {
         if (m_utility_thread)
@@ -430,6 +773,12 @@ CTrustThread * CTrustThreadPool::acquire_thread(int ecall_cmd)
     if(trust_thread)
     {
         trust_thread->increase_ref();
+        if(trust_thread != m_utility_thread)
+        {
+            cache_thread(trust_thread);
+            note_ecall(trust_thread);
+        }
+        track_demand(trust_thread);
     }
 
     if(is_special_ecall != true &&
@@ -454,18 +803,23 @@ bool CTrustThreadPool::is_dynamic_thread_exist()
 
 bool CTrustThreadPool::need_to_new_thread()
 {
-    LockGuard lock(&m_free_thread_mutex);
     if (m_unallocated_threads.empty())
     {
         return false;
     }
 
-    if(m_tcs_min_pool == 0 && m_free_thread_vector.size() > m_tcs_min_pool)
+    size_t predicted = predicted_free_threads();
+    if(predicted != 0 && m_free_threads.size() < predicted)
+    {
+        return true;
+    }
+
+    if(m_tcs_min_pool == 0 && m_free_threads.size() > m_tcs_min_pool)
     {
         return false;
     }
     
-    if(m_tcs_min_pool != 0 && m_free_thread_vector.size() >= m_tcs_min_pool)
+    if(m_tcs_min_pool != 0 && m_free_threads.size() >= m_tcs_min_pool)
     {
         return false;
     }
@@ -509,7 +863,7 @@ sgx_status_t CTrustThreadPool::new_thread()
     {    
         //add tcs to debug tcs info list
         trust_thread->get_enclave()->add_thread(trust_thread);
-        add_to_free_thread_vector(trust_thread);
+        add_to_free_threads(trust_thread);
         m_unallocated_threads.pop_back();
         urts_add_tcs(tcsp);
     }
@@ -518,10 +872,9 @@ sgx_status_t CTrustThreadPool::new_thread()
 }
 
 
-void CTrustThreadPool::add_to_free_thread_vector(CTrustThread* it)
+void CTrustThreadPool::add_to_free_threads(CTrustThread* it)
 {
-    LockGuard lock(&m_free_thread_mutex);
-    m_free_thread_vector.push_back(it);
+    m_free_threads.push(it);
 }
 
 sgx_status_t CTrustThreadPool::fill_tcs_mini_pool()
@@ -575,10 +928,10 @@ int CThreadPoolBindMode::garbage_collect()
         //if the thread has exited
         if(FALSE == find_thread(thread_vector, thread_id))
         {
-            if(0 == it->value->get_reference())
+            if(it->value->try_reclaim())
             {
-                add_to_free_thread_vector(it->value);
-                nr_free++; 
+                add_to_free_threads(it->value);
+                nr_free++;
             }
             else
             {
@@ -625,9 +978,9 @@ int CThreadPoolUnBindMode::garbage_collect()
     while(it != NULL)
     {
         //if the reference is 0, then the trust thread is not in use, so return to free_tcs list
-        if(0 == it->value->get_reference())
+        if(it->value->try_reclaim())
         {
-            add_to_free_thread_vector(it->value);
+            add_to_free_threads(it->value);
             nr_free++;
 
             tmp = it;
@@ -36,13 +36,18 @@
 #include "se_wrapper.h"
 #include "util.h"
 #include "sgx_error.h"
+#include "sgx_eid.h"
+#include "sgx_urts.h"
 #include "se_debugger_lib.h"
 #include "se_lock.hpp"
 #include <vector>
+#include <atomic>
 #include "node.h"
 
 typedef int (*bridge_fn_t)(const void*);
 
+#define TCS_CPU_UNKNOWN     0xFFFFFFFF
+
 class CEnclave;
 
 class CTrustThread: private Uncopyable
@@ -50,28 +55,67 @@ class CTrustThread: private Uncopyable
 public:
     CTrustThread(tcs_t *tcs, CEnclave* enclave);
     ~CTrustThread();
-    int get_reference() { return m_reference; }
-    void increase_ref() { m_reference++; }
-    void decrease_ref() { m_reference--; }
+    int get_reference();
+    void increase_ref() { m_ref_word.fetch_add(1); }
+    void decrease_ref();
+    bool try_acquire_ref(se_thread_id_t thread_id);
+    bool try_reclaim();
+    se_thread_id_t get_owner();
+    void set_owner(se_thread_id_t thread_id);
+    CTrustThread *get_next_free() { return m_next_free; }
+    void set_next_free(CTrustThread *next) { m_next_free = next; }
     tcs_t *get_tcs()    { return m_tcs; }
     CEnclave *get_enclave() { return m_enclave; }
     se_handle_t get_event();
-    void reset_ref() { m_reference = 0; }
+    void reset_ref();
     debug_tcs_info_t* get_debug_info(){return &m_tcs_info;}
     void push_ocall_frame(ocall_frame_t* frame_point);
     void pop_ocall_frame();
+    void count_ecall() { m_ecall_count.fetch_add(1, std::memory_order_relaxed); }
+    void record_cpu(uint32_t cpu, uint32_t node);
+    uint32_t get_last_cpu() { return m_last_cpu.load(std::memory_order_relaxed); }
+    uint32_t get_last_node() { return m_last_node.load(std::memory_order_relaxed); }
+    void get_stats(sgx_tcs_stats_t *stats);
+    void count_demand();
+    bool take_demand();
 private:
     tcs_t               *m_tcs;
     CEnclave            *m_enclave;
-    int                 m_reference;  //it will increase by 1 before ecall, and decrease after ecall.
+    //The reference count (low 32 bits) will increase by 1 before ecall, and decrease after ecall.
+    //The high 32 bits hold the thread the tcs is bound to, 0 if it is not bound.
+    std::atomic<uint64_t>   m_ref_word;
+    CTrustThread        *m_next_free;  //link in the free trust thread stack.
     se_handle_t         m_event;
     debug_tcs_info_t    m_tcs_info;
+    std::atomic<uint32_t>   m_last_cpu;     //cpu of the last ecall, only tracked with an affinity policy.
+    std::atomic<uint32_t>   m_last_node;    //NUMA node of the last ecall.
+    std::atomic<uint64_t>   m_ecall_count;
+    std::atomic<uint64_t>   m_cpu_migrations;
+    std::atomic<uint64_t>   m_node_migrations;
+    std::atomic<uint32_t>   m_demand_count; //ecalls on this tcs counted in the pool's m_active_ecalls.
+};
+
+//Free trust thread stack. push() is lock free and can be called from any thread.
+//pop() must be serialized by the caller (CTrustThreadPool holds m_thread_mutex),
+//so a node can't be popped and pushed again under a concurrent pop (no ABA).
+class CTrustThreadStack: private Uncopyable
+{
+public:
+    CTrustThreadStack() : m_head(NULL), m_size(0) {}
+    void push(CTrustThread *trust_thread);
+    CTrustThread *pop();
+    void remove(CTrustThread *prev, CTrustThread *trust_thread);
+    CTrustThread *top() { return m_head.load(); }
+    size_t size() { return m_size.load(); }
+private:
+    std::atomic<CTrustThread *> m_head;
+    std::atomic<size_t>         m_size;
 };
 
 class CTrustThreadPool: private Uncopyable
 {
 public:
-    CTrustThreadPool(uint32_t tcs_min_pool);
+    CTrustThreadPool(sgx_enclave_id_t enclave_id, uint32_t tcs_min_pool);
     virtual ~CTrustThreadPool();
     CTrustThread * acquire_free_thread();
     CTrustThread * acquire_thread(int ecall_cmd);
@@ -85,34 +129,50 @@ public:
     bool need_to_new_thread();
     bool is_dynamic_thread_exist();
     int bind_pthread(const se_thread_id_t thread_id,  CTrustThread * const trust_thread);
-    void add_to_free_thread_vector(CTrustThread* it);
+    void add_to_free_threads(CTrustThread* it);
+    void set_affinity_policy(uint32_t policy) { m_affinity_policy.store(policy); }
+    size_t get_tcs_stats(sgx_tcs_stats_t *stats, size_t count);
+    void set_provisioning(uint32_t headroom, uint32_t cooldown_ms);
+    void release_thread(CTrustThread * const trust_thread);
 protected:
     virtual int garbage_collect() = 0;
     inline int find_thread(std::vector<se_thread_id_t> &thread_vector, se_thread_id_t thread_id);
     inline CTrustThread * get_free_thread();
+    CTrustThread * get_local_free_thread();
+    void note_ecall(CTrustThread * const trust_thread);
+    void track_demand(CTrustThread * const trust_thread);
+    size_t predicted_free_threads();
     int bind_thread(const se_thread_id_t thread_id, CTrustThread * const trust_thread);
     void unbind_thread(const se_thread_id_t thread_id);
     CTrustThread * get_bound_thread(const se_thread_id_t thread_id);
+    CTrustThread * get_cached_thread(const se_thread_id_t thread_id);
+    void cache_thread(CTrustThread * const trust_thread);
 
-    std::vector<CTrustThread *>             m_free_thread_vector;
+    CTrustThreadStack                       m_free_threads;
     std::vector<CTrustThread *>             m_unallocated_threads; 
     Node<se_thread_id_t, CTrustThread *>    *m_thread_list;
     Mutex                                   m_thread_mutex; //protect thread_cache list. The mutex is recursive.
                                                             //Thread can operate the list when it get the mutex
-    Mutex                                   m_free_thread_mutex; //protect free threads.
     Cond                                    m_need_to_wait_for_new_thread_cond;
 private:
     CTrustThread * _acquire_free_thread();
     CTrustThread * _acquire_thread();
     CTrustThread *m_utility_thread;
+    sgx_enclave_id_t m_enclave_id;
     uint64_t     m_tcs_min_pool;
     bool         m_need_to_wait_for_new_thread;
+    std::atomic<uint32_t> m_affinity_policy;
+    std::atomic<uint32_t> m_active_ecalls;     //ecalls currently holding a tcs from acquire_thread().
+    std::atomic<uint64_t> m_active_peak;       //high watermark of m_active_ecalls, decays after the cooldown,
+                                               //and the ms timestamp of its last rise. see TCS_PEAK_WORD.
+    std::atomic<uint32_t> m_tcs_headroom;      //free dynamic tcs to keep ready while demand is recent, 0 to disable.
+    std::atomic<uint32_t> m_tcs_cooldown_ms;
 };
 
 class CThreadPoolBindMode : public CTrustThreadPool
 {
 public:
-    CThreadPoolBindMode(uint32_t tcs_min_pool):CTrustThreadPool(tcs_min_pool){}
+    CThreadPoolBindMode(sgx_enclave_id_t enclave_id, uint32_t tcs_min_pool):CTrustThreadPool(enclave_id, tcs_min_pool){}
 private:
     virtual int garbage_collect();
 };
@@ -120,7 +180,7 @@ private:
 class CThreadPoolUnBindMode : public CTrustThreadPool
 {
 public:
-    CThreadPoolUnBindMode(uint32_t tcs_min_pool):CTrustThreadPool(tcs_min_pool){}
+    CThreadPoolUnBindMode(sgx_enclave_id_t enclave_id, uint32_t tcs_min_pool):CTrustThreadPool(enclave_id, tcs_min_pool){}
 private:
     virtual int garbage_collect();
 };
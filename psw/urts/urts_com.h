@@ -44,6 +44,7 @@
 #include "debugger_support.h"
 #include "loader.h"
 #include "binparser.h"
+#include "enclave_template.h"
 #include "cpuid.h"
 #include "se_macro.h"
 #include "prd_css_util.h"
@@ -302,8 +303,7 @@ static bool is_SGX_DBG_OPTIN_variable_set()
 }
 
 
-static int __create_enclave(BinParser &parser, 
-                            uint8_t* base_addr, 
+static int __create_enclave(CEnclaveTemplate &image, 
                             const metadata_t *metadata, 
                             se_file_t& file, 
                             const bool debug, 
@@ -321,7 +321,9 @@ static int __create_enclave(BinParser &parser,
     sgx_kss_config_t *kss_config = NULL;
     sgx_uswitchless_config_t* us_config = NULL;
     
-    CLoader loader(base_addr, parser);
+    CLoader loader(image.get_base_addr(), *image.get_parser());
+    if (image.is_prepared())
+        loader.set_prepared_image(image.get_metadata(), image.get_reloc_bitmap());
 
     if (get_ex_feature_pointer(SGX_CREATE_ENCLAVE_EX_KSS, ex_features, ex_features_p, (void **)&kss_config) == -1)
         return SGX_ERROR_INVALID_PARAMETER;
@@ -332,6 +334,10 @@ static int __create_enclave(BinParser &parser,
     }
 
     ret = loader.load_enclave_ex(lc, debug, metadata, config_id, config_svn, prd_css_file, misc_attr);
+    // Once validated and patched the image can't be parsed for relocations again,
+    // keep what the loader read for the retries and later loads of the image.
+    if (!image.is_prepared() && loader.is_image_prepared())
+        image.set_prepared(metadata, loader.get_reloc_bitmap());
     if (ret != SGX_SUCCESS)
     {
         return ret;
@@ -528,9 +534,9 @@ fail:
 }
 
 
-sgx_status_t _create_enclave_from_buffer_ex(const bool debug, uint8_t *base_addr, uint64_t file_size, se_file_t& file, 
-                                            le_prd_css_file_t *prd_css_file, sgx_enclave_id_t *enclave_id, sgx_misc_attribute_t *misc_attr,
-                                            const uint32_t ex_features, const void* ex_features_p[32])
+static sgx_status_t __create_enclave_from_template(const bool debug, CEnclaveTemplate &image, se_file_t& file, 
+                                                   le_prd_css_file_t *prd_css_file, sgx_enclave_id_t *enclave_id, sgx_misc_attribute_t *misc_attr,
+                                                   const uint32_t ex_features, const void* ex_features_p[32])
 {
     unsigned int ret = SGX_SUCCESS;
     sgx_misc_attribute_t sgx_misc_attr;
@@ -544,8 +550,9 @@ sgx_status_t _create_enclave_from_buffer_ex(const bool debug, uint8_t *base_addr
     sgx_kss_config_t* kss_config = NULL;
     void *ex_fp = NULL;
     int res = 0;
+    PARSER *parser = static_cast<PARSER *>(image.get_parser());
 
-    if(NULL == base_addr || NULL == enclave_id)
+    if(NULL == enclave_id)
         return SGX_ERROR_INVALID_PARAMETER;
 #ifndef SE_SIM
     ret = validate_platform();
@@ -553,13 +560,18 @@ sgx_status_t _create_enclave_from_buffer_ex(const bool debug, uint8_t *base_addr
         return (sgx_status_t)ret;
 #endif
 
-    PARSER parser(base_addr, file_size);
-    if(SGX_SUCCESS != (ret = parser.run_parser()))
+    // A cached template is parsed and relocated already.
+    if(NULL == parser)
     {
-        goto clean_return;
+        parser = new PARSER(image.get_base_addr(), image.get_file_size());
+        image.set_parser(parser);
+        if(SGX_SUCCESS != (ret = parser->run_parser()))
+        {
+            goto clean_return;
+        }
     }
     //Make sure HW uRTS won't load simulation enclave and vice verse.
-    if(get_enclave_creator()->use_se_hw() != (!parser.get_symbol_rva("g_global_data_sim")))
+    if(get_enclave_creator()->use_se_hw() != (!parser->get_symbol_rva("g_global_data_sim")))
     {
         SE_TRACE_WARNING("HW and Simulation mode incompatibility detected. The enclave is linked with the incorrect tRTS library.\n");
         ret = SGX_ERROR_MODE_INCOMPATIBLE;
@@ -573,21 +585,31 @@ sgx_status_t _create_enclave_from_buffer_ex(const bool debug, uint8_t *base_addr
         goto clean_return;
 
     }
-    else if (res == 0 && parser.is_enclave_encrypted() != false)
+    else if (res == 0 && parser->is_enclave_encrypted() != false)
     {
     
         // If no PCL feature request is input, the enclave should not be encrypted.
         ret = SGX_ERROR_PCL_ENCRYPTED;
         goto clean_return;
     }
-    else if (res == 1 && parser.is_enclave_encrypted() != true)
+    else if (res == 1 && parser->is_enclave_encrypted() != true)
     {
         // If PCL feature is requested, the enclave should be encrypted
         ret = SGX_ERROR_PCL_NOT_ENCRYPTED;
         goto clean_return;
     }
 
-    if(SGX_SUCCESS != (ret = get_metadata(&parser, debug,  &metadata, &sgx_misc_attr)))
+    if(image.is_prepared())
+    {
+        // The metadata of a template was chosen and its signature verified by the first load.
+        metadata = const_cast<metadata_t *>(image.get_metadata());
+        ret = get_enclave_creator()->get_misc_attr(&sgx_misc_attr, metadata, NULL, debug);
+    }
+    else
+    {
+        ret = get_metadata(parser, debug,  &metadata, &sgx_misc_attr);
+    }
+    if(SGX_SUCCESS != ret)
     {
         goto clean_return;
     }
@@ -637,7 +659,7 @@ sgx_status_t _create_enclave_from_buffer_ex(const bool debug, uint8_t *base_addr
 
     //Need to set the whole misc_attr instead of just secs_attr.
     do {
-        ret = __create_enclave(parser, base_addr, metadata, file, debug, lc, prd_css_file, enclave_id, misc_attr, ex_features, ex_features_p);
+        ret = __create_enclave(image, metadata, file, debug, lc, prd_css_file, enclave_id, misc_attr, ex_features, ex_features_p);
         //SGX_ERROR_ENCLAVE_LOST caused by initializing enclave while power transition occurs
     } while(SGX_ERROR_ENCLAVE_LOST == ret);
 
@@ -662,6 +684,18 @@ clean_return:
     return (sgx_status_t)ret;
 }
 
+sgx_status_t _create_enclave_from_buffer_ex(const bool debug, uint8_t *base_addr, uint64_t file_size, se_file_t& file, 
+                                            le_prd_css_file_t *prd_css_file, sgx_enclave_id_t *enclave_id, sgx_misc_attribute_t *misc_attr,
+                                            const uint32_t ex_features, const void* ex_features_p[32])
+{
+    if(NULL == base_addr)
+        return SGX_ERROR_INVALID_PARAMETER;
+
+    // The caller owns the buffer, so the image is not kept as a template.
+    CEnclaveTemplate image(base_addr, file_size);
+    return __create_enclave_from_template(debug, image, file, prd_css_file, enclave_id, misc_attr, ex_features, ex_features_p);
+}
+
 sgx_status_t _create_enclave_ex(const bool debug, se_file_handle_t pfile, se_file_t& file, le_prd_css_file_t *prd_css_file,
                                 sgx_launch_token_t *launch, int *launch_updated, sgx_enclave_id_t *enclave_id, 
                                 sgx_misc_attribute_t *misc_attr, const uint32_t ex_features, const void* ex_features_p[32])
@@ -670,17 +704,16 @@ sgx_status_t _create_enclave_ex(const bool debug, se_file_handle_t pfile, se_fil
     UNUSED(launch_updated);
 
     unsigned int ret = SGX_SUCCESS;
-    off_t file_size = 0;
-    map_handle_t* mh = NULL;
+    CEnclaveTemplate* image = NULL;
 
-    mh = map_file(pfile, &file_size);
-    if (!mh)
+    image = CEnclaveTemplateCache::instance()->acquire(pfile);
+    if (!image)
         return SGX_ERROR_OUT_OF_MEMORY;
 
-    ret = _create_enclave_from_buffer_ex(debug, mh->base_addr, (uint64_t)(file_size), file, prd_css_file,
+    ret = __create_enclave_from_template(debug, *image, file, prd_css_file,
                                          enclave_id, misc_attr, ex_features, ex_features_p);
 
-    unmap_file(mh);
+    CEnclaveTemplateCache::instance()->release(image, SGX_SUCCESS == ret);
     return (sgx_status_t)ret;
 }
 
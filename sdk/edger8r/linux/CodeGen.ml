@@ -64,6 +64,13 @@
      | SGX_OCALLOC -> "sgx_ocalloc"
      | SGX_OCFREE -> "sgx_ocfree"
  
+ (* Whether trusted bridges take marshalling buffers from the per-TCS arena *)
+ let g_use_arena = ref false
+ 
+ (* The allocator used by trusted bridges for in-enclave copies of pointer parameters. *)
+ let get_tbridge_malloc () = if !g_use_arena then "sgx_arena_edge_malloc" else "malloc"
+ let get_tbridge_free () = if !g_use_arena then "sgx_arena_edge_free" else "free"
+ 
  (* Whether to prefix untrusted proxy with Enclave name *)
  let g_use_prefix = ref false
  let g_untrusted_dir = ref "."
@@ -628,6 +635,49 @@
           else
             sprintf "sgx_status_t SGX_CDECL %s(%s, %s)" fd.Ast.fname retval_parm_str parm_list
  
+ (* A switchless OCall can be batched with sgx_ocall_switchless_submit()
+  * when its marshaling structure holds nothing but by-value parameters
+  * and the return value, so that it can be filled in up front and the
+  * result read back once the call has completed.
+  *)
+ let is_batchable_ocall (uf: Ast.untrusted_func) =
+   let is_val_parm (pd: Ast.pdecl) =
+     match fst pd with
+         Ast.PTVal _ -> true
+       | Ast.PTPtr _ -> false
+   in
+     uf.Ast.uf_is_switchless && not uf.Ast.uf_propagate_errno &&
+     List.for_all is_val_parm uf.Ast.uf_fdecl.Ast.plist
+ 
+ let batch_call_name = "call"
+ let mk_batch_prepare_name (fname: string) = fname ^ "_batch_prepare"
+ let mk_batch_result_name (fname: string) = fname ^ "_batch_result"
+ 
+ (* Generate the prototypes of the batch helpers for a switchless OCall.
+  * For example, the untrusted function
+  *   int foo(double d) transition_using_threads;
+  *
+  * will have the trusted helpers below:
+  *   sgx_status_t foo_batch_prepare(sgx_switchless_ocall_t* call, double d);
+  *   sgx_status_t foo_batch_result(const sgx_switchless_ocall_t* call, int* retval);
+  *)
+ let gen_batch_prepare_proto (fd: Ast.func_decl) =
+   let parm_list =
+     List.fold_left (fun acc pd -> acc ^ ", " ^ gen_parm_str pd)
+       ("sgx_switchless_ocall_t* " ^ batch_call_name) fd.Ast.plist
+   in
+     sprintf "sgx_status_t SGX_CDECL %s(%s)" (mk_batch_prepare_name fd.Ast.fname) parm_list
+ 
+ let gen_batch_result_proto (fd: Ast.func_decl) =
+   sprintf "sgx_status_t SGX_CDECL %s(const sgx_switchless_ocall_t* %s, %s)"
+     (mk_batch_result_name fd.Ast.fname) batch_call_name (gen_parm_retval fd.Ast.rtype)
+ 
+ let gen_batch_protos (uf: Ast.untrusted_func) =
+   let fd = uf.Ast.uf_fdecl in
+     if not (is_batchable_ocall uf) then []
+     else if fd.Ast.rtype = Ast.Void then [gen_batch_prepare_proto fd]
+     else [gen_batch_prepare_proto fd; gen_batch_result_proto fd]
+ 
  (* Generate the function prototype for untrusted proxy in COM style.
   * For example, trusted functions
   *   int foo(double d);
@@ -908,9 +958,13 @@ let add_to_result_buffer result_buffer (fname: string)=
  let gen_trusted_header (ec: enclave_content) =
    let header_fname = get_theader_name ec.file_shortnm in
    let guard_macro = sprintf "%s_T_H__" (String.uppercase_ascii ec.enclave_name) in
+   let func_batch_list = List.concat (List.map gen_batch_protos ec.ufunc_decls) in
    let guard_code =
      let include_list = gen_include_list (ec.include_list @ !trusted_headers) in
-       gen_theader_preemble guard_macro include_list in
+     let batch_include =
+       if func_batch_list = [] then ""
+       else "#include \"sgx_tswitchless.h\" /* for sgx_switchless_ocall_t */\n" in
+       gen_theader_preemble guard_macro (include_list ^ batch_include) in
    let comp_def_list   = List.map gen_comp_def ec.comp_defs in
    let func_proto_list = List.map gen_func_proto (tf_list_to_fd_list ec.tfunc_decls) in
    let func_tproxy_list= List.map gen_tproxy_proto (uf_list_to_fd_list ec.ufunc_decls) in
@@ -921,6 +975,8 @@ let add_to_result_buffer result_buffer (fname: string)=
      List.iter (fun s -> output_string out_chan (s ^ ";\n")) func_proto_list;
      output_string out_chan "\n";
      List.iter (fun s -> output_string out_chan (s ^ ";\n")) func_tproxy_list;
+     if func_batch_list <> [] then output_string out_chan "\n";
+     List.iter (fun s -> output_string out_chan (s ^ ";\n")) func_batch_list;
      output_string out_chan header_footer;
      close_out out_chan
  
@@ -1448,7 +1504,7 @@ let add_to_result_buffer result_buffer (fname: string)=
                  in
                  let struct_malloc =
                    let code_template = [
-                       sprintf "\t__tmp_%s = malloc(_%s_malloc_size);"(mk_in_var name) name;
+                       sprintf "\t__tmp_%s = %s(_%s_malloc_size);"(mk_in_var name) (get_tbridge_malloc ()) name;
                        sprintf "\tif (__tmp_%s == NULL) {" (mk_in_var name);
                        "\t\tstatus = SGX_ERROR_OUT_OF_MEMORY;";
                        "\t\tgoto err;";
@@ -1471,7 +1527,7 @@ let add_to_result_buffer result_buffer (fname: string)=
                ]
                @ check_size @
                [
-               sprintf "\t%s = (%s)malloc(%s);" in_ptr_name in_ptr_type len_var;
+               sprintf "\t%s = (%s)%s(%s);" in_ptr_name in_ptr_type (get_tbridge_malloc ()) len_var;
                sprintf "\tif (%s == NULL) {" in_ptr_name;
                "\t\tstatus = SGX_ERROR_OUT_OF_MEMORY;";
                "\t\tgoto err;";
@@ -1515,7 +1571,7 @@ let add_to_result_buffer result_buffer (fname: string)=
                ]
                @ check_size @
                [
-               sprintf "\tif ((%s = (%s)malloc(%s)) == NULL) {" in_ptr_name in_ptr_type len_var;
+               sprintf "\tif ((%s = (%s)%s(%s)) == NULL) {" in_ptr_name in_ptr_type (get_tbridge_malloc ()) len_var;
                "\t\tstatus = SGX_ERROR_OUT_OF_MEMORY;";
                "\t\tgoto err;";
                "\t}\n";
@@ -1682,14 +1738,14 @@ let add_to_result_buffer result_buffer (fname: string)=
                            let (_, deep_copy)= get_struct_def struct_type
                            in
                            if deep_copy then
-                              sprintf "\tif (_in_member_%s) free(_in_member_%s);\n" name name
+                              sprintf "\tif (_in_member_%s) %s(_in_member_%s);\n" name (get_tbridge_free ()) name
                            else ""
                          else ""
                    | _ -> ""
              in
-             sprintf "\tif (%s) free(%s);\n%s" in_ptr_name in_ptr_dst_name struct_free
+             sprintf "\tif (%s) %s(%s);\n%s" in_ptr_name (get_tbridge_free ()) in_ptr_dst_name struct_free
          | Ast.PtrInOut | Ast.PtrOut ->
-                   sprintf "\tif (%s) free(%s);\n" in_ptr_name in_ptr_name
+                   sprintf "\tif (%s) %s(%s);\n" in_ptr_name (get_tbridge_free ()) in_ptr_name
          | _ -> ""
    in
    List.fold_left
@@ -1845,10 +1901,14 @@ let add_to_result_buffer result_buffer (fname: string)=
   in
 
    let local_vars = gen_tbridge_local_vars fd.Ast.plist ^
-                    if fd.rtype <> Ast.Void
+                    (if fd.rtype <> Ast.Void
                       then sprintf "\t%s %s;\n" (Ast.get_tystr fd.rtype) (mk_in_var retval_name)
-                      else "" in
+                      else "") in
    let func_close = "\treturn status;\n}\n" in
+   (* Arena allocations made during the ecall are released once the copies are freed.
+    * A naked ecall copies nothing, so it takes no mark. *)
+   let arena_mark = if !g_use_arena then "\tsgx_arena_mark_t _arena_mark = sgx_arena_begin();\n" else "" in
+   let arena_reset = if !g_use_arena then "\tsgx_arena_reset(_arena_mark);\n" else "" in
  
    let ms_struct_name = mk_ms_struct_name fd.Ast.fname in
    let declare_ms_ptr = sprintf "%s* %s = SGX_CAST(%s*, %s);"
@@ -1895,13 +1955,14 @@ let add_to_result_buffer result_buffer (fname: string)=
        in
          sprintf "%s%s%s\t%s\n\t%s\n%s" func_open local_vars dummy_var check_pms invoke_func func_close
      else
-       sprintf "%s%s\t%s\n\t%s\n%s%s\n%s%s\n%s%s%s\n%s\n%s%s"
+       sprintf "%s%s\t%s\n\t%s\n%s%s%s\n%s%s\n%s%s%s\n%s\n%s%s%s"
          func_open
          (mk_check_pms fd.Ast.fname)
          declare_ms_ptr
          declare_ms
          copy_ms
          local_vars
+         arena_mark
          (gen_check_tbridge_length_overflow fd.Ast.plist)
          (gen_check_tbridge_ptr_parms fd.Ast.plist)
          (gen_parm_ptr_direction_pre fd.Ast.plist)
@@ -1909,6 +1970,7 @@ let add_to_result_buffer result_buffer (fname: string)=
          (gen_parm_ptr_direction_post fd.Ast.plist)
          (gen_err_mark fd)
          (gen_parm_ptr_free_post fd.Ast.plist)
+         arena_reset
          func_close
  
  let tproxy_fill_ms_field (pd: Ast.pdecl) (is_ocall_switchless: bool) =
@@ -2455,6 +2517,68 @@ let add_to_result_buffer result_buffer (fname: string)=
          List.fold_left (fun acc s -> if s = "" then acc else acc ^ s ^ "\n") func_open (List.rev !func_body) ^ func_close
        end
  
+ (* Generate the trusted helper that fills in one entry of a batch of
+  * switchless OCalls.  The marshaling structure is taken from the
+  * OCall stack and stays there until sgx_ocfree() or the end of the
+  * ECall, so the helper never frees it on failure: doing so would also
+  * release the structures of the entries prepared before it.
+  *)
+ let gen_func_batch_prepare (ufunc: Ast.untrusted_func) (idx: int) =
+   let fd = ufunc.Ast.uf_fdecl in
+   let ms_struct_name = mk_ms_struct_name fd.Ast.fname in
+   let is_naked = is_naked_func fd in
+   let local_var =
+     if is_naked then ""
+     else sprintf "\t%s* %s = NULL;\n\n" ms_struct_name ms_struct_val in
+   let check_call = sprintf "\tif (%s == NULL)\n\t\treturn SGX_ERROR_INVALID_PARAMETER;\n\n" batch_call_name in
+   let ocalloc_ms =
+     if is_naked then ""
+     else sprintf "\t%s = (%s*)sgx_ocalloc(sizeof(%s));\n\tif (%s == NULL)\n\t\treturn SGX_ERROR_UNEXPECTED;\n"
+            ms_struct_val ms_struct_name ms_struct_name ms_struct_val in
+   let fill_ms_field (pd: Ast.pdecl) =
+     let name = (snd pd).Ast.identifier in
+     let parm_accessor = mk_parm_accessor name in
+       sprintf "\tif (memcpy_verw_s(&%s, sizeof(%s), &%s, sizeof(%s)))\n\t\treturn SGX_ERROR_UNEXPECTED;\n"
+         parm_accessor parm_accessor name name in
+   let fill_ms = List.fold_left (fun acc pd -> acc ^ fill_ms_field pd) "" fd.Ast.plist in
+   let set_call = sprintf "\n\t%s->index = %d;\n\t%s->ms = %s;\n\treturn SGX_SUCCESS;\n}\n"
+                    batch_call_name idx batch_call_name (if is_naked then "NULL" else ms_struct_val) in
+     sprintf "%s\n{\n%s%s%s%s%s" (gen_batch_prepare_proto fd) local_var check_call ocalloc_ms fill_ms set_call
+ 
+ (* Generate the trusted helper that reads the return value of a completed
+  * batched switchless OCall back from its marshaling structure.
+  *)
+ let gen_func_batch_result (ufunc: Ast.untrusted_func) (idx: int) =
+   let fd = ufunc.Ast.uf_fdecl in
+   let ms_struct_name = mk_ms_struct_name fd.Ast.fname in
+   let retval_accessor = mk_parm_accessor retval_name in
+   let code_template = [
+     gen_batch_result_proto fd;
+     "{";
+     sprintf "\tconst %s* %s = NULL;" ms_struct_name ms_struct_val;
+     "";
+     sprintf "\tif (%s == NULL || %s->index != %d)" batch_call_name batch_call_name idx;
+     "\t\treturn SGX_ERROR_INVALID_PARAMETER;";
+     sprintf "\tif (%s->status != SGX_SUCCESS)" batch_call_name;
+     sprintf "\t\treturn %s->status;" batch_call_name;
+     "";
+     sprintf "\t%s = (const %s*)%s->ms;" ms_struct_val ms_struct_name batch_call_name;
+     sprintf "\tCHECK_REF_POINTER(%s, sizeof(%s));" ms_struct_val ms_struct_name;
+     sprintf "\tif (%s) {" retval_name;
+     sprintf "\t\tif (memcpy_s((void*)%s, sizeof(*%s), &%s, sizeof(%s)))"
+       retval_name retval_name retval_accessor retval_accessor;
+     "\t\t\treturn SGX_ERROR_UNEXPECTED;";
+     "\t}";
+     "\treturn SGX_SUCCESS;";
+     "}";
+     ] in
+     List.fold_left (fun acc s -> acc ^ s ^ "\n") "" code_template
+ 
+ let gen_func_batch (ufunc: Ast.untrusted_func) (idx: int) =
+   if not (is_batchable_ocall ufunc) then []
+   else if ufunc.Ast.uf_fdecl.Ast.rtype = Ast.Void then [gen_func_batch_prepare ufunc idx]
+   else [gen_func_batch_prepare ufunc idx; gen_func_batch_result ufunc idx]
+ 
  (* It generates OCALL table and the untrusted proxy to setup OCALL table. *)
  let gen_ocall_table (ec: enclave_content) =
    let func_proto_ubridge = List.map (fun (uf: Ast.untrusted_func) ->
@@ -2508,7 +2632,8 @@ let add_to_result_buffer result_buffer (fname: string)=
  #include \"sgx_lfence.h\" /* for sgx_lfence */\n\n\
  #include <errno.h>\n\
  #include <mbusafecrt.h> /* for memcpy_s etc */\n\
- #include <stdlib.h> /* for malloc/free etc */\n\
+ #include <stdlib.h> /* for malloc/free etc */\n" ^
+ (if !g_use_arena then "#include \"sgx_arena.h\" /* for sgx_arena_begin etc */\n" else "") ^ "\
  \n\
  #define CHECK_REF_POINTER(ptr, siz) do {\t\\\n\
  \tif (!(ptr) || ! sgx_is_outside_enclave((ptr), (siz)))\t\\\n\
@@ -2540,6 +2665,10 @@ let add_to_result_buffer result_buffer (fname: string)=
                        (fun fd idx -> gen_func_tproxy fd idx)
                        (ec.ufunc_decls)
                        (Util.mk_seq 0 (List.length ec.ufunc_decls - 1)) in
+   let batch_list = List.concat (List.map2
+                       (fun fd idx -> gen_func_batch fd idx)
+                       (ec.ufunc_decls)
+                       (Util.mk_seq 0 (List.length ec.ufunc_decls - 1))) in
    let out_chan = open_out code_fname in
      output_string out_chan (include_hd ^ "\n");
      ms_writer out_chan ec;
@@ -2548,6 +2677,7 @@ let add_to_result_buffer result_buffer (fname: string)=
      output_string out_chan (entry_table ^ "\n");
      output_string out_chan "\n";
      List.iter (fun s -> output_string out_chan (s ^ "\n")) tproxy_list;
+     List.iter (fun s -> output_string out_chan (s ^ "\n")) batch_list;
      close_out out_chan
  
  (* We use a stack to keep record of imported files.
@@ -2751,6 +2881,7 @@ let add_to_result_buffer result_buffer (fname: string)=
  let gen_enclave_code (e: Ast.enclave) (ep: edger8r_params) =
    let ec = reduce_import (parse_enclave_ast e) in
      g_use_prefix := ep.use_prefix;
+     g_use_arena := ep.use_arena;
      g_untrusted_dir := ep.untrusted_dir;
      g_trusted_dir := ep.trusted_dir;
      create_dir ep.untrusted_dir;
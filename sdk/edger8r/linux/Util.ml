@@ -64,6 +64,7 @@ let usage (progname: string) =
   eprintf "\n[options]\n\
 --search-path <path>  Specify the search path of EDL files\n\
 --use-prefix          Prefix untrusted proxy with Enclave name\n\
+--use-arena           Allocate trusted bridge buffers from the per-ecall arena\n\
 --header-only         Only generate header files\n\
 --untrusted           Generate untrusted proxy and bridge\n\
 --trusted             Generate trusted proxy and bridge\n\
@@ -79,6 +80,7 @@ If neither `--untrusted' nor `--trusted' is specified, generate both.\n";
 type edger8r_params = {
   input_files   : string list;
   use_prefix    : bool;
+  use_arena     : bool;         (* User specified `--use-arena' *)
   header_only   : bool;
   gen_untrusted : bool;         (* User specified `--untrusted' *)
   gen_trusted   : bool;         (* User specified `--trusted' *)
@@ -103,6 +105,7 @@ let path_separator : char =
 (* Parse the command line and return a record of `edger8r_params'. *)
 let rec parse_cmdline (progname: string) (cmdargs: string list) =
   let use_pref = ref false in
+  let use_arena= ref false in
   let hd_only  = ref false in
   let untrusted= ref false in
   let trusted  = ref false in
@@ -116,6 +119,7 @@ let rec parse_cmdline (progname: string) (cmdargs: string list) =
       | op :: ops ->
           match String.lowercase_ascii op with
               "--use-prefix" -> use_pref := true; local_parser ops
+            | "--use-arena"  -> use_arena := true; local_parser ops
             | "--header-only"-> hd_only := true; local_parser ops
             | "--untrusted"  -> untrusted := true; local_parser ops
             | "--trusted"    -> trusted := true; local_parser ops
@@ -140,7 +144,7 @@ let rec parse_cmdline (progname: string) (cmdargs: string list) =
   in
     local_parser cmdargs;
     let opt =
-      { input_files = List.rev !files; use_prefix = !use_pref;
+      { input_files = List.rev !files; use_prefix = !use_pref; use_arena = !use_arena;
         header_only = !hd_only; gen_untrusted = true; gen_trusted = true;
         untrusted_dir = !u_dir; trusted_dir = !t_dir;
       }
@@ -30,6 +30,7 @@
  */
 
 #include <vector>
+#include <list>
 #include <pthread.h>
 #include "sgx_tprotected_fs.h"
 #include "sgx_tprotected_fs_t.h"
@@ -279,14 +279,17 @@ void protected_fs_file::init_fields(const uint32_t cache_page)
 	use_user_kdk_key = 0;
 	master_key_count = 0;
 	parallel_flush_level = 1;
+	read_advice = SGX_FADV_NORMAL;
+	last_read_end = -1;
+	sequential_reads = 0;
 
 	file_name[0] = '\0';
 	recovery_filename[0] = '\0';
 
 	max_cache_page = cache_page;
 
-	// set hash size
-	cache.rehash(max_cache_page);
+	// add this file's share to the shared cache
+	cache.init(max_cache_page, &mutex, node_evictable, release_node);
 	
 	memset(&mutex, 0, sizeof(sgx_thread_mutex_t));
 
@@ -518,23 +521,19 @@ protected_fs_file::~protected_fs_file()
 {
 	void* data;
 	
-	while ((data = cache.get_last()) != NULL)
+	// other files may evict our nodes while we don't hold the mutex
+	// (if the file failed to open before the mutex was initialized, the cache is empty and lock fails)
+	int32_t result32 = sgx_thread_mutex_lock(&mutex);
+
+	while ((data = cache.get_first()) != NULL) // newest first, children go before their parents
 	{
-		if (((file_data_node_t*)data)->type == FILE_DATA_NODE_TYPE) // type is in the same offset in both node types, need to scrub the plaintext
-		{
-			file_data_node_t* file_data_node = (file_data_node_t*)data;
-			memset_s(&file_data_node->plain, sizeof(data_node_t), 0, sizeof(data_node_t));
-			delete file_data_node;
-		}
-		else
-		{
-			file_mht_node_t* file_mht_node = (file_mht_node_t*)data;
-			memset_s(&file_mht_node->plain, sizeof(mht_node_t), 0, sizeof(mht_node_t));
-			delete file_mht_node;
-		}
-		cache.remove_last();
+		cache.remove(data);
+		release_node(data);
 	}
 
+	if (result32 == 0)
+		sgx_thread_mutex_unlock(&mutex);
+
 	// scrub the last encryption key and the session key
 	memset_s(&cur_key, sizeof(sgx_aes_gcm_128bit_key_t), 0, sizeof(sgx_aes_gcm_128bit_key_t));
 	memset_s(&session_master_key, sizeof(sgx_aes_gcm_128bit_key_t), 0, sizeof(sgx_aes_gcm_128bit_key_t));
@@ -222,7 +222,7 @@ int32_t protected_fs_file::clear_cache()
 
 	while (cache.size() > 0)
 	{
-		void* data = cache.get_last();
+		void* data = cache.get_first(); // newest first, children go before their parents
 
 		assert(data != NULL);
 		assert(((file_data_node_t*)data)->need_writing == false); // need_writing is in the same offset in both node types
@@ -233,24 +233,69 @@ int32_t protected_fs_file::clear_cache()
 			return 1;
 		}
 		
-		cache.remove_last();
+		cache.remove(data);
+		release_node(data);
+	}
 
-		// before deleting the memory, need to scrub the plain secrets
-		if (((file_data_node_t*)data)->type == FILE_DATA_NODE_TYPE) // type is in the same offset in both node types
-		{
-			file_data_node_t* file_data_node = (file_data_node_t*)data;
-			memset_s(&file_data_node->plain, sizeof(data_node_t), 0, sizeof(data_node_t));
-			delete file_data_node;
-		}
-		else
-		{
-			file_mht_node_t* file_mht_node = (file_mht_node_t*)data;
-			memset_s(&file_mht_node->plain, sizeof(mht_node_t), 0, sizeof(mht_node_t));
-			delete file_mht_node;
-		}
+	sgx_thread_mutex_unlock(&mutex);
+
+	return 0;
+}
+
+
+// called by the shared cache, with this file's mutex held
+bool protected_fs_file::node_evictable(const void* data)
+{
+	return ((const file_data_node_t*)data)->need_writing == false; // need_writing is in the same offset in both node types
+}
+
+
+// scrub the plain secrets and delete a node that was removed from the cache
+void protected_fs_file::release_node(void* data)
+{
+	if (((file_data_node_t*)data)->type == FILE_DATA_NODE_TYPE) // type is in the same offset in both node types
+	{
+		file_data_node_t* file_data_node = (file_data_node_t*)data;
+		memset_s(&file_data_node->plain, sizeof(data_node_t), 0, sizeof(data_node_t));
+		delete file_data_node;
+	}
+	else
+	{
+		file_mht_node_t* file_mht_node = (file_mht_node_t*)data;
+		memset_s(&file_mht_node->plain, sizeof(mht_node_t), 0, sizeof(mht_node_t));
+		delete file_mht_node;
+	}
+}
+
+
+int32_t protected_fs_file::get_stats(sgx_fstats_t* stats)
+{
+	node_cache_stats_t file_stats;
+	node_cache_stats_t shared_stats;
+	uint64_t capacity;
+
+	int32_t result32 = sgx_thread_mutex_lock(&mutex);
+	if (result32 != 0)
+	{
+		last_error = result32;
+		return 1;
 	}
 
+	cache.get_stats(&file_stats);
+
 	sgx_thread_mutex_unlock(&mutex);
 
+	node_cache::get_shared_stats(&shared_stats, &capacity);
+
+	stats->cache_hits = file_stats.hits;
+	stats->cache_misses = file_stats.misses;
+	stats->cache_evictions = file_stats.evictions;
+	stats->cached_pages = file_stats.nodes;
+	stats->shared_cache_hits = shared_stats.hits;
+	stats->shared_cache_misses = shared_stats.misses;
+	stats->shared_cache_evictions = shared_stats.evictions;
+	stats->shared_cached_pages = shared_stats.nodes;
+	stats->shared_cache_pages = capacity;
+
 	return 0;
 }
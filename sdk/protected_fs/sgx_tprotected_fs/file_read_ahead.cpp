@@ -0,0 +1,209 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include <pthread.h>
+#include "sgx_tprotected_fs_t.h"
+#include "protected_fs_file.h"
+
+#include <sgx_trts.h>
+
+
+// how many nodes to read in one batch when the node at the current offset is missing
+// sequential access gets the full window, otherwise only the nodes of the current request are read together
+uint32_t protected_fs_file::read_ahead_nodes(size_t data_left_to_read)
+{
+	uint64_t window = READ_AHEAD_MAX_NODES;
+	if (window > max_cache_page / 4)
+		window = max_cache_page / 4;
+
+	if (read_advice == SGX_FADV_RANDOM)
+		return 0;
+
+	if (read_advice == SGX_FADV_SEQUENTIAL || sequential_reads >= READ_AHEAD_SEQUENTIAL_READS)
+		return (uint32_t)window;
+
+	uint64_t offset_in_node = (uint64_t)(offset - MD_USER_DATA_SIZE) % NODE_SIZE;
+	uint64_t nodes_in_request = (offset_in_node + data_left_to_read + NODE_SIZE - 1) / NODE_SIZE;
+
+	return (uint32_t)(nodes_in_request < window ? nodes_in_request : window);
+}
+
+
+static void* read_ahead_decrypt(void* thread_input)
+{
+	read_ahead_input_t* input = (read_ahead_input_t*)thread_input;
+
+	for (uint32_t i = input->first ; i < input->count ; i += input->step)
+	{
+		read_ahead_node_t* read_ahead_node = &input->nodes[i];
+		file_data_node_t* file_data_node = read_ahead_node->node;
+		gcm_crypto_data_t* gcm_crypto_data = &file_data_node->parent->plain.data_nodes_crypto[file_data_node->data_node_number % ATTACHED_DATA_NODES_COUNT];
+
+		// this function decrypt the data _and_ checks the integrity of the data against the gmac
+		read_ahead_node->status = sgx_rijndael128GCM_decrypt(&gcm_crypto_data->key, read_ahead_node->encrypted, NODE_SIZE, file_data_node->plain.data,
+															 input->empty_iv, SGX_AESGCM_IV_SIZE, NULL, 0, &gcm_crypto_data->gmac);
+	}
+
+	return NULL;
+}
+
+
+// read the data nodes from the current offset on, and decrypt them together
+// the mht nodes are read one by one as before (one mht node covers 96 data nodes), the data nodes are decrypted by
+// up to parallel_flush_level threads. nodes that fail here are simply dropped, reading them on demand reports the error
+void protected_fs_file::read_ahead(uint32_t nodes_count)
+{
+	read_ahead_node_t* batch = NULL;
+	uint64_t physical_node_number;
+	uint32_t count = 0;
+
+	if (offset < MD_USER_DATA_SIZE || nodes_count > READ_AHEAD_MAX_NODES)
+		return;
+
+	get_node_numbers(offset, NULL, NULL, NULL, &physical_node_number);
+	if (cache.contains(physical_node_number) == true)
+		return;
+
+	try {
+		batch = new read_ahead_node_t[nodes_count];
+	}
+	catch (std::bad_alloc& e) {
+		(void)e; // remove warning
+		return; // not an error, the nodes are read on demand
+	}
+
+	int64_t node_offset = offset - (offset - MD_USER_DATA_SIZE) % NODE_SIZE;
+	for ( ; count < nodes_count && node_offset < encrypted_part_plain.size ; node_offset += NODE_SIZE)
+	{
+		uint64_t mht_node_number;
+		uint64_t data_node_number;
+		uint64_t physical_mht_node_number;
+
+		get_node_numbers(node_offset, &mht_node_number, &data_node_number, &physical_mht_node_number, &physical_node_number);
+
+		if (cache.contains(physical_node_number) == true) // might be newer than the data on disk
+			continue;
+
+		if (file_addr == NULL || real_file_size < 0 || ((uint64_t)real_file_size < NODE_SIZE * (physical_node_number + 1)))
+			break;
+
+		// the first node is needed anyway, past it don't read (and maybe fail on) mht nodes the user didn't ask for yet
+		if (count > 0 && mht_node_number != 0 && cache.contains(physical_mht_node_number) == false)
+			break;
+
+		file_mht_node_t* file_mht_node = read_mht_node(mht_node_number);
+		if (file_mht_node == NULL)
+			break;
+
+		file_data_node_t* file_data_node = NULL;
+		try {
+			file_data_node = new file_data_node_t;
+		}
+		catch (std::bad_alloc& e) {
+			(void)e; // remove warning
+			break;
+		}
+		memset(file_data_node, 0, sizeof(file_data_node_t));
+		file_data_node->type = FILE_DATA_NODE_TYPE;
+		file_data_node->data_node_number = data_node_number;
+		file_data_node->physical_node_number = physical_node_number;
+		file_data_node->parent = file_mht_node;
+
+		batch[count].node = file_data_node;
+		batch[count].status = SGX_ERROR_UNEXPECTED;
+		memcpy(batch[count].encrypted, file_addr + NODE_SIZE * physical_node_number, NODE_SIZE); // temp buffer for TOCTOU
+		count++;
+	}
+
+	// the calling thread takes the first share, the other shares go to new threads
+	uint32_t workers = parallel_flush_level < count ? parallel_flush_level : count;
+	pthread_t threads[READ_AHEAD_MAX_NODES];
+	read_ahead_input_t thread_inputs[READ_AHEAD_MAX_NODES];
+	uint32_t tnum = 1;
+
+	for (uint32_t i = 0 ; i < workers ; i++)
+		thread_inputs[i] = { batch, i, workers, count, empty_iv };
+
+	for ( ; tnum < workers ; tnum++)
+	{
+		if (pthread_create(&threads[tnum], NULL, &read_ahead_decrypt, &thread_inputs[tnum]) != 0)
+			break; // no free TCS, the calling thread does the rest
+	}
+
+	for (uint32_t i = 0 ; i < workers ; i++)
+	{
+		if (i == 0 || i >= tnum)
+			read_ahead_decrypt(&thread_inputs[i]);
+	}
+
+	for (uint32_t i = 1 ; i < tnum ; i++)
+		pthread_join(threads[i], NULL);
+
+	for (uint32_t i = 0 ; i < count ; i++)
+	{
+		file_data_node_t* file_data_node = batch[i].node;
+
+		if (batch[i].status == SGX_SUCCESS &&
+			cache.add(file_data_node->physical_node_number, file_data_node, file_data_node->parent, true) == true)
+			continue;
+
+		memset_s(&file_data_node->plain, sizeof(data_node_t), 0, sizeof(data_node_t)); // scrub the plaintext data
+		delete file_data_node;
+	}
+
+	delete[] batch;
+}
+
+
+int32_t protected_fs_file::advise(int32_t advice)
+{
+	if (advice != SGX_FADV_NORMAL && advice != SGX_FADV_RANDOM && advice != SGX_FADV_SEQUENTIAL)
+	{
+		errno = EINVAL;
+		return 1;
+	}
+
+	int32_t result32 = sgx_thread_mutex_lock(&mutex);
+	if (result32 != 0)
+	{
+		last_error = result32;
+		file_status = SGX_FILE_STATUS_MEMORY_CORRUPTED;
+		return 1;
+	}
+
+	read_advice = advice;
+	sequential_reads = 0;
+
+	sgx_thread_mutex_unlock(&mutex);
+
+	return 0;
+}
@@ -241,6 +241,16 @@ size_t protected_fs_file::read(void* ptr, size_t size, size_t count)
 	}
 	size_t data_attempted_to_read = data_left_to_read; // used at the end to return how much we actually read
 
+	if (offset == last_read_end)
+	{
+		if (sequential_reads < UINT32_MAX)
+			sequential_reads++;
+	}
+	else
+	{
+		sequential_reads = 0;
+	}
+
 	unsigned char* out_buffer = (unsigned char*)ptr;
 
 	// the first block of user data is read from the meta-data encrypted part
@@ -265,6 +275,10 @@ size_t protected_fs_file::read(void* ptr, size_t size, size_t count)
 
 	while (data_left_to_read > 0)
 	{
+		uint32_t nodes_count = read_ahead_nodes(data_left_to_read);
+		if (nodes_count > 1)
+			read_ahead(nodes_count); // does nothing if the current node is already cached
+
 		file_data_node_t* file_data_node = NULL;
 		file_data_node = get_data_node(); // return the data node of the current offset, will read it from disk if needed (and also the mht node if needed)
 		if (file_data_node == NULL)
@@ -290,6 +304,8 @@ size_t protected_fs_file::read(void* ptr, size_t size, size_t count)
 		}
 	}
 
+	last_read_end = offset;
+
 	sgx_thread_mutex_unlock(&mutex);
 
 	if (data_left_to_read == 0 &&
@@ -358,56 +374,37 @@ file_data_node_t* protected_fs_file::get_data_node()
 		file_data_node = read_data_node();
 	}
 
-	// bump all the parents mht to reside before the data node in the cache
+	// bump all the parents mht, they are used with every access to their children
 	if (file_data_node != NULL)
 	{
 		file_mht_node_t* file_mht_node = file_data_node->parent;
 		while (file_mht_node->mht_node_number != 0)
 		{
-			cache.get(file_mht_node->physical_node_number); // bump the mht node to the head of the lru
+			cache.touch(file_mht_node);
 			file_mht_node = file_mht_node->parent;
 		}
 	}
 
 	// even if we didn't get the required data_node, we might have read other nodes in the process
-	while (cache.size() > max_cache_page)
+	// the limit is shared by all the open files, evict from any of them but keep the node we return
+	bool flushed = false;
+	while (cache.over_limit())
 	{
-		void* data = cache.get_last();
-		assert(data != NULL);
-		// for production - 
-		if (data == NULL)
-		{
-			last_error = SGX_ERROR_UNEXPECTED;
-			return NULL;
-		}
-		if (((file_data_node_t*)data)->need_writing == false) // need_writing is in the same offset in both node types
-		{
-			cache.remove_last();
+		if (cache.evict_one(file_data_node) == true)
+			continue;
 
-			// before deleting the memory, need to scrub the plain secrets
-			if (((file_data_node_t*)data)->type == FILE_DATA_NODE_TYPE) // type is in the same offset in both node types
-			{
-				file_data_node_t* file_data_node1 = (file_data_node_t*)data;
-				memset_s(&file_data_node1->plain, sizeof(data_node_t), 0, sizeof(data_node_t));
-				delete file_data_node1;
-			}
-			else
-			{
-				file_mht_node_t* file_mht_node = (file_mht_node_t*)data;
-				memset_s(&file_mht_node->plain, sizeof(mht_node_t), 0, sizeof(mht_node_t));
-				delete file_mht_node;
-			}
-		}
-		else
+		// only dirty nodes of this file or nodes of busy files are left
+		if (flushed == true || need_writing == false)
+			break; // stay above the limit for now, next access will try again
+
+		if (internal_flush() == false) // error, can't flush cache, file status changed to error
 		{
-			if (internal_flush() == false) // error, can't flush cache, file status changed to error
-			{
-				assert(file_status != SGX_FILE_STATUS_OK);
-				if (file_status == SGX_FILE_STATUS_OK)
-					file_status = SGX_FILE_STATUS_FLUSH_ERROR; // for release set this anyway
-				return NULL; // even if we got the data_node!
-			}
+			assert(file_status != SGX_FILE_STATUS_OK);
+			if (file_status == SGX_FILE_STATUS_OK)
+				file_status = SGX_FILE_STATUS_FLUSH_ERROR; // for release set this anyway
+			return NULL; // even if we got the data_node!
 		}
+		flushed = true;
 	}
 	
 	return file_data_node;
@@ -437,7 +434,7 @@ file_data_node_t* protected_fs_file::append_data_node()
 	new_file_data_node->parent = file_mht_node;
 	get_node_numbers(offset, NULL, &new_file_data_node->data_node_number, NULL, &new_file_data_node->physical_node_number);
 
-	if (cache.add(new_file_data_node->physical_node_number, new_file_data_node) == false)
+	if (cache.add(new_file_data_node->physical_node_number, new_file_data_node, file_mht_node) == false)
 	{
 		delete new_file_data_node;
 		last_error = ENOMEM;
@@ -507,7 +504,7 @@ file_data_node_t* protected_fs_file::read_data_node()
 		return NULL;
 	}
 		
-	if (cache.add(file_data_node->physical_node_number, file_data_node) == false)
+	if (cache.add(file_data_node->physical_node_number, file_data_node, file_mht_node) == false)
 	{
 		memset_s(&file_data_node->plain, sizeof(data_node_t), 0, sizeof(data_node_t)); // scrub the plaintext data
 		delete file_data_node;
@@ -577,7 +574,7 @@ file_mht_node_t* protected_fs_file::append_mht_node(uint64_t mht_node_number)
 	new_file_mht_node->mht_node_number = mht_node_number;
 	new_file_mht_node->physical_node_number = physical_node_number;
 
-	if (cache.add(new_file_mht_node->physical_node_number, new_file_mht_node) == false)
+	if (cache.add(new_file_mht_node->physical_node_number, new_file_mht_node, parent_file_mht_node) == false)
 	{
 		delete new_file_mht_node;
 		last_error = ENOMEM;
@@ -646,7 +643,7 @@ file_mht_node_t* protected_fs_file::read_mht_node(uint64_t mht_node_number)
 		return NULL;
 	}
 
-	if (cache.add(file_mht_node->physical_node_number, file_mht_node) == false)
+	if (cache.add(file_mht_node->physical_node_number, file_mht_node, parent_file_mht_node) == false)
 	{
 		memset_s(&file_mht_node->plain, sizeof(mht_node_t), 0, sizeof(mht_node_t));
 		delete file_mht_node;
@@ -0,0 +1,515 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "node_cache.h"
+
+#include <assert.h>
+#include <stddef.h>
+#include <new>
+
+#define SEGMENT_PROBATION 1
+#define SEGMENT_PROTECTED 2
+
+typedef struct _lru_list
+{
+	cache_node_t* head;
+	cache_node_t* tail;
+	uint64_t count;
+} lru_list_t;
+
+typedef struct _shared_cache
+{
+	sgx_thread_mutex_t mutex; // protects the lists and node segments, taken after the file mutex
+	lru_list_t probation;
+	lru_list_t protect;
+	uint64_t capacity;        // sum of the cache sizes of all the open files, changed under the mutex
+	node_cache_stats_t stats; // hits and misses are relaxed atomics, the rest is changed under the mutex
+} shared_cache_t;
+
+static shared_cache_t g_shared = { SGX_THREAD_MUTEX_INITIALIZER, { NULL, NULL, 0 }, { NULL, NULL, 0 }, 0, { 0, 0, 0, 0 } };
+
+
+static void lru_push_head(lru_list_t* list, cache_node_t* node)
+{
+	node->lru_prev = NULL;
+	node->lru_next = list->head;
+	if (list->head != NULL)
+		list->head->lru_prev = node;
+	else
+		list->tail = node;
+	list->head = node;
+	list->count++;
+}
+
+
+static void lru_remove(lru_list_t* list, cache_node_t* node)
+{
+	if (node->lru_prev != NULL)
+		node->lru_prev->lru_next = node->lru_next;
+	else
+		list->head = node->lru_next;
+	if (node->lru_next != NULL)
+		node->lru_next->lru_prev = node->lru_prev;
+	else
+		list->tail = node->lru_prev;
+	node->lru_prev = NULL;
+	node->lru_next = NULL;
+	list->count--;
+}
+
+
+// the segment is only changed with the shared mutex held, but read without it on a hit
+static uint8_t node_segment(cache_node_t* node)
+{
+	return __atomic_load_n(&node->segment, __ATOMIC_RELAXED);
+}
+
+
+static void set_node_segment(cache_node_t* node, uint8_t segment)
+{
+	__atomic_store_n(&node->segment, segment, __ATOMIC_RELAXED);
+}
+
+
+static lru_list_t* lru_segment(cache_node_t* node)
+{
+	return (node_segment(node) == SEGMENT_PROTECTED) ? &g_shared.protect : &g_shared.probation;
+}
+
+
+// called with the shared mutex held
+static void lru_promote(cache_node_t* node)
+{
+	lru_remove(lru_segment(node), node);
+	set_node_segment(node, SEGMENT_PROTECTED);
+	__atomic_store_n(&node->referenced, 0, __ATOMIC_RELAXED);
+	lru_push_head(&g_shared.protect, node);
+
+	// the protected segment gets 3/4 of the pool, its lru nodes go back to probation
+	// unless they were hit since they were last looked at here (second chance)
+	uint64_t protect_max = g_shared.capacity - g_shared.capacity / 4;
+	uint64_t second_chances = 0;
+	while (g_shared.protect.count > protect_max && g_shared.protect.count > 1)
+	{
+		cache_node_t* demoted = g_shared.protect.tail;
+		lru_remove(&g_shared.protect, demoted);
+		if (__atomic_exchange_n(&demoted->referenced, 0, __ATOMIC_RELAXED) != 0 &&
+			second_chances++ < g_shared.protect.count)
+		{
+			lru_push_head(&g_shared.protect, demoted);
+			continue;
+		}
+		set_node_segment(demoted, SEGMENT_PROBATION);
+		lru_push_head(&g_shared.probation, demoted);
+	}
+}
+
+
+// a hit on a node, called with the owner's mutex held
+// a protected node is only marked as referenced, so hits on hot nodes don't take the shared mutex,
+// which is only needed to move a node from probation to the protected segment
+static void node_hit(cache_node_t* node)
+{
+	if (node_segment(node) == SEGMENT_PROTECTED)
+	{
+		__atomic_store_n(&node->referenced, 1, __ATOMIC_RELAXED);
+		return;
+	}
+
+	sgx_thread_mutex_lock(&g_shared.mutex);
+	if (node_segment(node) == SEGMENT_PROTECTED) // promoted by another file meanwhile
+		__atomic_store_n(&node->referenced, 1, __ATOMIC_RELAXED);
+	else
+		lru_promote(node);
+	sgx_thread_mutex_unlock(&g_shared.mutex);
+}
+
+
+static void count_shared_hit(bool hit)
+{
+	__atomic_fetch_add(hit ? &g_shared.stats.hits : &g_shared.stats.misses, 1, __ATOMIC_RELAXED);
+}
+
+
+node_cache::node_cache()
+{
+	owner_mutex = NULL;
+	evictable = NULL;
+	release = NULL;
+	buckets = NULL;
+	bucket_mask = 0;
+	max_pages = 0;
+	head = NULL;
+	m_it = NULL;
+	count = 0;
+	stats = { 0, 0, 0, 0 };
+}
+
+
+node_cache::~node_cache()
+{
+	// the owner must have removed (and released) all its nodes by now
+	assert(count == 0);
+
+	sgx_thread_mutex_lock(&g_shared.mutex);
+	while (head != NULL)
+	{
+		cache_node_t* node = head;
+		lru_remove(lru_segment(node), node);
+		__atomic_fetch_sub(&g_shared.stats.nodes, 1, __ATOMIC_RELAXED);
+		unlink(node);
+	}
+	__atomic_fetch_sub(&g_shared.capacity, max_pages, __ATOMIC_RELAXED);
+	sgx_thread_mutex_unlock(&g_shared.mutex);
+
+	delete[] buckets;
+}
+
+
+void node_cache::init(uint32_t max_pages_, sgx_thread_mutex_t* owner_mutex_, cache_node_evictable_t evictable_, cache_node_release_t release_)
+{
+	uint32_t bucket_count = 1;
+
+	owner_mutex = owner_mutex_;
+	evictable = evictable_;
+	release = release_;
+
+	while (bucket_count < max_pages_ && bucket_count < 0x80000000)
+		bucket_count <<= 1;
+
+	try {
+		buckets = new cache_node_t*[bucket_count]();
+	}
+	catch (std::bad_alloc& e) {
+		(void)e; // remove warning
+		return; // add will fail
+	}
+	bucket_mask = bucket_count - 1;
+
+	sgx_thread_mutex_lock(&g_shared.mutex);
+	max_pages = max_pages_;
+	__atomic_fetch_add(&g_shared.capacity, max_pages, __ATOMIC_RELAXED);
+	sgx_thread_mutex_unlock(&g_shared.mutex);
+}
+
+
+// the file can hold more nodes than its own share, keep the chains short
+void node_cache::grow_buckets()
+{
+	uint32_t bucket_count = (bucket_mask + 1) * 2;
+	cache_node_t** new_buckets = NULL;
+
+	if (bucket_count == 0) // overflow
+		return;
+
+	try {
+		new_buckets = new cache_node_t*[bucket_count]();
+	}
+	catch (std::bad_alloc& e) {
+		(void)e; // remove warning
+		return; // keep the current table, it still works
+	}
+
+	for (cache_node_t* node = head; node != NULL; node = node->file_next)
+	{
+		uint32_t index = (uint32_t)(node->key & (bucket_count - 1));
+		node->hash_next = new_buckets[index];
+		new_buckets[index] = node;
+	}
+
+	delete[] buckets;
+	buckets = new_buckets;
+	bucket_mask = bucket_count - 1;
+}
+
+
+cache_node_t* node_cache::lookup(uint64_t key)
+{
+	if (buckets == NULL)
+		return NULL;
+
+	cache_node_t* node = buckets[key & bucket_mask];
+	while (node != NULL && node->key != key)
+		node = node->hash_next;
+
+	return node;
+}
+
+
+bool node_cache::add(uint64_t key, void* data, void* parent, bool prefetched)
+{
+	cache_node_t* node = (cache_node_t*)data;
+
+	if (buckets == NULL)
+		return false;
+
+	assert(lookup(key) == NULL);
+
+	if (count > bucket_mask)
+		grow_buckets();
+
+	node->key = key;
+	node->owner = this;
+	node->parent = (cache_node_t*)parent;
+	node->children = 0;
+	node->prefetched = prefetched ? 1 : 0;
+	node->referenced = 0;
+	if (node->parent != NULL)
+		node->parent->children++;
+
+	uint32_t index = (uint32_t)(key & bucket_mask);
+	node->hash_next = buckets[index];
+	buckets[index] = node;
+
+	node->file_prev = NULL;
+	node->file_next = head;
+	if (head != NULL)
+		head->file_prev = node;
+	head = node;
+	count++;
+
+	sgx_thread_mutex_lock(&g_shared.mutex);
+	set_node_segment(node, SEGMENT_PROBATION);
+	lru_push_head(&g_shared.probation, node);
+	__atomic_fetch_add(&g_shared.stats.nodes, 1, __ATOMIC_RELAXED);
+	sgx_thread_mutex_unlock(&g_shared.mutex);
+
+	return true;
+}
+
+
+// the file's own statistics are protected by the owner's mutex, like the rest of the file
+void* node_cache::find(uint64_t key)
+{
+	cache_node_t* node = lookup(key);
+
+	if (node != NULL)
+		stats.hits++;
+	else
+		stats.misses++;
+	count_shared_hit(node != NULL);
+
+	return node;
+}
+
+
+bool node_cache::contains(uint64_t key)
+{
+	return lookup(key) != NULL;
+}
+
+
+void* node_cache::get(uint64_t key)
+{
+	cache_node_t* node = lookup(key);
+
+	if (node != NULL)
+	{
+		stats.hits++;
+		if (node->prefetched)
+			node->prefetched = 0; // first real use of a read ahead node, it has to be hit again to be promoted
+		else
+			node_hit(node);
+	}
+	else
+	{
+		stats.misses++;
+	}
+	count_shared_hit(node != NULL);
+
+	return node;
+}
+
+
+void node_cache::touch(void* data)
+{
+	cache_node_t* node = (cache_node_t*)data;
+
+	assert(node->owner == this);
+
+	node_hit(node);
+}
+
+
+// remove the node from the owner's hash and list, called with the owner's mutex held
+void node_cache::unlink(cache_node_t* node)
+{
+	cache_node_t** pp = &buckets[node->key & bucket_mask];
+	while (*pp != NULL && *pp != node)
+		pp = &(*pp)->hash_next;
+	assert(*pp == node);
+	if (*pp == node)
+		*pp = node->hash_next;
+
+	if (node->file_prev != NULL)
+		node->file_prev->file_next = node->file_next;
+	else
+		head = node->file_next;
+	if (node->file_next != NULL)
+		node->file_next->file_prev = node->file_prev;
+
+	if (m_it == node)
+		m_it = NULL;
+
+	if (node->parent != NULL)
+	{
+		assert(node->parent->children > 0);
+		node->parent->children--;
+	}
+
+	node->hash_next = NULL;
+	node->file_prev = NULL;
+	node->file_next = NULL;
+	node->owner = NULL;
+	count--;
+}
+
+
+// children have to be removed before their parents, the newest nodes (get_first) are always safe
+void node_cache::remove(void* data)
+{
+	cache_node_t* node = (cache_node_t*)data;
+
+	assert(node->owner == this);
+	assert(node->children == 0);
+
+	sgx_thread_mutex_lock(&g_shared.mutex);
+	lru_remove(lru_segment(node), node);
+	__atomic_fetch_sub(&g_shared.stats.nodes, 1, __ATOMIC_RELAXED);
+	sgx_thread_mutex_unlock(&g_shared.mutex);
+
+	unlink(node);
+}
+
+
+uint32_t node_cache::size()
+{
+	return count;
+}
+
+
+void* node_cache::get_first()
+{
+	m_it = head;
+	return m_it;
+}
+
+
+void* node_cache::get_next()
+{
+	if (m_it == NULL)
+		return NULL;
+
+	m_it = m_it->file_next;
+	return m_it;
+}
+
+
+// checked on every access, so it doesn't take the shared mutex, evict_one decides under it
+bool node_cache::over_limit()
+{
+	return __atomic_load_n(&g_shared.stats.nodes, __ATOMIC_RELAXED) > __atomic_load_n(&g_shared.capacity, __ATOMIC_RELAXED);
+}
+
+
+// evict the coldest node that can go, from this file or from any other idle file
+// returns false if no node can be evicted right now
+bool node_cache::evict_one(const void* keep)
+{
+	lru_list_t* lists[2] = { &g_shared.probation, &g_shared.protect };
+
+	sgx_thread_mutex_lock(&g_shared.mutex);
+
+	for (uint32_t i = 0 ; i < 2 ; i++)
+	{
+		for (cache_node_t* node = lists[i]->tail ; node != NULL ; node = node->lru_prev)
+		{
+			if (node == keep)
+				continue;
+
+			node_cache* owner = node->owner;
+			bool locked = false;
+
+			// another file's nodes can only be touched while that file is idle,
+			// trylock never waits so the lock order (file mutex, then shared mutex) is kept
+			if (owner != this)
+			{
+				if (sgx_thread_mutex_trylock(owner->owner_mutex) != 0)
+					continue;
+				locked = true;
+			}
+
+			if (node->children != 0 || owner->evictable(node) == false)
+			{
+				if (locked)
+					sgx_thread_mutex_unlock(owner->owner_mutex);
+				continue;
+			}
+
+			lru_remove(lists[i], node);
+			__atomic_fetch_sub(&g_shared.stats.nodes, 1, __ATOMIC_RELAXED);
+			g_shared.stats.evictions++;
+			owner->stats.evictions++;
+			owner->unlink(node);
+			owner->release(node);
+
+			if (locked)
+				sgx_thread_mutex_unlock(owner->owner_mutex);
+
+			sgx_thread_mutex_unlock(&g_shared.mutex);
+			return true;
+		}
+	}
+
+	sgx_thread_mutex_unlock(&g_shared.mutex);
+	return false;
+}
+
+
+// called with the owner's mutex held
+void node_cache::get_stats(node_cache_stats_t* out)
+{
+	*out = stats;
+	out->nodes = count;
+}
+
+
+void node_cache::get_shared_stats(node_cache_stats_t* out, uint64_t* capacity)
+{
+	sgx_thread_mutex_lock(&g_shared.mutex);
+	out->hits = __atomic_load_n(&g_shared.stats.hits, __ATOMIC_RELAXED);
+	out->misses = __atomic_load_n(&g_shared.stats.misses, __ATOMIC_RELAXED);
+	out->evictions = g_shared.stats.evictions;
+	out->nodes = g_shared.stats.nodes;
+	*capacity = g_shared.capacity;
+	sgx_thread_mutex_unlock(&g_shared.mutex);
+}
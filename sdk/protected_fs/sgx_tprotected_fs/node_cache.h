@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#pragma once
+
+#ifndef _NODE_CACHE_H_
+#define _NODE_CACHE_H_
+
+#include <stdint.h>
+#include <sgx_thread.h>
+
+/* All the open files share one pool of cached nodes. Its size is the sum of the cache sizes
+   the files were opened with, so a busy file can use the pages an idle file does not need.
+   Replacement is a segmented LRU (2Q without the ghost queue): new nodes enter the probation
+   segment and move to the protected segment on their second hit, so a long sequential scan
+   only recycles probation nodes and does not push the hot nodes out. Hits on protected nodes
+   only set a reference bit (CLOCK style), so the shared mutex is taken to insert, evict and
+   promote nodes, but not on every hit.
+   A node may be evicted by any file, but only when it is clean, has no cached children
+   (they point to it) and its file is not in the middle of an operation (its mutex is free). */
+
+class node_cache;
+
+/* Intrusive cache header, must be the first member of every cached node */
+typedef struct _cache_node
+{
+	uint64_t key;
+	node_cache* owner;
+	struct _cache_node* parent;     // pinned as long as this node is cached
+	struct _cache_node* hash_next;  // owner's hash chain
+	struct _cache_node* file_prev;  // owner's node list
+	struct _cache_node* file_next;
+	struct _cache_node* lru_prev;   // shared replacement list
+	struct _cache_node* lru_next;
+	uint32_t children;              // cached nodes that have this node as parent
+	uint8_t segment;
+	uint8_t prefetched;             // read ahead and not used yet
+	uint8_t referenced;             // hit while protected, gets a second chance before demotion
+} cache_node_t;
+
+typedef bool (*cache_node_evictable_t)(const void* data);
+typedef void (*cache_node_release_t)(void* data);
+
+typedef struct _node_cache_stats
+{
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t evictions;
+	uint64_t nodes;
+} node_cache_stats_t;
+
+class node_cache
+{
+private:
+	sgx_thread_mutex_t* owner_mutex;
+	cache_node_evictable_t evictable;
+	cache_node_release_t release;
+
+	cache_node_t** buckets;
+	uint32_t bucket_mask;
+	uint32_t max_pages; // this file's share of the shared pool
+
+	cache_node_t* head; // newest node first
+	cache_node_t* m_it; // for get_first and get_next sequence
+	uint32_t count;
+
+	node_cache_stats_t stats;
+
+	void grow_buckets();
+	cache_node_t* lookup(uint64_t key);
+	void unlink(cache_node_t* node);
+
+public:
+	node_cache();
+	~node_cache();
+
+	void init(uint32_t max_pages_, sgx_thread_mutex_t* owner_mutex_, cache_node_evictable_t evictable_, cache_node_release_t release_);
+
+	bool add(uint64_t key, void* data, void* parent, bool prefetched = false);
+	void* get(uint64_t key);
+	void* find(uint64_t key); // only returns the object, do not bump it in the lru
+	bool contains(uint64_t key); // like find, but not counted in the statistics
+	void touch(void* data);   // bump an object already held by the caller
+	void remove(void* data);
+	uint32_t size();
+
+	void* get_first();
+	void* get_next();
+
+	bool over_limit();
+	bool evict_one(const void* keep);
+
+	void get_stats(node_cache_stats_t* out);
+	static void get_shared_stats(node_cache_stats_t* out, uint64_t* capacity);
+};
+
+#endif // _NODE_CACHE_H_
@@ -35,7 +35,7 @@
 #define _PROTECTED_FS_H_
 
 #include "protected_fs_nodes.h"
-#include "lru_cache.h"
+#include "node_cache.h"
 #include "sgx_error.h"
 #include "sgx_tcrypto.h"
 #include "errno.h"
@@ -96,6 +96,10 @@ typedef struct _thread_input
 } thread_input_t;
 
 
+#define READ_AHEAD_MAX_NODES       32 // never more than a quarter of the file's cache share
+#define READ_AHEAD_SEQUENTIAL_READS 2  // back to back reads before the access is seen as sequential
+
+
 #define FILE_MHT_NODE_TYPE  1
 #define FILE_DATA_NODE_TYPE 2
 
@@ -113,6 +117,7 @@ the following 2 structures are almost identical, i do not merge them (union or c
 typedef struct _file_mht_node
 {
 	/* these are exactly the same as file_data_node_t below, any change should apply to both (both are saved in the cache as void*) */
+	cache_node_t cache_node; // must be first, the cache links the nodes through it
 	uint8_t type;
 	uint64_t mht_node_number;
 	struct _file_mht_node* parent;
@@ -127,6 +132,7 @@ typedef struct _file_mht_node
 typedef struct _file_data_node
 {
 	/* these are exactly the same as file_mht_node_t above, any change should apply to both (both are saved in the cache as void*) */
+	cache_node_t cache_node; // must be first, the cache links the nodes through it
 	uint8_t type;
 	uint64_t data_node_number;
 	file_mht_node_t* parent;
@@ -138,6 +144,28 @@ typedef struct _file_data_node
 } file_data_node_t;
 
 
+typedef struct _read_ahead_node
+{
+	file_data_node_t* node;
+	uint8_t encrypted[NODE_SIZE]; // copy of the node from the untrusted memory, for TOCTOU
+	sgx_status_t status;
+} read_ahead_node_t;
+
+
+typedef struct _read_ahead_input
+{
+	read_ahead_node_t* nodes;
+	uint32_t first;
+	uint32_t step;
+	uint32_t count;
+	uint8_t* empty_iv;
+} read_ahead_input_t;
+
+
+void get_node_numbers(uint64_t offset, uint64_t* mht_node_number, uint64_t* data_node_number,
+					  uint64_t* physical_mht_node_number, uint64_t* physical_data_node_number);
+
+
 class protected_fs_file
 {
 private:
@@ -168,6 +196,10 @@ private:
 
 	uint32_t parallel_flush_level;
 
+	int32_t read_advice; // SGX_FADV_*
+	int64_t last_read_end; // for sequential access detection
+	uint32_t sequential_reads;
+
 	uint8_t use_user_kdk_key;
 	sgx_aes_gcm_128bit_key_t user_kdk_key; // recieved from user, used instead of the seal key
 
@@ -178,7 +210,7 @@ private:
 	char file_name[FULLNAME_MAX_LEN]; // used for u_sgxprotectedfs_file_remap
 	char recovery_filename[RECOVERY_FILE_MAX_LEN]; // might include full path to the file
 
-	lru_cache cache;
+	node_cache cache;
 
 	// these don't change after init...
 	sgx_iv_t empty_iv;
@@ -200,6 +232,8 @@ private:
 	
 	
 	file_data_node_t* get_data_node();
+	uint32_t read_ahead_nodes(size_t data_left_to_read);
+	void read_ahead(uint32_t nodes_count);
 	file_data_node_t* read_data_node();
 	file_data_node_t* append_data_node();
 	file_mht_node_t* get_mht_node();
@@ -214,6 +248,9 @@ private:
 	void erase_recovery_file();
 	bool internal_flush();
 
+	static bool node_evictable(const void* data);
+	static void release_node(void* data);
+
 public:
 	protected_fs_file(const char* filename, const char* mode, const sgx_aes_gcm_128bit_key_t* import_key, const sgx_aes_gcm_128bit_key_t* kdk_key, const uint32_t cache_page);
 	~protected_fs_file();
@@ -223,10 +260,12 @@ public:
 	int64_t tell();
 	int seek(int64_t new_offset, int origin);
 	int32_t set_parallel_flush_level(uint32_t max_threads_number);
+	int32_t advise(int32_t advice);
 	bool get_eof();
 	uint32_t get_error();
 	void clear_error();
 	int32_t clear_cache();
+	int32_t get_stats(sgx_fstats_t* stats);
 	bool flush();
 	bool pre_close(sgx_key_128bit_t* key, bool import);
 	static int32_t remove(const char* filename);
@@ -145,6 +145,20 @@ int32_t sgx_fset_parallel_level(SGX_FILE* stream, uint32_t max_threads_number)
 }
 
 
+int32_t sgx_fadvise(SGX_FILE* stream, int32_t advice)
+{
+	if (stream == NULL)
+	{
+		errno = EINVAL;
+		return 1;
+	}
+
+	protected_fs_file* file = (protected_fs_file*)stream;
+
+	return file->advise(advice);
+}
+
+
 int32_t sgx_fflush(SGX_FILE* stream)
 {
 	if (stream == NULL)
@@ -248,3 +262,17 @@ int32_t sgx_fclear_cache(SGX_FILE* stream)
 
 	return file->clear_cache();
 }
+
+
+int32_t sgx_fget_stats(SGX_FILE* stream, sgx_fstats_t* stats)
+{
+	if (stream == NULL || stats == NULL)
+	{
+		errno = EINVAL;
+		return 1;
+	}
+
+	protected_fs_file* file = (protected_fs_file*)stream;
+
+	return file->get_stats(stats);
+}
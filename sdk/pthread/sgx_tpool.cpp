@@ -0,0 +1,518 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include "util.h"
+
+#include "sgx_trts.h"
+#include "sgx_spinlock.h"
+#include "sgx_thread.h"
+#include "sgx_tpool.h"
+
+#define TPOOL_CACHE_LINE    64
+/* Rounds of looking for work before an idle or waiting thread goes to sleep */
+#define TPOOL_IDLE_SPINS    2048
+
+#define TPOOL_STOPPED       0
+#define TPOOL_RUNNING       1
+#define TPOOL_STOPPING      2
+
+typedef struct _tpool_task_t
+{
+    sgx_tpool_fn_t      fn;
+    void                *arg;
+    sgx_tpool_group_t   *group;
+} tpool_task_t;
+
+/* Chase-Lev work stealing deque. The owner pushes and takes at the bottom,
+ * other threads steal from the top. Tasks are stored by value: a thief
+ * reads the slot before claiming it with the CAS on top, and the owner
+ * can't reuse that slot until top has moved past it.
+ */
+typedef struct _tpool_worker_t
+{
+    volatile int64_t    top __attribute__((aligned(TPOOL_CACHE_LINE)));
+    volatile int64_t    bottom __attribute__((aligned(TPOOL_CACHE_LINE)));
+    tpool_task_t        tasks[SGX_TPOOL_DEQUE_SIZE] __attribute__((aligned(TPOOL_CACHE_LINE)));
+    pthread_t           thread;
+    uint32_t            index;
+} tpool_worker_t;
+
+/* Destroy must not free g_workers under a thread that reads it, nor let a
+ * task be queued after its final drain. Only workers push to or steal from
+ * the deques, and destroy joins them before it frees anything. Other threads
+ * only use the shared queue, which stops taking tasks once destroy has
+ * changed the state under the queue lock. So submitting and stealing need
+ * no shared counter to keep the pool alive.
+ */
+static sgx_thread_mutex_t g_tpool_mutex = SGX_THREAD_MUTEX_INITIALIZER;   /* serializes init and destroy */
+static tpool_worker_t *g_workers = NULL;
+static uint32_t g_worker_count = 0;
+static volatile uint32_t g_tpool_state = TPOOL_STOPPED;
+
+/* Shared queue for tasks submitted by threads that are not workers */
+static sgx_spinlock_t g_queue_lock = SGX_SPINLOCK_INITIALIZER;
+static tpool_task_t g_queue[SGX_TPOOL_QUEUE_SIZE];
+static size_t g_queue_head = 0;
+static size_t g_queue_count = 0;
+
+/* Idle workers and waiting threads sleep on the condition. Submitters and
+ * finished groups only take the mutex when someone sleeps.
+ */
+static sgx_thread_mutex_t g_park_mutex = SGX_THREAD_MUTEX_INITIALIZER;
+static sgx_thread_cond_t g_park_cond = SGX_THREAD_COND_INITIALIZER;
+static uint64_t g_park_epoch = 0;   /* bumped under g_park_mutex when a task is queued */
+static volatile uint32_t g_sleepers = 0;
+
+static __thread tpool_worker_t *t_worker = NULL;
+static __thread uint32_t t_steal_seed = 0;
+
+static inline void tpool_pause(void)
+{
+    __asm__ __volatile__("pause" : : : "memory");
+}
+
+static inline void task_store(tpool_task_t *slot, const tpool_task_t *task)
+{
+    __atomic_store_n(&slot->fn, task->fn, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->arg, task->arg, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->group, task->group, __ATOMIC_RELAXED);
+}
+
+static inline void task_load(tpool_task_t *task, tpool_task_t *slot)
+{
+    task->fn = __atomic_load_n(&slot->fn, __ATOMIC_RELAXED);
+    task->arg = __atomic_load_n(&slot->arg, __ATOMIC_RELAXED);
+    task->group = __atomic_load_n(&slot->group, __ATOMIC_RELAXED);
+}
+
+/* Called by the owner only */
+static bool deque_push(tpool_worker_t *worker, const tpool_task_t *task)
+{
+    int64_t b = __atomic_load_n(&worker->bottom, __ATOMIC_RELAXED);
+    int64_t t = __atomic_load_n(&worker->top, __ATOMIC_ACQUIRE);
+    if (b - t >= SGX_TPOOL_DEQUE_SIZE)
+        return false;
+
+    task_store(&worker->tasks[b % SGX_TPOOL_DEQUE_SIZE], task);
+    __atomic_store_n(&worker->bottom, b + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+/* Called by the owner only */
+static bool deque_take(tpool_worker_t *worker, tpool_task_t *task)
+{
+    int64_t b = __atomic_load_n(&worker->bottom, __ATOMIC_RELAXED) - 1;
+    __atomic_store_n(&worker->bottom, b, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t t = __atomic_load_n(&worker->top, __ATOMIC_RELAXED);
+
+    if (t > b) {
+        /* empty */
+        __atomic_store_n(&worker->bottom, b + 1, __ATOMIC_RELAXED);
+        return false;
+    }
+
+    task_load(task, &worker->tasks[b % SGX_TPOOL_DEQUE_SIZE]);
+    if (t == b) {
+        /* last task, race the thieves for it */
+        bool won = __atomic_compare_exchange_n(&worker->top, &t, t + 1,
+                false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+        __atomic_store_n(&worker->bottom, b + 1, __ATOMIC_RELAXED);
+        return won;
+    }
+    return true;
+}
+
+static bool deque_steal(tpool_worker_t *worker, tpool_task_t *task)
+{
+    int64_t t = __atomic_load_n(&worker->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t b = __atomic_load_n(&worker->bottom, __ATOMIC_ACQUIRE);
+    if (t >= b)
+        return false;
+
+    task_load(task, &worker->tasks[t % SGX_TPOOL_DEQUE_SIZE]);
+    return __atomic_compare_exchange_n(&worker->top, &t, t + 1,
+            false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+}
+
+/* Fails once destroy has begun, see sgx_tpool_destroy() */
+static bool queue_push(const tpool_task_t *task)
+{
+    bool pushed = false;
+    sgx_spin_lock(&g_queue_lock);
+    if (__atomic_load_n(&g_tpool_state, __ATOMIC_RELAXED) == TPOOL_RUNNING
+            && g_queue_count < SGX_TPOOL_QUEUE_SIZE) {
+        g_queue[(g_queue_head + g_queue_count) % SGX_TPOOL_QUEUE_SIZE] = *task;
+        /* read outside the lock by queue_pop() and has_task() */
+        __atomic_store_n(&g_queue_count, g_queue_count + 1, __ATOMIC_RELAXED);
+        pushed = true;
+    }
+    sgx_spin_unlock(&g_queue_lock);
+    return pushed;
+}
+
+static bool queue_pop(tpool_task_t *task)
+{
+    if (__atomic_load_n(&g_queue_count, __ATOMIC_RELAXED) == 0)
+        return false;
+
+    bool popped = false;
+    sgx_spin_lock(&g_queue_lock);
+    if (g_queue_count != 0) {
+        *task = g_queue[g_queue_head];
+        g_queue_head = (g_queue_head + 1) % SGX_TPOOL_QUEUE_SIZE;
+        __atomic_store_n(&g_queue_count, g_queue_count - 1, __ATOMIC_RELAXED);
+        popped = true;
+    }
+    sgx_spin_unlock(&g_queue_lock);
+    return popped;
+}
+
+/* Own deque first, then the shared queue, then steal from a random victim.
+ * Threads that are not workers only look at the shared queue.
+ */
+static bool find_task(tpool_task_t *task)
+{
+    tpool_worker_t *self = t_worker;
+    if (self != NULL && deque_take(self, task))
+        return true;
+
+    if (queue_pop(task))
+        return true;
+
+    if (self == NULL)
+        return false;
+
+    uint32_t count = __atomic_load_n(&g_worker_count, __ATOMIC_ACQUIRE);
+    uint32_t seed = t_steal_seed;
+    if (seed == 0)
+        seed = (uint32_t)(size_t)&t_steal_seed | 1;
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    t_steal_seed = seed;
+
+    for (uint32_t i = 0; i < count; i++) {
+        tpool_worker_t *victim = &g_workers[(seed + i) % count];
+        if (victim != self && deque_steal(victim, task))
+            return true;
+    }
+    return false;
+}
+
+/* Whether find_task() may find something, without taking it */
+static bool has_task(void)
+{
+    if (__atomic_load_n(&g_queue_count, __ATOMIC_SEQ_CST) != 0)
+        return true;
+    if (t_worker == NULL)
+        return false;
+
+    uint32_t count = __atomic_load_n(&g_worker_count, __ATOMIC_ACQUIRE);
+    for (uint32_t i = 0; i < count; i++) {
+        tpool_worker_t *worker = &g_workers[i];
+        if (__atomic_load_n(&worker->top, __ATOMIC_SEQ_CST)
+                < __atomic_load_n(&worker->bottom, __ATOMIC_SEQ_CST))
+            return true;
+    }
+    return false;
+}
+
+/* Called after a task was queued or a group finished. The fence pairs with
+ * the sleeper count in tpool_sleep(): either the sleeper sees the change or
+ * we see the sleeper. All sleepers are woken, as a thread waiting for a
+ * group may return without looking for the new task.
+ */
+static void wake_sleepers(bool queued)
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&g_sleepers, __ATOMIC_RELAXED) == 0)
+        return;
+
+    sgx_thread_mutex_lock(&g_park_mutex);
+    if (queued)
+        g_park_epoch++;
+    sgx_thread_cond_broadcast(&g_park_cond);
+    sgx_thread_mutex_unlock(&g_park_mutex);
+}
+
+/* Sleep until a task is queued, and until the pool stops when 'group' is
+ * NULL or 'group' finishes otherwise.
+ */
+static void tpool_sleep(sgx_tpool_group_t *group)
+{
+    sgx_thread_mutex_lock(&g_park_mutex);
+    uint64_t epoch = g_park_epoch;
+    __atomic_add_fetch(&g_sleepers, 1, __ATOMIC_SEQ_CST);
+    if (!has_task()) {
+        while (g_park_epoch == epoch
+                && (group == NULL
+                    ? __atomic_load_n(&g_tpool_state, __ATOMIC_ACQUIRE) == TPOOL_RUNNING
+                    : __atomic_load_n(&group->m_pending, __ATOMIC_SEQ_CST) != 0))
+            sgx_thread_cond_wait(&g_park_cond, &g_park_mutex);
+    }
+    __atomic_sub_fetch(&g_sleepers, 1, __ATOMIC_RELAXED);
+    sgx_thread_mutex_unlock(&g_park_mutex);
+}
+
+static void run_task(const tpool_task_t *task)
+{
+    task->fn(task->arg);
+    /* the group may be gone once its count is zero */
+    if (task->group != NULL
+            && __atomic_sub_fetch(&task->group->m_pending, 1, __ATOMIC_SEQ_CST) == 0)
+        wake_sleepers(false);
+}
+
+/* Queue a task on the pool, false if it is not running or full. A worker
+ * pushes to its own deque, anyone else to the shared queue.
+ */
+static bool tpool_push(const tpool_task_t *task)
+{
+    tpool_worker_t *self = t_worker;
+    if ((self != NULL && deque_push(self, task)) || queue_push(task)) {
+        wake_sleepers(true);
+        return true;
+    }
+    return false;
+}
+
+static void tpool_wait(sgx_tpool_group_t *group)
+{
+    tpool_task_t task;
+    uint32_t idle = 0;
+    while (__atomic_load_n(&group->m_pending, __ATOMIC_ACQUIRE) != 0) {
+        if (find_task(&task)) {
+            run_task(&task);
+            idle = 0;
+        } else if (++idle < TPOOL_IDLE_SPINS) {
+            tpool_pause();
+        } else {
+            tpool_sleep(group);
+            idle = 0;
+        }
+    }
+}
+
+static void *tpool_worker(void *arg)
+{
+    t_worker = (tpool_worker_t *)arg;
+
+    tpool_task_t task;
+    uint32_t idle = 0;
+    while (1) {
+        if (find_task(&task)) {
+            run_task(&task);
+            idle = 0;
+            continue;
+        }
+        if (__atomic_load_n(&g_tpool_state, __ATOMIC_ACQUIRE) != TPOOL_RUNNING)
+            break;
+        if (++idle < TPOOL_IDLE_SPINS) {
+            tpool_pause();
+            continue;
+        }
+        tpool_sleep(NULL);
+        idle = 0;
+    }
+
+    t_worker = NULL;
+    return NULL;
+}
+
+int sgx_tpool_init(unsigned int workers)
+{
+    if (workers == 0 || workers > SGX_TPOOL_MAX_WORKERS)
+        return EINVAL;
+
+    sgx_thread_mutex_lock(&g_tpool_mutex);
+    if (g_tpool_state != TPOOL_STOPPED) {
+        sgx_thread_mutex_unlock(&g_tpool_mutex);
+        return EBUSY;
+    }
+
+    tpool_worker_t *pool = (tpool_worker_t *)memalign(TPOOL_CACHE_LINE, workers * sizeof(tpool_worker_t));
+    if (pool == NULL) {
+        sgx_thread_mutex_unlock(&g_tpool_mutex);
+        return ENOMEM;
+    }
+    memset(pool, 0, workers * sizeof(tpool_worker_t));
+    for (uint32_t i = 0; i < workers; i++)
+        pool[i].index = i;
+
+    g_workers = pool;
+    __atomic_store_n(&g_tpool_state, TPOOL_RUNNING, __ATOMIC_RELEASE);
+
+    int ret = 0;
+    uint32_t created = 0;
+    for (; created < workers; created++) {
+        /* Thieves only look at workers that exist */
+        __atomic_store_n(&g_worker_count, created + 1, __ATOMIC_RELEASE);
+        ret = pthread_create(&pool[created].thread, NULL, tpool_worker, &pool[created]);
+        if (ret != 0)
+            break;
+    }
+    __atomic_store_n(&g_worker_count, created, __ATOMIC_RELEASE);
+
+    if (created == 0) {
+        __atomic_store_n(&g_tpool_state, TPOOL_STOPPED, __ATOMIC_RELEASE);
+        g_workers = NULL;
+        free(pool);
+        sgx_thread_mutex_unlock(&g_tpool_mutex);
+        return ret;
+    }
+
+    sgx_thread_mutex_unlock(&g_tpool_mutex);
+    return 0;
+}
+
+int sgx_tpool_submit(sgx_tpool_group_t *group, sgx_tpool_fn_t fn, void *arg)
+{
+    if (fn == NULL || !sgx_is_within_enclave((void *)fn, sizeof(void *)))
+        return EINVAL;
+    if (group != NULL && !sgx_is_within_enclave(group, sizeof(*group)))
+        return EINVAL;
+
+    tpool_task_t task = {fn, arg, group};
+    if (group != NULL)
+        __atomic_add_fetch(&group->m_pending, 1, __ATOMIC_SEQ_CST);
+
+    if (!tpool_push(&task))
+        run_task(&task);
+    return 0;
+}
+
+int sgx_tpool_wait(sgx_tpool_group_t *group)
+{
+    if (group == NULL || !sgx_is_within_enclave(group, sizeof(*group)))
+        return EINVAL;
+
+    tpool_wait(group);
+    return 0;
+}
+
+typedef struct _tpool_range_t
+{
+    sgx_tpool_range_fn_t    fn;
+    void                    *arg;
+    size_t                  begin;
+    size_t                  end;
+    size_t                  grain;
+} tpool_range_t;
+
+/* Queue the upper half of the range and split the lower half again, down to
+ * single chunks. Thieves take the oldest, largest halves and split them in
+ * their own deques, so the range spreads over the pool in log(chunks) steps.
+ * Each upper half lives in the frame that waits for it.
+ */
+static void run_range(void *arg)
+{
+    const tpool_range_t *range = (const tpool_range_t *)arg;
+    size_t chunks = (range->end - range->begin - 1) / range->grain + 1;
+    if (chunks == 1) {
+        range->fn(range->begin, range->end, range->arg);
+        return;
+    }
+
+    size_t mid = range->begin + chunks / 2 * range->grain;
+    tpool_range_t upper = {range->fn, range->arg, mid, range->end, range->grain};
+    tpool_range_t lower = {range->fn, range->arg, range->begin, mid, range->grain};
+    sgx_tpool_group_t group = {1};
+    tpool_task_t task = {run_range, &upper, &group};
+    bool queued = tpool_push(&task);
+
+    run_range(&lower);
+    if (queued)
+        tpool_wait(&group);
+    else
+        run_range(&upper);
+}
+
+int sgx_tpool_parallel_for(size_t begin, size_t end, size_t grain,
+                           sgx_tpool_range_fn_t fn, void *arg)
+{
+    if (begin > end || grain == 0
+            || fn == NULL || !sgx_is_within_enclave((void *)fn, sizeof(void *)))
+        return EINVAL;
+    if (begin == end)
+        return 0;
+
+    tpool_range_t range = {fn, arg, begin, end, grain};
+    run_range(&range);
+    return 0;
+}
+
+int sgx_tpool_destroy(void)
+{
+    if (t_worker != NULL)
+        return EINVAL;
+
+    sgx_thread_mutex_lock(&g_tpool_mutex);
+    if (g_tpool_state != TPOOL_RUNNING) {
+        sgx_thread_mutex_unlock(&g_tpool_mutex);
+        return EINVAL;
+    }
+
+    /* From here on the shared queue refuses tasks and they run inline.
+     * Workers drain their deques and the queue before they see the state
+     * and leave.
+     */
+    sgx_spin_lock(&g_queue_lock);
+    __atomic_store_n(&g_tpool_state, TPOOL_STOPPING, __ATOMIC_SEQ_CST);
+    sgx_spin_unlock(&g_queue_lock);
+
+    sgx_thread_mutex_lock(&g_park_mutex);
+    sgx_thread_cond_broadcast(&g_park_cond);
+    sgx_thread_mutex_unlock(&g_park_mutex);
+
+    for (uint32_t i = 0; i < g_worker_count; i++)
+        pthread_join(g_workers[i].thread, NULL);
+
+    /* A worker may have left before a task queued just ahead of the state
+     * change was visible to it
+     */
+    tpool_task_t task;
+    while (queue_pop(&task))
+        run_task(&task);
+
+    __atomic_store_n(&g_worker_count, 0, __ATOMIC_RELEASE);
+    free(g_workers);
+    g_workers = NULL;
+    __atomic_store_n(&g_tpool_state, TPOOL_STOPPED, __ATOMIC_RELEASE);
+
+    sgx_thread_mutex_unlock(&g_tpool_mutex);
+    return 0;
+}
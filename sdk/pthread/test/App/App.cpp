@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Runtime test of the trusted worker pool in libsgx_pthread: parallel_for
+ * coverage with and without a pool, nested groups inside tasks, pool
+ * init/destroy while other TCSs submit and wait, destroy running the
+ * queued tasks, and a waiter sleeping instead of spinning on a long task.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <sgx_urts.h>
+#include "Enclave_u.h"
+
+#define ENCLAVE_FILENAME    "enclave.signed.so"
+#define TEST_SUBMITTERS     4
+#define TEST_CYCLES         3000
+#define TEST_LONG_TASK_MS   500
+
+static int failures = 0;
+
+static void expect(bool ok, const char *what)
+{
+    printf("%-56s %s\n", what, ok ? "ok" : "FAILED");
+    if (!ok)
+        failures++;
+}
+
+/* OCall functions */
+void ocall_print_string(const char *str)
+{
+    printf("%s", str);
+}
+
+static double thread_cpu_ms(pthread_t thread)
+{
+    clockid_t clock;
+    struct timespec ts;
+    if (pthread_getcpuclockid(thread, &clock) != 0 || clock_gettime(clock, &ts) != 0)
+        return -1;
+    return (double)ts.tv_sec * 1000 + (double)ts.tv_nsec / 1000000;
+}
+
+int SGX_CDECL main(int argc, char *argv[])
+{
+    (void)argc;
+    (void)argv;
+
+    sgx_enclave_id_t eid = 0;
+    sgx_status_t status = sgx_create_enclave(ENCLAVE_FILENAME, SGX_DEBUG_FLAG, NULL, NULL, &eid, NULL);
+    if (status != SGX_SUCCESS) {
+        printf("Error: sgx_create_enclave failed (0x%x).\n", status);
+        return -1;
+    }
+
+    int ret = -1;
+    expect(ecall_parallel_for(eid, &ret, 0, 100000, 64) == SGX_SUCCESS && ret == 0,
+           "parallel_for without a pool");
+    expect(ecall_parallel_for(eid, &ret, 4, 100000, 64) == SGX_SUCCESS && ret == 0,
+           "parallel_for, 4 workers");
+    expect(ecall_parallel_for(eid, &ret, 4, 100001, 1) == SGX_SUCCESS && ret == 0,
+           "parallel_for, grain 1");
+    expect(ecall_nested(eid, &ret, 4, 256) == SGX_SUCCESS && ret == 0,
+           "nested parallel_for and groups in tasks");
+    expect(ecall_destroy_drains(eid, &ret, 2, 1000) == SGX_SUCCESS && ret == 0,
+           "destroy runs the queued tasks");
+
+    /* Non-workers submit and wait while the pool starts and stops under
+     * them, so their tasks go to the pool or run inline.
+     */
+    std::atomic<bool> stop(false);
+    std::vector<std::thread> threads;
+    std::vector<int> results(TEST_SUBMITTERS, 0);
+    for (int i = 0; i < TEST_SUBMITTERS; i++) {
+        threads.push_back(std::thread([&, i] {
+            while (!stop.load() && results[i] == 0) {
+                int r = -1;
+                if (ecall_submit_wait(eid, &r, 10) != SGX_SUCCESS || r != 0)
+                    results[i] = -1;
+            }
+        }));
+    }
+    bool ok = true;
+    for (unsigned int c = 0; c < TEST_CYCLES && ok; c++)
+        ok = ecall_init_destroy(eid, &ret, 1 + c % 4) == SGX_SUCCESS && ret == 0;
+    stop = true;
+    for (int i = 0; i < TEST_SUBMITTERS; i++) {
+        threads[i].join();
+        ok = ok && results[i] == 0;
+    }
+    expect(ok, "init/destroy while other TCSs submit and wait");
+
+    std::thread waiter([&] {
+        if (ecall_wait_long_task(eid, &ret) != SGX_SUCCESS)
+            ret = -1;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(TEST_LONG_TASK_MS));
+    double cpu = thread_cpu_ms(waiter.native_handle());
+    ecall_release_long_task(eid);
+    waiter.join();
+    expect(ret == 0, "wait returns when a long task finishes");
+    printf("waiter cpu time: %.1f ms of %d ms\n", cpu, TEST_LONG_TASK_MS);
+    expect(cpu >= 0 && cpu < TEST_LONG_TASK_MS / 4, "waiter sleeps instead of spinning");
+
+    sgx_destroy_enclave(eid);
+
+    printf("%s\n", failures == 0 ? "PASSED" : "FAILED");
+    return failures == 0 ? 0 : 1;
+}
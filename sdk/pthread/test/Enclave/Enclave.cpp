@@ -0,0 +1,214 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <stdarg.h>
+#include <stdio.h> /* vsnprintf */
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "sgx_tpool.h"
+#include "Enclave_t.h"
+
+#define TEST_INNER_COUNT    100
+#define TEST_INNER_GRAIN    7
+
+int printf(const char* fmt, ...)
+{
+    char buf[BUFSIZ] = { '\0' };
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(buf, BUFSIZ, fmt, ap);
+    va_end(ap);
+    ocall_print_string(buf);
+    return (int)strnlen(buf, BUFSIZ - 1) + 1;
+}
+
+typedef struct _mark_ctx_t
+{
+    uint8_t     *seen;
+    size_t      grain;
+    size_t      bad_chunks;
+} mark_ctx_t;
+
+/* Counts every index it is given, and the chunks that are not one grain
+ * aligned to the start of the range or its last, shorter part.
+ */
+static void mark_range(size_t begin, size_t end, void *arg)
+{
+    mark_ctx_t *ctx = (mark_ctx_t *)arg;
+    if (begin % ctx->grain != 0 || end - begin > ctx->grain)
+        __atomic_add_fetch(&ctx->bad_chunks, 1, __ATOMIC_RELAXED);
+    for (size_t i = begin; i < end; i++)
+        __atomic_add_fetch(&ctx->seen[i], 1, __ATOMIC_RELAXED);
+}
+
+static void add_one(void *arg)
+{
+    __atomic_add_fetch((size_t *)arg, 1, __ATOMIC_RELAXED);
+}
+
+static void add_range(size_t begin, size_t end, void *arg)
+{
+    __atomic_add_fetch((size_t *)arg, end - begin, __ATOMIC_RELAXED);
+}
+
+/* Each index runs a parallel_for and a group of tasks of its own from
+ * inside a task, so workers wait for nested work they may have to steal.
+ */
+static void nested_range(size_t begin, size_t end, void *arg)
+{
+    size_t *failures = (size_t *)arg;
+    for (size_t i = begin; i < end; i++) {
+        size_t sum = 0, count = 0;
+        sgx_tpool_parallel_for(0, TEST_INNER_COUNT, TEST_INNER_GRAIN, add_range, &sum);
+
+        sgx_tpool_group_t group = SGX_TPOOL_GROUP_INITIALIZER;
+        for (size_t j = 0; j < TEST_INNER_COUNT; j++)
+            sgx_tpool_submit(&group, add_one, &count);
+        sgx_tpool_wait(&group);
+
+        if (sum != TEST_INNER_COUNT || count != TEST_INNER_COUNT)
+            __atomic_add_fetch(failures, 1, __ATOMIC_RELAXED);
+    }
+}
+
+/* 'workers' 0 runs without a pool, where every task runs inline */
+int ecall_parallel_for(unsigned int workers, uint32_t count, uint32_t grain)
+{
+    if (workers != 0 && sgx_tpool_init(workers) != 0)
+        return -1;
+
+    int ret = -1;
+    mark_ctx_t ctx = {(uint8_t *)calloc(count, 1), grain, 0};
+    if (ctx.seen != NULL && sgx_tpool_parallel_for(0, count, grain, mark_range, &ctx) == 0) {
+        ret = ctx.bad_chunks == 0 ? 0 : -1;
+        for (uint32_t i = 0; i < count; i++) {
+            if (ctx.seen[i] != 1)
+                ret = -1;
+        }
+    }
+    free(ctx.seen);
+
+    if (workers != 0 && sgx_tpool_destroy() != 0)
+        ret = -1;
+    return ret;
+}
+
+int ecall_nested(unsigned int workers, uint32_t count)
+{
+    if (sgx_tpool_init(workers) != 0)
+        return -1;
+
+    size_t failures = 0;
+    int ret = sgx_tpool_parallel_for(0, count, 1, nested_range, &failures);
+    if (sgx_tpool_destroy() != 0)
+        ret = -1;
+    return ret == 0 && failures == 0 ? 0 : -1;
+}
+
+int ecall_init_destroy(unsigned int workers)
+{
+    return ecall_nested(workers, 8);
+}
+
+/* Runs on threads that are not workers while the pool starts and stops */
+int ecall_submit_wait(uint32_t rounds)
+{
+    int ret = 0;
+    for (uint32_t r = 0; r < rounds; r++) {
+        size_t count = 0;
+        sgx_tpool_group_t group = SGX_TPOOL_GROUP_INITIALIZER;
+        for (size_t j = 0; j < TEST_INNER_COUNT; j++)
+            sgx_tpool_submit(&group, add_one, &count);
+        sgx_tpool_wait(&group);
+        if (count != TEST_INNER_COUNT)
+            ret = -1;
+
+        size_t sum = 0;
+        sgx_tpool_parallel_for(3, 3 + TEST_INNER_COUNT * 10, TEST_INNER_GRAIN, add_range, &sum);
+        if (sum != TEST_INNER_COUNT * 10)
+            ret = -1;
+    }
+    return ret;
+}
+
+/* Tasks still queued when the pool is destroyed run before it returns */
+int ecall_destroy_drains(unsigned int workers, uint32_t tasks)
+{
+    if (sgx_tpool_init(workers) != 0)
+        return -1;
+
+    size_t count = 0;
+    for (uint32_t i = 0; i < tasks; i++)
+        sgx_tpool_submit(NULL, add_one, &count);
+    if (sgx_tpool_destroy() != 0)
+        return -1;
+    return __atomic_load_n(&count, __ATOMIC_RELAXED) == tasks ? 0 : -1;
+}
+
+static volatile int g_started = 0;
+static volatile int g_release = 0;
+
+static void long_task(void *arg)
+{
+    (void)arg;
+    __atomic_store_n(&g_started, 1, __ATOMIC_RELEASE);
+    while (__atomic_load_n(&g_release, __ATOMIC_ACQUIRE) == 0)
+        __asm__ __volatile__("pause" : : : "memory");
+}
+
+/* Waits for a task that runs until ecall_release_long_task(), once per
+ * enclave
+ */
+int ecall_wait_long_task(void)
+{
+    if (sgx_tpool_init(1) != 0)
+        return -1;
+
+    sgx_tpool_group_t group = SGX_TPOOL_GROUP_INITIALIZER;
+    int ret = sgx_tpool_submit(&group, long_task, NULL);
+    /* Leave the task to the worker, the waiting thread would otherwise
+     * take it from the shared queue and run it itself.
+     */
+    while (ret == 0 && __atomic_load_n(&g_started, __ATOMIC_ACQUIRE) == 0)
+        __asm__ __volatile__("pause" : : : "memory");
+    if (ret == 0)
+        ret = sgx_tpool_wait(&group);
+    if (sgx_tpool_destroy() != 0)
+        ret = -1;
+    return ret == 0 ? 0 : -1;
+}
+
+void ecall_release_long_task(void)
+{
+    __atomic_store_n(&g_release, 1, __ATOMIC_RELEASE);
+}
@@ -53,6 +53,10 @@
 #include <openssl/err.h>
 
 #define DATA_BLOCK_SIZE 64
+#define EEXTEND_SIZE    256
+/* EADD block, plus one EEXTEND block and 256 bytes of data per 256-byte chunk */
+#define PAGE_RECORD_SIZE (DATA_BLOCK_SIZE + (SE_PAGE_SIZE / EEXTEND_SIZE) * (DATA_BLOCK_SIZE + EEXTEND_SIZE))
+
 #define EID             0x44444444
 
 uint64_t enclave_image_address = 0;
@@ -130,17 +134,51 @@ int EnclaveCreatorST::create_enclave(secs_t *secs, sgx_enclave_id_t *enclave_id,
     return SGX_SUCCESS;
 }
 
+// Serialize the measurement of one page, i.e. the EADD block followed, if the
+// page is extended, by an EEXTEND block and 256 bytes of page data for every
+// 256-byte chunk. Returns the size of the record.
+static size_t build_page_record(uint8_t *record, const uint8_t *pdata, uint64_t page_offset, const sec_info_t &sinfo, bool extend)
+{
+    uint8_t eadd_val[SIZE_NAMED_VALUE] = "EADD\0\0\0";
+    uint8_t eextend_val[SIZE_NAMED_VALUE] = "EEXTEND";
+    uint8_t *data_block = record;
+    size_t db_offset = 0;
+
+    memset(data_block, 0, DATA_BLOCK_SIZE);
+    memcpy_s(data_block, DATA_BLOCK_SIZE, eadd_val, SIZE_NAMED_VALUE);
+    db_offset += SIZE_NAMED_VALUE;
+    memcpy_s(data_block+db_offset, DATA_BLOCK_SIZE-db_offset, &page_offset, sizeof(page_offset));
+    db_offset += sizeof(page_offset);
+    memcpy_s(data_block+db_offset, DATA_BLOCK_SIZE-db_offset, &sinfo, DATA_BLOCK_SIZE-db_offset);
+    data_block += DATA_BLOCK_SIZE;
+
+    if(extend)
+    {
+        for(int i = 0; i < SE_PAGE_SIZE; i += EEXTEND_SIZE)
+        {
+            memset(data_block, 0, DATA_BLOCK_SIZE);
+            memcpy_s(data_block, DATA_BLOCK_SIZE, eextend_val, SIZE_NAMED_VALUE);
+            memcpy_s(data_block+SIZE_NAMED_VALUE, DATA_BLOCK_SIZE-SIZE_NAMED_VALUE, &page_offset, sizeof(page_offset));
+            data_block += DATA_BLOCK_SIZE;
+
+            memcpy_s(data_block, EEXTEND_SIZE, pdata + i, EEXTEND_SIZE);
+            data_block += EEXTEND_SIZE;
+            page_offset += EEXTEND_SIZE;
+        }
+    }
+
+    return (size_t)(data_block - record);
+}
+
 int EnclaveCreatorST::add_enclave_page(sgx_enclave_id_t enclave_id, void *src, uint64_t offset, const sec_info_t &sinfo, uint32_t attr)
+{   
+    return add_enclave_pages(enclave_id, src, offset, SE_PAGE_SIZE, sinfo, attr);
+}
+
+int EnclaveCreatorST::add_enclave_pages(sgx_enclave_id_t enclave_id, void *src, uint64_t offset, uint64_t size, const sec_info_t &sinfo, uint32_t attr)
 {   
     assert(m_ctx!=NULL);
     UNUSED(enclave_id);
-    void* source = src;
-    uint8_t color_page[SE_PAGE_SIZE];
-    if(!source)
-    {
-        memset(color_page, 0, SE_PAGE_SIZE);
-        source = reinterpret_cast<void*>(&color_page);
-    }
 
     for(unsigned int i = 0; i< sizeof(sinfo.reserved)/sizeof(sinfo.reserved[0]); i++)
     {
@@ -164,58 +202,37 @@ int EnclaveCreatorST::add_enclave_page(sgx_enclave_id_t enclave_id, void *src, u
     {
         page_offset += enclave_image_address - elrange_start_address;
     }
-    
-    uint8_t eadd_val[SIZE_NAMED_VALUE] = "EADD\0\0\0";
 
-    uint8_t data_block[DATA_BLOCK_SIZE];
-    size_t db_offset = 0;
-    memset(data_block, 0, DATA_BLOCK_SIZE);
-    memcpy_s(data_block, sizeof(data_block), eadd_val, SIZE_NAMED_VALUE);
-    db_offset += SIZE_NAMED_VALUE;
-    memcpy_s(data_block+db_offset, sizeof(data_block)-db_offset, &page_offset, sizeof(page_offset));
-    db_offset += sizeof(page_offset);
-    memcpy_s(data_block+db_offset, sizeof(data_block)-db_offset, &sinfo, sizeof(data_block)-db_offset);
-    if(EVP_DigestUpdate(m_ctx, data_block, DATA_BLOCK_SIZE) != 1)
+    bool extend = ((attr & ADD_EXTEND_PAGE) == ADD_EXTEND_PAGE);
+    uint64_t pages = size >> SE_PAGE_SHIFT;
+    int ret = SGX_SUCCESS;
+
+    uint8_t record[PAGE_RECORD_SIZE];
+    for(uint64_t i = 0; i < pages && ret == SGX_SUCCESS; i++)
     {
-        se_trace(SE_TRACE_DEBUG, "ERROR - EVP_digestUpdate: %s.\n", ERR_error_string(ERR_get_error(), NULL));
-        return SGX_ERROR_UNEXPECTED;
+        size_t len = build_page_record(record, get_page_source(src, i), page_offset + (i << SE_PAGE_SHIFT), sinfo, extend);
+        ret = measure_update(record, len);
     }
+    if(ret != SGX_SUCCESS)
+        return ret;
 
-    /* If the page need to eextend, do eextend. */
-    if((attr & ADD_EXTEND_PAGE) == ADD_EXTEND_PAGE)
-    {
-        uint8_t *pdata = (uint8_t *)source;
-        uint8_t eextend_val[SIZE_NAMED_VALUE] = "EEXTEND";
+    m_quota += size;
+    return SGX_SUCCESS;
+}
 
-#define EEXTEND_TIME  4 
-        for(int i = 0; i < SE_PAGE_SIZE; i += (DATA_BLOCK_SIZE * EEXTEND_TIME))
-        {
-            db_offset = 0;
-            memset(data_block, 0, DATA_BLOCK_SIZE);
-            memcpy_s(data_block, sizeof(data_block), eextend_val, SIZE_NAMED_VALUE);
-            db_offset += SIZE_NAMED_VALUE;
-            memcpy_s(data_block+db_offset, sizeof(data_block)-db_offset, &page_offset, sizeof(page_offset));
-            if(EVP_DigestUpdate(m_ctx, data_block, DATA_BLOCK_SIZE) != 1)
-            {
-                se_trace(SE_TRACE_DEBUG, "ERROR - EVP_digestUpdate: %s.\n", ERR_error_string(ERR_get_error(), NULL));
-                return SGX_ERROR_UNEXPECTED;
-            }
-
-            for(int j = 0; j < EEXTEND_TIME; j++)
-            {
-                memcpy_s(data_block, sizeof(data_block), pdata, DATA_BLOCK_SIZE);
-                if(EVP_DigestUpdate(m_ctx, data_block, DATA_BLOCK_SIZE) != 1)
-                {
-                    se_trace(SE_TRACE_DEBUG, "ERROR - EVP_digestUpdate: %s.\n", ERR_error_string(ERR_get_error(), NULL));
-                    return SGX_ERROR_UNEXPECTED;
-                }
-                pdata += DATA_BLOCK_SIZE;
-                page_offset += DATA_BLOCK_SIZE;
-            }
-        }
-    }
+const uint8_t *EnclaveCreatorST::get_page_source(const void *src, uint64_t page)
+{
+    static const uint8_t zero_page[SE_PAGE_SIZE] = {0};
+    return src ? GET_PTR(const uint8_t, src, page << SE_PAGE_SHIFT) : zero_page;
+}
 
-    m_quota += SE_PAGE_SIZE;
+int EnclaveCreatorST::measure_update(const uint8_t *data, size_t len)
+{
+    if(EVP_DigestUpdate(m_ctx, data, len) != 1)
+    {
+        se_trace(SE_TRACE_DEBUG, "ERROR - EVP_digestUpdate: %s.\n", ERR_error_string(ERR_get_error(), NULL));
+        return SGX_ERROR_UNEXPECTED;
+    }
     return SGX_SUCCESS;
 }
 
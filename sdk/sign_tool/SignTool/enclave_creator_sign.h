@@ -47,6 +47,7 @@ public:
     virtual ~EnclaveCreatorST();
     int create_enclave(secs_t *secs, sgx_enclave_id_t *enclave_id, void **start_addr, const uint32_t ex_features, const void* ex_features_p[32]);
     int add_enclave_page(sgx_enclave_id_t enclave_id, void *source, uint64_t offset, const sec_info_t &sinfo, uint32_t attr);
+    int add_enclave_pages(sgx_enclave_id_t enclave_id, void *source, uint64_t offset, uint64_t size, const sec_info_t &sinfo, uint32_t attr);
     int init_enclave(sgx_enclave_id_t enclave_id, enclave_css_t *enclave_css, SGXLaunchToken *lc, le_prd_css_file_t *prd_css_file);
     int get_misc_attr(sgx_misc_attribute_t *sgx_misc_attr, metadata_t *metadata, SGXLaunchToken * const lc, uint32_t flag);
     bool get_plat_cap(sgx_misc_attribute_t *se_attr);
@@ -57,6 +58,8 @@ public:
     bool is_driver_compatible();
     int get_enclave_info(uint8_t *hash, int size, uint64_t *quota);
 private:
+    static const uint8_t *get_page_source(const void *src, uint64_t page);
+    int measure_update(const uint8_t *data, size_t len);
     uint8_t m_enclave_hash[SGX_HASH_SIZE];
     EVP_MD_CTX  *m_ctx;
     bool m_hash_valid_flag;
@@ -494,6 +494,13 @@ bool CMetadata::check_xml_parameter(const xml_parameter_t *parameter)
         }
     }
 
+    if( (parameter[HEAPCOMMITAHEAD].value % ALIGN_SIZE)
+     || (parameter[HEAPTRIMTHRESHOLD].value % ALIGN_SIZE) )
+    {
+        se_trace(SE_TRACE_ERROR, SET_HEAP_COMMIT_ALIGN_ERROR);
+        return false;
+    }
+
     if ((parameter[RSRVMAXSIZE].value % ALIGN_SIZE)
         || (parameter[RSRVMINSIZE].value % ALIGN_SIZE)
         || (parameter[RSRVINITSIZE].value % ALIGN_SIZE))
@@ -605,6 +612,8 @@ bool CMetadata::check_xml_parameter(const xml_parameter_t *parameter)
     m_create_param.tcs_min_pool = (uint32_t)parameter[TCSMINPOOL].value;
     m_create_param.tcs_policy = (uint32_t)parameter[TCSPOLICY].value;
     m_create_param.fips_on = (uint32_t)parameter[ENABLEIPPFIPS].value;
+    m_create_param.heap_commit_ahead = parameter[HEAPCOMMITAHEAD].value;
+    m_create_param.heap_trim_threshold = parameter[HEAPTRIMTHRESHOLD].value;
 
     se_trace(SE_TRACE_ERROR, "tcs_num %d, tcs_max_num %d, tcs_min_pool %d\n", m_create_param.tcs_num, m_create_param.tcs_max_num, m_create_param.tcs_min_pool);
     SE_TRACE_DEBUG("RSRV_MIN_SIZE  = 0x%016llX\n", m_create_param.rsrv_min_size);
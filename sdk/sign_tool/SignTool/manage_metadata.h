@@ -87,7 +87,9 @@ typedef enum _para_type_t
     AMX,
     USERREGIONSIZE,
     ENABLEAEXNOTIFY,
-    ENABLEIPPFIPS
+    ENABLEIPPFIPS,
+    HEAPCOMMITAHEAD,
+    HEAPTRIMTHRESHOLD
 } para_type_t;
 
 typedef struct _xml_parameter_t
@@ -1357,7 +1357,9 @@ int main(int argc, char* argv[])
                                    {"AMX",                  FEATURE_LOADER_SELECTS,                     FEATURE_MUST_BE_DISABLED,              FEATURE_MUST_BE_DISABLED,                   0},
                                    {"UserRegionSize",       ENCLAVE_MAX_SIZE_64/2, 0,              USER_REGION_SIZE,    0},
                                    {"EnableAEXNotify",      1,                     0,              0,                   0},
-                                   {"EnableIPPFIPS",        1,                     0,              0,                   0}};
+                                   {"EnableIPPFIPS",        1,                     0,              0,                   0},
+                                   {"HeapCommitAhead",      ENCLAVE_MAX_SIZE_64/2, 0,              0,                   0},
+                                   {"HeapTrimThreshold",    ENCLAVE_MAX_SIZE_64/2, 0,              0,                   0}};
     const char *path[8] = {NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL};
     uint8_t enclave_hash[SGX_HASH_SIZE] = {0};
     uint8_t metadata_raw[METADATA_SIZE];
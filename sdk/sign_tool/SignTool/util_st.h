@@ -135,6 +135,7 @@
 #define SET_HEAP_SIZE_INIT_MAX_ERROR        "Heap size setting is not correct: init value should not be larger than max value.\n"
 #define SET_HEAP_SIZE_INIT_MIN_ERROR        "Heap size setting is not correct: min value should not be larger than init value.\n"
 #define SET_HEAP_SIZE_MAX_MIN_ERROR         "Heap size setting is not correct: max value should not be smaller than min value.\n"
+#define SET_HEAP_COMMIT_ALIGN_ERROR         "Heap commit setting is not correct: HeapCommitAhead and HeapTrimThreshold should be page aligned.\n"
 #define SET_RSRV_SIZE_ALIGN_ERROR           "Reserved memory size setting is not correct: size is not page aligned.\n"
 #define SET_RSRV_SIZE_INIT_MAX_ERROR        "Reserved memory size setting is not correct: init value should not be larger than max value.\n"
 #define SET_RSRV_SIZE_INIT_MIN_ERROR        "Reserved memory size setting is not correct: min value should not be larger than init value.\n"
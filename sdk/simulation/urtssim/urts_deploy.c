@@ -70,6 +70,7 @@ void sgx_thread_set_multiple_untrusted_events_ocall(){};
 void sgx_thread_set_untrusted_event_ocall(){};
 void sgx_thread_setwait_untrusted_events_ocall(){};
 void sgx_thread_wait_untrusted_event_ocall(){};
+void sgx_thread_get_event_words_ocall(){};
 
 sgx_status_t pthread_create_ocall()
 {
@@ -93,3 +94,33 @@ sgx_status_t sgx_get_metadata()
     printf("Please use the correct uRTS library from PSW package.\n");
     return SGX_ERROR_UNEXPECTED;
 }
+
+sgx_status_t sgx_set_enclave_template_cache_size()
+{
+    printf("Please use the correct uRTS library from PSW package.\n");
+    return SGX_ERROR_UNEXPECTED;
+}
+
+sgx_status_t sgx_invalidate_enclave_template()
+{
+    printf("Please use the correct uRTS library from PSW package.\n");
+    return SGX_ERROR_UNEXPECTED;
+}
+
+sgx_status_t sgx_set_tcs_affinity_policy()
+{
+    printf("Please use the correct uRTS library from PSW package.\n");
+    return SGX_ERROR_UNEXPECTED;
+}
+
+sgx_status_t sgx_get_tcs_stats()
+{
+    printf("Please use the correct uRTS library from PSW package.\n");
+    return SGX_ERROR_UNEXPECTED;
+}
+
+sgx_status_t sgx_set_tcs_provisioning()
+{
+    printf("Please use the correct uRTS library from PSW package.\n");
+    return SGX_ERROR_UNEXPECTED;
+}
@@ -190,6 +190,46 @@ on_done:
     } while(0)
 #endif
 
+/* Allocate a signal line and copy the call task into its slot. The signal
+ * itself is not triggered, so that a batch of calls can be published with
+ * a single memory barrier. Returns SL_INVALID_SIGLINE if no line is free. */
+static inline uint64_t sl_call_mngr_prepare(struct sl_call_mngr* mngr, struct sl_call_task* call_task)
+{
+    BUG_ON(!can_type_call(mngr->type));
+
+    struct sl_siglines* siglns = &mngr->siglns;
+    uint64_t line = sl_siglines_alloc_line(siglns);
+    if (line == SL_INVALID_SIGLINE)
+        return SL_INVALID_SIGLINE;
+
+    BUG_ON(call_task->status != SL_INIT);
+    SET_VALUE_HARDEN_FOR_SEND_TASK(&call_task->status, SL_SUBMITTED, sl_call_status_t);
+
+    // copy task data to internal array accessable by both sides (trusted & untrusted)
+    SET_VALUE_HARDEN_FOR_SEND_TASK(&mngr->tasks[line], *call_task, struct sl_call_task);
+
+    return line;
+}
+
+/* Give the signal line of a finished or revoked call back to the pool */
+static inline void sl_call_mngr_release(struct sl_call_mngr* mngr, uint64_t line)
+{
+    SET_VALUE_HARDEN_FOR_SEND_TASK(&mngr->tasks[line].func_id, SL_INVALID_FUNC_ID, uint64_t);
+    sl_siglines_free_line(&mngr->siglns, line);
+}
+
+/* Try to take back a call that no worker has accepted yet. Returns 1 if the
+ * call was revoked, 0 if it is being or has been processed by workers. */
+static inline int sl_call_mngr_cancel(struct sl_call_mngr* mngr, uint64_t line)
+{
+    return sl_siglines_revoke_signal(&mngr->siglns, line) == 0;
+}
+
+static inline int sl_call_mngr_is_done(const struct sl_call_mngr* mngr, uint64_t line)
+{
+    return mngr->tasks[line].status == SL_DONE;
+}
+
 static inline int sl_call_mngr_call(struct sl_call_mngr* mngr, struct sl_call_task* call_task, uint64_t max_tries)
 {
     /*
@@ -202,28 +242,19 @@ static inline int sl_call_mngr_call(struct sl_call_mngr* mngr, struct sl_call_ta
                    when called by enclave to make OCALL, call_task resides on enclaves stack
     */
 
-    BUG_ON(!can_type_call(mngr->type));
-
     int ret = 0;
 
     /* Allocate a free signal line to send signal */
-    struct sl_siglines* siglns = &mngr->siglns;
-    uint64_t line = sl_siglines_alloc_line(siglns);
+    uint64_t line = sl_call_mngr_prepare(mngr, call_task);
     if (line == SL_INVALID_SIGLINE)
         return -EAGAIN;
 
-    BUG_ON(call_task->status != SL_INIT);
-    SET_VALUE_HARDEN_FOR_SEND_TASK(&call_task->status, SL_SUBMITTED, sl_call_status_t);
-
-    // copy task data to internal array accessable by both sides (trusted & untrusted)
-    SET_VALUE_HARDEN_FOR_SEND_TASK(&mngr->tasks[line], *call_task, struct sl_call_task);
-
     /* Send a signal so that workers will access the buffer for switchless call
      * requests. Here, a memory barrier is used to make sure the buffer is
      * visible when the signal is received on other CPUs. */
     sgx_mfence();
 
-    sl_siglines_trigger_signal(siglns, line);
+    sl_siglines_trigger_signal(&mngr->siglns, line);
 
     // wait till the other side has picked the task for processing
     while ((mngr->tasks[line].status == SL_SUBMITTED) && (--max_tries > 0))
@@ -237,7 +268,7 @@ static inline int sl_call_mngr_call(struct sl_call_mngr* mngr, struct sl_call_ta
 
     if (unlikely(max_tries == 0))
     {
-        if (sl_siglines_revoke_signal(siglns, line) == 0)
+        if (sl_call_mngr_cancel(mngr, line))
         {
             ret = -EAGAIN;
             goto on_exit;
@@ -247,7 +278,7 @@ static inline int sl_call_mngr_call(struct sl_call_mngr* mngr, struct sl_call_ta
     }
 
     /* The request must has been accepted. Now wait for its completion */
-    while (mngr->tasks[line].status != SL_DONE)
+    while (!sl_call_mngr_is_done(mngr, line))
     {
 #ifdef SL_INSIDE_ENCLAVE /* trusted */
         if (sgx_is_enclave_crashed())
@@ -260,8 +291,7 @@ static inline int sl_call_mngr_call(struct sl_call_mngr* mngr, struct sl_call_ta
     call_task->ret_code = mngr->tasks[line].ret_code;
 
 on_exit:
-    SET_VALUE_HARDEN_FOR_SEND_TASK(&mngr->tasks[line].func_id, SL_INVALID_FUNC_ID, uint64_t);
-    sl_siglines_free_line(siglns, line);
+    sl_call_mngr_release(mngr, line);
     return ret;
 }
 
@@ -90,6 +90,11 @@ typedef int_type              sl_sigline_t;
 
 #define SL_FREE_LINE_INIT   ((sl_sigline_t)(-1))
 
+/* Each word of the free_lines bitmap sits on its own cache line, so that
+ * senders allocating from different words do not contend on one line */
+#define SL_CACHE_LINE_SIZE   64
+#define SL_FREE_LINES_STRIDE (SL_CACHE_LINE_SIZE / sizeof(sl_sigline_t))
+
 typedef enum : unsigned long long {
     SL_SIGLINES_DIR_T2U,
     SL_SIGLINES_DIR_U2T
@@ -103,7 +108,7 @@ struct sl_siglines {
     sl_siglines_dir_t               direction;
     uint64_t                        num_lines;
     sl_sigline_t*                   event_lines; /* bitmap: 1 - event, 0 - no event  */
-    sl_sigline_t*                   free_lines; /* bitmap: 1 - free, 0 - occupied */
+    sl_sigline_t*                   free_lines; /* bitmap: 1 - free, 0 - occupied, one word per cache line */
     sl_sighandler_t                 handler;
 };
 
@@ -162,20 +167,43 @@ static inline int is_line_valid(struct sl_siglines* sglns, uint64_t line)
     return (line < sglns->num_lines);
 }
 
+static inline sl_sigline_t* free_lines_word(struct sl_siglines* sglns, uint64_t i)
+{
+    return &sglns->free_lines[i * SL_FREE_LINES_STRIDE];
+}
+
+/* Per-thread index (plus one) of the free_lines word to start searching
+ * from. Threads are spread round-robin over the words on their first
+ * allocation and then stick to the word they last allocated from, so
+ * concurrent senders rarely touch the same cache line. */
+static inline uint64_t* sl_siglines_alloc_hint(void)
+{
+    static __thread uint64_t hint;
+    return &hint;
+}
+
 static inline uint64_t sl_siglines_alloc_line(struct sl_siglines* sglns)
 {
+    static volatile uint64_t next_hint;
+
     BUG_ON(!is_direction_sender(sglns->direction));
 
-    uint64_t i, max_i = (sglns->num_lines / NBITS_PER_LINE);
+    uint64_t n, i, max_i = (sglns->num_lines / NBITS_PER_LINE);
+    uint64_t* hint = sl_siglines_alloc_hint();
     sl_sigline_t* bits_p;
 
-    for (i = 0; i < max_i; i++)
+    if (unlikely(*hint == 0))
+        *hint = lock_xchg_add(&next_hint, 1) + 1;
+
+    i = (*hint - 1) % max_i;
+    for (n = 0; n < max_i; n++, i = (i + 1 == max_i) ? 0 : i + 1)
     {
-        bits_p = &sglns->free_lines[i];
+        bits_p = free_lines_word(sglns, i);
 
         int64_t j = extract_one_bit(bits_p);
         if (j < 0) continue;
 
+        *hint = i + 1;
         uint64_t free_line = NBITS_PER_LINE * i + (uint64_t)j;
         return free_line;
 
@@ -190,7 +218,7 @@ static inline void sl_siglines_free_line(struct sl_siglines* sglns, uint64_t lin
     BUG_ON(!is_line_valid(sglns, line));
     uint64_t i = line / NBITS_PER_LINE;
     uint64_t j = line % NBITS_PER_LINE;
-    set_bit(&sglns->free_lines[i], j);
+    set_bit(free_lines_word(sglns, i), j);
 }
 
 
@@ -80,11 +80,7 @@ struct sl_uswitchless
     volatile int64_t            us_should_stop;
     struct sl_workers           us_uworkers;
     struct sl_workers           us_tworkers;
-#ifndef SL_INSIDE_ENCLAVE /* Untrusted */
-    pthread_t                   us_waker;
-#else
-    void*                       __unused__;
-#endif
+    uint64_t                    us_reserved;    /* was the waker thread, keeps the layout shared with the enclave */
     volatile uint64_t           us_wake_workers;
     volatile uint64_t           us_init_finished;
 
@@ -94,6 +94,8 @@ void sl_workers_notify_event(struct sl_workers* workers, sl_worker_event_t event
 
 void wake_all_threads(struct sl_workers* workers);
 
+bool sl_workers_wake_on_request(struct sl_workers* workers);
+
 #ifdef __cplusplus
 }
 #endif
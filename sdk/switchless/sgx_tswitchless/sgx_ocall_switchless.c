@@ -32,6 +32,7 @@
 #include <sgx_error.h>
 #include <sgx_trts.h>
 #include <sgx_edger8r.h>
+#include <sgx_tswitchless.h>
 #include <internal/thread_data.h>
 #include <internal/util.h>
 #include <sl_uswitchless.h>
@@ -41,6 +42,7 @@
 #include <sl_util.h>
 #include <sl_debug.h>
 #include <sl_atomic.h>
+#include <sgx_lfence.h>
 #include <rts.h>
 
 
@@ -82,6 +84,12 @@ static int_type init_tswitchless_ocall_mngr(void* param)
         memcpy_verw((void*)(dest), &tmp, sizeof(value_type));         \
     } while(0)
 
+static inline int all_uworkers_sleeping(void)
+{
+    struct sl_workers* workers = &g_uswitchless_handle->us_uworkers;
+    return workers->num_sleeping >= workers->num_running;
+}
+
 sgx_status_t sgx_ocall_switchless(const unsigned int index, void* ms) 
 {
     int error = 0;
@@ -114,6 +122,11 @@ sgx_status_t sgx_ocall_switchless(const unsigned int index, void* ms)
     if (g_uswitchless_handle->us_uworkers.num_sleeping > 0)
     {
 	SET_VALUE_HARDEN(&g_uswitchless_handle->us_wake_workers, 1, uint64_t);
+
+        // no worker is spinning to take the call or to see the flag, the
+        // untrusted side of a normal OCall wakes them up
+        if (all_uworkers_sleeping())
+            goto on_fallback;
     }
 
     struct sl_call_task call_task;
@@ -138,3 +151,186 @@ on_fallback:
     return sgx_ocall(index, ms);
 }
 
+
+/*=========================================================================
+ * The implementation of batched switchless OCalls
+ *========================================================================*/
+#define SL_BATCH_COMPLETED  0
+#define SL_BATCH_PENDING    1
+#define SL_BATCH_FALLBACK   2
+
+static void ocall_batch_fallback(sgx_switchless_ocall_t* call)
+{
+    lock_inc(&g_uswitchless_handle->us_uworkers.stats.missed);
+    SET_VALUE_HARDEN(&g_uswitchless_handle->us_has_new_ocall_fallback, 1, uint64_t);
+    call->status = sgx_ocall(call->index, call->ms);
+    call->state = SL_BATCH_COMPLETED;
+}
+
+// validates the entries handed back by the caller before any of them is used
+// to index the tasks array; a pending entry must refer to a signal line of
+// the initialized OCall manager
+static int ocall_batch_check(const sgx_switchless_ocall_t* calls, size_t count)
+{
+    size_t i;
+
+    for (i = 0; i < count; i++)
+    {
+        if (calls[i].state == SL_BATCH_COMPLETED)
+            continue;
+
+        if (calls[i].state != SL_BATCH_PENDING ||
+            g_uswitchless_handle == NULL ||
+            calls[i].line >= g_ocall_mngr.siglns.num_lines)
+            return 0;
+    }
+
+    sgx_lfence();
+    return 1;
+}
+
+// collects the results of the pending entries that have been processed,
+// returns the number of completed entries
+static size_t ocall_batch_reap(sgx_switchless_ocall_t* calls, size_t count)
+{
+    size_t i, ncompleted = 0;
+
+    for (i = 0; i < count; i++)
+    {
+        if (calls[i].state == SL_BATCH_PENDING && sl_call_mngr_is_done(&g_ocall_mngr, calls[i].line))
+        {
+            calls[i].status = g_ocall_mngr.tasks[calls[i].line].ret_code;
+            sl_call_mngr_release(&g_ocall_mngr, calls[i].line);
+            calls[i].state = SL_BATCH_COMPLETED;
+            lock_inc(&g_uswitchless_handle->us_uworkers.stats.processed);
+        }
+
+        if (calls[i].state == SL_BATCH_COMPLETED)
+            ncompleted++;
+    }
+
+    return ncompleted;
+}
+
+sgx_status_t sgx_ocall_switchless_submit(sgx_switchless_ocall_t* calls, size_t count)
+{
+    size_t i, npending = 0;
+
+    if (calls == NULL && count != 0)
+        return SGX_ERROR_INVALID_PARAMETER;
+
+    if (sgx_is_enclave_crashed())
+        return SGX_ERROR_ENCLAVE_CRASHED;
+
+    /* Same fallback rules as sgx_ocall_switchless() */
+    if (g_uswitchless_handle == NULL ||
+        sl_call_once(&g_init_ocall_mngr_done, init_tswitchless_ocall_mngr, NULL))
+    {
+        for (i = 0; i < count; i++)
+        {
+            calls[i].status = sgx_ocall(calls[i].index, calls[i].ms);
+            calls[i].state = SL_BATCH_COMPLETED;
+        }
+        return SGX_SUCCESS;
+    }
+
+    int have_workers = g_uswitchless_handle->us_uworkers.num_running != 0;
+    // with all the workers asleep, the first request is made as a normal
+    // OCall, whose untrusted side wakes them up for the rest of the batch
+    int wake_by_fallback = have_workers && all_uworkers_sleeping();
+
+    // copy all the tasks first, so that one barrier covers the whole batch
+    for (i = 0; i < count; i++)
+    {
+        struct sl_call_task call_task;
+
+        call_task.status = SL_INIT;
+        call_task.func_id = calls[i].index;
+        call_task.func_data = calls[i].ms;
+        call_task.ret_code = SGX_ERROR_UNEXPECTED;
+
+        calls[i].line = (have_workers && !(wake_by_fallback && i == 0)) ?
+                        sl_call_mngr_prepare(&g_ocall_mngr, &call_task) : SL_INVALID_SIGLINE;
+        calls[i].state = (calls[i].line == SL_INVALID_SIGLINE) ? SL_BATCH_FALLBACK : SL_BATCH_PENDING;
+        if (calls[i].state == SL_BATCH_PENDING)
+            npending++;
+    }
+
+    // one wake-up for the whole batch
+    if (g_uswitchless_handle->us_uworkers.num_sleeping > 0)
+    {
+        SET_VALUE_HARDEN(&g_uswitchless_handle->us_wake_workers, 1, uint64_t);
+    }
+
+    if (npending > 0)
+    {
+        sgx_mfence();
+
+        for (i = 0; i < count; i++)
+        {
+            if (calls[i].state == SL_BATCH_PENDING)
+                sl_siglines_trigger_signal(&g_ocall_mngr.siglns, calls[i].line);
+        }
+    }
+
+    // the requests that did not get a signal line are performed synchronously
+    for (i = 0; i < count; i++)
+    {
+        if (calls[i].state == SL_BATCH_FALLBACK)
+            ocall_batch_fallback(&calls[i]);
+    }
+
+    return SGX_SUCCESS;
+}
+
+sgx_status_t sgx_ocall_switchless_poll(sgx_switchless_ocall_t* calls, size_t count, size_t* completed)
+{
+    if (calls == NULL && count != 0)
+        return SGX_ERROR_INVALID_PARAMETER;
+
+    if (!ocall_batch_check(calls, count))
+        return SGX_ERROR_INVALID_PARAMETER;
+
+    size_t ncompleted = ocall_batch_reap(calls, count);
+    if (completed != NULL)
+        *completed = ncompleted;
+
+    return (ncompleted == count) ? SGX_SUCCESS : SGX_ERROR_BUSY;
+}
+
+sgx_status_t sgx_ocall_switchless_wait(sgx_switchless_ocall_t* calls, size_t count)
+{
+    if (calls == NULL && count != 0)
+        return SGX_ERROR_INVALID_PARAMETER;
+
+    if (!ocall_batch_check(calls, count))
+        return SGX_ERROR_INVALID_PARAMETER;
+
+    uint64_t max_tries = (g_uswitchless_handle == NULL) ? 0 :
+                         g_uswitchless_handle->us_config.retries_before_fallback;
+
+    while (ocall_batch_reap(calls, count) != count)
+    {
+        if (sgx_is_enclave_crashed())
+            return SGX_ERROR_ENCLAVE_CRASHED;
+
+        // revoke the requests that no worker has accepted in time
+        if (max_tries > 0 && --max_tries == 0)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                if (calls[i].state == SL_BATCH_PENDING &&
+                    g_ocall_mngr.tasks[calls[i].line].status == SL_SUBMITTED &&
+                    sl_call_mngr_cancel(&g_ocall_mngr, calls[i].line))
+                {
+                    sl_call_mngr_release(&g_ocall_mngr, calls[i].line);
+                    ocall_batch_fallback(&calls[i]);
+                }
+            }
+        }
+
+        asm_pause();
+    }
+
+    return SGX_SUCCESS;
+}
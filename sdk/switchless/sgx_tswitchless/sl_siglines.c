@@ -34,6 +34,7 @@
 #include <sgx_trts.h>
 #include <sgx_error.h>
 #include <sgx_lfence.h>
+#include <sgx_uswitchless.h>
 #include <errno.h>
 #include <stdlib.h>
 
@@ -60,7 +61,8 @@ uint32_t sl_siglines_clone(struct sl_siglines* sglns,
     BUG_ON(is_direction_sender(direction) && (handler != NULL));
 
     uint64_t num_lines = untrusted->num_lines;
-    if ((num_lines <= 0) || ((num_lines % NBITS_PER_LINE) != 0))
+    if ((num_lines <= 0) || ((num_lines % NBITS_PER_LINE) != 0) ||
+        (num_lines > SL_MAX_TASKS_MAX_QWORDS * NBITS_PER_LINE))
         return EINVAL;
 
     sglns->num_lines = num_lines;
@@ -81,12 +83,12 @@ uint32_t sl_siglines_clone(struct sl_siglines* sglns,
         // OCALL manager, enclave is the sender
         // free_lines is used by enclave threads only, so allocate it inside the enclave
         // never gets freed, no global termination hooks defined
-        free_lines = (sl_sigline_t*)malloc(sizeof(sl_sigline_t) * nlong);
+        free_lines = (sl_sigline_t*)memalign(SL_CACHE_LINE_SIZE, SL_CACHE_LINE_SIZE * nlong);
         if (free_lines == NULL) 
             return ENOMEM;
 		
         for (uint32_t i = 0; i < nlong; i++)
-            free_lines[i] = SL_FREE_LINE_INIT;
+            free_lines[i * SL_FREE_LINES_STRIDE] = SL_FREE_LINE_INIT;
     }
 
     sglns->free_lines = free_lines;
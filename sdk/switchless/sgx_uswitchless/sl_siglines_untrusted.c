@@ -61,12 +61,15 @@ uint32_t sl_siglines_init(struct sl_siglines* sglns,
 
     if (is_direction_sender(direction))
     {
-        free_lines = (sl_sigline_t*)malloc(sizeof(sl_sigline_t) * nlong);
-        if (free_lines == NULL)
+        if (posix_memalign((void**)&free_lines, SL_CACHE_LINE_SIZE,
+                           SL_CACHE_LINE_SIZE * nlong) != 0)
+        {
+            free_lines = NULL;
             goto on_error;
+        }
 
         for (; i < nlong; i++)
-            free_lines[i] = SL_FREE_LINE_INIT;
+            free_lines[i * SL_FREE_LINES_STRIDE] = SL_FREE_LINE_INIT;
     }
 
     sglns->direction = direction;
@@ -228,6 +228,11 @@ void sl_uswitchless_check_switchless_ocall_fallback(void* _switchless)
     {
         sl_workers_notify_event(&handle->us_uworkers, SL_WORKER_EVENT_MISS);
     }
+
+    /* The enclave falls back to a normal OCall when all the untrusted workers
+     * sleep, this is where they get woken up */
+    if (handle->us_init_finished)
+        sl_workers_wake_on_request(&handle->us_uworkers);
 }
 
 /*=========================================================================
@@ -42,6 +42,7 @@
 #include <stdlib.h>
 #include <errno.h>
 #include <limits.h>
+#include <x86intrin.h>
 #include "sgx_tswitchless_u.h"
 
 /*=========================================================================
@@ -74,28 +75,87 @@ void sl_workers_destroy(struct sl_workers* workers)
 }
 
 /*=========================================================================
- * Sleep and wakeup threads
+ * Adaptive spin budget
+ *
+ * Each untrusted worker keeps an exponentially weighted moving average of
+ * the idle gaps (in pause iterations) between the calls it processes. The
+ * worker spins for about twice the average gap before going to sleep, so
+ * that a worker serving a steady stream of calls does not sleep between
+ * them, while a worker whose calls are far apart stops burning CPU early.
+ * The budget never exceeds retries_before_sleep. If the average gap itself
+ * exceeds retries_before_sleep, spinning is unlikely to catch the next
+ * call and the worker only spins for the minimal budget.
  *========================================================================*/
-static void* worker_waker(void* thread_data)
+#define SL_MIN_SPIN_RETRIES         512
+#define SL_SPIN_GAP_FACTOR          2
+#define SL_SPIN_EWMA_SHIFT          3
+#define SL_PAUSE_CALIBRATE_LOOPS    1024
+
+struct sl_worker_spin
 {
-    struct sl_uswitchless* handle = (struct sl_uswitchless*)thread_data;
+    uint64_t    budget;     /* pause iterations to spin before sleeping */
+    uint64_t    avg_gap;    /* EWMA of idle gaps, in pause iterations */
+    uint64_t    idle_gap;   /* idle pause iterations since the last call */
+};
 
-    while (!handle->us_should_stop)
-    {
-        if (handle->us_wake_workers == 1)
-        {
-            wake_all_threads(&handle->us_uworkers);
-            handle->us_wake_workers = 0;
-        }
-        else
-        {
-            usleep(50);
-        }
-    }
+static uint64_t g_cycles_per_pause = 1;
 
-    return NULL;
+static void calibrate_pause(void)
+{
+    uint64_t start = __rdtsc();
+    for (uint32_t i = 0; i < SL_PAUSE_CALIBRATE_LOOPS; i++)
+        asm_pause();
+    uint64_t cycles = (__rdtsc() - start) / SL_PAUSE_CALIBRATE_LOOPS;
+    g_cycles_per_pause = cycles ? cycles : 1;
 }
 
+static void spin_init(struct sl_worker_spin* spin, uint64_t max_retries)
+{
+    spin->budget = max_retries;
+    spin->avg_gap = max_retries / SL_SPIN_GAP_FACTOR;
+    spin->idle_gap = 0;
+}
+
+static void spin_update(struct sl_worker_spin* spin, uint64_t max_retries)
+{
+    uint64_t gap = spin->idle_gap;
+    uint64_t min_retries = max_retries < SL_MIN_SPIN_RETRIES ?
+                                         max_retries : SL_MIN_SPIN_RETRIES;
+
+    /* bound the weight of a single long sleep on the average */
+    if (gap > SL_SPIN_GAP_FACTOR * max_retries)
+        gap = SL_SPIN_GAP_FACTOR * max_retries;
+    spin->idle_gap = 0;
+
+    spin->avg_gap = spin->avg_gap - (spin->avg_gap >> SL_SPIN_EWMA_SHIFT)
+                                  + (gap >> SL_SPIN_EWMA_SHIFT);
+
+    if (spin->avg_gap > max_retries)
+        spin->budget = min_retries;
+    else if (spin->avg_gap * SL_SPIN_GAP_FACTOR > max_retries)
+        spin->budget = max_retries;
+    else if (spin->avg_gap * SL_SPIN_GAP_FACTOR < min_retries)
+        spin->budget = min_retries;
+    else
+        spin->budget = spin->avg_gap * SL_SPIN_GAP_FACTOR;
+}
+
+/*=========================================================================
+ * Sleep and wakeup threads
+ *
+ * should_wake is a wake generation counter used as the futex word: a
+ * sleeper samples it before announcing itself in num_sleeping, so a wake
+ * issued in between makes FUTEX_WAIT return immediately instead of
+ * being lost.
+ *
+ * The enclave cannot issue futex syscalls; it only sets us_wake_workers
+ * when it finds sleeping untrusted workers. An untrusted worker that is
+ * spinning and sees the flag issues the FUTEX_WAKE for its peers. When all
+ * the untrusted workers sleep, nobody would see the flag, so the enclave
+ * makes the OCall the normal way instead, and the untrusted side of that
+ * OCall wakes the workers (see sl_uswitchless_check_switchless_ocall_fallback).
+ *========================================================================*/
+
 static inline long futex(volatile int32_t* futex_addr, int32_t futex_op, int32_t futex_val) 
 {
     return syscall(__NR_futex, futex_addr, futex_op, futex_val, NULL, NULL, 0);
@@ -103,30 +163,49 @@ static inline long futex(volatile int32_t* futex_addr, int32_t futex_op, int32_t
 
 void sleep_this_thread(struct sl_workers* workers, bool notify) 
 {
+   int32_t gen = workers->should_wake;
+
    lock_inc64(&workers->num_sleeping);
 
    if (notify)
        sl_workers_notify_event(workers, SL_WORKER_EVENT_IDLE);
 
-   futex(&workers->should_wake, FUTEX_WAIT, 0);
+   futex(&workers->should_wake, FUTEX_WAIT, gen);
    lock_dec64(&workers->num_sleeping);
 }
 
 void wake_all_threads(struct sl_workers* workers)
 {
     BUG_ON(workers->handle->us_init_finished == 0);
+    __sync_fetch_and_add(&workers->should_wake, 1);
     futex(&workers->should_wake, FUTEX_WAKE, INT_MAX);
 }
 
+/* Wakes the sleeping workers if the enclave asked for it */
+bool sl_workers_wake_on_request(struct sl_workers* workers)
+{
+    struct sl_uswitchless* handle = workers->handle;
+
+    if (handle->us_wake_workers == 0 || xchg(&handle->us_wake_workers, 0) == 0)
+        return false;
+
+    if (workers->num_sleeping > 0)
+        wake_all_threads(workers);
+    return true;
+}
+
 
 /*=========================================================================
  * Thread Management of Workers
  *========================================================================*/
 
-typedef uint32_t(*process_calls_func_t)(struct sl_workers* workers);
+typedef uint32_t(*process_calls_func_t)(struct sl_workers* workers,
+                                        struct sl_worker_spin* spin);
 
-static uint32_t tworker_process_calls(struct sl_workers* workers);
-static uint32_t uworker_process_calls(struct sl_workers* workers);
+static uint32_t tworker_process_calls(struct sl_workers* workers,
+                                      struct sl_worker_spin* spin);
+static uint32_t uworker_process_calls(struct sl_workers* workers,
+                                      struct sl_worker_spin* spin);
 
 static inline process_calls_func_t get_process_calls_fn(sl_worker_type_t type) {
     return (type == SL_WORKER_TYPE_UNTRUSTED) ? uworker_process_calls :
@@ -138,8 +217,11 @@ static void* run_worker(void* thread_data)
 {
     struct sl_workers* workers = (struct sl_workers*)thread_data;
     process_calls_func_t process_calls_fn = get_process_calls_fn(workers->type);
+    struct sl_worker_spin spin;
     lock_inc(&workers->num_running);
 
+    spin_init(&spin, workers->handle->us_config.retries_before_sleep);
+
     /* Start worker thread */
     sl_workers_notify_event(workers, SL_WORKER_EVENT_START);
 
@@ -152,7 +234,8 @@ static void* run_worker(void* thread_data)
      * EDL-generated ECall is called upon the enclave. This OCall table must be
      * given to trusted or untrusted workers so that they can function properly.
      * */
-    sleep_this_thread(workers, false);
+    while (!workers->handle->us_init_finished && !workers->handle->us_should_stop)
+        sleep_this_thread(workers, false);
 
     BUG_ON(workers->handle->us_init_finished == 0);
         
@@ -161,11 +244,14 @@ static void* run_worker(void* thread_data)
     {
     	BUG_ON(workers->handle->us_ocall_table == NULL);
         /* Process calls until idle for some time */
-        process_calls_fn(workers);
+        process_calls_fn(workers, &spin);
         /* Notify idle event */
         if (!workers->handle->us_should_stop)
         {
+            uint64_t start = __rdtsc();
+
             sleep_this_thread(workers, true);
+            spin.idle_gap += (__rdtsc() - start) / g_cycles_per_pause;
         }
     }
     
@@ -176,25 +262,14 @@ static void* run_worker(void* thread_data)
 }
 
 
-int sl_workers_start_waker(struct sl_uswitchless* handle)
-{
-    return pthread_create(&handle->us_waker, NULL, worker_waker, (void*)handle);
-}
-
-void sl_workers_kill_waker(struct sl_uswitchless* handle)
-{
-    BUG_ON(handle->us_should_stop != 1);
-    if (handle->us_waker != 0)
-    {
-        pthread_join(handle->us_waker, NULL);
-    }
-}
-
-
 uint32_t sl_workers_init_threads(struct sl_workers* workers)
 {
     int ret = 0;
     uint32_t num_started = 0, ti = 0;
+
+    if (workers->type == SL_WORKER_TYPE_UNTRUSTED)
+        calibrate_pause();
+
     for (; num_started < workers->num_all; num_started++)
     {
         ret = pthread_create(&workers->threads[num_started], NULL,
@@ -207,12 +282,6 @@ uint32_t sl_workers_init_threads(struct sl_workers* workers)
         usleep(100);
     }
 
-    if (workers->type == SL_WORKER_TYPE_UNTRUSTED)
-    {
-        ret = sl_workers_start_waker(workers->handle);
-        if (ret) goto on_error;
-    }
-
     return 0;
 on_error:
     workers->handle->us_should_stop = 1;
@@ -233,11 +302,6 @@ void sl_workers_kill_threads(struct sl_workers* workers)
     uint32_t ti = 0;
     BUG_ON(workers->handle->us_should_stop != 1);
 
-    if (workers->type == SL_WORKER_TYPE_UNTRUSTED)
-    {
-        sl_workers_kill_waker(workers->handle);
-    }
-    workers->should_wake = 1;
     wake_all_threads(workers);
     for (; ti < workers->num_all; ti++)
     {
@@ -264,8 +328,10 @@ void sl_workers_notify_event(struct sl_workers* workers,
  * Process calls by trusted workers
  *========================================================================*/
 
-static uint32_t tworker_process_calls(struct sl_workers* workers)
+static uint32_t tworker_process_calls(struct sl_workers* workers,
+                                      struct sl_worker_spin* spin)
 {
+    (void)spin;
     sgx_status_t ret;
     BUG_ON(workers->handle->us_ocall_table == NULL);
     struct sl_uswitchless* handle = workers->handle;
@@ -277,31 +343,35 @@ static uint32_t tworker_process_calls(struct sl_workers* workers)
  * Process calls by untrusted workers
  *========================================================================*/
 
-static uint32_t uworker_process_calls(struct sl_workers* workers) 
+static uint32_t uworker_process_calls(struct sl_workers* workers,
+                                      struct sl_worker_spin* spin)
 {
     struct sl_uswitchless* handle = workers->handle;
     struct sl_call_mngr* ocall_mngr = &handle->us_ocall_mngr;
 
-	uint64_t max_retries = handle->us_config.retries_before_sleep;
-	uint64_t retries = 0;
-	
-	while (retries < max_retries)
-	{
-		if (sl_call_mngr_process(ocall_mngr) == 0)
-		{
+    uint64_t max_retries = handle->us_config.retries_before_sleep;
+    uint64_t retries = 0;
+
+    while (retries < spin->budget)
+    {
+        if (sl_call_mngr_process(ocall_mngr) == 0)
+        {
             if (handle->us_should_stop)
                 break;
 
-			asm_pause();
-			retries++;
-		}
-		else
-		{
-			retries = 0;
-		}
-	}
+            sl_workers_wake_on_request(workers);
+            asm_pause();
+            retries++;
+        }
+        else
+        {
+            spin->idle_gap += retries;
+            spin_update(spin, max_retries);
+            retries = 0;
+        }
+    }
+    spin->idle_gap += retries;
 
     /* Idle for some time */
     return 0;
 }
-
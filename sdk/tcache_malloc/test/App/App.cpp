@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Runtime test of libsgx_tcache_malloc.a: allocations of every cached
+ * size from several TCSs, blocks freed on another TCS than the one that
+ * allocated them, the byte limit of a cache, and double frees, which must
+ * crash the enclave.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <sgx_urts.h>
+#include "Enclave_u.h"
+
+#define ENCLAVE_FILENAME    "enclave.signed.so"
+#define TEST_THREADS        8
+#define TEST_ROUNDS         200
+#define TEST_SHARED_BATCH   512     /* 8 batches fill the shared table */
+#define TEST_CACHE_BYTES    (64 * 1024)
+
+static int failures = 0;
+
+static void expect(bool ok, const char *what)
+{
+    printf("%-56s %s\n", what, ok ? "ok" : "FAILED");
+    if (!ok)
+        failures++;
+}
+
+static sgx_enclave_id_t create_enclave(void)
+{
+    sgx_enclave_id_t eid = 0;
+    sgx_status_t ret = sgx_create_enclave(ENCLAVE_FILENAME, SGX_DEBUG_FLAG, NULL, NULL, &eid, NULL);
+    if (ret != SGX_SUCCESS) {
+        printf("Error: sgx_create_enclave failed (0x%x).\n", ret);
+        exit(-1);
+    }
+    return eid;
+}
+
+/* OCall functions */
+void ocall_print_string(const char *str)
+{
+    printf("%s", str);
+}
+
+static void alloc_bins_worker(sgx_enclave_id_t eid, unsigned int seed, int *result)
+{
+    if (ecall_alloc_bins(eid, result, seed, TEST_ROUNDS) != SGX_SUCCESS)
+        *result = -1;
+}
+
+/* Each thread allocates a batch, then frees the batch of the next thread,
+ * so every block is freed into the cache of another TCS.
+ */
+static void cross_free_worker(sgx_enclave_id_t eid, unsigned int id, int *result)
+{
+    static std::atomic<unsigned int> allocated(0);
+    int ret = -1;
+
+    *result = -1;
+    if (ecall_alloc_shared(eid, &ret, id * TEST_SHARED_BATCH, TEST_SHARED_BATCH) != SGX_SUCCESS || ret != 0)
+        return;
+    allocated++;
+    while (allocated.load() < TEST_THREADS)
+        std::this_thread::yield();
+    unsigned int next = (id + 1) % TEST_THREADS;
+    if (ecall_free_shared(eid, &ret, next * TEST_SHARED_BATCH, TEST_SHARED_BATCH) != SGX_SUCCESS)
+        return;
+    *result = ret;
+}
+
+static bool run_threads(sgx_enclave_id_t eid, void (*worker)(sgx_enclave_id_t, unsigned int, int *))
+{
+    std::vector<std::thread> threads;
+    std::vector<int> results(TEST_THREADS, -1);
+    for (unsigned int i = 0; i < TEST_THREADS; i++)
+        threads.push_back(std::thread(worker, eid, i, &results[i]));
+    bool ok = true;
+    for (unsigned int i = 0; i < TEST_THREADS; i++) {
+        threads[i].join();
+        ok = ok && results[i] == 0;
+    }
+    return ok;
+}
+
+int SGX_CDECL main(int argc, char *argv[])
+{
+    (void)argc;
+    (void)argv;
+
+    sgx_enclave_id_t eid = create_enclave();
+    int ret = -1;
+    uint64_t before = 0, after = 0;
+
+    expect(ecall_alloc_bins(eid, &ret, 1, TEST_ROUNDS) == SGX_SUCCESS && ret == 0,
+           "malloc/calloc/free of every size, one TCS");
+    expect(ecall_in_use(eid, &before) == SGX_SUCCESS, "read heap usage");
+    expect(run_threads(eid, alloc_bins_worker), "malloc/calloc/free of every size, 8 TCSs");
+    expect(run_threads(eid, cross_free_worker), "free on another TCS than malloc");
+    expect(ecall_in_use(eid, &after) == SGX_SUCCESS &&
+           after <= before + (uint64_t)(TEST_THREADS + 1) * TEST_CACHE_BYTES,
+           "no blocks lost beyond the cache limits");
+    expect(ecall_fill_cache(eid, &ret) == SGX_SUCCESS && ret == 0,
+           "a full cache gives back blocks of every size");
+    sgx_destroy_enclave(eid);
+
+    /* A double free aborts the enclave, so each case gets a new one */
+    uint64_t p = 0;
+    eid = create_enclave();
+    ecall_alloc_one(eid, &p);
+    ecall_free_one(eid, p);
+    expect(ecall_free_one(eid, p) == SGX_ERROR_ENCLAVE_CRASHED, "double free on the same TCS crashes");
+    sgx_destroy_enclave(eid);
+
+    eid = create_enclave();
+    ecall_alloc_one(eid, &p);
+    ecall_free_one(eid, p);
+    sgx_status_t status = SGX_SUCCESS;
+    std::thread other([&] { status = ecall_free_one(eid, p); });
+    other.join();
+    expect(status == SGX_ERROR_ENCLAVE_CRASHED, "double free on another TCS crashes");
+    sgx_destroy_enclave(eid);
+
+    printf("%s\n", failures == 0 ? "PASSED" : "FAILED");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,227 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <stdarg.h>
+#include <stdio.h> /* vsnprintf */
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "Enclave_t.h"
+
+/* mallinfo() has no declaration in the trusted headers, this is its
+ * struct mallinfo, with dlmalloc's default int fields.
+ */
+struct heap_info {
+    int arena;
+    int ordblks;
+    int smblks;
+    int hblks;
+    int hblkhd;
+    int usmblks;
+    int fsmblks;
+    int uordblks;
+    int fordblks;
+    int keepcost;
+};
+extern "C" struct heap_info mallinfo(void);
+
+#define TEST_SLOTS          512
+#define TEST_MAX_SIZE       600     /* past the largest cached chunk */
+#define TEST_CACHE_BYTES    (64 * 1024)
+#define TEST_SHARED         4096
+
+int printf(const char* fmt, ...)
+{
+    char buf[BUFSIZ] = { '\0' };
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(buf, BUFSIZ, fmt, ap);
+    va_end(ap);
+    ocall_print_string(buf);
+    return (int)strnlen(buf, BUFSIZ - 1) + 1;
+}
+
+static unsigned int next_rand(unsigned int *seed)
+{
+    *seed = *seed * 1103515245U + 12345U;
+    return *seed >> 16;
+}
+
+/* Every live block holds bytes derived from its address and slot, so a
+ * block handed out twice, or written after it was freed, shows up as a
+ * mismatch.
+ */
+static void fill(void *p, size_t size, unsigned int slot)
+{
+    uint8_t tag = (uint8_t)(((uintptr_t)p >> 4) ^ slot);
+    for (size_t i = 0; i < size; i++)
+        ((uint8_t *)p)[i] = (uint8_t)(tag + i);
+}
+
+static bool check(const void *p, size_t size, unsigned int slot)
+{
+    uint8_t tag = (uint8_t)(((uintptr_t)p >> 4) ^ slot);
+    for (size_t i = 0; i < size; i++) {
+        if (((const uint8_t *)p)[i] != (uint8_t)(tag + i)) {
+            printf("block %p of %zu bytes (slot %u) corrupt at %zu\n", p, size, slot, i);
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Random malloc/calloc/free of 1 to TEST_MAX_SIZE bytes, so every cached
+ * size and some uncached ones are used, with blocks kept alive across
+ * many other calls.
+ */
+int ecall_alloc_bins(unsigned int seed, unsigned int rounds)
+{
+    void *blocks[TEST_SLOTS] = { NULL };
+    size_t sizes[TEST_SLOTS] = { 0 };
+    int ret = 0;
+
+    for (unsigned int n = 0; n < rounds * TEST_SLOTS && ret == 0; n++) {
+        unsigned int k = next_rand(&seed) % TEST_SLOTS;
+        if (blocks[k] != NULL) {
+            if (!check(blocks[k], sizes[k], k))
+                ret = -1;
+            free(blocks[k]);
+            blocks[k] = NULL;
+            continue;
+        }
+        size_t size = next_rand(&seed) % TEST_MAX_SIZE + 1;
+        void *p;
+        if ((next_rand(&seed) & 3) == 0) {
+            p = calloc(1, size);
+            for (size_t i = 0; p != NULL && i < size; i++) {
+                if (((uint8_t *)p)[i] != 0) {
+                    printf("calloc(%zu) returned a dirty block\n", size);
+                    ret = -1;
+                    break;
+                }
+            }
+        } else {
+            p = malloc(size);
+        }
+        if (p == NULL) {
+            printf("allocation of %zu bytes failed\n", size);
+            ret = -1;
+            break;
+        }
+        fill(p, size, k);
+        blocks[k] = p;
+        sizes[k] = size;
+    }
+    for (unsigned int k = 0; k < TEST_SLOTS; k++) {
+        if (blocks[k] != NULL) {
+            if (!check(blocks[k], sizes[k], k))
+                ret = -1;
+            free(blocks[k]);
+        }
+    }
+    return ret;
+}
+
+/* Free 64 blocks of every cached size in turn. The cache overflows its
+ * byte limit while most lists are full, and must give back blocks of all
+ * sizes, not only of the list being freed into.
+ */
+int ecall_fill_cache(void)
+{
+    static void *blocks[32][64];
+    size_t before = (size_t)mallinfo().uordblks;
+
+    for (unsigned int s = 0; s < 32; s++) {
+        for (unsigned int i = 0; i < 64; i++) {
+            blocks[s][i] = malloc(s * 16 + 1);
+            if (blocks[s][i] == NULL)
+                return -1;
+        }
+    }
+    for (unsigned int s = 0; s < 32; s++) {
+        for (unsigned int i = 0; i < 64; i++)
+            free(blocks[s][i]);
+    }
+
+    size_t after = (size_t)mallinfo().uordblks;
+    if (after > before + TEST_CACHE_BYTES) {
+        printf("%zu bytes still cached after the flush\n", after - before);
+        return -1;
+    }
+    return 0;
+}
+
+/* Blocks allocated on one TCS and freed on another. */
+static void *shared[TEST_SHARED];
+
+int ecall_alloc_shared(unsigned int first, unsigned int count)
+{
+    if (first > TEST_SHARED || count > TEST_SHARED - first)
+        return -1;
+    for (unsigned int k = first; k < first + count; k++) {
+        shared[k] = malloc(k % TEST_MAX_SIZE + 1);
+        if (shared[k] == NULL)
+            return -1;
+        fill(shared[k], k % TEST_MAX_SIZE + 1, k);
+    }
+    return 0;
+}
+
+int ecall_free_shared(unsigned int first, unsigned int count)
+{
+    int ret = 0;
+    if (first > TEST_SHARED || count > TEST_SHARED - first)
+        return -1;
+    for (unsigned int k = first; k < first + count; k++) {
+        if (!check(shared[k], k % TEST_MAX_SIZE + 1, k))
+            ret = -1;
+        free(shared[k]);
+        shared[k] = NULL;
+    }
+    return ret;
+}
+
+/* Bytes in use, including blocks held by the caches */
+uint64_t ecall_in_use(void)
+{
+    return (uint64_t)mallinfo().uordblks;
+}
+
+uint64_t ecall_alloc_one(void)
+{
+    return (uint64_t)(uintptr_t)malloc(32);
+}
+
+void ecall_free_one(uint64_t ptr)
+{
+    free((void *)(uintptr_t)ptr);
+}
@@ -37,26 +37,48 @@
 #include "util.h"
 #include "global_data.h"
 #include "trts_inst.h"
+#include "sgx_spinlock.h"
 
 SE_DECLSPEC_EXPORT size_t g_peak_heap_used = 0;
-/* Please be aware of: sbrk is not thread safe by default. */
+
+/* sbrk is thread safe: the program break is moved with a CAS on heap_used,
+ * and only EDMM commit/trim of the heap pages is serialized by heap_lock.
+ *
+ * heap_committed is the end of the heap pages that are currently usable.
+ * Without EDMM the whole heap is committed at load time. With EDMM it starts
+ * at heap_min_size and is moved in steps of at least heap_commit_ahead, so a
+ * burst of small sbrk calls takes one mm_commit instead of one per call.
+ * Shrinking the heap only gives pages back when more than heap_trim_threshold
+ * bytes would be freed, and always keeps heap_commit_ahead bytes above the
+ * break. With both settings left at 0, pages are committed and trimmed to
+ * exactly the bytes requested.
+ */
 
 #ifndef SERVTD_ATTEST
 static void *heap_base __attribute__((section(RELRO_SECTION_NAME))) = NULL;
 static size_t heap_size __attribute__((section(RELRO_SECTION_NAME))) = 0;
 static int is_edmm_supported __attribute__((section(RELRO_SECTION_NAME))) = 0;
 static size_t heap_min_size __attribute__((section(RELRO_SECTION_NAME))) = 0;
+static size_t heap_commit_ahead __attribute__((section(RELRO_SECTION_NAME))) = 0;
+static size_t heap_trim_threshold __attribute__((section(RELRO_SECTION_NAME))) = 0;
 #else
 void *heap_base = NULL;
 size_t heap_size = 0;
 int is_edmm_supported = 0;
 size_t heap_min_size = 0;
+size_t heap_commit_ahead = 0;
+size_t heap_trim_threshold = 0;
 #endif
 
+static size_t heap_used = 0;
+static size_t heap_committed = 0;
+static sgx_spinlock_t heap_lock = SGX_SPINLOCK_INITIALIZER;
+
 extern int mm_commit(void* addr, size_t size);
 extern int mm_uncommit(void* addr, size_t size);
 
-int heap_init(void *_heap_base, size_t _heap_size, size_t _heap_min_size, int _is_edmm_supported)
+int heap_init(void *_heap_base, size_t _heap_size, size_t _heap_min_size, int _is_edmm_supported,
+              size_t _heap_commit_ahead, size_t _heap_trim_threshold)
 {
     if (heap_base != NULL)
         return SGX_ERROR_UNEXPECTED;
@@ -70,6 +92,9 @@ int heap_init(void *_heap_base, size_t _heap_size, size_t _heap_min_size, int _i
     if (_heap_min_size & (SE_PAGE_SIZE - 1))
         return SGX_ERROR_UNEXPECTED;
 
+    if ((_heap_commit_ahead & (SE_PAGE_SIZE - 1)) || (_heap_trim_threshold & (SE_PAGE_SIZE - 1)))
+        return SGX_ERROR_UNEXPECTED;
+
     if (_heap_size > SIZE_MAX - (size_t)heap_base)
         return SGX_ERROR_UNEXPECTED;
 
@@ -77,104 +102,156 @@ int heap_init(void *_heap_base, size_t _heap_size, size_t _heap_min_size, int _i
     heap_size = _heap_size;
     heap_min_size = _heap_min_size;
     is_edmm_supported = _is_edmm_supported;
+    heap_commit_ahead = _heap_commit_ahead;
+    heap_trim_threshold = _heap_trim_threshold;
+    heap_committed = is_edmm_supported ? heap_min_size : heap_size;
 
     return SGX_SUCCESS;
 }
 
-void* sbrk(intptr_t n)
+/* Commit pages so that heap_committed covers 'end'. Called with heap_lock held. */
+static int heap_commit_to(size_t end)
 {
-    static size_t heap_used;
-    void *heap_ptr = NULL;
-    size_t prev_heap_used = heap_used;
-    void * start_addr;
-    size_t size = 0;
-    assert((heap_used & (SE_PAGE_SIZE - 1)) == 0);
-    
-    if (!heap_base)
-        return (void *)(~(size_t)0);
+    size_t committed = __atomic_load_n(&heap_committed, __ATOMIC_SEQ_CST);
+    if (end <= committed)
+        return 0;
 
-    /* shrink the heap */
-    if (n < 0) {
+    /* heap_commit_ahead is page aligned and committed <= heap_size, so the
+       step below cannot overflow before it is capped to heap_size.
+     */
+    size_t target = ROUND_TO_PAGE(end);
+    if (heap_commit_ahead > heap_size - committed)
+    {
+        if (target < heap_size)
+            target = heap_size;
+    }
+    else if (target < committed + heap_commit_ahead)
+    {
+        target = committed + heap_commit_ahead;
+    }
+    if (target > heap_size)
+        target = heap_size;
 
-        n *= -1;
-        if (heap_used < n)
-            return (void *)(~(size_t)0);
+    int ret = mm_commit((void *)((size_t)heap_base + committed), target - committed);
+    if (ret != 0)
+        return ret;
 
-        heap_used -= n;
+    __atomic_store_n(&heap_committed, target, __ATOMIC_SEQ_CST);
+    return 0;
+}
 
-        /* heap_used is never larger than heap_size, and since heap_size <= SIZE_MAX - (size_t)heap_base,
-           there's no integer overflow here.
-         */  
-        heap_ptr = (void *)((size_t)heap_base + (size_t)heap_used);
+/* Give back committed pages above the break when the retain policy allows. */
+static void heap_trim(void)
+{
+    sgx_spin_lock(&heap_lock);
+
+    size_t committed = __atomic_load_n(&heap_committed, __ATOMIC_SEQ_CST);
+    size_t used = __atomic_load_n(&heap_used, __ATOMIC_SEQ_CST);
+    size_t keep = ROUND_TO_PAGE(used);
 
-        if (is_edmm_supported && (prev_heap_used > heap_min_size)) 
+    keep = (heap_commit_ahead > heap_size - keep) ? heap_size : keep + heap_commit_ahead;
+    if (keep < heap_min_size)
+        keep = heap_min_size;
+
+    if (keep < committed && committed - keep > heap_trim_threshold)
+    {
+        /* Publish the lower limit before re-reading the break. A concurrent
+           grower either sees the new limit and waits on heap_lock to commit,
+           or its reservation is visible here and the trim is abandoned.
+         */
+        __atomic_store_n(&heap_committed, keep, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&heap_used, __ATOMIC_SEQ_CST) > keep
+            || mm_uncommit((void *)((size_t)heap_base + keep), committed - keep) != 0)
         {
-            assert((n & (SE_PAGE_SIZE - 1)) == 0);
-
-            if (heap_used > heap_min_size)
-            {
-                start_addr = heap_ptr;
-                size = n;
-            }
-            else
-            {
-                /* heap_min_size is never larger than heap_size, and since heap_size <= SIZE_MAX - (size_t)heap_base,
-                   there's no integer overflow here.
-                 */  
-                start_addr = (void *)((size_t)(heap_base) + heap_min_size);
-                size = prev_heap_used - heap_min_size;
-            }
-            assert((size & (SE_PAGE_SIZE - 1)) == 0);
-            int ret = mm_uncommit(start_addr, size);
-            if (ret != 0)
-            {
-                heap_used = prev_heap_used;
-                return (void *)(~(size_t)0);
-            }
+            __atomic_store_n(&heap_committed, committed, __ATOMIC_SEQ_CST);
         }
-        return heap_ptr;
     }
 
-    /* extend the heap */
-    if((heap_used > (SIZE_MAX - n)) || ((heap_used + n) > heap_size))
+    sgx_spin_unlock(&heap_lock);
+}
+
+static void update_peak_heap_used(size_t used)
+{
+    size_t peak = __atomic_load_n(&g_peak_heap_used, __ATOMIC_RELAXED);
+    while (peak < used
+           && !__atomic_compare_exchange_n(&g_peak_heap_used, &peak, used, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+void* sbrk(intptr_t n)
+{
+    size_t used, end;
+
+    if (!heap_base)
         return (void *)(~(size_t)0);
 
-    /* heap_used is never larger than heap_size, and since heap_size <= SIZE_MAX - (size_t)heap_base,
-       there's no integer overflow here.
-     */  
-    heap_ptr = (void *)((size_t)heap_base + (size_t)heap_used);
-    if(n==0) return heap_ptr;
+    /* shrink the heap */
+    if (n < 0) {
+        size_t dec = (size_t)0 - (size_t)n;
 
-    heap_used += n;
+        assert(!is_edmm_supported || (dec & (SE_PAGE_SIZE - 1)) == 0);
+        used = __atomic_load_n(&heap_used, __ATOMIC_SEQ_CST);
+        do {
+            if (used < dec)
+                return (void *)(~(size_t)0);
+        } while (!__atomic_compare_exchange_n(&heap_used, &used, used - dec, 1, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST));
+
+        if (is_edmm_supported)
+            heap_trim();
 
-    /* update g_peak_heap_used */
-    g_peak_heap_used = (g_peak_heap_used < heap_used) ? heap_used : g_peak_heap_used;
+        /* heap_used is never larger than heap_size, and since heap_size <= SIZE_MAX - (size_t)heap_base,
+           there's no integer overflow here.
+         */
+        return (void *)((size_t)heap_base + used - dec);
+    }
 
-    if (is_edmm_supported && heap_used > heap_min_size)
+    /* extend the heap */
+    assert(!is_edmm_supported || (n & (SE_PAGE_SIZE - 1)) == 0);
+    used = __atomic_load_n(&heap_used, __ATOMIC_SEQ_CST);
+    for (;;)
     {
-        assert((n & (SE_PAGE_SIZE - 1)) == 0);
+        if ((used > (SIZE_MAX - (size_t)n)) || ((used + (size_t)n) > heap_size))
+            return (void *)(~(size_t)0);
+        if (n == 0)
+            return (void *)((size_t)heap_base + used);
 
-        if (prev_heap_used > heap_min_size)
+        end = used + (size_t)n;
+        if (end > __atomic_load_n(&heap_committed, __ATOMIC_SEQ_CST))
         {
-            start_addr = heap_ptr;
-            size = n;
+            /* Commit before reserving, so a failed commit leaves the break untouched. */
+            sgx_spin_lock(&heap_lock);
+            int ret = heap_commit_to(end);
+            sgx_spin_unlock(&heap_lock);
+            if (ret != 0)
+                return (void *)(~(size_t)0);
+            used = __atomic_load_n(&heap_used, __ATOMIC_SEQ_CST);
+            continue;
         }
-        else
-        {
+        if (__atomic_compare_exchange_n(&heap_used, &used, end, 1, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+            break;
+    }
 
-            /* heap_min_size is never larger than heap_size, and since heap_size <= SIZE_MAX - (size_t)heap_base,
-               there's no integer overflow here.
-             */  
-            start_addr = (void *)((size_t)(heap_base) + heap_min_size);
-            size = heap_used - heap_min_size;
-        }
-        assert((size & (SE_PAGE_SIZE - 1)) == 0);
-        int ret = mm_commit(start_addr, size);
+    /* A trim may have lowered heap_committed between the check above and the
+       reservation. heap_trim() restores it once it sees the new break, so
+       waiting on heap_lock is enough to make the range usable again.
+     */
+    if (end > __atomic_load_n(&heap_committed, __ATOMIC_SEQ_CST))
+    {
+        sgx_spin_lock(&heap_lock);
+        int ret = heap_commit_to(end);
+        sgx_spin_unlock(&heap_lock);
         if (ret != 0)
         {
-            heap_used = prev_heap_used;
+            size_t expected = end;
+            __atomic_compare_exchange_n(&heap_used, &expected, used, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
             return (void *)(~(size_t)0);
         }
     }
-    return heap_ptr;
+
+    update_peak_heap_used(end);
+
+    /* heap_used is never larger than heap_size, and since heap_size <= SIZE_MAX - (size_t)heap_base,
+       there's no integer overflow here.
+     */
+    return (void *)((size_t)heap_base + used);
 }
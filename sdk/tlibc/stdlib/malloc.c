@@ -563,7 +563,15 @@ typedef int LONG;
 #define USE_SPIN_LOCKS 1
 #define FOOTERS 1
 #define REALLOC_ZERO_BYTES_FREES 1
+#ifndef USE_TCACHE
+#define USE_TCACHE 0
+#endif
 #include "sgx_trts.h" /* sgx_read_rand */
+#if USE_TCACHE
+/* The caches take gm once and call dlmalloc/dlfree repeatedly under it */
+#define USE_RECURSIVE_LOCKS 1
+#include "sgx_thread.h" /* sgx_thread_self */
+#endif
 #include "sgx_error.h" /* SGX_SUCCESS */
 #endif /* _TLIBC_ */
 
@@ -850,10 +858,16 @@ extern "C" {
 /* ------------------- Declarations of public routines ------------------- */
 #ifndef USE_DL_PREFIX
   #define ALIAS(tc_fn)   __attribute__ ((alias (#tc_fn), used))
+#if USE_TCACHE
+  void* __attribute__((weak)) malloc(size_t size)               ALIAS(tcache_malloc);
+  void __attribute__((weak)) free(void* ptr)                     ALIAS(tcache_free);
+  void* __attribute__((weak)) calloc(size_t n, size_t size)      ALIAS(tcache_calloc);
+#else /* USE_TCACHE */
   void* __attribute__((weak)) malloc(size_t size)               ALIAS(dlmalloc);
   void __attribute__((weak)) free(void* ptr)                     ALIAS(dlfree);
-  void* __attribute__((weak)) realloc(void* ptr, size_t size)    ALIAS(dlrealloc);
   void* __attribute__((weak)) calloc(size_t n, size_t size)      ALIAS(dlcalloc);
+#endif /* USE_TCACHE */
+  void* __attribute__((weak)) realloc(void* ptr, size_t size)    ALIAS(dlrealloc);
   void* __attribute__((weak)) memalign(size_t align, size_t s)  ALIAS(dlmemalign); 
   struct mallinfo __attribute__((weak)) mallinfo(void)         ALIAS(dlmallinfo);
   int __attribute__((weak)) posix_memalign(void** pp, size_t alignment, size_t n) ALIAS(dlposix_memalign);
@@ -1543,7 +1557,7 @@ extern void*     sbrk(ptrdiff_t);
 #elif !defined(LACKS_SCHED_H)
 #include <sched.h>
 #endif /* solaris or LACKS_SCHED_H */
-#if (defined(USE_RECURSIVE_LOCKS) && USE_RECURSIVE_LOCKS != 0) || !USE_SPIN_LOCKS
+#if ((defined(USE_RECURSIVE_LOCKS) && USE_RECURSIVE_LOCKS != 0) || !USE_SPIN_LOCKS) && !defined(_TLIBC_)
 #include <pthread.h>
 #endif /* USE_RECURSIVE_LOCKS ... */
 #elif defined(_MSC_VER)
@@ -1953,6 +1967,10 @@ static MLOCK_T malloc_global_mutex = 0;
 #define THREAD_ID_T           DWORD
 #define CURRENT_THREAD        GetCurrentThreadId()
 #define EQ_OWNER(X,Y)         ((X) == (Y))
+#elif defined(_TLIBC_)
+#define THREAD_ID_T           sgx_thread_t
+#define CURRENT_THREAD        sgx_thread_self()
+#define EQ_OWNER(X,Y)         ((X) == (Y))
 #else
 /*
   Note: the following assume that pthread_t is a type that can be
@@ -1976,6 +1994,8 @@ static MLOCK_T malloc_global_mutex = { 0, 0, (THREAD_ID_T)0};
 static FORCEINLINE void recursive_release_lock(MLOCK_T *lk) {
   assert(lk->sl != 0);
   if (--lk->c == 0) {
+    /* So a later holder isn't taken for us before it records itself */
+    lk->threadid = (THREAD_ID_T)0;
     CLEAR_LOCK(&lk->sl);
   }
 }
@@ -4872,6 +4892,211 @@ void* dlcalloc(size_t n_elements, size_t elem_size) {
   return mem;
 }
 
+#if USE_TCACHE
+/* ---------------------- per-TCS small chunk caches ---------------------- */
+
+/*
+  Every TCS keeps one list of free chunks per small chunk size, so most
+  small malloc/free pairs never touch the global lock. A miss takes a
+  batch of chunks from gm and an overflowing list gives half of itself
+  back, each under a single hold of the (recursive) gm lock around plain
+  dlmalloc/dlfree calls. Chunks stay in use as far as gm is concerned
+  while they sit in a cache.
+
+  Chunks are not owned by the cache that handed them out: a chunk freed
+  on another TCS joins the cache of that TCS and goes back to gm when
+  that cache overflows, so cross-TCS frees need no remote queues.
+
+  The thread local storage of a TCS is reset on every root ECALL unless
+  the TCS is bound, so caches are kept on a global list keyed by the
+  thread data of the TCS, and the thread local pointer only saves the
+  list walk.
+*/
+
+#define TCACHE_MAX_CHUNK   ((size_t)512U)
+#define TCACHE_BINS        (((TCACHE_MAX_CHUNK - MIN_CHUNK_SIZE) >> 4) + 1)
+#define TCACHE_BIN_MAX     (64U)   /* chunks kept per size */
+#define TCACHE_REFILL      (16U)   /* chunks taken from gm on a miss */
+#define TCACHE_MAX_BYTES   ((size_t)64U * 1024U)
+#define tcache_index(s)    ((bindex_t)(((s) - MIN_CHUNK_SIZE) >> 4))
+
+typedef struct tcache_s {
+  struct tcache_s* next;   /* all caches, never freed */
+  sgx_thread_t     owner;  /* thread data of the TCS */
+  size_t           bytes;  /* total size of the cached chunks */
+  void*            heads[TCACHE_BINS];
+  unsigned int     counts[TCACHE_BINS];
+} tcache;
+
+static tcache* volatile tcache_list;
+static __thread tcache* tcache_self;
+
+/*
+  Free chunks are linked through their first word, masked with the
+  malloc magic so a stale write through a dangling pointer can't steer
+  malloc to an arbitrary address. The second word holds the same tag in
+  every cache, so a chunk freed again while it sits in the cache of any
+  TCS is caught, and a chunk whose tag was overwritten after it was
+  freed is caught when it is handed out again. Chunks leave a cache only
+  through tcache_pop, which clears the tag, so no chunk outside a cache
+  carries it.
+*/
+#define tcache_link(mem)   (((void**)(mem))[0])
+#define tcache_key(mem)    (((size_t*)(mem))[1])
+#define tcache_mask(tc, v) ((void*)((size_t)(v) ^ mparams.magic ^ (size_t)(tc)))
+#define tcache_tag()       (~mparams.magic)
+
+static tcache* get_tcache(void) {
+  sgx_thread_t owner = sgx_thread_self();
+  tcache* tc = tcache_self;
+  if (tc != 0 && tc->owner == owner)
+    return tc;
+  if (owner == 0)
+    return 0;
+  for (tc = tcache_list; tc != 0; tc = tc->next) {
+    if (tc->owner == owner)
+      break;
+  }
+  if (tc == 0) {
+    tc = (tcache*)dlmalloc(sizeof(tcache));
+    if (tc == 0)
+      return 0;
+    memset(tc, 0, sizeof(tcache));
+    tc->owner = owner;
+    do {
+      tc->next = tcache_list;
+    } while (!__sync_bool_compare_and_swap(&tcache_list, tc->next, tc));
+  }
+  tcache_self = tc;
+  return tc;
+}
+
+static void tcache_push(tcache* tc, bindex_t i, void* mem) {
+  tcache_link(mem) = tcache_mask(tc, tc->heads[i]);
+  tcache_key(mem) = tcache_tag();
+  tc->heads[i] = mem;
+  tc->counts[i]++;
+  tc->bytes += chunksize(mem2chunk(mem));
+}
+
+static void* tcache_pop(tcache* tc, bindex_t i) {
+  void* mem = tc->heads[i];
+  mchunkptr p = mem2chunk(mem);
+  if (!RTCHECK(ok_address(gm, p) && ok_inuse(p) &&
+               tcache_key(mem) == tcache_tag())) {
+    CORRUPTION_ERROR_ACTION(gm);
+    return 0;
+  }
+  tc->heads[i] = tcache_mask(tc, tcache_link(mem));
+  tc->counts[i]--;
+  tc->bytes -= chunksize(p);
+  tcache_key(mem) = 0;
+  return mem;
+}
+
+/* Fill an empty list with up to TCACHE_REFILL chunks of size nb. */
+static int tcache_refill(tcache* tc, bindex_t i, size_t nb) {
+  unsigned int n = 0;
+#if USE_LOCKS
+  ensure_initialization();
+#endif
+  if (!PREACTION(gm)) {
+    for (; n < TCACHE_REFILL; ++n) {
+      void* mem = dlmalloc(nb - CHUNK_OVERHEAD);
+      if (mem == 0)
+        break;
+      tcache_push(tc, i, mem);
+    }
+    POSTACTION(gm);
+  }
+  return n != 0;
+}
+
+/* Give chunks of list i back to gm until it holds at most keep chunks. */
+static void tcache_trim(tcache* tc, bindex_t i, unsigned int keep) {
+  while (tc->counts[i] > keep) {
+    void* mem = tcache_pop(tc, i);
+    if (mem == 0)
+      break;
+    dlfree(mem);
+  }
+}
+
+static void tcache_flush(tcache* tc, bindex_t i, unsigned int keep) {
+  if (!PREACTION(gm)) {
+    tcache_trim(tc, i, keep);
+    POSTACTION(gm);
+  }
+}
+
+/* Halve every list, until the cache is back under TCACHE_MAX_BYTES / 2. */
+static void tcache_flush_all(tcache* tc) {
+  if (!PREACTION(gm)) {
+    bindex_t i;
+    for (i = 0; i < TCACHE_BINS && tc->bytes > TCACHE_MAX_BYTES / 2; ++i)
+      tcache_trim(tc, i, tc->counts[i] / 2);
+    for (i = 0; i < TCACHE_BINS && tc->bytes > TCACHE_MAX_BYTES / 2; ++i)
+      tcache_trim(tc, i, 0);
+    POSTACTION(gm);
+  }
+}
+
+static void* tcache_malloc(size_t bytes) {
+  if (bytes <= TCACHE_MAX_CHUNK - CHUNK_OVERHEAD) {
+    size_t nb = request2size(bytes);
+    bindex_t i = tcache_index(nb);
+    tcache* tc = get_tcache();
+    if (tc != 0 && (tc->counts[i] != 0 || tcache_refill(tc, i, nb)))
+      return tcache_pop(tc, i);
+  }
+  return dlmalloc(bytes);
+}
+
+static void tcache_free(void* mem) {
+  if (mem != 0) {
+    mchunkptr p = mem2chunk(mem);
+    size_t psize = chunksize(p);
+    tcache* tc;
+    if (psize >= MIN_CHUNK_SIZE && psize <= TCACHE_MAX_CHUNK &&
+#if FOOTERS
+        get_mstate_for(p) == gm &&
+#endif /* FOOTERS */
+        RTCHECK(ok_address(gm, p) && ok_inuse(p)) &&
+        (tc = get_tcache()) != 0) {
+      bindex_t i = tcache_index(psize);
+      if (tcache_key(mem) == tcache_tag()) {
+        /* Already in the cache of this or another TCS */
+        USAGE_ERROR_ACTION(gm, p);
+        return;
+      }
+      tcache_push(tc, i, mem);
+      if (tc->bytes > TCACHE_MAX_BYTES)
+        tcache_flush_all(tc);
+      else if (tc->counts[i] > TCACHE_BIN_MAX)
+        tcache_flush(tc, i, TCACHE_BIN_MAX / 2);
+      return;
+    }
+  }
+  dlfree(mem);
+}
+
+static void* tcache_calloc(size_t n_elements, size_t elem_size) {
+  void* mem;
+  size_t req = 0;
+  if (n_elements != 0) {
+    req = n_elements * elem_size;
+    if (((n_elements | elem_size) & ~(size_t)0xffff) &&
+        (req / n_elements != elem_size))
+      req = MAX_SIZE_T; /* force downstream failure on overflow */
+  }
+  mem = tcache_malloc(req);
+  if (mem != 0)
+    memset(mem, 0, req);
+  return mem;
+}
+
+#endif /* USE_TCACHE */
+
 #endif /* !ONLY_MSPACES */
 
 /* ------------ Internal support for realloc, memalign, etc -------------- */
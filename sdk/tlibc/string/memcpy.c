@@ -99,6 +99,10 @@ done:
 
 extern void* __memcpy_verw(void *dst0, const void *src0);
 extern void* __memcpy_8a(void *dst0, const void *src0);
+
+/* in-enclave staging buffer used to realign the source for memcpy_verw */
+#define	VERW_BOUNCE_SIZE	512
+
 // use in the enclave when dst is outside the enclave
 void* memcpy_verw(void *dst0, const void *src0, size_t len)
 {
@@ -109,23 +113,39 @@ void* memcpy_verw(void *dst0, const void *src0, size_t len)
         return dst0;
     }
 
-    while (len >= 8) {
-        if(((unsigned long long)dst%8 == 0) && ((unsigned long long)src%8 == 0)) {
-            // 8-byte-aligned - don't need <VERW><MFENCE LFENCE> bracketing
-            size_t len0 = len - len%8;
+    // not 8-byte-aligned head - need <VERW><MFENCE LFENCE> bracketing
+    while (len > 0 && ((unsigned long long)dst%8 != 0)) {
+        __memcpy_verw(dst, src);
+        src++;
+        dst++;
+        len--;
+    }
+
+    if (len >= 8) {
+        // dst is 8-byte-aligned - don't need <VERW><MFENCE LFENCE> bracketing
+        size_t len0 = len - len%8;
+        if ((unsigned long long)src%8 == 0) {
             memcpy_nochecks(dst, src, len0);
             src += len0;
             dst += len0;
-            len -= len0;
         }
-        else{
-            // not 8-byte-aligned - need <VERW><MFENCE LFENCE> bracketing
-            __memcpy_verw(dst, src);
-            src++;
-            dst++;
-            len--;
+        else {
+            // realign src through the bounce buffer so that dst is still
+            // written with 8-byte-aligned stores only
+            long bounce[VERW_BOUNCE_SIZE / sizeof(long)];
+            size_t left = len0;
+            while (left > 0) {
+                size_t chunk = left < VERW_BOUNCE_SIZE ? left : VERW_BOUNCE_SIZE;
+                memcpy_nochecks(bounce, src, chunk);
+                memcpy_nochecks(dst, bounce, chunk);
+                src += chunk;
+                dst += chunk;
+                left -= chunk;
+            }
         }
+        len -= len0;
     }
+
     // less than 8 bytes left - need <VERW> <MFENCE LFENCE> bracketing
     for (unsigned i = 0; i < len; i++) {
         __memcpy_verw(dst, src);
@@ -32,6 +32,7 @@
 #include "sgx_tcrypto.h"
 #include "ippcp.h"
 #include "ipp_wrapper.h"
+#include "se_cdefs.h"
 #include "stdlib.h"
 #include "string.h"
 #include <limits.h>
@@ -64,43 +65,12 @@ static void fips_self_test_aes_gcm()
     return;
 }
 
-static sgx_status_t aes_gcm_encrypt_internal(const uint8_t *p_key, uint32_t key_len, const uint8_t *p_src, uint32_t src_len,
-                                             uint8_t *p_dst, const uint8_t *p_iv, uint32_t iv_len, const uint8_t *p_aad,
-                                             uint32_t aad_len, sgx_aes_gcm_128bit_tag_t *p_out_mac)
+static sgx_status_t aes_gcm_init_state(const uint8_t *p_key, uint32_t key_len, IppsAES_GCMState *pState, int ippStateSize)
 {
-    IppStatus error_code = ippStsNoErr;
-    IppsAES_GCMState *pState = NULL;
-    int ippStateSize = 0;
     const int noise_level = 1;
-
-    if ((p_key == NULL) || ((src_len > 0) && (p_dst == NULL)) || ((src_len > 0) && (p_src == NULL)) || (p_out_mac == NULL)
-        || (iv_len != SGX_AESGCM_IV_SIZE) || ((aad_len > 0) && (p_aad == NULL)) || (p_iv == NULL) || ((p_src == NULL) && (p_aad == NULL)))
-    {
-        return SGX_ERROR_INVALID_PARAMETER;
-    }
-    if (key_len != SGX_AESGCM_KEY_SIZE && key_len != SGX_AESGCM_KEY256_SIZE)
-    {
-        return SGX_ERROR_INVALID_PARAMETER;
-    }
-
-    fips_self_test_aes_gcm();
-
-    error_code = ippsAES_GCMGetSize(&ippStateSize);
-    if (error_code != ippStsNoErr)
-    {
-        return SGX_ERROR_UNEXPECTED;
-    }
-    pState = (IppsAES_GCMState *)malloc(ippStateSize);
-    if (pState == NULL)
-    {
-        return SGX_ERROR_OUT_OF_MEMORY;
-    }
-    error_code = ippsAES_GCMInit((const Ipp8u *)p_key, key_len, pState, ippStateSize);
+    IppStatus error_code = ippsAES_GCMInit((const Ipp8u *)p_key, key_len, pState, ippStateSize);
     if (error_code != ippStsNoErr)
     {
-        // Clear temp State before free.
-        memset_s(pState, ippStateSize, 0, ippStateSize);
-        free(pState);
         switch (error_code)
         {
         case ippStsMemAllocErr:
@@ -115,16 +85,17 @@ static sgx_status_t aes_gcm_encrypt_internal(const uint8_t *p_key, uint32_t key_
     error_code = ippsAES_GCMSetupNoise(noise_level, pState);
     if (error_code != ippStsNoErr)
     {
-        memset_s(pState, ippStateSize, 0, ippStateSize);
-        free(pState);
         return SGX_ERROR_UNEXPECTED;
     }
-    error_code = ippsAES_GCMStart(p_iv, SGX_AESGCM_IV_SIZE, p_aad, aad_len, pState);
+    return SGX_SUCCESS;
+}
+
+static sgx_status_t aes_gcm_encrypt_state(IppsAES_GCMState *pState, const uint8_t *p_src, uint32_t src_len, uint8_t *p_dst,
+                                          const uint8_t *p_iv, const uint8_t *p_aad, uint32_t aad_len, sgx_aes_gcm_128bit_tag_t *p_out_mac)
+{
+    IppStatus error_code = ippsAES_GCMStart(p_iv, SGX_AESGCM_IV_SIZE, p_aad, aad_len, pState);
     if (error_code != ippStsNoErr)
     {
-        // Clear temp State before free.
-        memset_s(pState, ippStateSize, 0, ippStateSize);
-        free(pState);
         switch (error_code)
         {
         case ippStsNullPtrErr:
@@ -139,9 +110,6 @@ static sgx_status_t aes_gcm_encrypt_internal(const uint8_t *p_key, uint32_t key_
         error_code = ippsAES_GCMEncrypt(p_src, p_dst, src_len, pState);
         if (error_code != ippStsNoErr)
         {
-            // Clear temp State before free.
-            memset_s(pState, ippStateSize, 0, ippStateSize);
-            free(pState);
             switch (error_code)
             {
             case ippStsNullPtrErr:
@@ -154,10 +122,7 @@ static sgx_status_t aes_gcm_encrypt_internal(const uint8_t *p_key, uint32_t key_
     error_code = ippsAES_GCMGetTag((Ipp8u *)p_out_mac, SGX_AESGCM_MAC_SIZE, pState);
     if (error_code != ippStsNoErr)
     {
-        // Clear temp State before free.
         memset_s(p_dst, src_len, 0, src_len);
-        memset_s(pState, ippStateSize, 0, ippStateSize);
-        free(pState);
         switch (error_code)
         {
         case ippStsNullPtrErr:
@@ -167,77 +132,19 @@ static sgx_status_t aes_gcm_encrypt_internal(const uint8_t *p_key, uint32_t key_
             return SGX_ERROR_UNEXPECTED;
         }
     }
-    // Clear temp State before free.
-    memset_s(pState, ippStateSize, 0, ippStateSize);
-    free(pState);
     return SGX_SUCCESS;
 }
 
-static sgx_status_t aes_gcm_decrypt_internal(const uint8_t *p_key, uint32_t key_len, const uint8_t *p_src, uint32_t src_len,
-                                             uint8_t *p_dst, const uint8_t *p_iv, uint32_t iv_len, const uint8_t *p_aad, uint32_t aad_len,
-                                             const sgx_aes_gcm_128bit_tag_t *p_in_mac)
+static sgx_status_t aes_gcm_decrypt_state(IppsAES_GCMState *pState, const uint8_t *p_src, uint32_t src_len, uint8_t *p_dst,
+                                          const uint8_t *p_iv, const uint8_t *p_aad, uint32_t aad_len, const sgx_aes_gcm_128bit_tag_t *p_in_mac)
 {
-    IppStatus error_code = ippStsNoErr;
     uint8_t l_tag[SGX_AESGCM_MAC_SIZE];
-    IppsAES_GCMState *pState = NULL;
-    int ippStateSize = 0;
-    const int noise_level = 1;
-
-    if ((p_key == NULL) || ((src_len > 0) && (p_dst == NULL)) || ((src_len > 0) && (p_src == NULL)) || (p_in_mac == NULL)
-        || (iv_len != SGX_AESGCM_IV_SIZE) || ((aad_len > 0) && (p_aad == NULL)) || (p_iv == NULL) || ((p_src == NULL) && (p_aad == NULL)))
-    {
-        return SGX_ERROR_INVALID_PARAMETER;
-    }
-    // Currently only accept 128-bits key and 256-bits key
-    if (key_len != SGX_AESGCM_KEY_SIZE && key_len != SGX_AESGCM_KEY256_SIZE)
-    {
-        return SGX_ERROR_INVALID_PARAMETER;
-    }
-
-    fips_self_test_aes_gcm();
 
     // Autenthication Tag returned by Decrypt to be compared with Tag created during seal
     memset(&l_tag, 0, SGX_AESGCM_MAC_SIZE);
-    error_code = ippsAES_GCMGetSize(&ippStateSize);
+    IppStatus error_code = ippsAES_GCMStart(p_iv, SGX_AESGCM_IV_SIZE, p_aad, aad_len, pState);
     if (error_code != ippStsNoErr)
     {
-        return SGX_ERROR_UNEXPECTED;
-    }
-    pState = (IppsAES_GCMState *)malloc(ippStateSize);
-    if (pState == NULL)
-    {
-        return SGX_ERROR_OUT_OF_MEMORY;
-    }
-    error_code = ippsAES_GCMInit((const Ipp8u *)p_key, key_len, pState, ippStateSize);
-    if (error_code != ippStsNoErr)
-    {
-        // Clear temp State before free.
-        memset_s(pState, ippStateSize, 0, ippStateSize);
-        free(pState);
-        switch (error_code)
-        {
-        case ippStsMemAllocErr:
-            return SGX_ERROR_OUT_OF_MEMORY;
-        case ippStsNullPtrErr:
-        case ippStsLengthErr:
-            return SGX_ERROR_INVALID_PARAMETER;
-        default:
-            return SGX_ERROR_UNEXPECTED;
-        }
-    }
-    error_code = ippsAES_GCMSetupNoise(noise_level, pState);
-    if (error_code != ippStsNoErr)
-    {
-        memset_s(pState, ippStateSize, 0, ippStateSize);
-        free(pState);
-        return SGX_ERROR_UNEXPECTED;
-    }
-    error_code = ippsAES_GCMStart(p_iv, SGX_AESGCM_IV_SIZE, p_aad, aad_len, pState);
-    if (error_code != ippStsNoErr)
-    {
-        // Clear temp State before free.
-        memset_s(pState, ippStateSize, 0, ippStateSize);
-        free(pState);
         switch (error_code)
         {
         case ippStsNullPtrErr:
@@ -252,9 +159,6 @@ static sgx_status_t aes_gcm_decrypt_internal(const uint8_t *p_key, uint32_t key_
         error_code = ippsAES_GCMDecrypt(p_src, p_dst, src_len, pState);
         if (error_code != ippStsNoErr)
         {
-            // Clear temp State before free.
-            memset_s(pState, ippStateSize, 0, ippStateSize);
-            free(pState);
             switch (error_code)
             {
             case ippStsNullPtrErr:
@@ -267,10 +171,7 @@ static sgx_status_t aes_gcm_decrypt_internal(const uint8_t *p_key, uint32_t key_
     error_code = ippsAES_GCMGetTag((Ipp8u *)l_tag, SGX_AESGCM_MAC_SIZE, pState);
     if (error_code != ippStsNoErr)
     {
-        // Clear temp State before free.
         memset_s(p_dst, src_len, 0, src_len);
-        memset_s(pState, ippStateSize, 0, ippStateSize);
-        free(pState);
         switch (error_code)
         {
         case ippStsNullPtrErr:
@@ -280,9 +181,6 @@ static sgx_status_t aes_gcm_decrypt_internal(const uint8_t *p_key, uint32_t key_
             return SGX_ERROR_UNEXPECTED;
         }
     }
-    // Clear temp State before free.
-    memset_s(pState, ippStateSize, 0, ippStateSize);
-    free(pState);
 
     // Verify current data tag = data tag generated when sealing the data blob
     if (consttime_memequal(p_in_mac, &l_tag, SGX_AESGCM_MAC_SIZE) == 0)
@@ -296,6 +194,110 @@ static sgx_status_t aes_gcm_decrypt_internal(const uint8_t *p_key, uint32_t key_
     return SGX_SUCCESS;
 }
 
+/* One-shot calls expand the key into a state on the stack, which is
+ * scrubbed on return. ippsAES_GCMGetSize() reports a small constant that
+ * fits; if a larger state is ever reported it comes from the heap instead.
+ */
+#define AES_GCM_STACK_STATE_SIZE 4096
+
+static IppsAES_GCMState *aes_gcm_temp_state(uint8_t *stack_buf, int state_size)
+{
+    if (state_size <= AES_GCM_STACK_STATE_SIZE)
+    {
+        return reinterpret_cast<IppsAES_GCMState *>(stack_buf);
+    }
+    return (IppsAES_GCMState *)malloc(state_size);
+}
+
+static void aes_gcm_clear_temp_state(IppsAES_GCMState *pState, uint8_t *stack_buf, int state_size)
+{
+    if (reinterpret_cast<uint8_t *>(pState) == stack_buf)
+    {
+        memset_s(stack_buf, AES_GCM_STACK_STATE_SIZE, 0, state_size);
+        return;
+    }
+    CLEAR_FREE_MEM(pState, state_size);
+}
+
+static sgx_status_t aes_gcm_encrypt_internal(const uint8_t *p_key, uint32_t key_len, const uint8_t *p_src, uint32_t src_len,
+                                             uint8_t *p_dst, const uint8_t *p_iv, uint32_t iv_len, const uint8_t *p_aad,
+                                             uint32_t aad_len, sgx_aes_gcm_128bit_tag_t *p_out_mac)
+{
+    SE_DECLSPEC_ALIGN(16) uint8_t state_buf[AES_GCM_STACK_STATE_SIZE];
+    IppsAES_GCMState *pState = NULL;
+    int ippStateSize = 0;
+    sgx_status_t ret = SGX_ERROR_UNEXPECTED;
+
+    if ((p_key == NULL) || ((src_len > 0) && (p_dst == NULL)) || ((src_len > 0) && (p_src == NULL)) || (p_out_mac == NULL)
+        || (iv_len != SGX_AESGCM_IV_SIZE) || ((aad_len > 0) && (p_aad == NULL)) || (p_iv == NULL) || ((p_src == NULL) && (p_aad == NULL)))
+    {
+        return SGX_ERROR_INVALID_PARAMETER;
+    }
+    if (key_len != SGX_AESGCM_KEY_SIZE && key_len != SGX_AESGCM_KEY256_SIZE)
+    {
+        return SGX_ERROR_INVALID_PARAMETER;
+    }
+
+    fips_self_test_aes_gcm();
+
+    if (ippsAES_GCMGetSize(&ippStateSize) != ippStsNoErr)
+    {
+        return SGX_ERROR_UNEXPECTED;
+    }
+    pState = aes_gcm_temp_state(state_buf, ippStateSize);
+    if (pState == NULL)
+    {
+        return SGX_ERROR_OUT_OF_MEMORY;
+    }
+    ret = aes_gcm_init_state(p_key, key_len, pState, ippStateSize);
+    if (ret == SGX_SUCCESS)
+    {
+        ret = aes_gcm_encrypt_state(pState, p_src, src_len, p_dst, p_iv, p_aad, aad_len, p_out_mac);
+    }
+    aes_gcm_clear_temp_state(pState, state_buf, ippStateSize);
+    return ret;
+}
+
+static sgx_status_t aes_gcm_decrypt_internal(const uint8_t *p_key, uint32_t key_len, const uint8_t *p_src, uint32_t src_len,
+                                             uint8_t *p_dst, const uint8_t *p_iv, uint32_t iv_len, const uint8_t *p_aad, uint32_t aad_len,
+                                             const sgx_aes_gcm_128bit_tag_t *p_in_mac)
+{
+    SE_DECLSPEC_ALIGN(16) uint8_t state_buf[AES_GCM_STACK_STATE_SIZE];
+    IppsAES_GCMState *pState = NULL;
+    int ippStateSize = 0;
+    sgx_status_t ret = SGX_ERROR_UNEXPECTED;
+
+    if ((p_key == NULL) || ((src_len > 0) && (p_dst == NULL)) || ((src_len > 0) && (p_src == NULL)) || (p_in_mac == NULL)
+        || (iv_len != SGX_AESGCM_IV_SIZE) || ((aad_len > 0) && (p_aad == NULL)) || (p_iv == NULL) || ((p_src == NULL) && (p_aad == NULL)))
+    {
+        return SGX_ERROR_INVALID_PARAMETER;
+    }
+    // Currently only accept 128-bits key and 256-bits key
+    if (key_len != SGX_AESGCM_KEY_SIZE && key_len != SGX_AESGCM_KEY256_SIZE)
+    {
+        return SGX_ERROR_INVALID_PARAMETER;
+    }
+
+    fips_self_test_aes_gcm();
+
+    if (ippsAES_GCMGetSize(&ippStateSize) != ippStsNoErr)
+    {
+        return SGX_ERROR_UNEXPECTED;
+    }
+    pState = aes_gcm_temp_state(state_buf, ippStateSize);
+    if (pState == NULL)
+    {
+        return SGX_ERROR_OUT_OF_MEMORY;
+    }
+    ret = aes_gcm_init_state(p_key, key_len, pState, ippStateSize);
+    if (ret == SGX_SUCCESS)
+    {
+        ret = aes_gcm_decrypt_state(pState, p_src, src_len, p_dst, p_iv, p_aad, aad_len, p_in_mac);
+    }
+    aes_gcm_clear_temp_state(pState, state_buf, ippStateSize);
+    return ret;
+}
+
 /* Rijndael AES-GCM
  * Parameters:
  *   Return: sgx_status_t  - SGX_SUCCESS or failure as defined sgx_error.h
@@ -350,6 +352,69 @@ sgx_status_t sgx_aes_gcm_decrypt(const uint8_t *p_key, uint32_t key_len, const u
     return aes_gcm_decrypt_internal(p_key, key_len, p_src, src_len, p_dst, p_iv, iv_len, p_aad, aad_len, p_in_mac);
 }
 
+sgx_status_t sgx_aes_gcm_key_init(const uint8_t *p_key, uint32_t key_len, sgx_aes_state_handle_t *p_key_state)
+{
+    if ((p_key == NULL) || (p_key_state == NULL))
+    {
+        return SGX_ERROR_INVALID_PARAMETER;
+    }
+    if (key_len != SGX_AESGCM_KEY_SIZE && key_len != SGX_AESGCM_KEY256_SIZE)
+    {
+        return SGX_ERROR_INVALID_PARAMETER;
+    }
+
+    fips_self_test_aes_gcm();
+
+    int state_size = 0;
+    if (ippsAES_GCMGetSize(&state_size) != ippStsNoErr)
+    {
+        return SGX_ERROR_UNEXPECTED;
+    }
+    IppsAES_GCMState *p_state = reinterpret_cast<IppsAES_GCMState *>(malloc(state_size));
+    if (p_state == NULL)
+    {
+        return SGX_ERROR_OUT_OF_MEMORY;
+    }
+    sgx_status_t ret = aes_gcm_init_state(p_key, key_len, p_state, state_size);
+    if (ret != SGX_SUCCESS)
+    {
+        CLEAR_FREE_MEM(p_state, state_size);
+        return ret;
+    }
+    *p_key_state = p_state;
+    return SGX_SUCCESS;
+}
+
+sgx_status_t sgx_aes_gcm_key_encrypt(sgx_aes_state_handle_t key_state, const uint8_t *p_src, uint32_t src_len,
+                                     uint8_t *p_dst, const uint8_t *p_iv, uint32_t iv_len, const uint8_t *p_aad,
+                                     uint32_t aad_len, sgx_aes_gcm_128bit_tag_t *p_out_mac)
+{
+    if ((key_state == NULL) || ((src_len > 0) && (p_dst == NULL)) || ((src_len > 0) && (p_src == NULL)) || (p_out_mac == NULL)
+        || (iv_len != SGX_AESGCM_IV_SIZE) || ((aad_len > 0) && (p_aad == NULL)) || (p_iv == NULL) || ((p_src == NULL) && (p_aad == NULL)))
+    {
+        return SGX_ERROR_INVALID_PARAMETER;
+    }
+
+    fips_self_test_aes_gcm();
+
+    return aes_gcm_encrypt_state((IppsAES_GCMState *)key_state, p_src, src_len, p_dst, p_iv, p_aad, aad_len, p_out_mac);
+}
+
+sgx_status_t sgx_aes_gcm_key_decrypt(sgx_aes_state_handle_t key_state, const uint8_t *p_src, uint32_t src_len,
+                                     uint8_t *p_dst, const uint8_t *p_iv, uint32_t iv_len, const uint8_t *p_aad,
+                                     uint32_t aad_len, const sgx_aes_gcm_128bit_tag_t *p_in_mac)
+{
+    if ((key_state == NULL) || ((src_len > 0) && (p_dst == NULL)) || ((src_len > 0) && (p_src == NULL)) || (p_in_mac == NULL)
+        || (iv_len != SGX_AESGCM_IV_SIZE) || ((aad_len > 0) && (p_aad == NULL)) || (p_iv == NULL) || ((p_src == NULL) && (p_aad == NULL)))
+    {
+        return SGX_ERROR_INVALID_PARAMETER;
+    }
+
+    fips_self_test_aes_gcm();
+
+    return aes_gcm_decrypt_state((IppsAES_GCMState *)key_state, p_src, src_len, p_dst, p_iv, p_aad, aad_len, p_in_mac);
+}
+
 sgx_status_t sgx_aes_gcm128_enc_init(const uint8_t *key, const uint8_t *iv, uint32_t iv_len, const uint8_t *aad,
                                      uint32_t aad_len, sgx_aes_state_handle_t *aes_gcm_state)
 {
@@ -253,6 +253,147 @@ sgx_status_t sgx_aes_gcm_decrypt(const uint8_t *p_key, uint32_t key_len, const u
     return aes_gcm_decrypt_internal(p_key, key_len, p_src, src_len, p_dst, p_iv, iv_len, p_aad, aad_len, p_in_mac);
 }
 
+sgx_status_t sgx_aes_gcm_key_init(const uint8_t *p_key, uint32_t key_len, sgx_aes_state_handle_t *p_key_state)
+{
+    if ((p_key == NULL) || (p_key_state == NULL))
+    {
+        return SGX_ERROR_INVALID_PARAMETER;
+    }
+    if (key_len != SGX_AESGCM_KEY_SIZE && key_len != SGX_AESGCM_KEY256_SIZE)
+    {
+        return SGX_ERROR_INVALID_PARAMETER;
+    }
+
+    sgx_status_t ret = SGX_ERROR_UNEXPECTED;
+    EVP_CIPHER_CTX *pState = NULL;
+    const EVP_CIPHER *chpher = (key_len == SGX_AESGCM_KEY_SIZE ? EVP_aes_128_gcm() : EVP_aes_256_gcm());
+    do
+    {
+        if (!(pState = EVP_CIPHER_CTX_new()))
+        {
+            ret = SGX_ERROR_OUT_OF_MEMORY;
+            break;
+        }
+
+        // Expand the key once, the IV is set on every encrypt/decrypt
+        //
+        if (1 != EVP_CipherInit_ex(pState, chpher, NULL, (unsigned char *)p_key, NULL, 1))
+        {
+            break;
+        }
+
+        *p_key_state = pState;
+        ret = SGX_SUCCESS;
+    } while (0);
+
+    if (ret != SGX_SUCCESS && pState != NULL)
+    {
+        EVP_CIPHER_CTX_free(pState);
+    }
+    return ret;
+}
+
+sgx_status_t sgx_aes_gcm_key_encrypt(sgx_aes_state_handle_t key_state, const uint8_t *p_src, uint32_t src_len,
+                                     uint8_t *p_dst, const uint8_t *p_iv, uint32_t iv_len, const uint8_t *p_aad,
+                                     uint32_t aad_len, sgx_aes_gcm_128bit_tag_t *p_out_mac)
+{
+    if ((src_len >= INT_MAX) || (aad_len >= INT_MAX) || (key_state == NULL) || ((src_len > 0) && (p_dst == NULL)) || ((src_len > 0) && (p_src == NULL)) || (p_out_mac == NULL) || (iv_len != SGX_AESGCM_IV_SIZE) || ((aad_len > 0) && (p_aad == NULL)) || (p_iv == NULL) || ((p_src == NULL) && (p_aad == NULL)))
+    {
+        return SGX_ERROR_INVALID_PARAMETER;
+    }
+
+    int len = 0;
+    sgx_status_t ret = SGX_ERROR_UNEXPECTED;
+    EVP_CIPHER_CTX *pState = (EVP_CIPHER_CTX *)key_state;
+    do
+    {
+        // Start a new message with the given IV, the expanded key is kept
+        //
+        if (1 != EVP_CipherInit_ex(pState, NULL, NULL, NULL, p_iv, 1))
+        {
+            break;
+        }
+        if (NULL != p_aad)
+        {
+            if (1 != EVP_EncryptUpdate(pState, NULL, &len, p_aad, aad_len))
+            {
+                break;
+            }
+        }
+        if (src_len > 0)
+        {
+            if (1 != EVP_EncryptUpdate(pState, p_dst, &len, p_src, src_len))
+            {
+                break;
+            }
+        }
+        if (1 != EVP_EncryptFinal_ex(pState, p_dst + len, &len))
+        {
+            break;
+        }
+        if (1 != EVP_CIPHER_CTX_ctrl(pState, EVP_CTRL_GCM_GET_TAG, SGX_AESGCM_MAC_SIZE, p_out_mac))
+        {
+            break;
+        }
+        ret = SGX_SUCCESS;
+    } while (0);
+
+    return ret;
+}
+
+sgx_status_t sgx_aes_gcm_key_decrypt(sgx_aes_state_handle_t key_state, const uint8_t *p_src, uint32_t src_len,
+                                     uint8_t *p_dst, const uint8_t *p_iv, uint32_t iv_len, const uint8_t *p_aad,
+                                     uint32_t aad_len, const sgx_aes_gcm_128bit_tag_t *p_in_mac)
+{
+    uint8_t l_tag[SGX_AESGCM_MAC_SIZE];
+
+    if ((src_len >= INT_MAX) || (aad_len >= INT_MAX) || (key_state == NULL) || ((src_len > 0) && (p_dst == NULL)) || ((src_len > 0) && (p_src == NULL)) || (p_in_mac == NULL) || (iv_len != SGX_AESGCM_IV_SIZE) || ((aad_len > 0) && (p_aad == NULL)) || (p_iv == NULL) || ((p_src == NULL) && (p_aad == NULL)))
+    {
+        return SGX_ERROR_INVALID_PARAMETER;
+    }
+
+    int len = 0;
+    sgx_status_t ret = SGX_ERROR_UNEXPECTED;
+    EVP_CIPHER_CTX *pState = (EVP_CIPHER_CTX *)key_state;
+    memcpy(l_tag, p_in_mac, SGX_AESGCM_MAC_SIZE);
+    do
+    {
+        // Start a new message with the given IV, the expanded key is kept
+        //
+        if (1 != EVP_CipherInit_ex(pState, NULL, NULL, NULL, p_iv, 0))
+        {
+            break;
+        }
+        if (NULL != p_aad)
+        {
+            if (!EVP_DecryptUpdate(pState, NULL, &len, p_aad, aad_len))
+            {
+                break;
+            }
+        }
+        if (!EVP_DecryptUpdate(pState, p_dst, &len, p_src, src_len))
+        {
+            break;
+        }
+        if (!EVP_CIPHER_CTX_ctrl(pState, EVP_CTRL_GCM_SET_TAG, SGX_AESGCM_MAC_SIZE, l_tag))
+        {
+            break;
+        }
+        // A positive return value indicates success, anything else is a failure - the plaintext is not trustworthy.
+        //
+        if (EVP_DecryptFinal_ex(pState, p_dst + len, &len) <= 0)
+        {
+            memset_s(p_dst, src_len, 0, src_len);
+            ret = SGX_ERROR_MAC_MISMATCH;
+            break;
+        }
+        ret = SGX_SUCCESS;
+    } while (0);
+
+    memset_s(&l_tag, SGX_AESGCM_MAC_SIZE, 0, SGX_AESGCM_MAC_SIZE);
+    return ret;
+}
+
 sgx_status_t sgx_aes_gcm128_enc_init(const uint8_t *key, const uint8_t *iv, uint32_t iv_len, const uint8_t *aad,
     uint32_t aad_len, sgx_aes_state_handle_t* aes_gcm_state)
 {
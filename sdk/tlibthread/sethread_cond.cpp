@@ -87,9 +87,9 @@ int sgx_thread_cond_wait(sgx_thread_cond_t *cond, sgx_thread_mutex_t *mutex)
         SPIN_UNLOCK(&cond->m_lock);
         /* OPT: if there is a thread waiting on the mutex, wake it in a single OCALL. */
         if (waiter == SGX_THREAD_T_NULL) {
-            sgx_thread_wait_untrusted_event_ocall(&ret, TD2TCS(self));
+            ret = sgx_thread_wait_event(TD2TCS(self));
         } else {
-            sgx_thread_setwait_untrusted_events_ocall(&ret, TD2TCS(waiter), TD2TCS(self));
+            ret = sgx_thread_setwait_events(TD2TCS(waiter), TD2TCS(self));
             waiter = SGX_THREAD_T_NULL;
         }
         SPIN_LOCK(&cond->m_lock);
@@ -108,7 +108,6 @@ int sgx_thread_cond_wait(sgx_thread_cond_t *cond, sgx_thread_mutex_t *mutex)
 
 int sgx_thread_cond_signal(sgx_thread_cond_t *cond)
 {
-    int err = 0;
     sgx_thread_t waiter = SGX_THREAD_T_NULL;
 
     CHECK_PARAMETER(cond);
@@ -122,14 +121,14 @@ int sgx_thread_cond_signal(sgx_thread_cond_t *cond)
     QUEUE_REMOVE_HEAD(&cond->m_queue);
     SPIN_UNLOCK(&cond->m_lock);
 
-    sgx_thread_set_untrusted_event_ocall(&err, TD2TCS(waiter));    /* wake first pending thread */
+    sgx_thread_set_event(TD2TCS(waiter));    /* wake first pending thread */
 
     return 0;
 }
 
 int sgx_thread_cond_broadcast(sgx_thread_cond_t *cond)
 {
-    size_t n_waiter = 0; int err = 0;
+    size_t n_waiter = 0;
     sgx_thread_t waiter = SGX_THREAD_T_NULL;
     const void **waiters = NULL;
 
@@ -156,7 +155,7 @@ int sgx_thread_cond_broadcast(sgx_thread_cond_t *cond)
 
     SPIN_UNLOCK(&cond->m_lock);
 
-    sgx_thread_set_multiple_untrusted_events_ocall(&err, waiters, n_waiter);   /* wake all pending threads up */
+    sgx_thread_set_multiple_events(waiters, n_waiter);   /* wake all pending threads up */
     free(waiters);
     return 0;
 }
@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include <stdlib.h>
+#include <limits.h>
+
+#include "util.h"
+#include "sethread_internal.h"
+
+/* Only present when the enclave EDL imports it from sgx_tstdc.edl. */
+extern "C" sgx_status_t sgx_thread_get_event_words_ocall(int* retval, const void *self,
+        uint64_t *words, uint64_t *count, uint64_t *origin) __attribute__((weak));
+
+/* The untrusted event of a TCS is a futex word owned by the uRTS: 0 when
+ * idle, -1 while its thread sleeps outside and positive when a wakeup is
+ * pending. The uRTS keeps one word per enclave page, so the word of a TCS
+ * is indexed by the page of the TCS. A wakeup for a thread that is not
+ * asleep, and a wait that finds a wakeup pending, only need an atomic
+ * update of the word. The word can't be trusted, but a bad value only
+ * causes spurious or lost wakeups, which the host can cause anyway.
+ */
+#define EVENT_WORDS_UNKNOWN     0
+#define EVENT_WORDS_PENDING     1
+#define EVENT_WORDS_READY       2
+#define EVENT_WORDS_NONE        3
+
+static uint32_t g_event_words_state = EVENT_WORDS_UNKNOWN;
+static int *g_event_words = NULL;
+static size_t g_event_word_count = 0;
+
+static void init_event_words(void)
+{
+    uint32_t state = EVENT_WORDS_UNKNOWN;
+    if (!__atomic_compare_exchange_n(&g_event_words_state, &state, EVENT_WORDS_PENDING,
+                false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        return;
+
+    int ret = -1;
+    uint64_t words = 0, count = 0, origin = 0;
+
+    /* The words are indexed from the enclave base the uRTS knows,
+     * so only use them if it is the one the enclave sees.
+     */
+    state = EVENT_WORDS_NONE;
+    if (sgx_thread_get_event_words_ocall != NULL
+            && sgx_thread_get_event_words_ocall(&ret, TD2TCS(get_thread_data()), &words, &count, &origin) == SGX_SUCCESS
+            && ret == 0
+            && origin == (uint64_t)(size_t)get_enclave_base()
+            && count != 0 && count <= SIZE_MAX / sizeof(int)
+            && (words & (sizeof(int) - 1)) == 0
+            && sgx_is_outside_enclave((void *)(size_t)words, (size_t)count * sizeof(int))) {
+        g_event_words = (int *)(size_t)words;
+        g_event_word_count = (size_t)count;
+        state = EVENT_WORDS_READY;
+    }
+
+    __atomic_store_n(&g_event_words_state, state, __ATOMIC_RELEASE);
+}
+
+static int *get_event_word(const void *tcs)
+{
+    uint32_t state = __atomic_load_n(&g_event_words_state, __ATOMIC_ACQUIRE);
+    if (state == EVENT_WORDS_UNKNOWN) {
+        init_event_words();
+        state = __atomic_load_n(&g_event_words_state, __ATOMIC_ACQUIRE);
+    }
+    if (state != EVENT_WORDS_READY)
+        return NULL;
+
+    size_t index = ((size_t)tcs - (size_t)get_enclave_base()) >> SE_PAGE_SHIFT;
+    if (index >= g_event_word_count)
+        return NULL;
+
+    return &g_event_words[index];
+}
+
+/* Post a wakeup, unless the owner of the word is asleep and needs a FUTEX_WAKE. */
+static bool post_event(int *word)
+{
+    int value = __atomic_load_n(word, __ATOMIC_RELAXED);
+    do {
+        if (value < 0 || value == INT_MAX)
+            return false;
+    } while (!__atomic_compare_exchange_n(word, &value, value + 1,
+                true, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED));
+    return true;
+}
+
+/* Consume a pending wakeup, if there is one. */
+static bool consume_event(int *word)
+{
+    int value = __atomic_load_n(word, __ATOMIC_RELAXED);
+    do {
+        if (value <= 0)
+            return false;
+    } while (!__atomic_compare_exchange_n(word, &value, value - 1,
+                true, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED));
+    return true;
+}
+
+int sgx_thread_wait_event(const void *self)
+{
+    int *word = get_event_word(self);
+    if (word != NULL && consume_event(word))
+        return 0;
+
+    int ret = 0;
+    sgx_thread_wait_untrusted_event_ocall(&ret, self);
+    return ret;
+}
+
+int sgx_thread_set_event(const void *waiter)
+{
+    int *word = get_event_word(waiter);
+    if (word != NULL && post_event(word))
+        return 0;
+
+    int ret = 0;
+    sgx_thread_set_untrusted_event_ocall(&ret, waiter);
+    return ret;
+}
+
+int sgx_thread_setwait_events(const void *waiter, const void *self)
+{
+    int *word = get_event_word(waiter);
+    if (word != NULL && post_event(word))
+        return sgx_thread_wait_event(self);
+
+    /* The waiter is asleep. Wake it and sleep in a single OCALL,
+     * unless a wakeup is already pending for this thread.
+     */
+    int ret = 0;
+    word = get_event_word(self);
+    if (word != NULL && consume_event(word))
+        sgx_thread_set_untrusted_event_ocall(&ret, waiter);
+    else
+        sgx_thread_setwait_untrusted_events_ocall(&ret, waiter, self);
+    return ret;
+}
+
+/* Wakes the threads that are awake in place, and packs the sleeping ones
+ * at the front of waiters for a single OCALL.
+ */
+int sgx_thread_set_multiple_events(const void **waiters, size_t total)
+{
+    size_t sleeping = 0;
+    for (size_t i = 0; i < total; i++) {
+        int *word = get_event_word(waiters[i]);
+        if (word == NULL || !post_event(word))
+            waiters[sleeping++] = waiters[i];
+    }
+    if (sleeping == 0)
+        return 0;
+
+    int ret = 0;
+    sgx_thread_set_multiple_untrusted_events_ocall(&ret, waiters, sleeping);
+    return ret;
+}
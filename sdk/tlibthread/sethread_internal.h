@@ -124,4 +124,13 @@ extern "C" sgx_status_t sgx_thread_set_untrusted_event_ocall(int* retval, const
 extern "C" sgx_status_t sgx_thread_set_multiple_untrusted_events_ocall(int* retval, const void** waiters, size_t total);
 extern "C" sgx_status_t sgx_thread_setwait_untrusted_events_ocall(int* retval, const void *waiter, const void *self);
 
+/* Untrusted event helpers. They take TCS addresses like the OCALLs above,
+ * but post and consume wakeups in the shared futex words where possible
+ * and only leave the enclave when a thread has to sleep or be woken.
+ */
+int sgx_thread_wait_event(const void *self);
+int sgx_thread_set_event(const void *waiter);
+int sgx_thread_setwait_events(const void *waiter, const void *self);
+int sgx_thread_set_multiple_events(const void **waiters, size_t total);
+
 extern "C" int sgx_thread_mutex_unlock_lazy(sgx_thread_mutex_t *mutex, sgx_thread_t *pwaiter);
@@ -36,13 +36,109 @@
 
 #include "util.h"
 #include "sethread_internal.h"
+#include "internal/global_data.h"   /* EDMM_supported */
+
+#define MUTEX_TYPE_MASK     (SGX_THREAD_MUTEX_NONRECURSIVE | SGX_THREAD_MUTEX_RECURSIVE)
+#define MUTEX_FLAGS_MASK    0xFFFF
+#define MUTEX_TYPE(m)       ((m)->m_control & MUTEX_TYPE_MASK)
+#define MUTEX_IS_ADAPTIVE(m) (((m)->m_control & SGX_THREAD_MUTEX_ADAPTIVE) != 0)
+#define MUTEX_VALID(m)      \
+    (((m)->m_control & MUTEX_FLAGS_MASK & ~SGX_THREAD_MUTEX_ADAPTIVE) == SGX_THREAD_MUTEX_RECURSIVE \
+    || ((m)->m_control & MUTEX_FLAGS_MASK & ~SGX_THREAD_MUTEX_ADAPTIVE) == SGX_THREAD_MUTEX_NONRECURSIVE)
+
+/* Adaptive mutexes keep a running average of how long a waiter spun
+ * before the owner let go, in units of MUTEX_SPIN_UNIT cycles, in the upper
+ * half of m_control. A waiter spins for about twice that long, bounded by
+ * MUTEX_SPIN_MAX cycles, which is kept below the cost of the OCALL round
+ * trip that sleeping and waking a thread takes.
+ *
+ * SGX2 processors, the ones EDMM runs on, let an enclave read the TSC, so
+ * the spin is timed with RDTSC there. Elsewhere it is counted in pause
+ * iterations of MUTEX_PAUSE_CYCLES, an estimate for recent cores.
+ */
+#define MUTEX_SPIN_SHIFT    16
+#define MUTEX_SPIN_UNIT     16
+#define MUTEX_SPIN_MIN      256
+#define MUTEX_SPIN_MAX      16384
+#define MUTEX_PAUSE_CYCLES  40
+#define MUTEX_PAUSE_CALIBRATE_LOOPS 256
+
+static uint32_t g_pause_cycles;     /* 0 until calibrated */
+
+static inline uint64_t mutex_rdtsc(void)
+{
+    uint32_t lo, hi;
+    __asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static uint32_t mutex_pause_cycles(void)
+{
+    uint32_t cycles = g_pause_cycles;
+    if (cycles != 0)
+        return cycles;
+
+    cycles = MUTEX_PAUSE_CYCLES;
+    if (EDMM_supported) {
+        uint64_t start = mutex_rdtsc();
+        for (uint32_t i = 0; i < MUTEX_PAUSE_CALIBRATE_LOOPS; i++)
+            __asm__ __volatile__("pause" : : : "memory");
+        uint64_t measured = (mutex_rdtsc() - start) / MUTEX_PAUSE_CALIBRATE_LOOPS;
+        cycles = measured != 0 ? (uint32_t)measured : 1;
+    }
+    g_pause_cycles = cycles;
+    return cycles;
+}
+
+static inline uint32_t mutex_spin_budget(const sgx_thread_mutex_t *mutex)
+{
+    uint32_t budget = (mutex->m_control >> MUTEX_SPIN_SHIFT) * MUTEX_SPIN_UNIT * 2 + MUTEX_SPIN_MIN;
+    return budget < MUTEX_SPIN_MAX ? budget : MUTEX_SPIN_MAX;
+}
+
+/* Fold the cycles of the last spin into the average. Called with m_lock held. */
+static inline void mutex_spin_update(sgx_thread_mutex_t *mutex, uint32_t cycles)
+{
+    int32_t avg = (int32_t)(mutex->m_control >> MUTEX_SPIN_SHIFT);
+    avg += ((int32_t)(cycles / MUTEX_SPIN_UNIT) - avg) / 8;
+    mutex->m_control = (mutex->m_control & MUTEX_FLAGS_MASK) | ((uint32_t)avg << MUTEX_SPIN_SHIFT);
+}
+
+/* Spin without holding m_lock until the owner releases the mutex or the
+ * budget, in cycles, runs out. Returns the cycles spent.
+ */
+static uint32_t mutex_spin_wait(sgx_thread_mutex_t *mutex, uint32_t budget)
+{
+    uint32_t pause_cycles = mutex_pause_cycles();
+    uint32_t cycles = 0;
+    uint64_t start = EDMM_supported ? mutex_rdtsc() : 0;
+
+    while (cycles < budget
+            && *(volatile sgx_thread_t *)&mutex->m_owner != SGX_THREAD_T_NULL) {
+        __asm__ __volatile__("pause" : : : "memory");
+        if (EDMM_supported)
+            cycles = (uint32_t)(mutex_rdtsc() - start);
+        else
+            cycles += pause_cycles;
+    }
+    return cycles;
+}
 
-int sgx_thread_mutex_init(sgx_thread_mutex_t *mutex, const sgx_thread_mutexattr_t *unused)
+int sgx_thread_mutex_init(sgx_thread_mutex_t *mutex, const sgx_thread_mutexattr_t *attr)
 {
-    UNUSED(unused);
     CHECK_PARAMETER(mutex);
 
-    mutex->m_control = SGX_THREAD_MUTEX_NONRECURSIVE;
+    uint32_t type = SGX_THREAD_MUTEX_NONRECURSIVE;
+    if (attr != NULL) {
+        type = attr->m_type;
+        if ((type & ~(MUTEX_TYPE_MASK | SGX_THREAD_MUTEX_ADAPTIVE)) != 0
+            || (type & MUTEX_TYPE_MASK) == MUTEX_TYPE_MASK)
+            return EINVAL;
+        if ((type & MUTEX_TYPE_MASK) == 0)
+            type |= SGX_THREAD_MUTEX_NONRECURSIVE;
+    }
+
+    mutex->m_control = type;
     mutex->m_refcount = 0;
     mutex->m_owner = SGX_THREAD_T_NULL;
     mutex->m_lock = SGX_SPINLOCK_INITIALIZER;
@@ -76,17 +172,23 @@ int sgx_thread_mutex_lock(sgx_thread_mutex_t *mutex)
     CHECK_PARAMETER(mutex);
 
     sgx_thread_t self = (sgx_thread_t)get_thread_data();
+    uint32_t spun_cycles = 0;
+    bool spun = false, tuned = false;
 
     while (1) {
         SPIN_LOCK(&mutex->m_lock);
 
-        if(mutex->m_control != SGX_THREAD_MUTEX_RECURSIVE
-            && mutex->m_control != SGX_THREAD_MUTEX_NONRECURSIVE) {
+        if(!MUTEX_VALID(mutex)) {
             SPIN_UNLOCK(&mutex->m_lock);
             return EINVAL;
         }
+
+        if (spun && !tuned) {
+            mutex_spin_update(mutex, spun_cycles);
+            tuned = true;
+        }
         
-        if (mutex->m_control == SGX_THREAD_MUTEX_RECURSIVE
+        if (MUTEX_TYPE(mutex) == SGX_THREAD_MUTEX_RECURSIVE
             && mutex->m_owner == self) {
             mutex->m_refcount++;
             SPIN_UNLOCK(&mutex->m_lock);
@@ -106,6 +208,19 @@ int sgx_thread_mutex_lock(sgx_thread_mutex_t *mutex)
             return 0;
         }
 
+        /* Spin once before sleeping, unless other threads are already
+         * queued: they have priority over us once the owner unlocks.
+         */
+        if (MUTEX_IS_ADAPTIVE(mutex) && !spun
+            && QUEUE_FIRST(&mutex->m_queue) == SGX_THREAD_T_NULL) {
+            uint32_t budget = mutex_spin_budget(mutex);
+            SPIN_UNLOCK(&mutex->m_lock);
+
+            spun_cycles = mutex_spin_wait(mutex, budget);
+            spun = true;
+            continue;
+        }
+
         sgx_thread_t waiter = SGX_THREAD_T_NULL;
         QUEUE_FOREACH(waiter, &mutex->m_queue) {
             if (waiter == self) break;
@@ -116,8 +231,7 @@ int sgx_thread_mutex_lock(sgx_thread_mutex_t *mutex)
 
         SPIN_UNLOCK(&mutex->m_lock);
 
-        int err = 0;
-        sgx_thread_wait_untrusted_event_ocall(&err, TD2TCS(self));
+        sgx_thread_wait_event(TD2TCS(self));
     }
 
     /* NOTREACHED */
@@ -131,13 +245,12 @@ int sgx_thread_mutex_trylock(sgx_thread_mutex_t *mutex)
 
     SPIN_LOCK(&mutex->m_lock);
 
-    if(mutex->m_control != SGX_THREAD_MUTEX_RECURSIVE
-        && mutex->m_control != SGX_THREAD_MUTEX_NONRECURSIVE) {
+    if(!MUTEX_VALID(mutex)) {
         SPIN_UNLOCK(&mutex->m_lock);
         return EINVAL;
     }
     
-    if (mutex->m_control == SGX_THREAD_MUTEX_RECURSIVE
+    if (MUTEX_TYPE(mutex) == SGX_THREAD_MUTEX_RECURSIVE
         && mutex->m_owner == self) {
         mutex->m_refcount++;
         SPIN_UNLOCK(&mutex->m_lock);
@@ -173,8 +286,7 @@ int sgx_thread_mutex_unlock_lazy(sgx_thread_mutex_t *mutex, sgx_thread_t *pwaite
 
     SPIN_LOCK(&mutex->m_lock);
     
-    if(mutex->m_control != SGX_THREAD_MUTEX_RECURSIVE
-        && mutex->m_control != SGX_THREAD_MUTEX_NONRECURSIVE) {
+    if(!MUTEX_VALID(mutex)) {
         SPIN_UNLOCK(&mutex->m_lock);
         return EINVAL;
     }
@@ -221,7 +333,7 @@ int sgx_thread_mutex_unlock(sgx_thread_mutex_t *mutex)
     if (ret != 0) return ret;
 
     if (waiter != SGX_THREAD_T_NULL) /* wake the waiter up*/
-        sgx_thread_set_untrusted_event_ocall(&ret, TD2TCS(waiter));
+        sgx_thread_set_event(TD2TCS(waiter));
 
     return 0;
 }
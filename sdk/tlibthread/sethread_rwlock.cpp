@@ -117,11 +117,10 @@ int sgx_thread_rwlock_rdlock(sgx_thread_rwlock_t *rwlock)
 
         while (1)
         {
-            int err = 0;
             SPIN_UNLOCK(&rwlock->m_lock);
 
-            //make an OCall to wait for the lock
-            sgx_thread_wait_untrusted_event_ocall(&err, TD2TCS(self));
+            //wait for the lock, leaving the enclave unless a wakeup is pending
+            sgx_thread_wait_event(TD2TCS(self));
 
             SPIN_LOCK(&rwlock->m_lock);
 
@@ -208,11 +207,10 @@ int sgx_thread_rwlock_wrlock(sgx_thread_rwlock_t *rwlock)
 
         while (1)
         {
-            int err = 0;
             SPIN_UNLOCK(&rwlock->m_lock);
 
-            //make an OCall to wait for the lock
-            sgx_thread_wait_untrusted_event_ocall(&err, TD2TCS(self));
+            //wait for the lock, leaving the enclave unless a wakeup is pending
+            sgx_thread_wait_event(TD2TCS(self));
             
             SPIN_LOCK(&rwlock->m_lock);
 
@@ -295,7 +293,7 @@ int sgx_thread_rwlock_rdunlock(sgx_thread_rwlock_t *rwlock)
         SPIN_UNLOCK(&rwlock->m_lock);
         
         if (waiter != SGX_THREAD_T_NULL) /* wake the waiter up*/
-            sgx_thread_set_untrusted_event_ocall(&ret, TD2TCS(waiter));
+            ret = sgx_thread_set_event(TD2TCS(waiter));
     }
     else
     {
@@ -346,7 +344,7 @@ int sgx_thread_rwlock_wrunlock(sgx_thread_rwlock_t *rwlock)
         SPIN_UNLOCK(&rwlock->m_lock);
         
         /* wake all the queued threads up*/
-        sgx_thread_set_multiple_untrusted_events_ocall(&ret, ppWaiters, iCount);
+        ret = sgx_thread_set_multiple_events(ppWaiters, iCount);
         free(ppWaiters);
     }
     else
@@ -357,7 +355,7 @@ int sgx_thread_rwlock_wrunlock(sgx_thread_rwlock_t *rwlock)
         if (waiter != SGX_THREAD_T_NULL)
         {
             /* wake the waiter up*/
-            sgx_thread_set_untrusted_event_ocall(&ret, TD2TCS(waiter));
+            ret = sgx_thread_set_event(TD2TCS(waiter));
         }
     }
 
@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "sgx_arena.h"
+#include "sgx_rsrv_mem_mngr.h"
+#include "sgx_thread.h"
+#include "util.h"
+#include <stdlib.h>
+#include <stdint.h>
+
+/* Per-TCS bump region. The region is taken from the reserved memory area the
+ * first time a thread allocates from its arena and is kept for the lifetime of
+ * the enclave, so later ecalls on the same TCS reuse it without any locking.
+ *
+ * The thread local storage of a TCS is reset on every root ECALL unless the
+ * TCS is bound, so arenas are kept on a global list keyed by the thread data
+ * of the TCS, and the thread local pointer only saves the list walk.
+ */
+typedef struct _arena_t
+{
+    struct _arena_t *next;  /* all arenas, never freed */
+    sgx_thread_t owner;     /* thread data of the TCS */
+    uint8_t *base;          /* NULL if reserved memory could not be allocated */
+    size_t   top;
+} arena_t;
+
+static arena_t * volatile g_arena_list = NULL;
+static __thread arena_t *t_arena = NULL;
+
+static arena_t *get_arena(void)
+{
+    sgx_thread_t owner = sgx_thread_self();
+    arena_t *arena = t_arena;
+
+    if (arena != NULL && arena->owner == owner)
+        return arena;
+    if (owner == SGX_THREAD_T_NULL)
+        return NULL;
+
+    for (arena = g_arena_list; arena != NULL; arena = arena->next)
+    {
+        if (arena->owner == owner)
+            break;
+    }
+    if (arena == NULL)
+    {
+        arena = (arena_t *)calloc(1, sizeof(arena_t));
+        if (arena == NULL)
+            return NULL;
+        arena->owner = owner;
+        arena->base = (uint8_t *)sgx_alloc_rsrv_mem(SGX_ARENA_SIZE);
+        do {
+            arena->next = g_arena_list;
+        } while (!__sync_bool_compare_and_swap(&g_arena_list, arena->next, arena));
+    }
+    t_arena = arena;
+    return arena;
+}
+
+extern "C" sgx_arena_mark_t sgx_arena_begin(void)
+{
+    const arena_t *arena = get_arena();
+
+    return arena != NULL ? arena->top : 0;
+}
+
+extern "C" void *sgx_arena_alloc(size_t size)
+{
+    if (size == 0 || size > SGX_ARENA_SIZE)
+        return NULL;
+
+    arena_t *arena = get_arena();
+    if (arena == NULL || arena->base == NULL)
+        return NULL;
+
+    size = ROUND_TO(size, SGX_ARENA_ALIGN);
+    if (size > SGX_ARENA_SIZE - arena->top)
+        return NULL;
+
+    void *ptr = arena->base + arena->top;
+    arena->top += size;
+    return ptr;
+}
+
+extern "C" void sgx_arena_reset(sgx_arena_mark_t mark)
+{
+    arena_t *arena = get_arena();
+
+    if (arena != NULL && mark < arena->top)
+        arena->top = mark;
+}
+
+extern "C" int sgx_arena_contains(const void *ptr)
+{
+    const arena_t *arena = get_arena();
+
+    return arena != NULL
+        && arena->base != NULL
+        && (const uint8_t *)ptr >= arena->base
+        && (const uint8_t *)ptr < arena->base + SGX_ARENA_SIZE;
+}
+
+extern "C" void *sgx_arena_edge_malloc(size_t size)
+{
+    void *ptr = sgx_arena_alloc(size);
+    return ptr != NULL ? ptr : malloc(size);
+}
+
+extern "C" void sgx_arena_edge_free(void *ptr)
+{
+    if (ptr != NULL && !sgx_arena_contains(ptr))
+        free(ptr);
+}
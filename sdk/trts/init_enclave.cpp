@@ -181,7 +181,8 @@ extern "C" int init_enclave(void *enclave_base, void *ms)
     
     g_aexnotify_supported = feature_supported((const uint64_t *)sys_features.system_feature_set, AEXNOTIFY_BIT);
 
-    if (heap_init(get_heap_base(), get_heap_size(), get_heap_min_size(), EDMM_supported) != SGX_SUCCESS)
+    if (heap_init(get_heap_base(), get_heap_size(), get_heap_min_size(), EDMM_supported,
+                  g_global_data.heap_commit_ahead, g_global_data.heap_trim_threshold) != SGX_SUCCESS)
         return -1;
 
 #ifdef SE_SIM
@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include <string.h>
+#include "sgx_tring.h"
+#include "sgx_trts.h"
+#include "sgx_lfence.h"
+
+// Copy 'len' bytes starting at ring offset 'pos' into enclave memory.
+static void ring_copy_in(const sgx_tring_t *tring, uint64_t pos, void *dst, uint64_t len)
+{
+    uint64_t off = pos & (tring->size - 1);
+    uint64_t first = (len < tring->size - off) ? len : tring->size - off;
+
+    memcpy(dst, tring->data + off, first);
+    memcpy(reinterpret_cast<uint8_t *>(dst) + first, tring->data, len - first);
+}
+
+// Copy 'len' bytes from enclave memory to ring offset 'pos'.
+static void ring_copy_out(const sgx_tring_t *tring, uint64_t pos, const void *src, uint64_t len)
+{
+    uint64_t off = pos & (tring->size - 1);
+    uint64_t first = (len < tring->size - off) ? len : tring->size - off;
+
+    memcpy_verw(tring->data + off, src, first);
+    memcpy_verw(tring->data, reinterpret_cast<const uint8_t *>(src) + first, len - first);
+}
+
+static void ring_publish(volatile uint64_t *offset, uint64_t value)
+{
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy_verw(const_cast<uint64_t *>(offset), &value, sizeof(value));
+}
+
+//
+// sgx_tring_attach
+// Parameters:
+//      tring - the trusted handle of the ring
+//      ring - the ring in untrusted memory, SGX_RING_ALIGN-byte aligned
+//      mem_size - the size of the untrusted memory holding the ring
+// Return Value:
+//      SGX_SUCCESS or SGX_ERROR_INVALID_PARAMETER
+//
+sgx_status_t sgx_tring_attach(sgx_tring_t *tring, void *ring, size_t mem_size)
+{
+    if (tring == NULL || !sgx_is_within_enclave(tring, sizeof(*tring)))
+        return SGX_ERROR_INVALID_PARAMETER;
+    if (ring == NULL || mem_size < SGX_RING_HDR_SIZE || !sgx_is_outside_enclave(ring, mem_size))
+        return SGX_ERROR_INVALID_PARAMETER;
+    // Aligned, every 64-bit field of the header and every record length is
+    // read from untrusted memory with a single 8-byte aligned access.
+    if (reinterpret_cast<uintptr_t>(ring) & (SGX_RING_ALIGN - 1))
+        return SGX_ERROR_INVALID_PARAMETER;
+
+    sgx_ring_t *r = reinterpret_cast<sgx_ring_t *>(ring);
+    uint64_t size = r->size;
+    uint64_t head = r->head;
+    uint64_t tail = r->tail;
+
+    // The size is read once here and never again from untrusted memory.
+    if (size < 2 * SGX_RING_RECORD_ALIGN || (size & (size - 1)) || size > mem_size - SGX_RING_HDR_SIZE)
+        return SGX_ERROR_INVALID_PARAMETER;
+    if ((head | tail) & (SGX_RING_RECORD_ALIGN - 1) || tail - head > size)
+        return SGX_ERROR_INVALID_PARAMETER;
+    sgx_lfence();
+
+    tring->ring = r;
+    tring->data = SGX_RING_DATA(r);
+    tring->size = size;
+    tring->head = head;
+    tring->tail = tail;
+    return SGX_SUCCESS;
+}
+
+sgx_status_t sgx_tring_read(sgx_tring_t *tring, void *buf, size_t buf_size, size_t *len)
+{
+    if (tring == NULL || tring->ring == NULL || len == NULL)
+        return SGX_ERROR_INVALID_PARAMETER;
+    if (buf_size != 0 && (buf == NULL || !sgx_is_within_enclave(buf, buf_size)))
+        return SGX_ERROR_INVALID_PARAMETER;
+
+    uint64_t head = tring->head;
+    uint64_t tail = __atomic_load_n(&tring->ring->tail, __ATOMIC_ACQUIRE);
+    uint64_t avail = tail - head;
+    uint64_t hdr = 0;
+
+    *len = 0;
+    if (avail == 0)
+        return SGX_SUCCESS;
+    if (avail > tring->size || (avail & (SGX_RING_RECORD_ALIGN - 1)))
+        return SGX_ERROR_UNEXPECTED;
+
+    ring_copy_in(tring, head, &hdr, sizeof(hdr));
+    if (hdr == 0 || hdr > avail || SGX_RING_RECORD_SIZE(hdr) > avail)
+        return SGX_ERROR_UNEXPECTED;
+    sgx_lfence();
+
+    *len = (size_t)hdr;
+    if (hdr > buf_size)
+        return SGX_ERROR_INVALID_PARAMETER;
+
+    ring_copy_in(tring, head + sizeof(hdr), buf, hdr);
+    tring->head = head + SGX_RING_RECORD_SIZE(hdr);
+    ring_publish(&tring->ring->head, tring->head);
+    return SGX_SUCCESS;
+}
+
+sgx_status_t sgx_tring_write(sgx_tring_t *tring, const void *buf, size_t len)
+{
+    if (tring == NULL || tring->ring == NULL || len == 0 || buf == NULL)
+        return SGX_ERROR_INVALID_PARAMETER;
+    if (len > tring->size)
+        return SGX_ERROR_OUT_OF_MEMORY;
+
+    uint64_t tail = tring->tail;
+    uint64_t head = __atomic_load_n(&tring->ring->head, __ATOMIC_ACQUIRE);
+    uint64_t used = tail - head;
+    uint64_t rec = SGX_RING_RECORD_SIZE(len);
+    uint64_t hdr = len;
+
+    if (used > tring->size || (used & (SGX_RING_RECORD_ALIGN - 1)))
+        return SGX_ERROR_UNEXPECTED;
+    sgx_lfence();
+    if (rec > tring->size - used)
+        return SGX_ERROR_OUT_OF_MEMORY;
+
+    ring_copy_out(tring, tail, &hdr, sizeof(hdr));
+    ring_copy_out(tring, tail + sizeof(hdr), buf, len);
+    tring->tail = tail + rec;
+    ring_publish(&tring->ring->tail, tring->tail);
+    return SGX_SUCCESS;
+}
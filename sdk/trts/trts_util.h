@@ -54,7 +54,8 @@ int * get_errno_addr(void);
 bool is_stack_addr(void *address, size_t size);
 bool is_valid_sp(uintptr_t sp);
 
-int heap_init(void *_heap_base, size_t _heap_size, size_t _heap_min_size, int _is_edmm_supported);
+int heap_init(void *_heap_base, size_t _heap_size, size_t _heap_min_size, int _is_edmm_supported,
+              size_t _heap_commit_ahead, size_t _heap_trim_threshold);
 int feature_supported(const uint64_t *feature_set, uint32_t feature_shift);
 bool is_utility_thread();
 size_t get_max_tcs_num();
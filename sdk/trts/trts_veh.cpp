@@ -64,8 +64,94 @@ typedef struct _handler_node_t
     struct _handler_node_t   *next;
 } handler_node_t;
 
+// Immutable snapshot of the handler list, in calling order. The list is
+// only used by register/unregister; exceptions read the published table.
+typedef struct _handler_table_t
+{
+    size_t      count;
+    uintptr_t   callbacks[];
+} handler_table_t;
+
 static handler_node_t *g_first_node = NULL;
-static sgx_spinlock_t g_handler_lock = SGX_SPINLOCK_INITIALIZER;
+static sgx_spinlock_t g_handler_lock = SGX_SPINLOCK_INITIALIZER;   // serializes writers
+static handler_table_t *g_handler_table = NULL;
+
+// Readers announce themselves in one of two sets of striped counters,
+// picked by g_reader_phase, while they copy g_handler_table. A writer that
+// replaced the table flips the phase and waits for the old set to drain
+// twice (as SRCU does) before freeing the old table.
+#define VEH_READER_STRIPES  16
+typedef struct _veh_reader_count_t
+{
+    volatile uint32_t count;
+} __attribute__((aligned(64))) veh_reader_count_t;
+
+static veh_reader_count_t g_reader_count[2][VEH_READER_STRIPES];
+static volatile uint32_t g_reader_phase = 0;
+
+static inline veh_reader_count_t *veh_read_lock()
+{
+    uint32_t phase = __atomic_load_n(&g_reader_phase, __ATOMIC_ACQUIRE) & 1;
+    size_t stripe = ((size_t)get_thread_data() >> SE_PAGE_SHIFT) % VEH_READER_STRIPES;
+    veh_reader_count_t *counter = &g_reader_count[phase][stripe];
+    __atomic_add_fetch(&counter->count, 1, __ATOMIC_SEQ_CST);
+    return counter;
+}
+
+static inline void veh_read_unlock(veh_reader_count_t *counter)
+{
+    __atomic_sub_fetch(&counter->count, 1, __ATOMIC_RELEASE);
+}
+
+// Called with g_handler_lock held, after a new table has been published.
+static void veh_wait_for_readers()
+{
+    for (int flip = 0; flip < 2; flip++)
+    {
+        uint32_t phase = __atomic_fetch_add(&g_reader_phase, 1, __ATOMIC_SEQ_CST) & 1;
+        for (size_t i = 0; i < VEH_READER_STRIPES; i++)
+        {
+            while (__atomic_load_n(&g_reader_count[phase][i].count, __ATOMIC_SEQ_CST) != 0)
+                __asm__ __volatile__("pause" : : : "memory");
+        }
+    }
+}
+
+// Build the table for the list starting at 'first'. Called with g_handler_lock held.
+// Return: 0 on success, -1 when out of memory. An empty list gives a NULL table.
+static int veh_build_table(const handler_node_t *first, handler_table_t **table)
+{
+    size_t count = 0;
+    for (const handler_node_t *node = first; node != NULL; node = node->next)
+        count++;
+
+    *table = NULL;
+    if (count == 0)
+        return 0;
+
+    handler_table_t *t = (handler_table_t *)malloc(sizeof(handler_table_t) + count * sizeof(uintptr_t));
+    if (t == NULL)
+        return -1;
+
+    t->count = count;
+    count = 0;
+    for (const handler_node_t *node = first; node != NULL; node = node->next)
+        t->callbacks[count++] = node->callback;
+    *table = t;
+    return 0;
+}
+
+// Publish 'table' and free the previous one once no reader can see it.
+// Called with g_handler_lock held.
+static void veh_publish_table(handler_table_t *table)
+{
+    handler_table_t *old = __atomic_exchange_n(&g_handler_table, table, __ATOMIC_SEQ_CST);
+    if (old != NULL)
+    {
+        veh_wait_for_readers();
+        free(old);
+    }
+}
 
 static uintptr_t g_veh_cookie = 0;
 sgx_mm_pfhandler_t g_mm_pfhandler = NULL;
@@ -126,6 +212,7 @@ void *sgx_register_exception_handler(int is_first_handler, sgx_exception_handler
     // write lock
     sgx_spin_lock(&g_handler_lock);
 
+    handler_node_t *tail = NULL;
     if((g_first_node == NULL) || is_first_handler)
     {
         node->next = g_first_node;
@@ -133,14 +220,29 @@ void *sgx_register_exception_handler(int is_first_handler, sgx_exception_handler
     }
     else
     {
-        handler_node_t *tmp = g_first_node;
-        while(tmp->next != NULL)
+        tail = g_first_node;
+        while(tail->next != NULL)
         {
-            tmp = tmp->next;
+            tail = tail->next;
         }
         node->next = NULL;
-        tmp->next = node;
+        tail->next = node;
     }
+
+    handler_table_t *table = NULL;
+    if(veh_build_table(g_first_node, &table) != 0)
+    {
+        // undo the insertion
+        if(tail != NULL)
+            tail->next = NULL;
+        else
+            g_first_node = node->next;
+        sgx_spin_unlock(&g_handler_lock);
+        free(node);
+        return NULL;
+    }
+    veh_publish_table(table);
+
     // write unlock
     sgx_spin_unlock(&g_handler_lock);
 
@@ -169,22 +271,33 @@ int sgx_unregister_exception_handler(void *handler)
     if(g_first_node)
     {
         handler_node_t *node = g_first_node;
-        if(node == handler)
+        handler_node_t *prev = NULL;
+        while(node != NULL && node != handler)
         {
-            g_first_node = node->next;
-            status = 1;
+            prev = node;
+            node = node->next;
         }
-        else
+        if(node != NULL)
         {
-            while(node->next != NULL)
+            handler_node_t *next = node->next;
+            if(prev != NULL)
+                prev->next = next;
+            else
+                g_first_node = next;
+
+            handler_table_t *table = NULL;
+            if(veh_build_table(g_first_node, &table) == 0)
+            {
+                veh_publish_table(table);
+                status = 1;
+            }
+            else
             {
-                if(node->next == handler)
-                {
-                    node->next = node->next->next;
-                    status = 1;
-                    break;
-                }
-                node = node->next;
+                // keep the handler registered
+                if(prev != NULL)
+                    prev->next = node;
+                else
+                    g_first_node = node;
             }
         }
     }
@@ -332,7 +445,8 @@ static void apply_constant_time_sgxstep_mitigation_and_continue_execution(sgx_ex
 extern "C" __attribute__((regparm(1))) void internal_handle_exception(sgx_exception_info_t *info)
 {
     int status = EXCEPTION_CONTINUE_SEARCH;
-    handler_node_t *node = NULL;
+    handler_table_t *table = NULL;
+    veh_reader_count_t *reader = NULL;
     thread_data_t *thread_data = get_thread_data();
     size_t size = 0;
     uintptr_t *nhead = NULL;
@@ -368,43 +482,36 @@ extern "C" __attribute__((regparm(1))) void internal_handle_exception(sgx_except
         //restore old flag, and fall thru
         thread_data->exception_flag++;
     }
-    // read lock
-    sgx_spin_lock(&g_handler_lock);
+    // read lock, doesn't block other readers or wait for writers
+    reader = veh_read_lock();
 
-    node = g_first_node;
-    while(node != NULL)
-    {
-        size += sizeof(uintptr_t);
-        node = node->next;
-    }
+    table = __atomic_load_n(&g_handler_table, __ATOMIC_SEQ_CST);
 
     // There's no exception handler registered
-    if (size == 0)
+    if (table == NULL)
     {
-        sgx_spin_unlock(&g_handler_lock);
+        veh_read_unlock(reader);
 
         //exception cannot be handled
         thread_data->exception_flag = -1;
 
         goto exception_handling_end;
     }
-    // The customer handler may never return, use alloca instead of malloc
+    size = table->count * sizeof(uintptr_t);
+    // The customer handler may never return, so the table can't be used
+    // after the read unlock. Copy it with alloca instead of malloc
     if ((nhead = (uintptr_t *)alloca(size)) == NULL)
     {
-        sgx_spin_unlock(&g_handler_lock);
+        veh_read_unlock(reader);
         goto failed_end;
     }
-    ntmp = nhead;
-    node = g_first_node;
-    while(node != NULL)
+    for (size_t i = 0; i < table->count; i++)
     {
-        *ntmp = node->callback;
-        ntmp++;
-        node = node->next;
+        nhead[i] = table->callbacks[i];
     }
 
     // read unlock
-    sgx_spin_unlock(&g_handler_lock);
+    veh_read_unlock(reader);
 
     // decrease the nested exception count before the customer
     // handler execution, becasue the handler may never return
@@ -65,32 +65,16 @@ extern "C" sgx_status_t sgx_seal_data(const uint32_t additional_MACtext_length,
     return err;
 }
 
-extern "C" sgx_status_t sgx_seal_data_ex(const uint16_t key_policy,
-                                         const sgx_attributes_t attribute_mask,
-                                         const sgx_misc_select_t misc_mask,
-                                         const uint32_t additional_MACtext_length,
-                                         const uint8_t *p_additional_MACtext, const uint32_t text2encrypt_length,
-                                         const uint8_t *p_text2encrypt, const uint32_t sealed_data_size,
-                                         sgx_sealed_data_t *p_sealed_data)
+// Check the key policy and masks, and build a seal key request with a random key ID
+sgx_status_t sgx_seal_init_key_request(const uint16_t key_policy,
+                                       const sgx_attributes_t attribute_mask,
+                                       const sgx_misc_select_t misc_mask,
+                                       sgx_key_request_t *p_key_request)
 {
     sgx_status_t err = SGX_ERROR_UNEXPECTED;
     sgx_key_id_t keyID;
-    sgx_key_request_t tmp_key_request;
-    uint8_t payload_iv[SGX_SEAL_IV_SIZE];
-    memset(&payload_iv, 0, sizeof(payload_iv));
-
 
-    uint32_t sealedDataSize = sgx_calc_sealed_data_size(additional_MACtext_length,text2encrypt_length);
-    // Check for overflow
-    if (sealedDataSize == UINT32_MAX)
-    {
-        return SGX_ERROR_INVALID_PARAMETER;
-    }
-
-    //
-    // Check parameters
-    //
-    // check key_request->key_policy: 
+    // check key_request->key_policy:
     //  1. Reserved bits are not set
     //  2. Either MRENCLAVE or MRSIGNER is set
     if ((key_policy & ~(SGX_KEYPOLICY_MRENCLAVE | SGX_KEYPOLICY_MRSIGNER | (KEY_POLICY_KSS) | SGX_KEYPOLICY_NOISVPRODID)) ||
@@ -103,6 +87,47 @@ extern "C" sgx_status_t sgx_seal_data_ex(const uint16_t key_policy,
     {
         return SGX_ERROR_INVALID_PARAMETER;
     }
+    memset(&keyID, 0, sizeof(sgx_key_id_t));
+    memset(p_key_request, 0, sizeof(sgx_key_request_t));
+
+    // Get the report to obtain isv_svn and cpu_svn
+    const sgx_report_t *report = sgx_self_report();
+
+    // Get a random number to populate the key_id of the key_request
+    err = sgx_read_rand(reinterpret_cast<uint8_t *>(&keyID), sizeof(sgx_key_id_t));
+    if (err != SGX_SUCCESS)
+    {
+        goto clear_return;
+    }
+
+    memcpy(&(p_key_request->cpu_svn), &(report->body.cpu_svn), sizeof(sgx_cpu_svn_t));
+    memcpy(&(p_key_request->isv_svn), &(report->body.isv_svn), sizeof(sgx_isv_svn_t));
+    p_key_request->config_svn = report->body.config_svn;
+    p_key_request->key_name = SGX_KEYSELECT_SEAL;
+    p_key_request->key_policy = key_policy;
+    p_key_request->attribute_mask.flags = attribute_mask.flags;
+    p_key_request->attribute_mask.xfrm = attribute_mask.xfrm;
+    memcpy(&(p_key_request->key_id), &keyID, sizeof(sgx_key_id_t));
+    p_key_request->misc_mask = misc_mask;
+
+clear_return:
+    // Clear temp state
+    memset_s(&keyID, sizeof(sgx_key_id_t), 0, sizeof(sgx_key_id_t));
+    return err;
+}
+
+// Check the parameters of a seal operation
+sgx_status_t sgx_seal_check_params(const uint32_t additional_MACtext_length,
+                                   const uint8_t *p_additional_MACtext, const uint32_t text2encrypt_length,
+                                   const uint8_t *p_text2encrypt, const uint32_t sealed_data_size,
+                                   const sgx_sealed_data_t *p_sealed_data)
+{
+    uint32_t sealedDataSize = sgx_calc_sealed_data_size(additional_MACtext_length,text2encrypt_length);
+    // Check for overflow
+    if (sealedDataSize == UINT32_MAX)
+    {
+        return SGX_ERROR_INVALID_PARAMETER;
+    }
     if ((additional_MACtext_length > 0) && (p_additional_MACtext == NULL))
     {
         return SGX_ERROR_INVALID_PARAMETER;
@@ -126,29 +151,37 @@ extern "C" sgx_status_t sgx_seal_data_ex(const uint16_t key_policy,
     {
         return SGX_ERROR_INVALID_PARAMETER;
     }
-    memset(p_sealed_data, 0, sealedDataSize);
-    memset(&keyID, 0, sizeof(sgx_key_id_t));
-    memset(&tmp_key_request, 0, sizeof(sgx_key_request_t));
+    return SGX_SUCCESS;
+}
 
-    // Get the report to obtain isv_svn and cpu_svn
-    const sgx_report_t *report = sgx_self_report();
+extern "C" sgx_status_t sgx_seal_data_ex(const uint16_t key_policy,
+                                         const sgx_attributes_t attribute_mask,
+                                         const sgx_misc_select_t misc_mask,
+                                         const uint32_t additional_MACtext_length,
+                                         const uint8_t *p_additional_MACtext, const uint32_t text2encrypt_length,
+                                         const uint8_t *p_text2encrypt, const uint32_t sealed_data_size,
+                                         sgx_sealed_data_t *p_sealed_data)
+{
+    sgx_status_t err = SGX_ERROR_UNEXPECTED;
+    sgx_key_request_t tmp_key_request;
+    uint8_t payload_iv[SGX_SEAL_IV_SIZE];
+    memset(&payload_iv, 0, sizeof(payload_iv));
 
-    // Get a random number to populate the key_id of the key_request
-    err = sgx_read_rand(reinterpret_cast<uint8_t *>(&keyID), sizeof(sgx_key_id_t));
+    //
+    // Check parameters
+    //
+    err = sgx_seal_check_params(additional_MACtext_length, p_additional_MACtext, text2encrypt_length,
+        p_text2encrypt, sealed_data_size, p_sealed_data);
     if (err != SGX_SUCCESS)
     {
-        goto clear_return;
+        return err;
     }
-
-    memcpy(&(tmp_key_request.cpu_svn), &(report->body.cpu_svn), sizeof(sgx_cpu_svn_t));
-    memcpy(&(tmp_key_request.isv_svn), &(report->body.isv_svn), sizeof(sgx_isv_svn_t));
-    tmp_key_request.config_svn = report->body.config_svn;
-    tmp_key_request.key_name = SGX_KEYSELECT_SEAL;
-    tmp_key_request.key_policy = key_policy;
-    tmp_key_request.attribute_mask.flags = attribute_mask.flags;
-    tmp_key_request.attribute_mask.xfrm = attribute_mask.xfrm;
-    memcpy(&(tmp_key_request.key_id), &keyID, sizeof(sgx_key_id_t));
-    tmp_key_request.misc_mask = misc_mask;
+    err = sgx_seal_init_key_request(key_policy, attribute_mask, misc_mask, &tmp_key_request);
+    if (err != SGX_SUCCESS)
+    {
+        return err;
+    }
+    memset(p_sealed_data, 0, sealed_data_size);
 
     err = random_stack_advance<0x400>(sgx_seal_data_iv, additional_MACtext_length, p_additional_MACtext,
         text2encrypt_length, p_text2encrypt, payload_iv, &tmp_key_request, p_sealed_data);
@@ -158,16 +191,15 @@ extern "C" sgx_status_t sgx_seal_data_ex(const uint16_t key_policy,
         // Copy data from the temporary key request buffer to the sealed data blob
         memcpy(&(p_sealed_data->key_request), &tmp_key_request, sizeof(sgx_key_request_t));
     }
-clear_return:
-    // Clear temp state
-    memset_s(&keyID, sizeof(sgx_key_id_t), 0, sizeof(sgx_key_id_t));
     return err;
 }
 
-extern "C" sgx_status_t sgx_unseal_data(const sgx_sealed_data_t *p_sealed_data, uint8_t *p_additional_MACtext,
-                                        uint32_t *p_additional_MACtext_length, uint8_t *p_decrypted_text, uint32_t *p_decrypted_text_length)
+// Check the parameters of an unseal operation and get the lengths from the sealed data
+sgx_status_t sgx_unseal_check_params(const sgx_sealed_data_t *p_sealed_data, const uint8_t *p_additional_MACtext,
+                                     const uint32_t *p_additional_MACtext_length, const uint8_t *p_decrypted_text,
+                                     const uint32_t *p_decrypted_text_length, uint32_t *p_encrypt_text_length,
+                                     uint32_t *p_add_text_length)
 {
-    sgx_status_t err = SGX_ERROR_UNEXPECTED;
     // Ensure the the sgx_sealed_data_t members are all inside enclave before using them.
     if ((p_sealed_data == NULL) || (!sgx_is_within_enclave(p_sealed_data,sizeof(sgx_sealed_data_t))))
     {
@@ -237,6 +269,25 @@ extern "C" sgx_status_t sgx_unseal_data(const sgx_sealed_data_t *p_sealed_data,
         return SGX_ERROR_INVALID_PARAMETER;
     }
 
+    *p_encrypt_text_length = encrypt_text_length;
+    *p_add_text_length = add_text_length;
+    return SGX_SUCCESS;
+}
+
+extern "C" sgx_status_t sgx_unseal_data(const sgx_sealed_data_t *p_sealed_data, uint8_t *p_additional_MACtext,
+                                        uint32_t *p_additional_MACtext_length, uint8_t *p_decrypted_text, uint32_t *p_decrypted_text_length)
+{
+    sgx_status_t err = SGX_ERROR_UNEXPECTED;
+    uint32_t encrypt_text_length = 0;
+    uint32_t add_text_length = 0;
+
+    err = sgx_unseal_check_params(p_sealed_data, p_additional_MACtext, p_additional_MACtext_length,
+        p_decrypted_text, p_decrypted_text_length, &encrypt_text_length, &add_text_length);
+    if (err != SGX_SUCCESS)
+    {
+        return err;
+    }
+
     err = random_stack_advance<0x400>(sgx_unseal_data_helper, p_sealed_data, p_additional_MACtext, add_text_length,
         p_decrypted_text, encrypt_text_length);
     if (err == SGX_SUCCESS)
@@ -247,4 +298,3 @@ extern "C" sgx_status_t sgx_unseal_data(const sgx_sealed_data_t *p_sealed_data,
     }
     return err;
 }
-
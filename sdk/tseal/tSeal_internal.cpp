@@ -103,6 +103,31 @@ sgx_status_t sgx_seal_data_iv(const uint32_t additional_MACtext_length,
     return err;
 }
 
+// sgx_seal_get_key_request
+//
+// Parameters:
+//      p_sealed_data - [IN] pointer to the sealed data structure containing protected data
+//      p_key_request - [OUT] key request to derive the seal key with
+//      p_payload_iv - [OUT] IV of the payload, SGX_SEAL_IV_SIZE bytes
+//
+// Blobs from sgx_seal_data use an all zero IV. Blobs from a sealing session are
+// flagged in the key request and keep their IV in the reserved field; the flag
+// is not part of the key derivation.
+void sgx_seal_get_key_request(const sgx_sealed_data_t *p_sealed_data,
+    sgx_key_request_t *p_key_request, uint8_t *p_payload_iv)
+{
+    memcpy(p_key_request, &p_sealed_data->key_request, sizeof(sgx_key_request_t));
+    if (p_key_request->reserved2[SEAL_RANDOM_IV_FLAG_OFFSET] == SEAL_RANDOM_IV_FLAG)
+    {
+        p_key_request->reserved2[SEAL_RANDOM_IV_FLAG_OFFSET] = 0;
+        memcpy(p_payload_iv, p_sealed_data->reserved, SGX_SEAL_IV_SIZE);
+    }
+    else
+    {
+        memset(p_payload_iv, 0, SGX_SEAL_IV_SIZE);
+    }
+}
+
 // sgx_unseal_data_helper
 //
 // Parameters:
@@ -119,9 +144,9 @@ sgx_status_t sgx_unseal_data_helper(const sgx_sealed_data_t *p_sealed_data, uint
 {
     sgx_status_t err = SGX_ERROR_UNEXPECTED;
     randomly_placed_buffer<sgx_key_128bit_t, sizeof(sgx_key_128bit_t), 0x200> seal_key_buf{};
-
+    sgx_key_request_t key_request;
     uint8_t payload_iv[SGX_SEAL_IV_SIZE];
-    memset(&payload_iv, 0, SGX_SEAL_IV_SIZE);
+    sgx_seal_get_key_request(p_sealed_data, &key_request, payload_iv);
 
     if (decrypted_text_length > 0)
         memset(p_decrypted_text, 0, decrypted_text_length);
@@ -135,7 +160,7 @@ sgx_status_t sgx_unseal_data_helper(const sgx_sealed_data_t *p_sealed_data, uint
     cseal_key200 oseal_key_buf;
     auto* oseal_key = oseal_key_buf.instantiate_object();
     auto* seal_key = &oseal_key->v;
-    err = sgx_get_key(&p_sealed_data->key_request, seal_key);
+    err = sgx_get_key(&key_request, seal_key);
     if (err != SGX_SUCCESS)
     {
         // Clear temp state
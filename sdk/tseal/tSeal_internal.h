@@ -38,6 +38,13 @@
 
 #define KEY_POLICY_KSS  (SGX_KEYPOLICY_CONFIGID | SGX_KEYPOLICY_ISVFAMILYID | SGX_KEYPOLICY_ISVEXTPRODID)
 
+// Blobs sealed by a sealing session keep a random IV in sgx_sealed_data_t.reserved
+// and set this flag in key_request.reserved2[SEAL_RANDOM_IV_FLAG_OFFSET]. EGETKEY
+// needs reserved2 to be zero, so SDKs that don't know the flag refuse the blob
+// instead of decrypting it with the wrong IV.
+#define SEAL_RANDOM_IV_FLAG_OFFSET  0
+#define SEAL_RANDOM_IV_FLAG         0x01
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -47,10 +54,27 @@ extern "C" {
         const uint8_t *p_text2encrypt, const uint8_t *p_payload_iv,
         const sgx_key_request_t* p_key_request, sgx_sealed_data_t *p_sealed_data);
 
+    void sgx_seal_get_key_request(const sgx_sealed_data_t *p_sealed_data,
+        sgx_key_request_t *p_key_request, uint8_t *p_payload_iv);
+
     sgx_status_t sgx_unseal_data_helper(const sgx_sealed_data_t *p_sealed_data, uint8_t *p_additional_MACtext,
         uint32_t additional_MACtext_length, uint8_t *p_decrypted_text,
         uint32_t decrypted_text_length);
 
+    sgx_status_t sgx_seal_init_key_request(const uint16_t key_policy,
+        const sgx_attributes_t attribute_mask, const sgx_misc_select_t misc_mask,
+        sgx_key_request_t *p_key_request);
+
+    sgx_status_t sgx_seal_check_params(const uint32_t additional_MACtext_length,
+        const uint8_t *p_additional_MACtext, const uint32_t text2encrypt_length,
+        const uint8_t *p_text2encrypt, const uint32_t sealed_data_size,
+        const sgx_sealed_data_t *p_sealed_data);
+
+    sgx_status_t sgx_unseal_check_params(const sgx_sealed_data_t *p_sealed_data,
+        const uint8_t *p_additional_MACtext, const uint32_t *p_additional_MACtext_length,
+        const uint8_t *p_decrypted_text, const uint32_t *p_decrypted_text_length,
+        uint32_t *p_encrypt_text_length, uint32_t *p_add_text_length);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,416 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+
+// tSeal_session.cpp - Sealing sessions with cached seal keys
+
+#include <sgx_secure_align.h>
+#include <sgx_random_buffers.h>
+#include "sgx_tseal.h"
+#include <stdlib.h>
+#include <string.h>
+#include "sgx_trts.h"
+#include "sgx_utils.h"
+#include "sgx_spinlock.h"
+#include "sgx_lfence.h"
+#include "tSeal_internal.h"
+
+// Number of foreign key requests whose keys are kept for unsealing
+#define SEAL_SESSION_UNSEAL_KEYS    8
+// Expanded keys kept per key request. An AES-GCM state can't be used by two
+// threads at once, so every concurrent caller takes one of its own.
+#define SEAL_SESSION_IDLE_STATES    4
+// Random 96-bit IVs are limited to 2^32 messages per key (NIST SP 800-38D),
+// the session moves to a new key ID before that
+#define SEAL_SESSION_MAX_SEALS      (1ULL << 32)
+
+typedef struct _seal_session_key_t
+{
+    sgx_key_request_t       key_request;
+    uint32_t                idle_count;
+    sgx_aes_state_handle_t  idle_states[SEAL_SESSION_IDLE_STATES];
+} seal_session_key_t;
+
+// The lock only covers the key cache and the seal count. AES runs outside it
+// on a state that belongs to the calling thread until it is put back.
+struct _sgx_seal_session_t
+{
+    sgx_spinlock_t      lock;
+    uint16_t            key_policy;
+    sgx_attributes_t    attribute_mask;
+    sgx_misc_select_t   misc_mask;
+    seal_session_key_t  seal_key;
+    uint64_t            seal_count;
+    seal_session_key_t  unseal_keys[SEAL_SESSION_UNSEAL_KEYS];
+    uint32_t            next_unseal_key;
+};
+
+// Run EGETKEY for p_key_request and expand the key into an AES-GCM state.
+// The raw key is cleared before returning.
+static sgx_status_t seal_session_derive_key(const sgx_key_request_t *p_key_request,
+                                            sgx_aes_state_handle_t *p_key_state)
+{
+    sgx_status_t err = SGX_ERROR_UNEXPECTED;
+
+    using cseal_key200 = randomly_placed_object<sgx::custom_alignment_aligned<sgx_key_128bit_t, sizeof(sgx_key_128bit_t), 0, sizeof(sgx_key_128bit_t)>, 0x200>;
+    cseal_key200 oseal_key_buf;
+    auto* oseal_key = oseal_key_buf.instantiate_object();
+    auto* seal_key = &oseal_key->v;
+    err = sgx_get_key(p_key_request, seal_key);
+    if (err == SGX_SUCCESS)
+    {
+        err = sgx_aes_gcm_key_init(reinterpret_cast<const uint8_t *>(seal_key), SGX_AESGCM_KEY_SIZE, p_key_state);
+    }
+    // Clear temp state
+    memset_s(seal_key, sizeof(sgx_key_128bit_t), 0, sizeof(sgx_key_128bit_t));
+    return err;
+}
+
+static void seal_session_clear_key(seal_session_key_t *p_key)
+{
+    for (uint32_t i = 0; i < p_key->idle_count; i++)
+    {
+        sgx_aes_gcm_close(p_key->idle_states[i]);
+    }
+    memset_s(p_key, sizeof(seal_session_key_t), 0, sizeof(seal_session_key_t));
+}
+
+// Find the cache entry for p_key_request. An empty entry never matches, its key
+// request is all zero and key_name is never zero. Called with the session lock held.
+static seal_session_key_t *seal_session_find_key(sgx_seal_session_t *p_session,
+                                                 const sgx_key_request_t *p_key_request)
+{
+    if (memcmp(&p_session->seal_key.key_request, p_key_request, sizeof(sgx_key_request_t)) == 0)
+    {
+        return &p_session->seal_key;
+    }
+    for (uint32_t i = 0; i < SEAL_SESSION_UNSEAL_KEYS; i++)
+    {
+        seal_session_key_t *p_key = &p_session->unseal_keys[i];
+        if (memcmp(&p_key->key_request, p_key_request, sizeof(sgx_key_request_t)) == 0)
+        {
+            return p_key;
+        }
+    }
+    return NULL;
+}
+
+// Take a free entry of the unseal key cache, evicting the oldest one.
+// Called with the session lock held.
+static seal_session_key_t *seal_session_new_key(sgx_seal_session_t *p_session)
+{
+    seal_session_key_t *p_victim = &p_session->unseal_keys[p_session->next_unseal_key];
+    p_session->next_unseal_key = (p_session->next_unseal_key + 1) % SEAL_SESSION_UNSEAL_KEYS;
+    seal_session_clear_key(p_victim);
+    return p_victim;
+}
+
+// Take an idle state for p_key_request. Returns NULL if the caller has to derive
+// one. Called with the session lock held.
+static sgx_aes_state_handle_t seal_session_take_state(sgx_seal_session_t *p_session,
+                                                      const sgx_key_request_t *p_key_request)
+{
+    seal_session_key_t *p_key = seal_session_find_key(p_session, p_key_request);
+    if (p_key == NULL || p_key->idle_count == 0)
+    {
+        return NULL;
+    }
+    return p_key->idle_states[--p_key->idle_count];
+}
+
+// Give a state back to the cache once the caller is done with it. A state for a
+// key that isn't cached gets a new unseal cache entry, so a key that was
+// rotated out stays around for the blobs it sealed.
+static void seal_session_put_state(sgx_seal_session_t *p_session,
+                                   const sgx_key_request_t *p_key_request,
+                                   sgx_aes_state_handle_t key_state)
+{
+    sgx_spin_lock(&p_session->lock);
+    seal_session_key_t *p_key = seal_session_find_key(p_session, p_key_request);
+    if (p_key == NULL)
+    {
+        p_key = seal_session_new_key(p_session);
+        memcpy(&p_key->key_request, p_key_request, sizeof(sgx_key_request_t));
+    }
+    if (p_key->idle_count < SEAL_SESSION_IDLE_STATES)
+    {
+        p_key->idle_states[p_key->idle_count++] = key_state;
+        key_state = NULL;
+    }
+    sgx_spin_unlock(&p_session->lock);
+
+    if (key_state != NULL)
+    {
+        sgx_aes_gcm_close(key_state);
+    }
+}
+
+// Start sealing under a new random key ID. The expanded keys of the old seal key
+// move to the unseal key cache. Called with the session lock held.
+static sgx_status_t seal_session_rotate_key(sgx_seal_session_t *p_session)
+{
+    sgx_status_t err = SGX_ERROR_UNEXPECTED;
+    sgx_key_request_t key_request;
+
+    err = sgx_seal_init_key_request(p_session->key_policy, p_session->attribute_mask,
+        p_session->misc_mask, &key_request);
+    if (err != SGX_SUCCESS)
+    {
+        return err;
+    }
+
+    seal_session_key_t *p_old = seal_session_new_key(p_session);
+    memcpy(p_old, &p_session->seal_key, sizeof(seal_session_key_t));
+    memset_s(&p_session->seal_key, sizeof(seal_session_key_t), 0, sizeof(seal_session_key_t));
+    memcpy(&p_session->seal_key.key_request, &key_request, sizeof(sgx_key_request_t));
+    p_session->seal_count = 0;
+    return SGX_SUCCESS;
+}
+
+extern "C" sgx_status_t sgx_seal_session_open(const uint16_t key_policy,
+                                              const sgx_attributes_t attribute_mask,
+                                              const sgx_misc_select_t misc_mask,
+                                              sgx_seal_session_t **pp_session)
+{
+    sgx_status_t err = SGX_ERROR_UNEXPECTED;
+    sgx_key_request_t key_request;
+    sgx_aes_state_handle_t key_state = NULL;
+
+    if (pp_session == NULL)
+    {
+        return SGX_ERROR_INVALID_PARAMETER;
+    }
+    *pp_session = NULL;
+
+    // Reject a bad key policy or mask here rather than on the first seal
+    err = sgx_seal_init_key_request(key_policy, attribute_mask, misc_mask, &key_request);
+    if (err != SGX_SUCCESS)
+    {
+        return err;
+    }
+
+    sgx_seal_session_t *p_session = static_cast<sgx_seal_session_t *>(malloc(sizeof(sgx_seal_session_t)));
+    if (p_session == NULL)
+    {
+        return SGX_ERROR_OUT_OF_MEMORY;
+    }
+    memset(p_session, 0, sizeof(sgx_seal_session_t));
+    p_session->lock = SGX_SPINLOCK_INITIALIZER;
+    p_session->key_policy = key_policy;
+    p_session->attribute_mask = attribute_mask;
+    p_session->misc_mask = misc_mask;
+
+    err = seal_session_derive_key(&key_request, &key_state);
+    if (err != SGX_SUCCESS)
+    {
+        free(p_session);
+        if (err != SGX_ERROR_OUT_OF_MEMORY)
+            err = SGX_ERROR_UNEXPECTED;
+        return err;
+    }
+    memcpy(&p_session->seal_key.key_request, &key_request, sizeof(sgx_key_request_t));
+    p_session->seal_key.idle_states[0] = key_state;
+    p_session->seal_key.idle_count = 1;
+
+    *pp_session = p_session;
+    return SGX_SUCCESS;
+}
+
+extern "C" sgx_status_t sgx_seal_session_seal(sgx_seal_session_t *p_session,
+                                              const uint32_t additional_MACtext_length,
+                                              const uint8_t *p_additional_MACtext,
+                                              const uint32_t text2encrypt_length,
+                                              const uint8_t *p_text2encrypt,
+                                              const uint32_t sealed_data_size,
+                                              sgx_sealed_data_t *p_sealed_data)
+{
+    sgx_status_t err = SGX_ERROR_UNEXPECTED;
+    sgx_aes_state_handle_t key_state = NULL;
+    uint8_t payload_iv[SGX_SEAL_IV_SIZE];
+
+    if (p_session == NULL)
+    {
+        return SGX_ERROR_INVALID_PARAMETER;
+    }
+    err = sgx_seal_check_params(additional_MACtext_length, p_additional_MACtext, text2encrypt_length,
+        p_text2encrypt, sealed_data_size, p_sealed_data);
+    if (err != SGX_SUCCESS)
+    {
+        return err;
+    }
+    memset(p_sealed_data, 0, sealed_data_size);
+
+    // Every record gets its own IV since the key is shared by the whole session
+    err = sgx_read_rand(payload_iv, sizeof(payload_iv));
+    if (err != SGX_SUCCESS)
+    {
+        return err;
+    }
+
+    // The seal count is taken before encrypting, a failed record still uses up an IV
+    sgx_spin_lock(&p_session->lock);
+    if (p_session->seal_count >= SEAL_SESSION_MAX_SEALS)
+    {
+        err = seal_session_rotate_key(p_session);
+        if (err != SGX_SUCCESS)
+        {
+            sgx_spin_unlock(&p_session->lock);
+            return err;
+        }
+    }
+    p_session->seal_count++;
+    memcpy(&p_sealed_data->key_request, &p_session->seal_key.key_request, sizeof(sgx_key_request_t));
+    key_state = seal_session_take_state(p_session, &p_sealed_data->key_request);
+    sgx_spin_unlock(&p_session->lock);
+
+    if (key_state == NULL)
+    {
+        err = seal_session_derive_key(&p_sealed_data->key_request, &key_state);
+        if (err != SGX_SUCCESS)
+        {
+            memset_s(p_sealed_data, sealed_data_size, 0, sealed_data_size);
+            if (err != SGX_ERROR_OUT_OF_MEMORY)
+                err = SGX_ERROR_UNEXPECTED;
+            return err;
+        }
+    }
+
+    err = sgx_aes_gcm_key_encrypt(key_state, p_text2encrypt, text2encrypt_length,
+        p_sealed_data->aes_data.payload, payload_iv, SGX_SEAL_IV_SIZE,
+        p_additional_MACtext, additional_MACtext_length,
+        reinterpret_cast<sgx_aes_gcm_128bit_tag_t *>(&p_sealed_data->aes_data.payload_tag));
+    seal_session_put_state(p_session, &p_sealed_data->key_request, key_state);
+
+    if (err == SGX_SUCCESS)
+    {
+        // Copy additional MAC text
+        if (additional_MACtext_length > 0)
+        {
+            memcpy(&(p_sealed_data->aes_data.payload[text2encrypt_length]), p_additional_MACtext, additional_MACtext_length);
+        }
+        p_sealed_data->key_request.reserved2[SEAL_RANDOM_IV_FLAG_OFFSET] = SEAL_RANDOM_IV_FLAG;
+        memcpy(p_sealed_data->reserved, payload_iv, SGX_SEAL_IV_SIZE);
+        p_sealed_data->plain_text_offset = text2encrypt_length;
+        p_sealed_data->aes_data.payload_size = additional_MACtext_length + text2encrypt_length;
+    }
+    else
+    {
+        memset_s(p_sealed_data, sealed_data_size, 0, sealed_data_size);
+    }
+    return err;
+}
+
+extern "C" sgx_status_t sgx_seal_session_unseal(sgx_seal_session_t *p_session,
+                                                const sgx_sealed_data_t *p_sealed_data,
+                                                uint8_t *p_additional_MACtext,
+                                                uint32_t *p_additional_MACtext_length,
+                                                uint8_t *p_decrypted_text,
+                                                uint32_t *p_decrypted_text_length)
+{
+    sgx_status_t err = SGX_ERROR_UNEXPECTED;
+    sgx_aes_state_handle_t key_state = NULL;
+    sgx_key_request_t key_request;
+    uint8_t payload_iv[SGX_SEAL_IV_SIZE];
+    uint32_t encrypt_text_length = 0;
+    uint32_t add_text_length = 0;
+
+    if (p_session == NULL)
+    {
+        return SGX_ERROR_INVALID_PARAMETER;
+    }
+    err = sgx_unseal_check_params(p_sealed_data, p_additional_MACtext, p_additional_MACtext_length,
+        p_decrypted_text, p_decrypted_text_length, &encrypt_text_length, &add_text_length);
+    if (err != SGX_SUCCESS)
+    {
+        return err;
+    }
+    memset(p_decrypted_text, 0, encrypt_text_length);
+    if (add_text_length > 0)
+        memset(p_additional_MACtext, 0, add_text_length);
+
+    sgx_seal_get_key_request(p_sealed_data, &key_request, payload_iv);
+
+    sgx_spin_lock(&p_session->lock);
+    key_state = seal_session_take_state(p_session, &key_request);
+    sgx_spin_unlock(&p_session->lock);
+
+    if (key_state == NULL)
+    {
+        err = seal_session_derive_key(&key_request, &key_state);
+        if (err != SGX_SUCCESS)
+        {
+            // Provide only error codes that the calling code could act on
+            if ((err == SGX_ERROR_INVALID_CPUSVN) || (err == SGX_ERROR_INVALID_ISVSVN) || (err == SGX_ERROR_OUT_OF_MEMORY))
+                return err;
+            // Return error indicating the blob is corrupted
+            return SGX_ERROR_MAC_MISMATCH;
+        }
+    }
+
+    // See sgx_unseal_data_helper
+    sgx_lfence();
+
+    err = sgx_aes_gcm_key_decrypt(key_state, p_sealed_data->aes_data.payload, encrypt_text_length,
+        p_decrypted_text, payload_iv, SGX_SEAL_IV_SIZE,
+        &(p_sealed_data->aes_data.payload[encrypt_text_length]), add_text_length,
+        reinterpret_cast<const sgx_aes_gcm_128bit_tag_t *>(&p_sealed_data->aes_data.payload_tag));
+    seal_session_put_state(p_session, &key_request, key_state);
+    if (err != SGX_SUCCESS)
+    {
+        return err;
+    }
+
+    if (add_text_length > 0)
+    {
+        memcpy(p_additional_MACtext, &(p_sealed_data->aes_data.payload[encrypt_text_length]), add_text_length);
+    }
+    *p_decrypted_text_length = encrypt_text_length;
+    if (p_additional_MACtext_length != NULL)
+        *p_additional_MACtext_length = add_text_length;
+    return SGX_SUCCESS;
+}
+
+extern "C" sgx_status_t sgx_seal_session_close(sgx_seal_session_t *p_session)
+{
+    if (p_session == NULL)
+    {
+        return SGX_ERROR_INVALID_PARAMETER;
+    }
+    seal_session_clear_key(&p_session->seal_key);
+    for (uint32_t i = 0; i < SEAL_SESSION_UNSEAL_KEYS; i++)
+    {
+        seal_session_clear_key(&p_session->unseal_keys[i]);
+    }
+    memset_s(p_session, sizeof(sgx_seal_session_t), 0, sizeof(sgx_seal_session_t));
+    free(p_session);
+    return SGX_SUCCESS;
+}
@@ -37,6 +37,7 @@
 #include "cert_header.h"
 #include "sgx_dcap_tvl.h"
 #include <string.h>
+#include <time.h>
 #include <sgx_trts.h>
 
 #include "sgx_ttls_t.h"
@@ -303,7 +304,7 @@ sgx_status_t generate_cbor_evidence(uint8_t *quote, size_t quote_size,
     return SGX_SUCCESS;
 }
 
-extern "C" quote3_error_t tee_get_certificate_with_evidence(
+static quote3_error_t generate_certificate_with_evidence(
     const unsigned char *p_subject_name,
     const uint8_t *p_prv_key,
     size_t private_key_size,
@@ -332,17 +333,6 @@ extern "C" quote3_error_t tee_get_certificate_with_evidence(
     uint8_t *p_quote = NULL;
     uint32_t quote_size = 0;
 
-    if (p_subject_name == NULL ||
-        p_prv_key == NULL || private_key_size <= 0 ||
-        p_pub_key == NULL || public_key_size <= 0 ||
-        pp_output_cert == NULL || p_output_cert_size == NULL)
-        return SGX_QL_ERROR_INVALID_PARAMETER;
-
-    // only support PEM format key
-    if (strnlen(reinterpret_cast<const char*>(p_pub_key), public_key_size) != public_key_size - 1 ||
-        strnlen(reinterpret_cast<const char*>(p_prv_key), private_key_size) != private_key_size -1)
-        return SGX_QL_ERROR_INVALID_PARAMETER;
-
     do {
         // first need to get cbor claims through pub_key
         ret = generate_cbor_claims(p_pub_key, public_key_size, &claims, &claims_size);
@@ -460,6 +450,276 @@ extern "C" quote3_error_t tee_get_certificate_with_evidence(
     return func_ret;
 }
 
+/* Certificate cache
+ *
+ * Generating a quote dominates the cost of a certificate, so when enabled
+ * with tee_set_certificate_cache(), certificates are cached by a SHA-256
+ * of the subject name and key pair. The report data is derived from the
+ * public key, so it is covered by the same key. An entry is served for
+ * 'ttl' seconds. In the last fifth of that time, the first caller that
+ * finds it regenerates the certificate while the other callers still get
+ * the cached one, so busy servers refresh before the entry expires.
+ *
+ * The time comes from the host, which could stop or rewind its clock to
+ * keep serving an old quote. The cache never lets its clock go backwards,
+ * and an entry is dropped after CERT_CACHE_MAX_USES copies whatever the
+ * clock says.
+ */
+#define CERT_CACHE_DEFAULT_ENTRIES  8
+#define CERT_CACHE_MAX_ENTRIES      64
+#define CERT_CACHE_MAX_USES         1024
+
+typedef struct _cert_cache_entry_t
+{
+    uint8_t     key[SHA256_DIGEST_LENGTH];
+    uint8_t     *cert;
+    size_t      cert_size;
+    uint64_t    expire_time;
+    uint64_t    refresh_time;
+    uint64_t    last_used;
+    uint32_t    uses;
+    bool        refreshing;
+} cert_cache_entry_t;
+
+static volatile uint32_t g_cert_cache_lock = 0;
+static cert_cache_entry_t *g_cert_cache = NULL;
+static uint32_t g_cert_cache_entries = 0;
+static uint32_t g_cert_cache_ttl = 0;
+static uint64_t g_cert_cache_clock = 0;    /* latest time seen */
+
+static void cert_cache_lock()
+{
+    while (__atomic_exchange_n(&g_cert_cache_lock, 1, __ATOMIC_ACQUIRE) != 0) {
+        while (__atomic_load_n(&g_cert_cache_lock, __ATOMIC_RELAXED) != 0)
+            __asm__ __volatile__("pause" : : : "memory");
+    }
+}
+
+static void cert_cache_unlock()
+{
+    __atomic_store_n(&g_cert_cache_lock, 0, __ATOMIC_RELEASE);
+}
+
+#ifndef TDX_ENV
+/* Only present when the enclave EDL imports it from sgx_ttls.edl. */
+extern "C" sgx_status_t sgx_tls_get_time_ocall(quote3_error_t* retval, time_t *p_time) __attribute__((weak));
+#endif
+
+/* Seconds from the host clock. The TTL only bounds how long evidence is
+ * reused, so an untrusted clock can't make a certificate carry another key,
+ * and CERT_CACHE_MAX_USES bounds the reuse if the clock is held back.
+ */
+static bool cert_cache_now(uint64_t *now)
+{
+    time_t t = 0;
+#ifndef TDX_ENV
+    quote3_error_t func_ret = SGX_QL_ERROR_UNEXPECTED;
+    if (sgx_tls_get_time_ocall == NULL
+            || sgx_tls_get_time_ocall(&func_ret, &t) != SGX_SUCCESS
+            || func_ret != SGX_QL_SUCCESS)
+        return false;
+#else
+    t = time(NULL);
+#endif
+    if (t < 0)
+        return false;
+    *now = (uint64_t)t;
+    return true;
+}
+
+static bool cert_cache_key(const unsigned char *p_subject_name,
+    const uint8_t *p_prv_key, size_t private_key_size,
+    const uint8_t *p_pub_key, size_t public_key_size,
+    uint8_t key[SHA256_DIGEST_LENGTH])
+{
+    size_t subject_size = strlen(reinterpret_cast<const char*>(p_subject_name)) + 1;
+    size_t size = subject_size + public_key_size + private_key_size;
+    uint8_t *buf = (uint8_t *)malloc(size);
+    if (buf == NULL)
+        return false;
+
+    memcpy(buf, p_subject_name, subject_size);
+    memcpy(buf + subject_size, p_pub_key, public_key_size);
+    memcpy(buf + subject_size + public_key_size, p_prv_key, private_key_size);
+    bool ret = SHA256(buf, size, key) != NULL;
+
+    // the buffer holds the private key
+    memset(buf, 0, size);
+    free(buf);
+    return ret;
+}
+
+static void cert_cache_clear_entry(cert_cache_entry_t *entry)
+{
+    SGX_TLS_SAFE_FREE(entry->cert);
+    memset(entry, 0, sizeof(*entry));
+}
+
+/* Returns true with a copy of the certificate in *pp_cert when it can be
+ * served from the cache. Called with the cache locked.
+ */
+static bool cert_cache_lookup(const uint8_t *key, uint64_t now,
+    uint8_t **pp_cert, size_t *p_cert_size)
+{
+    for (uint32_t i = 0; i < g_cert_cache_entries; i++) {
+        cert_cache_entry_t *entry = &g_cert_cache[i];
+        if (entry->cert == NULL || memcmp(entry->key, key, SHA256_DIGEST_LENGTH) != 0)
+            continue;
+
+        if (now >= entry->expire_time || entry->uses >= CERT_CACHE_MAX_USES) {
+            cert_cache_clear_entry(entry);
+            return false;
+        }
+        if (now >= entry->refresh_time && !entry->refreshing) {
+            /* this caller refreshes, the others keep using the entry */
+            entry->refreshing = true;
+            return false;
+        }
+
+        uint8_t *cert = (uint8_t *)malloc(entry->cert_size);
+        if (cert == NULL)
+            return false;
+        memcpy(cert, entry->cert, entry->cert_size);
+        entry->last_used = now;
+        entry->uses++;
+        *pp_cert = cert;
+        *p_cert_size = entry->cert_size;
+        return true;
+    }
+    return false;
+}
+
+/* Store a copy of a new certificate, replacing the entry for the same key
+ * or the least recently used one. Called with the cache locked.
+ */
+static void cert_cache_store(const uint8_t *key, uint64_t now,
+    const uint8_t *p_cert, size_t cert_size)
+{
+    cert_cache_entry_t *victim = NULL;
+    for (uint32_t i = 0; i < g_cert_cache_entries; i++) {
+        cert_cache_entry_t *entry = &g_cert_cache[i];
+        if (entry->cert != NULL && memcmp(entry->key, key, SHA256_DIGEST_LENGTH) == 0) {
+            victim = entry;
+            break;
+        }
+        if (victim == NULL || entry->cert == NULL
+                || (victim->cert != NULL && entry->last_used < victim->last_used))
+            victim = entry;
+    }
+    if (victim == NULL)
+        return;
+
+    uint8_t *cert = (uint8_t *)malloc(cert_size);
+    if (cert == NULL)
+        return;
+    memcpy(cert, p_cert, cert_size);
+
+    cert_cache_clear_entry(victim);
+    memcpy(victim->key, key, SHA256_DIGEST_LENGTH);
+    victim->cert = cert;
+    victim->cert_size = cert_size;
+    victim->expire_time = now + g_cert_cache_ttl;
+    victim->refresh_time = now + g_cert_cache_ttl - g_cert_cache_ttl / 5;
+    victim->last_used = now;
+}
+
+/* Let another caller refresh the entry after a failed refresh. Called with the cache locked. */
+static void cert_cache_release(const uint8_t *key)
+{
+    for (uint32_t i = 0; i < g_cert_cache_entries; i++) {
+        cert_cache_entry_t *entry = &g_cert_cache[i];
+        if (entry->cert != NULL && memcmp(entry->key, key, SHA256_DIGEST_LENGTH) == 0)
+            entry->refreshing = false;
+    }
+}
+
+extern "C" quote3_error_t tee_set_certificate_cache(uint32_t ttl_seconds, uint32_t max_entries)
+{
+    if (max_entries > CERT_CACHE_MAX_ENTRIES)
+        return SGX_QL_ERROR_INVALID_PARAMETER;
+    if (max_entries == 0)
+        max_entries = CERT_CACHE_DEFAULT_ENTRIES;
+
+    cert_cache_entry_t *cache = NULL;
+    if (ttl_seconds != 0) {
+        cache = (cert_cache_entry_t *)calloc(max_entries, sizeof(cert_cache_entry_t));
+        if (cache == NULL)
+            return SGX_QL_ERROR_OUT_OF_MEMORY;
+    }
+
+    cert_cache_lock();
+    cert_cache_entry_t *old = g_cert_cache;
+    uint32_t old_entries = g_cert_cache_entries;
+    g_cert_cache = cache;
+    g_cert_cache_entries = cache != NULL ? max_entries : 0;
+    g_cert_cache_ttl = ttl_seconds;
+    cert_cache_unlock();
+
+    for (uint32_t i = 0; i < old_entries; i++)
+        cert_cache_clear_entry(&old[i]);
+    SGX_TLS_SAFE_FREE(old);
+
+    return SGX_QL_SUCCESS;
+}
+
+extern "C" quote3_error_t tee_get_certificate_with_evidence(
+    const unsigned char *p_subject_name,
+    const uint8_t *p_prv_key,
+    size_t private_key_size,
+    const uint8_t *p_pub_key,
+    size_t public_key_size,
+    uint8_t **pp_output_cert,
+    size_t *p_output_cert_size)
+{
+    if (p_subject_name == NULL ||
+        p_prv_key == NULL || private_key_size <= 0 ||
+        p_pub_key == NULL || public_key_size <= 0 ||
+        pp_output_cert == NULL || p_output_cert_size == NULL)
+        return SGX_QL_ERROR_INVALID_PARAMETER;
+
+    // only support PEM format key
+    if (strnlen(reinterpret_cast<const char*>(p_pub_key), public_key_size) != public_key_size - 1 ||
+        strnlen(reinterpret_cast<const char*>(p_prv_key), private_key_size) != private_key_size -1)
+        return SGX_QL_ERROR_INVALID_PARAMETER;
+
+    uint8_t key[SHA256_DIGEST_LENGTH];
+    uint64_t now = 0;
+    bool cached = __atomic_load_n(&g_cert_cache_ttl, __ATOMIC_RELAXED) != 0
+        && cert_cache_now(&now)
+        && cert_cache_key(p_subject_name, p_prv_key, private_key_size,
+                          p_pub_key, public_key_size, key);
+    if (cached) {
+        cert_cache_lock();
+        if (now < g_cert_cache_clock)
+            now = g_cert_cache_clock;
+        else
+            g_cert_cache_clock = now;
+        bool hit = g_cert_cache != NULL
+            && cert_cache_lookup(key, now, pp_output_cert, p_output_cert_size);
+        cert_cache_unlock();
+        if (hit)
+            return SGX_QL_SUCCESS;
+    }
+
+    quote3_error_t func_ret = generate_certificate_with_evidence(p_subject_name,
+        p_prv_key, private_key_size, p_pub_key, public_key_size,
+        pp_output_cert, p_output_cert_size);
+
+    if (cached) {
+        cert_cache_lock();
+        if (g_cert_cache != NULL) {
+            if (func_ret == SGX_QL_SUCCESS)
+                cert_cache_store(key, now, *pp_output_cert, *p_output_cert_size);
+            else
+                cert_cache_release(key);
+        }
+        cert_cache_unlock();
+    }
+    memset(key, 0, sizeof(key));
+
+    return func_ret;
+}
+
 extern "C" quote3_error_t tee_free_certificate(uint8_t* p_certificate)
 {
     SGX_TLS_SAFE_FREE(p_certificate);
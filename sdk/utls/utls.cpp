@@ -44,6 +44,7 @@
 
 #include <openssl/sha.h>
 #include <string.h>
+#include <time.h>
 
 static const char* oid_sgx_quote = X509_OID_FOR_QUOTE_STRING;
 
@@ -98,6 +99,15 @@ extern "C" quote3_error_t sgx_tls_get_supplemental_data_size_ocall(uint32_t *p_s
     return sgx_qv_get_quote_supplemental_data_size(p_supplemental_data_size);
 }
 
+extern "C" quote3_error_t sgx_tls_get_time_ocall(time_t *p_time)
+{
+    if (p_time == NULL)
+        return SGX_QL_ERROR_INVALID_PARAMETER;
+
+    *p_time = time(NULL);
+    return SGX_QL_SUCCESS;
+}
+
 extern "C" quote3_error_t sgx_tls_verify_quote_ocall(
     const uint8_t *p_quote,
     uint32_t quote_size,